@@ -0,0 +1,262 @@
+#include <string.h>
+#include "aead.h"
+
+#define POLY_MASK 0x3ffffff
+
+static inline uint32_t load32_le(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void store32_le(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static inline uint32_t rotl32(uint32_t v, int n) {
+    return (v << n) | (v >> (32 - n));
+}
+
+#define QUARTER_ROUND(a, b, c, d)              \
+    a += b; d ^= a; d = rotl32(d, 16);         \
+    c += d; b ^= c; b = rotl32(b, 12);         \
+    a += b; d ^= a; d = rotl32(d, 8);          \
+    c += d; b ^= c; b = rotl32(b, 7)
+
+static void chacha20_setup(uint32_t *input, const uint8_t *key, uint32_t counter, const uint8_t *nonce) {
+    input[0] = 0x61707865;  // "expand 32-byte k"
+    input[1] = 0x3320646e;
+    input[2] = 0x79622d32;
+    input[3] = 0x6b206574;
+    for (int i = 0; i < 8; i++) {
+        input[4 + i] = load32_le(key + 4 * i);
+    }
+    input[12] = counter;
+    for (int i = 0; i < 3; i++) {
+        input[13 + i] = load32_le(nonce + 4 * i);
+    }
+}
+
+static void chacha20_core(const uint32_t *input, uint8_t *out) {
+    uint32_t x[16];
+    memcpy(x, input, sizeof(x));
+    for (int i = 0; i < 10; i++) {
+        QUARTER_ROUND(x[0], x[4], x[8], x[12]);
+        QUARTER_ROUND(x[1], x[5], x[9], x[13]);
+        QUARTER_ROUND(x[2], x[6], x[10], x[14]);
+        QUARTER_ROUND(x[3], x[7], x[11], x[15]);
+        QUARTER_ROUND(x[0], x[5], x[10], x[15]);
+        QUARTER_ROUND(x[1], x[6], x[11], x[12]);
+        QUARTER_ROUND(x[2], x[7], x[8], x[13]);
+        QUARTER_ROUND(x[3], x[4], x[9], x[14]);
+    }
+    for (int i = 0; i < 16; i++) {
+        store32_le(out + 4 * i, x[i] + input[i]);
+    }
+}
+
+void aead_chacha20_block(const uint8_t *key, uint32_t counter, const uint8_t *nonce, uint8_t *out) {
+    uint32_t input[16];
+    chacha20_setup(input, key, counter, nonce);
+    chacha20_core(input, out);
+}
+
+// Poly1305 на 26-битных частях: только умножения 32x32->64, без 128-битной арифметики
+static void poly1305_blocks(aead_ctx_t *ctx, const uint8_t *m, size_t len) {
+    const uint32_t r0 = ctx->r[0], r1 = ctx->r[1], r2 = ctx->r[2], r3 = ctx->r[3], r4 = ctx->r[4];
+    const uint32_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+    uint32_t h0 = ctx->h[0], h1 = ctx->h[1], h2 = ctx->h[2], h3 = ctx->h[3], h4 = ctx->h[4];
+
+    while (len >= 16) {
+        h0 += load32_le(m + 0) & POLY_MASK;
+        h1 += (load32_le(m + 3) >> 2) & POLY_MASK;
+        h2 += (load32_le(m + 6) >> 4) & POLY_MASK;
+        h3 += (load32_le(m + 9) >> 6) & POLY_MASK;
+        h4 += (load32_le(m + 12) >> 8) | (1u << 24);
+
+        uint64_t d0 = (uint64_t)h0 * r0 + (uint64_t)h1 * s4 + (uint64_t)h2 * s3 + (uint64_t)h3 * s2 + (uint64_t)h4 * s1;
+        uint64_t d1 = (uint64_t)h0 * r1 + (uint64_t)h1 * r0 + (uint64_t)h2 * s4 + (uint64_t)h3 * s3 + (uint64_t)h4 * s2;
+        uint64_t d2 = (uint64_t)h0 * r2 + (uint64_t)h1 * r1 + (uint64_t)h2 * r0 + (uint64_t)h3 * s4 + (uint64_t)h4 * s3;
+        uint64_t d3 = (uint64_t)h0 * r3 + (uint64_t)h1 * r2 + (uint64_t)h2 * r1 + (uint64_t)h3 * r0 + (uint64_t)h4 * s4;
+        uint64_t d4 = (uint64_t)h0 * r4 + (uint64_t)h1 * r3 + (uint64_t)h2 * r2 + (uint64_t)h3 * r1 + (uint64_t)h4 * r0;
+
+        uint32_t c = (uint32_t)(d0 >> 26); h0 = (uint32_t)d0 & POLY_MASK;
+        d1 += c; c = (uint32_t)(d1 >> 26); h1 = (uint32_t)d1 & POLY_MASK;
+        d2 += c; c = (uint32_t)(d2 >> 26); h2 = (uint32_t)d2 & POLY_MASK;
+        d3 += c; c = (uint32_t)(d3 >> 26); h3 = (uint32_t)d3 & POLY_MASK;
+        d4 += c; c = (uint32_t)(d4 >> 26); h4 = (uint32_t)d4 & POLY_MASK;
+        h0 += c * 5; c = h0 >> 26; h0 &= POLY_MASK;
+        h1 += c;
+
+        m += 16;
+        len -= 16;
+    }
+
+    ctx->h[0] = h0; ctx->h[1] = h1; ctx->h[2] = h2; ctx->h[3] = h3; ctx->h[4] = h4;
+}
+
+static void poly1305_update(aead_ctx_t *ctx, const uint8_t *m, size_t len) {
+    if (ctx->buf_len) {
+        size_t n = 16 - ctx->buf_len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(ctx->buf + ctx->buf_len, m, n);
+        ctx->buf_len += n;
+        m += n;
+        len -= n;
+        if (ctx->buf_len < 16) {
+            return;
+        }
+        poly1305_blocks(ctx, ctx->buf, 16);
+        ctx->buf_len = 0;
+    }
+    size_t full = len & ~(size_t)15;
+    poly1305_blocks(ctx, m, full);
+    memcpy(ctx->buf, m + full, len - full);
+    ctx->buf_len = len - full;
+}
+
+// Дополнение нулями до границы 16 байт (как в RFC 8439)
+static void poly1305_pad16(aead_ctx_t *ctx) {
+    if (ctx->buf_len) {
+        memset(ctx->buf + ctx->buf_len, 0, 16 - ctx->buf_len);
+        poly1305_blocks(ctx, ctx->buf, 16);
+        ctx->buf_len = 0;
+    }
+}
+
+void aead_init(aead_ctx_t *ctx, const uint8_t *key, const uint8_t *nonce) {
+    uint8_t block[AEAD_BLOCK_LEN];
+    memset(ctx, 0, sizeof(*ctx));
+    chacha20_setup(ctx->input, key, 0, nonce);
+    chacha20_core(ctx->input, block);
+    ctx->input[12] = 1;
+    ctx->keystream_pos = AEAD_BLOCK_LEN;
+
+    ctx->r[0] = load32_le(block + 0) & 0x3ffffff;
+    ctx->r[1] = (load32_le(block + 3) >> 2) & 0x3ffff03;
+    ctx->r[2] = (load32_le(block + 6) >> 4) & 0x3ffc0ff;
+    ctx->r[3] = (load32_le(block + 9) >> 6) & 0x3f03fff;
+    ctx->r[4] = (load32_le(block + 12) >> 8) & 0x00fffff;
+    for (int i = 0; i < 4; i++) {
+        ctx->pad[i] = load32_le(block + 16 + 4 * i);
+    }
+    memset(block, 0, sizeof(block));
+}
+
+void aead_aad(aead_ctx_t *ctx, const uint8_t *aad, size_t len) {
+    poly1305_update(ctx, aad, len);
+    ctx->aad_len += len;
+}
+
+static void aead_begin_payload(aead_ctx_t *ctx) {
+    if (!ctx->in_payload) {
+        poly1305_pad16(ctx);
+        ctx->in_payload = true;
+    }
+}
+
+// Наложение гаммы; блоки ChaCha20 генерируются по мере необходимости
+static void chacha20_xor(aead_ctx_t *ctx, uint8_t *out, const uint8_t *in, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (ctx->keystream_pos == AEAD_BLOCK_LEN) {
+            chacha20_core(ctx->input, ctx->keystream);
+            ctx->input[12]++;
+            ctx->keystream_pos = 0;
+        }
+        out[i] = in[i] ^ ctx->keystream[ctx->keystream_pos++];
+    }
+}
+
+void aead_encrypt(aead_ctx_t *ctx, uint8_t *out, const uint8_t *in, size_t len) {
+    aead_begin_payload(ctx);
+    chacha20_xor(ctx, out, in, len);
+    poly1305_update(ctx, out, len);
+    ctx->text_len += len;
+}
+
+void aead_decrypt(aead_ctx_t *ctx, uint8_t *out, const uint8_t *in, size_t len) {
+    aead_begin_payload(ctx);
+    poly1305_update(ctx, in, len);
+    if (out) {
+        chacha20_xor(ctx, out, in, len);
+    } else {
+        // Только проверка: гамма всё равно расходуется, чтобы позиция совпадала с шифрованием
+        uint8_t scratch[16];
+        for (size_t done = 0; done < len; done += sizeof(scratch)) {
+            size_t n = len - done < sizeof(scratch) ? len - done : sizeof(scratch);
+            chacha20_xor(ctx, scratch, in + done, n);
+        }
+    }
+    ctx->text_len += len;
+}
+
+void aead_authenticate(aead_ctx_t *ctx, uint8_t *out, const uint8_t *in, size_t len) {
+    aead_begin_payload(ctx);
+    poly1305_update(ctx, in, len);
+    if (out && out != in) {
+        memcpy(out, in, len);
+    }
+    ctx->text_len += len;
+}
+
+void aead_finish(aead_ctx_t *ctx, uint8_t *tag) {
+    aead_begin_payload(ctx);
+    poly1305_pad16(ctx);
+    uint8_t lengths[16];
+    store32_le(lengths + 0, (uint32_t)ctx->aad_len);
+    store32_le(lengths + 4, (uint32_t)(ctx->aad_len >> 32));
+    store32_le(lengths + 8, (uint32_t)ctx->text_len);
+    store32_le(lengths + 12, (uint32_t)(ctx->text_len >> 32));
+    poly1305_blocks(ctx, lengths, 16);
+
+    // Полный перенос и приведение по модулю 2^130 - 5
+    uint32_t h0 = ctx->h[0], h1 = ctx->h[1], h2 = ctx->h[2], h3 = ctx->h[3], h4 = ctx->h[4];
+    uint32_t c;
+    c = h1 >> 26; h1 &= POLY_MASK;
+    h2 += c; c = h2 >> 26; h2 &= POLY_MASK;
+    h3 += c; c = h3 >> 26; h3 &= POLY_MASK;
+    h4 += c; c = h4 >> 26; h4 &= POLY_MASK;
+    h0 += c * 5; c = h0 >> 26; h0 &= POLY_MASK;
+    h1 += c;
+
+    uint32_t g0 = h0 + 5; c = g0 >> 26; g0 &= POLY_MASK;
+    uint32_t g1 = h1 + c; c = g1 >> 26; g1 &= POLY_MASK;
+    uint32_t g2 = h2 + c; c = g2 >> 26; g2 &= POLY_MASK;
+    uint32_t g3 = h3 + c; c = g3 >> 26; g3 &= POLY_MASK;
+    uint32_t g4 = h4 + c - (1u << 26);
+
+    uint32_t mask = (g4 >> 31) - 1;  // Все единицы, если h >= p
+    g0 &= mask; g1 &= mask; g2 &= mask; g3 &= mask; g4 &= mask;
+    mask = ~mask;
+    h0 = (h0 & mask) | g0;
+    h1 = (h1 & mask) | g1;
+    h2 = (h2 & mask) | g2;
+    h3 = (h3 & mask) | g3;
+    h4 = (h4 & mask) | g4;
+
+    h0 = h0 | (h1 << 26);
+    h1 = (h1 >> 6) | (h2 << 20);
+    h2 = (h2 >> 12) | (h3 << 14);
+    h3 = (h3 >> 18) | (h4 << 8);
+
+    uint64_t f;
+    f = (uint64_t)h0 + ctx->pad[0];             store32_le(tag + 0, (uint32_t)f);
+    f = (uint64_t)h1 + ctx->pad[1] + (f >> 32); store32_le(tag + 4, (uint32_t)f);
+    f = (uint64_t)h2 + ctx->pad[2] + (f >> 32); store32_le(tag + 8, (uint32_t)f);
+    f = (uint64_t)h3 + ctx->pad[3] + (f >> 32); store32_le(tag + 12, (uint32_t)f);
+
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+bool aead_verify(aead_ctx_t *ctx, const uint8_t *tag) {
+    uint8_t computed[AEAD_TAG_LEN];
+    aead_finish(ctx, computed);
+    uint8_t diff = 0;
+    for (int i = 0; i < AEAD_TAG_LEN; i++) {
+        diff |= computed[i] ^ tag[i];
+    }
+    return diff == 0;
+}
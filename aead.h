@@ -0,0 +1,81 @@
+#ifndef AEAD_H
+#define AEAD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define AEAD_KEY_LEN            32         ///< Длина ключа ChaCha20-Poly1305
+#define AEAD_NONCE_LEN          12         ///< Длина nonce
+#define AEAD_TAG_LEN            16         ///< Длина тега аутентификации
+#define AEAD_BLOCK_LEN          64         ///< Размер блока ChaCha20
+
+/**
+ * @brief Состояние потокового ChaCha20-Poly1305 (RFC 8439)
+ *
+ * Данные обрабатываются за один проход: шифрование (или расшифровка) и расчёт
+ * Poly1305 выполняются над одними и теми же байтами при копировании.
+ */
+typedef struct {
+    uint32_t input[16];                     ///< Входной блок ChaCha20 (ключ, счётчик, nonce)
+    uint8_t keystream[AEAD_BLOCK_LEN];      ///< Текущий блок гаммы
+    size_t keystream_pos;                   ///< Использовано байт гаммы
+    uint32_t r[5];                          ///< Ключ Poly1305 (26-битные части)
+    uint32_t h[5];                          ///< Аккумулятор Poly1305
+    uint32_t pad[4];                        ///< Вторая половина одноразового ключа Poly1305
+    uint8_t buf[16];                        ///< Неполный блок Poly1305
+    size_t buf_len;                         ///< Заполнено байт в buf
+    uint64_t aad_len;                       ///< Длина дополнительных данных
+    uint64_t text_len;                      ///< Длина основных данных
+    bool in_payload;                        ///< Дополнительные данные закончены
+} aead_ctx_t;
+
+/**
+ * @brief Начало операции: одноразовый ключ Poly1305 из блока 0, гамма с блока 1
+ * @param ctx Состояние
+ * @param key Ключ (AEAD_KEY_LEN байт)
+ * @param nonce Nonce (AEAD_NONCE_LEN байт, не должен повторяться для одного ключа)
+ */
+void aead_init(aead_ctx_t *ctx, const uint8_t *key, const uint8_t *nonce);
+
+/**
+ * @brief Дополнительные данные: только аутентифицируются (до основных данных)
+ */
+void aead_aad(aead_ctx_t *ctx, const uint8_t *aad, size_t len);
+
+/**
+ * @brief Шифрование основных данных с аутентификацией шифротекста
+ * @param out Буфер шифротекста (может совпадать с in)
+ */
+void aead_encrypt(aead_ctx_t *ctx, uint8_t *out, const uint8_t *in, size_t len);
+
+/**
+ * @brief Расшифровка основных данных с аутентификацией шифротекста
+ * @param out Буфер открытого текста (NULL - только аутентификация)
+ */
+void aead_decrypt(aead_ctx_t *ctx, uint8_t *out, const uint8_t *in, size_t len);
+
+/**
+ * @brief Основные данные, которые аутентифицируются и копируются без шифрования
+ * @param out Буфер назначения (NULL - только аутентификация)
+ */
+void aead_authenticate(aead_ctx_t *ctx, uint8_t *out, const uint8_t *in, size_t len);
+
+/**
+ * @brief Завершение операции и получение тега
+ */
+void aead_finish(aead_ctx_t *ctx, uint8_t *tag);
+
+/**
+ * @brief Завершение операции и сравнение тега за постоянное время
+ * @return true если тег совпадает
+ */
+bool aead_verify(aead_ctx_t *ctx, const uint8_t *tag);
+
+/**
+ * @brief Один блок ChaCha20 (используется также для вывода ключей)
+ * @param out Буфер на AEAD_BLOCK_LEN байт
+ */
+void aead_chacha20_block(const uint8_t *key, uint32_t counter, const uint8_t *nonce, uint8_t *out);
+
+#endif // AEAD_H
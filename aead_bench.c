@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#ifndef VFD_HOST_BUILD
+#include "hardware/clocks.h"
+#endif
+#include "settings.h"
+#include "logging.h"
+
+#define BENCH_ITERATIONS        256        ///< Повторов на каждое измерение
+
+typedef struct {
+    const char *name;
+    uint32_t protect;
+} protect_mode_t;
+
+static const protect_mode_t modes[] = {
+    { "xor+crc32", SETTINGS_PROTECT_CRC },
+    { "chacha20-poly1305", SETTINGS_PROTECT_AEAD },
+};
+
+static settings_record_t record;
+
+// Время в тактах системной частоты (на хосте - в наносекундах)
+static double elapsed_units(uint64_t elapsed_us) {
+#ifdef VFD_HOST_BUILD
+    return (double)elapsed_us * 1000.0;
+#else
+    return (double)elapsed_us * clock_get_hz(clk_sys) / 1e6;
+#endif
+}
+
+static bool bench_mode(const protect_mode_t *mode, const settings_t *cfg) {
+    settings_t loaded;
+    record.seq = 1;
+    record.seq_inv = ~record.seq;
+
+    uint64_t start = time_us_64();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        settings_record_seal(&record, cfg, mode->protect);
+    }
+    double seal = elapsed_units(time_us_64() - start) / BENCH_ITERATIONS;
+
+    bool ok = true;
+    start = time_us_64();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        ok &= settings_record_open(&record, &loaded);
+    }
+    double open = elapsed_units(time_us_64() - start) / BENCH_ITERATIONS;
+
+    if (!ok || strcmp(loaded.wifi_pass, cfg->wifi_pass) != 0) {
+        LOG_ERROR("%s: round trip failed", mode->name);
+        return false;
+    }
+#ifdef VFD_HOST_BUILD
+    const char *unit = "ns";
+#else
+    const char *unit = "cycles";
+#endif
+    printf(COLOR_CYAN "%-18s" COLOR_RESET " : save %9.1f %s/op, load %9.1f %s/op\n",
+           mode->name, seal, unit, open, unit);
+    return true;
+}
+
+int main(void) {
+    stdio_init_all();
+#ifndef VFD_HOST_BUILD
+    sleep_ms(1000);  // Ожидание стабилизации UART
+#endif
+
+    printf(COLOR_YELLOW "\n=== Settings Record Protection Benchmark ===\n" COLOR_RESET);
+    printf(COLOR_CYAN "Record size: " COLOR_RESET "%u bytes\n", (unsigned)sizeof(settings_record_t));
+
+    settings_t cfg;
+    settings_init_default(&cfg);
+    snprintf(cfg.wifi_pass, WIFI_PASS_MAX_LEN, "%s", "BenchPassword123");
+    cfg.flags |= FLAG_SETTINGS_ENCRYPTED;
+    log_flush();
+
+    int failed = 0;
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        if (!bench_mode(&modes[m], &cfg)) {
+            failed++;
+        }
+        log_flush();
+    }
+
+    printf(COLOR_YELLOW "=== Benchmark Completed (%d mode(s) failed) ===\n" COLOR_RESET, failed);
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Доступные реализации CRC32 (выбираются при сборке через CRC32_BACKEND)
+#define CRC32_BACKEND_BITWISE   0          ///< Побитовый расчёт (эталон, минимальный размер)
+#define CRC32_BACKEND_TABLE     1          ///< Табличный расчёт, 1 КБ таблица во флеш-памяти
+#define CRC32_BACKEND_SLICE8    2          ///< Slice-by-8, 8 байт за итерацию (7 КБ константных таблиц, на устройстве в SRAM)
+#define CRC32_BACKEND_DMA       3          ///< DMA sniffer RP2040 (CRC считается при копировании из XIP)
+
+#ifndef CRC32_BACKEND
+#define CRC32_BACKEND           CRC32_BACKEND_TABLE
+#endif
+
+#define CRC32_POLYNOMIAL        0xEDB88320 ///< Отражённый полином IEEE 802.3
+#define CRC32_INIT              0xFFFFFFFF ///< Начальное состояние и финальный XOR
+
+/**
+ * @brief Продолжение расчёта CRC32 выбранной реализацией
+ * @param crc Текущее состояние (CRC32_INIT для начала расчёта, без финального XOR)
+ * @param data Указатель на данные
+ * @param len Длина данных в байтах
+ * @return Новое состояние CRC32 (для получения результата выполнить XOR с CRC32_INIT)
+ */
+uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t len);
+
+/**
+ * @brief Копирование данных с одновременным расчётом CRC32
+ *
+ * Для CRC32_BACKEND_DMA копирование из XIP выполняет DMA, а CRC считает sniffer.
+ * Остальные реализации копируют и считают за один проход по данным.
+ * @param dst Буфер назначения (NULL - только расчёт CRC32)
+ * @param src Источник данных
+ * @param len Длина данных в байтах
+ * @return Итоговое значение CRC32 (с финальным XOR)
+ */
+uint32_t crc32_copy(void *dst, const void *src, size_t len);
+
+/**
+ * @brief Полный расчёт CRC32 (совместим с zlib/IEEE 802.3)
+ * @param data Указатель на данные
+ * @param len Длина данных в байтах
+ * @return Итоговое значение CRC32
+ */
+static inline uint32_t crc32_compute(const uint8_t *data, size_t len) {
+    return crc32_update(CRC32_INIT, data, len) ^ CRC32_INIT;
+}
+
+/**
+ * @brief Имя реализации, выбранной при сборке
+ */
+const char *crc32_backend_name(void);
+
+// Отдельные реализации (используются бенчмарком для сравнения)
+uint32_t crc32_update_bitwise(uint32_t crc, const uint8_t *data, size_t len);
+uint32_t crc32_update_table(uint32_t crc, const uint8_t *data, size_t len);
+uint32_t crc32_update_slice8(uint32_t crc, const uint8_t *data, size_t len);
+#ifdef CRC32_HAS_DMA
+uint32_t crc32_update_dma(uint32_t crc, const uint8_t *data, size_t len);
+uint32_t crc32_copy_dma(void *dst, const void *src, size_t len, uint32_t crc);
+#endif
+
+#endif // CRC32_H
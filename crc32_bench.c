@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/flash.h"
+#include "crc32.h"
+#include "settings.h"
+#include "logging.h"
+
+#define BENCH_ITERATIONS        64         ///< Повторов на каждое измерение
+#define BENCH_MAX_LEN           FLASH_SECTOR_SIZE
+
+typedef uint32_t (*crc32_kernel_t)(uint32_t crc, const uint8_t *data, size_t len);
+
+typedef struct {
+    const char *name;
+    crc32_kernel_t update;
+} crc32_backend_t;
+
+static const crc32_backend_t backends[] = {
+    { "bitwise", crc32_update_bitwise },
+    { "table",   crc32_update_table },
+    { "slice8",  crc32_update_slice8 },
+#ifdef CRC32_HAS_DMA
+    { "dma",     crc32_update_dma },
+#endif
+};
+
+static uint8_t ram_buffer[BENCH_MAX_LEN];
+
+// Проверка побитового совпадения с эталонной побитовой реализацией
+static bool verify_backend(const crc32_backend_t *backend) {
+    static const size_t lengths[] = { 1, 3, 7, 8, 9, 31, 64, sizeof(settings_t), BENCH_MAX_LEN - 3 };
+
+    if ((backend->update(CRC32_INIT, (const uint8_t *)"123456789", 9) ^ CRC32_INIT) != 0xCBF43926) {
+        LOG_ERROR("%s: check value mismatch", backend->name);
+        return false;
+    }
+    for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        for (size_t shift = 0; shift < 4; shift++) {
+            const uint8_t *data = ram_buffer + shift;
+            uint32_t expected = crc32_update_bitwise(CRC32_INIT, data, lengths[i]);
+            uint32_t actual = backend->update(CRC32_INIT, data, lengths[i]);
+            if (actual != expected) {
+                LOG_ERROR("%s: mismatch at len %u shift %u (0x%08X != 0x%08X)", backend->name,
+                          (unsigned)lengths[i], (unsigned)shift, actual, expected);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Замер пропускной способности в байтах за такт системной частоты
+static void bench_backend(const crc32_backend_t *backend, const char *source, const uint8_t *data, size_t len) {
+    volatile uint32_t sink = 0;
+    uint32_t crc = CRC32_INIT;
+
+    uint64_t start = time_us_64();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        crc = backend->update(crc, data, len);
+    }
+    uint64_t elapsed_us = time_us_64() - start;
+    sink = crc;
+    (void)sink;
+
+    double cycles = (double)elapsed_us * clock_get_hz(clk_sys) / 1e6;
+    double bytes = (double)len * BENCH_ITERATIONS;
+    printf(COLOR_CYAN "%-8s %-4s %5u B" COLOR_RESET " : %8.1f cycles/op, %6.3f bytes/cycle\n",
+           backend->name, source, (unsigned)len, cycles / BENCH_ITERATIONS, cycles > 0 ? bytes / cycles : 0.0);
+}
+
+int main(void) {
+    stdio_init_all();
+    sleep_ms(1000);  // Ожидание стабилизации UART
+
+    printf(COLOR_YELLOW "\n=== CRC32 Backend Benchmark ===\n" COLOR_RESET);
+    printf(COLOR_CYAN "Selected backend: " COLOR_RESET "%s, clk_sys %u Hz\n",
+           crc32_backend_name(), (unsigned)clock_get_hz(clk_sys));
+
+    uint32_t x = 0x12345678;
+    for (size_t i = 0; i < sizeof(ram_buffer); i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        ram_buffer[i] = (uint8_t)x;
+    }
+
+    int failed = 0;
+    static const size_t lengths[] = { sizeof(settings_t), BENCH_MAX_LEN };
+    for (size_t b = 0; b < sizeof(backends) / sizeof(backends[0]); b++) {
+        if (!verify_backend(&backends[b])) {
+            failed++;
+            log_flush();
+            continue;
+        }
+        for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+            bench_backend(&backends[b], "ram", ram_buffer, lengths[i]);
+            bench_backend(&backends[b], "xip", (const uint8_t *)XIP_BASE, lengths[i]);
+        }
+    }
+
+    printf(COLOR_YELLOW "=== Benchmark Completed (%d backend(s) failed) ===\n" COLOR_RESET, failed);
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,64 @@
+#include <stdatomic.h>
+#include "flash_async.h"
+#include "flash_utils.h"
+#include "logging.h"
+
+// Очередь с одним производителем и одним потребителем: индексы только читаются
+// и записываются атомарно, без read-modify-write (которых нет на Cortex-M0+)
+static flash_job_t queue[FLASH_ASYNC_QUEUE_LEN];
+static atomic_uint queue_head;
+static atomic_uint queue_tail;
+
+bool flash_async_submit(const flash_job_t *job) {
+    if (!job) {
+        LOG_ERROR("Null pointer passed to flash_async_submit");
+        return false;
+    }
+
+    unsigned head = atomic_load_explicit(&queue_head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&queue_tail, memory_order_acquire);
+    if (head - tail >= FLASH_ASYNC_QUEUE_LEN) {
+        LOG_WARN("Flash job queue full - job at offset 0x%08X rejected", job->offset);
+        return false;
+    }
+    queue[head % FLASH_ASYNC_QUEUE_LEN] = *job;
+    atomic_store_explicit(&queue_head, head + 1, memory_order_release);
+    return true;
+}
+
+bool flash_async_task(void) {
+    unsigned tail = atomic_load_explicit(&queue_tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&queue_head, memory_order_acquire);
+    if (tail == head) {
+        return false;
+    }
+
+    flash_job_t job = queue[tail % FLASH_ASYNC_QUEUE_LEN];
+    atomic_store_explicit(&queue_tail, tail + 1, memory_order_release);
+
+    bool ok;
+    switch (job.type) {
+    case FLASH_JOB_ERASE:
+        ok = erase_flash_sector(job.offset);
+        break;
+    case FLASH_JOB_WRITE_RANGE:
+        ok = write_flash_range(job.offset, job.data, job.len);
+        break;
+    case FLASH_JOB_PROGRAM:
+        ok = program_flash_pages(job.offset, job.data, job.len);
+        break;
+    default:
+        LOG_ERROR("Unknown flash job type %d", (int)job.type);
+        ok = false;
+        break;
+    }
+
+    if (job.callback) {
+        job.callback(ok, job.user);
+    }
+    return true;
+}
+
+size_t flash_async_pending(void) {
+    return atomic_load(&queue_head) - atomic_load(&queue_tail);
+}
@@ -0,0 +1,61 @@
+#ifndef FLASH_ASYNC_H
+#define FLASH_ASYNC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define FLASH_ASYNC_QUEUE_LEN   4          ///< Максимум заданий в очереди
+
+/**
+ * @brief Тип операции с флеш-памятью
+ */
+typedef enum {
+    FLASH_JOB_ERASE,                        ///< Стирание сектора (erase_flash_sector)
+    FLASH_JOB_WRITE_RANGE,                  ///< Запись диапазона (write_flash_range)
+    FLASH_JOB_PROGRAM,                      ///< Программирование страниц без стирания (program_flash_pages)
+} flash_job_type_t;
+
+/**
+ * @brief Функция обратного вызова по завершении задания
+ * @param ok true если операция выполнена успешно
+ * @param user Пользовательский указатель из задания
+ */
+typedef void (*flash_job_callback_t)(bool ok, void *user);
+
+/**
+ * @brief Задание на операцию с флеш-памятью
+ * @note Буфер data должен оставаться действительным до вызова callback
+ */
+typedef struct {
+    flash_job_type_t type;                  ///< Тип операции
+    uint32_t offset;                        ///< Смещение во флеш-памяти
+    const uint8_t *data;                    ///< Данные (не используются для стирания)
+    size_t len;                             ///< Длина данных
+    flash_job_callback_t callback;          ///< Обратный вызов по завершении (может быть NULL)
+    void *user;                             ///< Пользовательский указатель для callback
+} flash_job_t;
+
+/**
+ * @brief Постановка задания в очередь (возврат без ожидания операции)
+ * @param job Описание задания (копируется)
+ * @return true если задание принято, false если очередь заполнена
+ */
+bool flash_async_submit(const flash_job_t *job);
+
+/**
+ * @brief Выполнение одного задания из очереди
+ *
+ * Вызывается из главного цикла ядра, владеющего флеш-памятью. Операция выполняется
+ * в минимальном окне: второе ядро останавливается или продолжает работу из SRAM
+ * в зависимости от flash_hal_set_peer_mode.
+ * @return true если задание было выполнено
+ */
+bool flash_async_task(void);
+
+/**
+ * @brief Количество заданий, ожидающих выполнения
+ */
+size_t flash_async_pending(void);
+
+#endif // FLASH_ASYNC_H
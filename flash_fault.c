@@ -0,0 +1,54 @@
+#include <string.h>
+#include "pico/stdlib.h"
+#include "flash_hal.h"
+#include "flash_fault.h"
+#include "logging.h"
+
+// Прогон шага с отключением питания после cut единиц работы и проверка восстановления
+static bool flash_fault_cut(const flash_fault_plan_t *plan, uint32_t step, uint64_t cut) {
+    flash_hal_host_set_power_cut(cut);
+    plan->run(plan->ctx, step);
+    flash_hal_host_set_power_cut(FLASH_HAL_NO_POWER_CUT);
+    bool ok = plan->check(plan->ctx, step);
+    flash_hal_host_rollback();
+    return ok;
+}
+
+bool flash_fault_sweep(const flash_fault_plan_t *plan, flash_fault_report_t *report) {
+    if (!plan || !plan->run || !plan->check || !report) {
+        LOG_ERROR("Invalid fault injection plan");
+        return false;
+    }
+    memset(report, 0, sizeof(*report));
+    uint64_t stride = plan->stride ? plan->stride : 1;
+
+    bool done = flash_hal_host_snapshot();
+    for (uint32_t step = 0; step < plan->steps && done; step++) {
+        // Объём работы шага без сбоя
+        flash_hal_host_set_power_cut(FLASH_HAL_NO_POWER_CUT);
+        if (!plan->run(plan->ctx, step)) {
+            LOG_ERROR("Fault injection step %u failed without a power cut", (unsigned)step);
+            done = false;
+            break;
+        }
+        uint64_t units = flash_hal_host_power_units();
+        flash_hal_host_rollback();
+
+        for (uint64_t cut = 0; cut < units; cut += stride) {
+            if (!flash_fault_cut(plan, step, cut)) {
+                if (report->failures++ == 0) {
+                    report->first_failed_step = step;
+                    report->first_failed_unit = cut;
+                }
+            }
+            report->cut_points++;
+        }
+
+        // Шаг целиком становится следующей точкой восстановления
+        flash_hal_host_set_power_cut(FLASH_HAL_NO_POWER_CUT);
+        done = plan->run(plan->ctx, step) && flash_hal_host_snapshot();
+    }
+    flash_hal_host_set_power_cut(FLASH_HAL_NO_POWER_CUT);
+    flash_hal_host_snapshot_drop();
+    return done;
+}
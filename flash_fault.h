@@ -0,0 +1,59 @@
+#ifndef FLASH_FAULT_H
+#define FLASH_FAULT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Перебор точек отключения питания (только сборка для хоста).
+ *
+ * Каждый шаг сценария сначала выполняется без сбоя, чтобы узнать объём его работы,
+ * затем повторяется с отключением питания после 0, stride, 2*stride, ... единиц работы
+ * (см. flash_hal_host_set_power_cut). После каждого отключения вызывается проверка,
+ * и образ возвращается к точке восстановления перед шагом копированием изменённых
+ * секторов - сценарий с начала не повторяется. Затем шаг выполняется полностью
+ * и его результат становится следующей точкой восстановления.
+ *
+ * RAM-состояние модулей не восстанавливается: шаг и проверка должны начинаться так же,
+ * как после перезагрузки (например, с settings_load).
+ */
+
+/**
+ * @brief Шаг сценария или проверка после отключения питания
+ * @param ctx Контекст сценария
+ * @param step Номер шага (для проверки - номер прерванного шага)
+ * @return true при успехе
+ */
+typedef bool (*flash_fault_fn_t)(void *ctx, uint32_t step);
+
+/**
+ * @brief Сценарий перебора
+ */
+typedef struct {
+    flash_fault_fn_t run;                   ///< Шаг сценария (выполняется с отключением питания)
+    flash_fault_fn_t check;                 ///< Проверка восстановления после отключения
+    void *ctx;                              ///< Контекст для run и check
+    uint32_t steps;                         ///< Количество шагов
+    uint32_t stride;                        ///< Шаг перебора точек отключения в единицах работы (0 или 1 - все)
+} flash_fault_plan_t;
+
+/**
+ * @brief Результат перебора
+ */
+typedef struct {
+    uint64_t cut_points;                    ///< Проверено точек отключения
+    uint64_t failures;                      ///< Точек, после которых проверка не прошла
+    uint32_t first_failed_step;             ///< Шаг первой неудачной точки
+    uint64_t first_failed_unit;             ///< Единица работы первой неудачной точки
+} flash_fault_report_t;
+
+/**
+ * @brief Перебор точек отключения питания по всем шагам сценария
+ * @param plan Сценарий
+ * @param report Результат перебора
+ * @return true если перебор выполнен (failures может быть ненулевым), false если шаг
+ *         сценария не выполнился без сбоя или образ недоступен
+ */
+bool flash_fault_sweep(const flash_fault_plan_t *plan, flash_fault_report_t *report);
+
+#endif // FLASH_FAULT_H
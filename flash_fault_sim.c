@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "settings.h"
+#include "flash_hal.h"
+#include "flash_utils.h"
+#include "flash_fault.h"
+#include "logging.h"
+
+/*
+ * Симулятор отключения питания при сохранении настроек (только сборка для хоста).
+ *
+ * Сценарий - последовательность settings_save, проходящая кольцо журнала дважды
+ * (со стиранием секторов). Питание отключается на каждом байте программирования
+ * и каждой странице стирания; после перезагрузки settings_load() должна вернуть
+ * либо предыдущую, либо новую запись, а журнал - принять следующую запись.
+ * Каждая запись помечается номером шага в anim_lags_period_s.
+ */
+
+#define FLASH_OFFSET        (PICO_FLASH_SIZE_BYTES - SETTINGS_LOG_SIZE)
+#define SIM_PROBE_MARK      UINT16_MAX      ///< Метка записи, проверяющей журнал после сбоя
+
+static settings_t sim_cfg;
+
+// Метка записи шага; исходная запись (до первого шага) - метка 0
+static uint16_t sim_mark(uint32_t step) {
+    return (uint16_t)(step % (SIM_PROBE_MARK - 1) + 1);
+}
+
+static bool sim_run(void *ctx, uint32_t step) {
+    (void)ctx;
+    settings_t cfg;
+    if (!settings_load(&cfg, FLASH_OFFSET)) {
+        return false;
+    }
+    cfg.anim_lags_period_s = sim_mark(step);
+    cfg.brightness = (uint8_t)(step % (BRIGHTNESS_MAX + 1));
+    return settings_save(&cfg, FLASH_OFFSET);
+}
+
+static bool sim_check(void *ctx, uint32_t step) {
+    (void)ctx;
+    settings_t cfg;
+    if (!settings_load(&cfg, FLASH_OFFSET)) {
+        return false;
+    }
+    uint16_t before = step ? sim_mark(step - 1) : 0;
+    if (cfg.anim_lags_period_s != before && cfg.anim_lags_period_s != sim_mark(step)) {
+        return false;
+    }
+    if (strcmp(cfg.wifi_pass, sim_cfg.wifi_pass) != 0) {
+        return false;
+    }
+
+    // После сбоя журнал должен принимать новые записи
+    cfg.anim_lags_period_s = SIM_PROBE_MARK;
+    settings_t probe;
+    return settings_save(&cfg, FLASH_OFFSET) && settings_load(&probe, FLASH_OFFSET) &&
+           probe.anim_lags_period_s == SIM_PROBE_MARK;
+}
+
+int main(int argc, char **argv) {
+    // Аргументы: количество шагов (по умолчанию - два оборота кольца) и шаг перебора
+    uint32_t steps = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0)
+                              : 2 * SETTINGS_LOG_SECTORS * SETTINGS_SLOTS_PER_SECTOR + 1;
+    uint32_t stride = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 1;
+
+    if (!flash_hal_host_open(NULL)) {
+        fprintf(stderr, "Flash image unavailable\n");
+        return 1;
+    }
+    settings_init_default(&sim_cfg);
+    snprintf(sim_cfg.wifi_pass, WIFI_PASS_MAX_LEN, "%s", "FaultPassword123");
+    sim_cfg.anim_lags_period_s = 0;
+    if (!settings_save(&sim_cfg, FLASH_OFFSET)) {
+        fprintf(stderr, "Initial settings save failed\n");
+        return 1;
+    }
+
+    flash_fault_plan_t plan = { sim_run, sim_check, NULL, steps, stride };
+    flash_fault_report_t report;
+    uint64_t start = time_us_64();
+    bool done = flash_fault_sweep(&plan, &report);
+    double seconds = (double)(time_us_64() - start) / 1e6;
+    log_flush();
+
+    printf("Log sectors        : %u\n", (unsigned)SETTINGS_LOG_SECTORS);
+    printf("Save steps         : %u (stride %u)\n", (unsigned)steps, (unsigned)stride);
+    printf("Cut points         : %llu\n", (unsigned long long)report.cut_points);
+    printf("Failures           : %llu\n", (unsigned long long)report.failures);
+    if (report.failures) {
+        printf("First failure      : step %u, unit %llu\n", (unsigned)report.first_failed_step,
+               (unsigned long long)report.first_failed_unit);
+    }
+    printf("Elapsed            : %.2f s (%.0f cut points/min)\n", seconds,
+           seconds > 0 ? report.cut_points * 60.0 / seconds : 0.0);
+    flash_hal_host_close();
+    return done && report.failures == 0 ? 0 : 1;
+}
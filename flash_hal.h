@@ -0,0 +1,207 @@
+#ifndef FLASH_HAL_H
+#define FLASH_HAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "hardware/flash.h"
+
+/**
+ * @brief Счётчики операций с флеш-памятью
+ */
+typedef struct {
+    uint32_t erase_ops;                     ///< Количество операций стирания
+    uint32_t program_ops;                   ///< Количество операций программирования
+    uint64_t erase_bytes;                   ///< Стёрто байт
+    uint64_t program_bytes;                 ///< Запрограммировано байт
+    uint32_t program_violations;            ///< Попыток установить бит 0 -> 1 без стирания
+    uint32_t lockouts;                      ///< Остановок второго ядра на время операции
+    uint32_t xip_violations;                ///< Чтений флеш-памяти другим ядром при отключённом XIP (эмулятор)
+} flash_hal_stats_t;
+
+/**
+ * @brief Поведение второго ядра во время стирания/программирования
+ */
+typedef enum {
+    FLASH_PEER_NONE,                        ///< Второе ядро не запущено: только отключение прерываний
+    FLASH_PEER_LOCKOUT,                     ///< Второе ядро ждёт в цикле в SRAM (multicore lockout)
+    FLASH_PEER_RAM_RESIDENT,                ///< Второе ядро выполняет только код из SRAM и не останавливается
+} flash_peer_mode_t;
+
+/**
+ * @brief Стирание области флеш-памяти (заполнение 0xFF)
+ * @param offset Смещение во флеш-памяти (выровнено по FLASH_SECTOR_SIZE)
+ * @param len Длина (кратна FLASH_SECTOR_SIZE)
+ * @return true если стирание выполнено, false при неверных аргументах
+ * @note Вызывается с отключёнными прерываниями (см. flash_hal_lock)
+ */
+bool flash_hal_erase(uint32_t offset, size_t len);
+
+/**
+ * @brief Программирование области флеш-памяти (биты могут только сбрасываться в 0)
+ * @param offset Смещение во флеш-памяти (выровнено по FLASH_PAGE_SIZE)
+ * @param data Указатель на данные
+ * @param len Длина (кратна FLASH_PAGE_SIZE)
+ * @return true если программирование выполнено, false при неверных аргументах
+ * @note Вызывается с отключёнными прерываниями (см. flash_hal_lock)
+ */
+bool flash_hal_program(uint32_t offset, const uint8_t *data, size_t len);
+
+/**
+ * @brief Указатель для чтения флеш-памяти (окно XIP на устройстве)
+ * @param offset Смещение во флеш-памяти
+ * @return Указатель на данные по смещению offset
+ */
+const uint8_t *flash_hal_xip_ptr(uint32_t offset);
+
+/**
+ * @brief Указатель для проверки записанных данных в обход кэша XIP
+ *
+ * На устройстве - некэшируемое окно XIP без выделения строк кэша: чтение всегда
+ * идёт из микросхемы и не вытесняет код из кэша.
+ * @param offset Смещение во флеш-памяти
+ * @return Указатель на данные по смещению offset
+ */
+const uint8_t *flash_hal_readback_ptr(uint32_t offset);
+
+#define FLASH_HAL_UNIQUE_ID_LEN 8          ///< Длина уникального идентификатора флеш-памяти
+
+/**
+ * @brief Уникальный идентификатор микросхемы флеш-памяти (идентификатор платы на RP2040)
+ * @param id Буфер на FLASH_HAL_UNIQUE_ID_LEN байт
+ */
+void flash_hal_unique_id(uint8_t *id);
+
+/**
+ * @brief Вход в критическую секцию на время стирания/программирования
+ *
+ * Отключает прерывания текущего ядра. В режиме FLASH_PEER_LOCKOUT второе ядро
+ * предварительно останавливается в цикле в SRAM (если оно вызвало flash_hal_peer_init).
+ * @return Состояние для передачи в flash_hal_unlock
+ */
+uint32_t flash_hal_lock(void);
+
+/**
+ * @brief Выход из критической секции
+ * @param state Значение, возвращённое flash_hal_lock
+ */
+void flash_hal_unlock(uint32_t state);
+
+/**
+ * @brief Выбор поведения второго ядра во время операций (по умолчанию FLASH_PEER_LOCKOUT)
+ * @param mode Режим, см. flash_peer_mode_t
+ */
+void flash_hal_set_peer_mode(flash_peer_mode_t mode);
+
+/**
+ * @brief Регистрация второго ядра как останавливаемого (вызывается на нём при старте)
+ */
+void flash_hal_peer_init(void);
+
+/**
+ * @brief Снятие регистрации второго ядра (вызывается на нём перед завершением цикла)
+ */
+void flash_hal_peer_exit(void);
+
+/**
+ * @brief Точка остановки в цикле второго ядра
+ *
+ * На RP2040 остановка выполняется через прерывание FIFO и вызов не требуется;
+ * в эмуляторе поток второго ядра останавливается только здесь.
+ */
+void flash_hal_peer_checkpoint(void);
+
+/**
+ * @brief Получение счётчиков операций
+ * @param stats Указатель на структуру для заполнения
+ */
+void flash_hal_get_stats(flash_hal_stats_t *stats);
+
+/**
+ * @brief Сброс счётчиков операций
+ */
+void flash_hal_reset_stats(void);
+
+#ifdef VFD_HOST_BUILD
+/**
+ * @brief Подключение файла-образа флеш-памяти (только сборка для хоста)
+ *
+ * Файл создаётся (заполненный 0xFF) при отсутствии и отображается через mmap.
+ * Без явного вызова используется файл из переменной окружения VFD_FLASH_IMAGE
+ * или "vfd_flash.img" в текущем каталоге.
+ * @param path Путь к файлу-образу (NULL - анонимная память без файла)
+ * @return true если образ подключён, false в противном случае
+ */
+bool flash_hal_host_open(const char *path);
+
+/**
+ * @brief Отключение образа флеш-памяти (изменения сохраняются в файле)
+ */
+void flash_hal_host_close(void);
+
+/**
+ * @brief Имитация длительности операций (только сборка для хоста)
+ * @param erase_us Время стирания одного сектора в микросекундах
+ * @param program_us Время программирования одной страницы в микросекундах
+ */
+void flash_hal_host_set_timing(uint32_t erase_us, uint32_t program_us);
+
+/**
+ * @brief Подстановка уникального идентификатора платы (только сборка для хоста)
+ * @param id Идентификатор (FLASH_HAL_UNIQUE_ID_LEN байт, NULL - идентификатор эмулятора по умолчанию)
+ */
+void flash_hal_host_set_unique_id(const uint8_t *id);
+
+#define FLASH_HAL_NO_POWER_CUT  UINT64_MAX  ///< Отключение питания не запланировано
+
+/**
+ * @brief Отключение питания после заданного объёма работы (только сборка для хоста)
+ *
+ * Единица работы - программирование одного байта или стирание одной страницы сектора.
+ * Операция, на которой кончается запас, выполняется частично и возвращает false:
+ * при программировании следующий байт получает часть нулевых битов, при стирании
+ * следующая страница - часть единичных. Дальнейшие стирания и программирования
+ * отклоняются без изменения образа до следующего вызова.
+ * @param units Единиц работы до отключения (FLASH_HAL_NO_POWER_CUT - питание не отключается)
+ */
+void flash_hal_host_set_power_cut(uint64_t units);
+
+/**
+ * @brief Единиц работы, выполненных после flash_hal_host_set_power_cut()
+ */
+uint64_t flash_hal_host_power_units(void);
+
+/**
+ * @brief Проверка, что запланированное отключение питания произошло
+ */
+bool flash_hal_host_power_lost(void);
+
+/**
+ * @brief Имитация страницы, которая не программируется с первого раза (только сборка для хоста)
+ * @param offset Смещение страницы (выровнено по FLASH_PAGE_SIZE)
+ * @param count Сколько следующих программирований страницы оставят её без изменений
+ */
+void flash_hal_host_inject_weak_page(uint32_t offset, uint32_t count);
+
+/**
+ * @brief Точка восстановления образа с копированием при записи (только сборка для хоста)
+ *
+ * Перед первым изменением сектора после вызова его содержимое сохраняется, так что
+ * откат копирует обратно только изменённые секторы. Повторный вызов переносит
+ * точку восстановления на текущее состояние образа.
+ * @return true если точка создана, false если образ недоступен
+ */
+bool flash_hal_host_snapshot(void);
+
+/**
+ * @brief Возврат образа к точке восстановления (точка сохраняется)
+ */
+void flash_hal_host_rollback(void);
+
+/**
+ * @brief Отказ от точки восстановления: текущее состояние образа остаётся
+ */
+void flash_hal_host_snapshot_drop(void);
+#endif
+
+#endif // FLASH_HAL_H
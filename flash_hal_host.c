@@ -0,0 +1,339 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include "pico/stdlib.h"
+#include "flash_hal.h"
+#include "logging.h"
+
+// Эмулятор NOR-флеш: образ в файле, отображённом через mmap
+static uint8_t *flash_image = NULL;
+static int flash_fd = -1;
+static flash_hal_stats_t stats;
+static uint32_t erase_time_us = 0;
+static uint32_t program_time_us = 0;
+
+// Страница, которая не программируется заданное число раз
+static uint32_t weak_page = UINT32_MAX;
+static uint32_t weak_count;
+
+#define HOST_FLASH_SECTORS      (PICO_FLASH_SIZE_BYTES / FLASH_SECTOR_SIZE)
+
+// Отключение питания: запас единиц работы до отключения и выполненная работа
+static uint64_t power_cut_at = FLASH_HAL_NO_POWER_CUT;
+static uint64_t power_units;
+static bool power_lost;
+
+// Точка восстановления: исходное содержимое секторов, изменённых после flash_hal_host_snapshot()
+static bool cow_active;
+static uint8_t *cow_saved[HOST_FLASH_SECTORS];
+static bool cow_dirty[HOST_FLASH_SECTORS];
+static uint16_t cow_list[HOST_FLASH_SECTORS];
+static size_t cow_count;
+
+// Второе ядро моделируется потоком; остановка - через флаги в точках flash_hal_peer_checkpoint
+static flash_peer_mode_t peer_mode = FLASH_PEER_LOCKOUT;
+static atomic_bool peer_registered;
+static atomic_bool lockout_requested;
+static atomic_bool peer_parked;
+static atomic_bool xip_disabled;
+static atomic_uint xip_violations;
+static _Atomic(pthread_t) lock_owner;   // Читается потоком второго ядра в flash_hal_xip_ptr
+
+bool flash_hal_host_open(const char *path) {
+    flash_hal_host_close();
+
+    if (!path) {
+        flash_image = mmap(NULL, PICO_FLASH_SIZE_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (flash_image == MAP_FAILED) {
+            flash_image = NULL;
+            LOG_ERROR("Failed to allocate in-memory flash image");
+            return false;
+        }
+        memset(flash_image, 0xFF, PICO_FLASH_SIZE_BYTES);
+        return true;
+    }
+
+    flash_fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (flash_fd < 0) {
+        LOG_ERROR("Failed to open flash image %s", path);
+        return false;
+    }
+
+    struct stat st;
+    bool fresh = fstat(flash_fd, &st) == 0 && st.st_size != PICO_FLASH_SIZE_BYTES;
+    if (fresh && ftruncate(flash_fd, PICO_FLASH_SIZE_BYTES) != 0) {
+        LOG_ERROR("Failed to size flash image %s", path);
+        flash_hal_host_close();
+        return false;
+    }
+
+    flash_image = mmap(NULL, PICO_FLASH_SIZE_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, flash_fd, 0);
+    if (flash_image == MAP_FAILED) {
+        flash_image = NULL;
+        LOG_ERROR("Failed to map flash image %s", path);
+        flash_hal_host_close();
+        return false;
+    }
+    if (fresh) {
+        memset(flash_image, 0xFF, PICO_FLASH_SIZE_BYTES);  // Новый образ - стёртая флеш-память
+    }
+    return true;
+}
+
+void flash_hal_host_close(void) {
+    flash_hal_host_snapshot_drop();
+    if (flash_image) {
+        munmap(flash_image, PICO_FLASH_SIZE_BYTES);
+        flash_image = NULL;
+    }
+    if (flash_fd >= 0) {
+        close(flash_fd);
+        flash_fd = -1;
+    }
+}
+
+// Ленивое подключение образа по умолчанию
+static bool ensure_image(void) {
+    if (flash_image) {
+        return true;
+    }
+    const char *path = getenv("VFD_FLASH_IMAGE");
+    return flash_hal_host_open(path ? path : "vfd_flash.img");
+}
+
+// Сохранение исходного содержимого секторов перед первым изменением после точки восстановления
+static bool cow_touch(uint32_t offset, size_t len) {
+    if (!cow_active || len == 0) {
+        return true;
+    }
+    for (uint32_t sector = offset / FLASH_SECTOR_SIZE; sector <= (offset + len - 1) / FLASH_SECTOR_SIZE; sector++) {
+        if (cow_dirty[sector]) {
+            continue;
+        }
+        if (!cow_saved[sector] && !(cow_saved[sector] = malloc(FLASH_SECTOR_SIZE))) {
+            LOG_ERROR("Failed to allocate snapshot copy of sector %u", (unsigned)sector);
+            return false;
+        }
+        memcpy(cow_saved[sector], flash_image + sector * FLASH_SECTOR_SIZE, FLASH_SECTOR_SIZE);
+        cow_dirty[sector] = true;
+        cow_list[cow_count++] = (uint16_t)sector;
+    }
+    return true;
+}
+
+// Сколько единиц работы операции выполняется до отключения питания
+static uint64_t power_budget(uint64_t units) {
+    uint64_t left = power_cut_at - power_units;
+    if (units < left) {
+        power_units += units;
+        return units;
+    }
+    power_units = power_cut_at;
+    power_lost = true;
+    return left;
+}
+
+bool flash_hal_erase(uint32_t offset, size_t len) {
+    if (offset % FLASH_SECTOR_SIZE != 0 || len % FLASH_SECTOR_SIZE != 0 || offset + len > PICO_FLASH_SIZE_BYTES) {
+        LOG_ERROR("Emulated erase out of sector granularity: offset 0x%08X len %u", offset, (unsigned)len);
+        return false;
+    }
+    if (!ensure_image() || power_lost || !cow_touch(offset, len)) {
+        return false;
+    }
+    size_t pages = len / FLASH_PAGE_SIZE;
+    size_t done = (size_t)power_budget(pages);
+    memset(flash_image + offset, 0xFF, done * FLASH_PAGE_SIZE);
+    if (done < pages) {
+        // Оборванное стирание: часть битов страницы уже поднята
+        uint8_t *page = flash_image + offset + done * FLASH_PAGE_SIZE;
+        for (size_t i = 0; i < FLASH_PAGE_SIZE; i++) {
+            page[i] |= 0xA5;
+        }
+        return false;
+    }
+    if (erase_time_us) {
+        sleep_us((uint64_t)erase_time_us * (len / FLASH_SECTOR_SIZE));
+    }
+    stats.erase_ops++;
+    stats.erase_bytes += len;
+    return true;
+}
+
+bool flash_hal_program(uint32_t offset, const uint8_t *data, size_t len) {
+    if (offset % FLASH_PAGE_SIZE != 0 || len % FLASH_PAGE_SIZE != 0 || offset + len > PICO_FLASH_SIZE_BYTES) {
+        LOG_ERROR("Emulated program out of page granularity: offset 0x%08X len %u", offset, (unsigned)len);
+        return false;
+    }
+    if (!ensure_image() || power_lost || !cow_touch(offset, len)) {
+        return false;
+    }
+    // Программирование NOR может только сбрасывать биты
+    uint8_t *dst = flash_image + offset;
+    size_t done = (size_t)power_budget(len);
+    for (size_t i = 0; i < done; i++) {
+        if (weak_count && offset + i == weak_page) {
+            weak_count--;
+            i += FLASH_PAGE_SIZE - 1;  // Страница осталась без изменений
+            continue;
+        }
+        if (data[i] & ~dst[i]) {
+            stats.program_violations++;
+        }
+        dst[i] &= data[i];
+    }
+    if (done < len) {
+        dst[done] &= data[done] | 0xF0;  // Оборванное программирование: сброшена часть битов байта
+        return false;
+    }
+    if (program_time_us) {
+        sleep_us((uint64_t)program_time_us * (len / FLASH_PAGE_SIZE));
+    }
+    stats.program_ops++;
+    stats.program_bytes += len;
+    return true;
+}
+
+const uint8_t *flash_hal_xip_ptr(uint32_t offset) {
+    if (!ensure_image()) {
+        LOG_ERROR("Flash image unavailable");
+        abort();
+    }
+    // На устройстве чтение из флеш-памяти другим ядром при отключённом XIP приводит к сбою
+    if (atomic_load(&xip_disabled) && !pthread_equal(pthread_self(), atomic_load(&lock_owner))) {
+        atomic_fetch_add(&xip_violations, 1);
+    }
+    return flash_image + offset;
+}
+
+const uint8_t *flash_hal_readback_ptr(uint32_t offset) {
+    return flash_hal_xip_ptr(offset);  // У эмулятора нет кэша
+}
+
+void flash_hal_host_inject_weak_page(uint32_t offset, uint32_t count) {
+    weak_page = offset;
+    weak_count = count;
+}
+
+// Фиксированный идентификатор эмулируемой платы
+static const uint8_t host_default_id[FLASH_HAL_UNIQUE_ID_LEN] = { 'V', 'F', 'D', 'H', 'O', 'S', 'T', 0x01 };
+static uint8_t host_id[FLASH_HAL_UNIQUE_ID_LEN] = { 'V', 'F', 'D', 'H', 'O', 'S', 'T', 0x01 };
+
+void flash_hal_unique_id(uint8_t *id) {
+    memcpy(id, host_id, FLASH_HAL_UNIQUE_ID_LEN);
+}
+
+void flash_hal_host_set_unique_id(const uint8_t *id) {
+    memcpy(host_id, id ? id : host_default_id, FLASH_HAL_UNIQUE_ID_LEN);
+}
+
+void flash_hal_host_set_timing(uint32_t erase_us, uint32_t program_us) {
+    erase_time_us = erase_us;
+    program_time_us = program_us;
+}
+
+void flash_hal_host_set_power_cut(uint64_t units) {
+    power_cut_at = units;
+    power_units = 0;
+    power_lost = false;
+}
+
+uint64_t flash_hal_host_power_units(void) {
+    return power_units;
+}
+
+bool flash_hal_host_power_lost(void) {
+    return power_lost;
+}
+
+bool flash_hal_host_snapshot(void) {
+    if (!ensure_image()) {
+        return false;
+    }
+    while (cow_count) {
+        cow_dirty[cow_list[--cow_count]] = false;
+    }
+    cow_active = true;
+    return true;
+}
+
+void flash_hal_host_rollback(void) {
+    while (cow_count) {
+        uint16_t sector = cow_list[--cow_count];
+        memcpy(flash_image + sector * FLASH_SECTOR_SIZE, cow_saved[sector], FLASH_SECTOR_SIZE);
+        cow_dirty[sector] = false;
+    }
+}
+
+void flash_hal_host_snapshot_drop(void) {
+    while (cow_count) {
+        cow_dirty[cow_list[--cow_count]] = false;
+    }
+    for (size_t sector = 0; sector < HOST_FLASH_SECTORS; sector++) {
+        free(cow_saved[sector]);
+        cow_saved[sector] = NULL;
+    }
+    cow_active = false;
+}
+
+uint32_t flash_hal_lock(void) {
+    if (peer_mode == FLASH_PEER_LOCKOUT && atomic_load(&peer_registered)) {
+        atomic_store(&lockout_requested, true);
+        // Второе ядро может завершиться, не дойдя до точки остановки
+        while (!atomic_load(&peer_parked) && atomic_load(&peer_registered)) {
+            sched_yield();
+        }
+        if (atomic_load(&peer_parked)) {
+            stats.lockouts++;
+        }
+    }
+    atomic_store(&lock_owner, pthread_self());
+    atomic_store(&xip_disabled, true);
+    return 0;
+}
+
+void flash_hal_unlock(uint32_t state) {
+    (void)state;
+    atomic_store(&xip_disabled, false);
+    atomic_store(&lockout_requested, false);
+}
+
+void flash_hal_set_peer_mode(flash_peer_mode_t mode) {
+    peer_mode = mode;
+}
+
+void flash_hal_peer_init(void) {
+    atomic_store(&peer_registered, true);
+}
+
+void flash_hal_peer_exit(void) {
+    atomic_store(&peer_registered, false);
+}
+
+void flash_hal_peer_checkpoint(void) {
+    if (!atomic_load(&lockout_requested)) {
+        return;
+    }
+    atomic_store(&peer_parked, true);
+    while (atomic_load(&lockout_requested)) {
+        sched_yield();
+    }
+    atomic_store(&peer_parked, false);
+}
+
+void flash_hal_get_stats(flash_hal_stats_t *out) {
+    *out = stats;
+    out->xip_violations = atomic_load(&xip_violations);
+}
+
+void flash_hal_reset_stats(void) {
+    stats = (flash_hal_stats_t){0};
+    atomic_store(&xip_violations, 0);
+}
@@ -0,0 +1,91 @@
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "pico/multicore.h"
+#include "pico/unique_id.h"
+#include "flash_hal.h"
+
+static flash_hal_stats_t stats;
+static flash_peer_mode_t peer_mode = FLASH_PEER_LOCKOUT;
+static bool peer_locked_out = false;
+static volatile bool peer_registered = false;
+
+bool flash_hal_erase(uint32_t offset, size_t len) {
+    if (offset % FLASH_SECTOR_SIZE != 0 || len % FLASH_SECTOR_SIZE != 0 || offset + len > PICO_FLASH_SIZE_BYTES) {
+        return false;
+    }
+    flash_range_erase(offset, len);
+    stats.erase_ops++;
+    stats.erase_bytes += len;
+    return true;
+}
+
+bool flash_hal_program(uint32_t offset, const uint8_t *data, size_t len) {
+    if (offset % FLASH_PAGE_SIZE != 0 || len % FLASH_PAGE_SIZE != 0 || offset + len > PICO_FLASH_SIZE_BYTES) {
+        return false;
+    }
+    flash_range_program(offset, data, len);
+    stats.program_ops++;
+    stats.program_bytes += len;
+    return true;
+}
+
+const uint8_t *flash_hal_xip_ptr(uint32_t offset) {
+    return (const uint8_t *)(XIP_BASE + offset);
+}
+
+const uint8_t *flash_hal_readback_ptr(uint32_t offset) {
+    return (const uint8_t *)(XIP_NOCACHE_NOALLOC_BASE + offset);
+}
+
+void flash_hal_unique_id(uint8_t *id) {
+    // Идентификатор читается SDK из флеш-памяти при старте, повторное чтение XIP не прерывает
+    pico_unique_board_id_t board_id;
+    pico_get_unique_board_id(&board_id);
+    memcpy(id, board_id.id, FLASH_HAL_UNIQUE_ID_LEN);
+}
+
+uint32_t flash_hal_lock(void) {
+    // Второе ядро останавливается только если оно зарегистрировалось как останавливаемое
+    if (peer_mode == FLASH_PEER_LOCKOUT && peer_registered &&
+        multicore_lockout_victim_is_initialized(get_core_num() ^ 1)) {
+        multicore_lockout_start_blocking();
+        peer_locked_out = true;
+        stats.lockouts++;
+    }
+    return save_and_disable_interrupts();
+}
+
+void flash_hal_unlock(uint32_t state) {
+    restore_interrupts(state);
+    if (peer_locked_out) {
+        peer_locked_out = false;
+        multicore_lockout_end_blocking();
+    }
+}
+
+void flash_hal_set_peer_mode(flash_peer_mode_t mode) {
+    peer_mode = mode;
+}
+
+void flash_hal_peer_init(void) {
+    multicore_lockout_victim_init();
+    peer_registered = true;
+}
+
+void flash_hal_peer_exit(void) {
+    peer_registered = false;
+}
+
+void __not_in_flash_func(flash_hal_peer_checkpoint)(void) {
+    // Остановка выполняется обработчиком прерывания FIFO, установленным multicore_lockout_victim_init
+}
+
+void flash_hal_get_stats(flash_hal_stats_t *out) {
+    *out = stats;
+}
+
+void flash_hal_reset_stats(void) {
+    stats = (flash_hal_stats_t){0};
+}
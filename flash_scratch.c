@@ -0,0 +1,49 @@
+#include <string.h>
+#include "pico/stdlib.h"
+#include "flash_scratch.h"
+#include "logging.h"
+
+_Static_assert(FLASH_SCRATCH_SIZE % 8 == 0, "FLASH_SCRATCH_SIZE must be a multiple of 8");
+
+static uint64_t scratch[FLASH_SCRATCH_SIZE / sizeof(uint64_t)];
+static flash_scratch_stats_t scratch_stats;
+
+void *flash_scratch_borrow(size_t len) {
+    size_t size = FLASH_SCRATCH_ALIGN(len);
+    if (len == 0 || size > FLASH_SCRATCH_SIZE - scratch_stats.in_use) {
+        scratch_stats.failures++;
+        LOG_ERROR("Flash scratch arena exhausted: %u bytes requested, %u of %u in use", (unsigned)len,
+                  (unsigned)scratch_stats.in_use, (unsigned)FLASH_SCRATCH_SIZE);
+        return NULL;
+    }
+    uint8_t *buf = (uint8_t *)scratch + scratch_stats.in_use;
+    scratch_stats.in_use += size;
+    scratch_stats.borrows++;
+    if (scratch_stats.in_use > scratch_stats.peak) {
+        scratch_stats.peak = scratch_stats.in_use;
+    }
+    return buf;
+}
+
+void flash_scratch_release(void *buf) {
+    if (!buf) {
+        return;
+    }
+    uintptr_t pos = (uintptr_t)buf - (uintptr_t)scratch;  // Вне арены - заведомо больше in_use
+    if (pos >= scratch_stats.in_use || pos % 8 != 0) {
+        LOG_ERROR("Invalid flash scratch release %p", buf);
+        return;
+    }
+    scratch_stats.in_use = (uint32_t)pos;
+}
+
+void flash_scratch_get_stats(flash_scratch_stats_t *stats) {
+    *stats = scratch_stats;
+}
+
+void flash_scratch_reset_stats(void) {
+    uint32_t in_use = scratch_stats.in_use;
+    scratch_stats = (flash_scratch_stats_t){0};
+    scratch_stats.in_use = in_use;
+    scratch_stats.peak = in_use;
+}
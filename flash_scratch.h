@@ -0,0 +1,65 @@
+#ifndef FLASH_SCRATCH_H
+#define FLASH_SCRATCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "hardware/flash.h"
+
+/*
+ * Общий рабочий буфер подсистемы флеш-памяти.
+ *
+ * Вместо собственных статических буферов (сектор для перезаписи со стиранием, крайние страницы
+ * диапазона, образ записи настроек, запись хранилища «ключ - значение») модули берут участок
+ * арены на время операции и возвращают его. Участки выдаются стеком: освобождение возвращает
+ * арену к началу участка, поэтому вложенные заимствования освобождаются в обратном порядке.
+ * Арена используется из одного контекста (как и прежние статические буферы).
+ *
+ * Запись во флеш-память сама берёт участки арены, поэтому модуль, который держит свой участок
+ * во время write_flash_range() или copy_flash_range(), проверяет static_assert, что его участок
+ * вместе с FLASH_SCRATCH_COPY помещается в FLASH_SCRATCH_SIZE.
+ */
+
+#define FLASH_SCRATCH_ALIGN(n)  (((n) + 7u) & ~(size_t)7u)  ///< Размер участка после выравнивания
+#define FLASH_SCRATCH_WRITE     FLASH_SECTOR_SIZE  ///< Наибольшая часть арены в write_flash_range (образ сектора)
+#define FLASH_SCRATCH_COPY      (FLASH_PAGE_SIZE + FLASH_SCRATCH_WRITE)  ///< То же для copy_flash_range
+
+#ifndef FLASH_SCRATCH_SIZE
+#define FLASH_SCRATCH_SIZE      (2 * FLASH_SECTOR_SIZE)  ///< Размер арены (образ сектора и вложенные участки)
+#endif
+
+/**
+ * @brief Счётчики арены
+ */
+typedef struct {
+    uint32_t in_use;                        ///< Занято байт
+    uint32_t peak;                          ///< Наибольшее занятое значение
+    uint32_t borrows;                       ///< Выдано участков
+    uint32_t failures;                      ///< Отказов из-за нехватки места
+} flash_scratch_stats_t;
+
+/**
+ * @brief Заимствование участка арены
+ * @param len Размер участка (округляется до 8 байт)
+ * @return Указатель на участок (выровнен по 8 байтам) или NULL, если места нет
+ */
+void *flash_scratch_borrow(size_t len);
+
+/**
+ * @brief Возврат участка
+ * @param buf Указатель, полученный от flash_scratch_borrow (NULL игнорируется)
+ * @note Освобождаются и все участки, выданные после него
+ */
+void flash_scratch_release(void *buf);
+
+/**
+ * @brief Получение счётчиков арены
+ */
+void flash_scratch_get_stats(flash_scratch_stats_t *stats);
+
+/**
+ * @brief Сброс наибольшего занятого значения и счётчиков
+ */
+void flash_scratch_reset_stats(void);
+
+#endif // FLASH_SCRATCH_H
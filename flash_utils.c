@@ -1,13 +1,109 @@
-
-
 #include <string.h>
 #include "pico/stdlib.h"
-#include "hardware/flash.h"
-#include "hardware/sync.h"
+#include "flash_hal.h"
 #include "flash_utils.h"
+#include "flash_scratch.h"
 #include "logging.h"
 
-static uint8_t flash_buffer[FLASH_SECTOR_SIZE];
+#define PAGES_PER_SECTOR (FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE)
+
+_Static_assert(2 * FLASH_PAGE_SIZE <= FLASH_SCRATCH_WRITE, "Edge pages must fit the write share of the arena");
+_Static_assert(FLASH_SCRATCH_COPY <= FLASH_SCRATCH_SIZE, "Flash copy must fit the scratch arena");
+
+static flash_verify_stats_t verify_stats;
+
+static bool bytes_blank(const uint8_t *flash, size_t len) {
+    // Невыровненное начало и хвост проверяем побайтно, основную часть - словами
+    while (len && ((uintptr_t)flash & 3)) {
+        if (*flash++ != 0xFF) return false;
+        len--;
+    }
+    const uint32_t *words = (const uint32_t *)flash;
+    for (size_t i = 0; i < len / 4; i++) {
+        if (words[i] != 0xFFFFFFFF) return false;
+    }
+    flash += len & ~(size_t)3;
+    for (size_t i = 0; i < (len & 3); i++) {
+        if (flash[i] != 0xFF) return false;
+    }
+    return true;
+}
+
+bool flash_is_blank(const uint32_t offset, size_t len) {
+    return bytes_blank(flash_hal_xip_ptr(offset), len);
+}
+
+// Проверка записанной страницы: чтение в обход кэша XIP, сравнение словами.
+// *programmable - можно ли дописать страницу без стирания (нет нулей на месте единиц)
+static bool page_matches(uint32_t offset, const uint8_t *data, bool *programmable) {
+    const uint32_t *flash = (const uint32_t *)flash_hal_readback_ptr(offset);
+    bool match = true;
+    *programmable = true;
+    for (size_t i = 0; i < FLASH_PAGE_SIZE / sizeof(uint32_t); i++) {
+        uint32_t word;
+        memcpy(&word, data + i * sizeof(uint32_t), sizeof(word));  // data может быть не выровнен
+        if (flash[i] != word) {
+            match = false;
+            *programmable &= (flash[i] & word) == word;
+        }
+    }
+    return match;
+}
+
+// Проверка страницы с повторным программированием только её самой
+static bool verify_page(uint32_t offset, const uint8_t *data) {
+    verify_stats.verify_pages++;
+    for (uint32_t attempt = 0;; attempt++) {
+        bool programmable;
+        if (page_matches(offset, data, &programmable)) {
+            return true;
+        }
+        if (attempt == FLASH_VERIFY_RETRIES || !programmable) {
+            break;
+        }
+        LOG_WARN("Flash page at offset 0x%08X mismatch after programming - retry %u", offset, (unsigned)(attempt + 1));
+        verify_stats.retries++;
+        uint32_t ints = flash_hal_lock();
+        bool done = flash_hal_program(offset, data, FLASH_PAGE_SIZE);
+        flash_hal_unlock(ints);
+        if (!done) {
+            break;
+        }
+    }
+    verify_stats.failures++;
+    verify_stats.last_failed_offset = offset;
+    LOG_ERROR("Flash page program verification failed at offset 0x%08X", offset);
+    return false;
+}
+
+static void verify_finish(uint64_t start_us) {
+    uint32_t elapsed = (uint32_t)(time_us_64() - start_us);
+    verify_stats.verify_ops++;
+    verify_stats.last_us = elapsed;
+    verify_stats.total_us += elapsed;
+    if (elapsed > verify_stats.max_us) {
+        verify_stats.max_us = elapsed;
+    }
+}
+
+// Проверка непрерывного диапазона целых страниц
+static bool verify_range(uint32_t offset, const uint8_t *data, size_t len) {
+    uint64_t start = time_us_64();
+    bool ok = true;
+    for (size_t pos = 0; pos < len && ok; pos += FLASH_PAGE_SIZE) {
+        ok = verify_page(offset + pos, data + pos);
+    }
+    verify_finish(start);
+    return ok;
+}
+
+void flash_verify_get_stats(flash_verify_stats_t *stats) {
+    *stats = verify_stats;
+}
+
+void flash_verify_reset_stats(void) {
+    verify_stats = (flash_verify_stats_t){0};
+}
 
 bool write_flash_sector(const uint32_t offset, const uint8_t *data, size_t len) {
     if (offset % FLASH_SECTOR_SIZE != 0 || offset >= PICO_FLASH_SIZE_BYTES) {
@@ -19,14 +115,7 @@ bool write_flash_sector(const uint32_t offset, const uint8_t *data, size_t len)
         return false;
     }
 
-    uint32_t ints = save_and_disable_interrupts();
-    flash_range_erase(offset, FLASH_SECTOR_SIZE);
-    flash_range_program(offset, data, FLASH_SECTOR_SIZE);
-    restore_interrupts(ints);
-
-    const uint8_t *flash = (const uint8_t *)(XIP_BASE + offset);
-    if (memcmp(flash, data, len) != 0) {
-        LOG_ERROR("Flash write verification failed at offset 0x%08X", offset);
+    if (!write_flash_range(offset, data, len)) {
         return false;
     }
 
@@ -35,6 +124,205 @@ bool write_flash_sector(const uint32_t offset, const uint8_t *data, size_t len)
 }
 
 bool erase_flash_sector(const uint32_t flash_offset) {
-    memset(flash_buffer, 0xFF, FLASH_SECTOR_SIZE);
-    return write_flash_sector(flash_offset, flash_buffer, FLASH_SECTOR_SIZE);
-}
\ No newline at end of file
+    if (flash_offset % FLASH_SECTOR_SIZE != 0 || flash_offset >= PICO_FLASH_SIZE_BYTES) {
+        LOG_ERROR("Invalid or unaligned flash offset 0x%08X", flash_offset);
+        return false;
+    }
+    if (flash_is_blank(flash_offset, FLASH_SECTOR_SIZE)) {
+        return true;  // Сектор уже стёрт - лишний цикл стирания не нужен
+    }
+
+    uint32_t ints = flash_hal_lock();
+    bool done = flash_hal_erase(flash_offset, FLASH_SECTOR_SIZE);
+    flash_hal_unlock(ints);
+    if (!done || !bytes_blank(flash_hal_readback_ptr(flash_offset), FLASH_SECTOR_SIZE)) {
+        LOG_ERROR("Flash erase failed at offset 0x%08X", flash_offset);
+        return false;
+    }
+
+    LOG_INFO("Flash sector erased at offset 0x%08X", flash_offset);
+    return true;
+}
+
+bool program_flash_pages(const uint32_t offset, const uint8_t *data, size_t len) {
+    if (offset % FLASH_PAGE_SIZE != 0 || offset >= PICO_FLASH_SIZE_BYTES) {
+        LOG_ERROR("Invalid or unaligned flash page offset 0x%08X", offset);
+        return false;
+    }
+    if (!data || len == 0 || len % FLASH_PAGE_SIZE != 0 ||
+        (offset % FLASH_SECTOR_SIZE) + len > FLASH_SECTOR_SIZE) {
+        LOG_ERROR("Invalid page program length %u at offset 0x%08X", (unsigned)len, offset);
+        return false;
+    }
+
+    uint32_t ints = flash_hal_lock();
+    bool done = flash_hal_program(offset, data, len);
+    flash_hal_unlock(ints);
+    if (!done) {
+        LOG_ERROR("Flash program rejected at offset 0x%08X", offset);
+        return false;
+    }
+
+    if (!verify_range(offset, data, len)) {
+        return false;
+    }
+
+    LOG_INFO("Flash pages programmed at offset 0x%08X (%u bytes)", offset, (unsigned)len);
+    return true;
+}
+
+bool program_flash_page_list(const flash_page_write_t *pages, size_t count) {
+    if (!pages || count == 0) {
+        LOG_ERROR("Empty page list passed to program_flash_page_list");
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (pages[i].offset % FLASH_PAGE_SIZE != 0 || pages[i].offset >= PICO_FLASH_SIZE_BYTES || !pages[i].data) {
+            LOG_ERROR("Invalid page entry %u at offset 0x%08X", (unsigned)i, pages[i].offset);
+            return false;
+        }
+    }
+
+    // Все страницы программируются за одно окно с отключёнными прерываниями
+    bool done = true;
+    uint32_t ints = flash_hal_lock();
+    for (size_t i = 0; i < count && done; i++) {
+        done = flash_hal_program(pages[i].offset, pages[i].data, FLASH_PAGE_SIZE);
+    }
+    flash_hal_unlock(ints);
+    if (!done) {
+        LOG_ERROR("Flash page list program rejected");
+        return false;
+    }
+
+    uint64_t start = time_us_64();
+    bool ok = true;
+    for (size_t i = 0; i < count && ok; i++) {
+        ok = verify_page(pages[i].offset, pages[i].data);
+    }
+    verify_finish(start);
+    return ok;
+}
+
+// Перезапись части сектора со стиранием: остальное содержимое сектора сохраняется.
+// Образ сектора берётся из арены поверх участков вызывающего (FLASH_SCRATCH_WRITE)
+static bool rewrite_sector(uint32_t sector, uint32_t lo, uint32_t hi, const uint8_t *src) {
+    uint8_t *flash_buffer = flash_scratch_borrow(FLASH_SECTOR_SIZE);
+    if (!flash_buffer) {
+        LOG_ERROR("No scratch space to rewrite flash sector at offset 0x%08X", sector);
+        return false;
+    }
+    memcpy(flash_buffer, flash_hal_xip_ptr(sector), FLASH_SECTOR_SIZE);
+    memcpy(flash_buffer + (lo - sector), src, hi - lo);
+
+    bool done;
+    uint32_t ints = flash_hal_lock();
+    done = flash_hal_erase(sector, FLASH_SECTOR_SIZE);
+    // После стирания программируем только непустые страницы
+    for (uint32_t page = 0; page < PAGES_PER_SECTOR && done; page++) {
+        const uint8_t *buf = flash_buffer + page * FLASH_PAGE_SIZE;
+        bool blank = true;
+        for (uint32_t i = 0; i < FLASH_PAGE_SIZE && blank; i++) {
+            blank = buf[i] == 0xFF;
+        }
+        if (!blank) {
+            done = flash_hal_program(sector + page * FLASH_PAGE_SIZE, buf, FLASH_PAGE_SIZE);
+        }
+    }
+    flash_hal_unlock(ints);
+
+    done = done && verify_range(sector, flash_buffer, FLASH_SECTOR_SIZE);
+    flash_scratch_release(flash_buffer);
+    if (!done) {
+        LOG_ERROR("Flash sector rewrite failed at offset 0x%08X", sector);
+        return false;
+    }
+    return true;
+}
+
+bool write_flash_range(const uint32_t offset, const uint8_t *data, size_t len) {
+    if (!data || len == 0 || offset >= PICO_FLASH_SIZE_BYTES || len > PICO_FLASH_SIZE_BYTES - offset) {
+        LOG_ERROR("Invalid flash range 0x%08X + %u", offset, (unsigned)len);
+        return false;
+    }
+
+    const uint32_t end = offset + len;
+    for (uint32_t sector = offset - (offset % FLASH_SECTOR_SIZE); sector < end; sector += FLASH_SECTOR_SIZE) {
+        const uint32_t lo = offset > sector ? offset : sector;
+        const uint32_t hi = end < sector + FLASH_SECTOR_SIZE ? end : sector + FLASH_SECTOR_SIZE;
+        const uint8_t *src = data + (lo - offset);
+        const uint8_t *flash = flash_hal_xip_ptr(lo);
+
+        // Стирание нужно, только если какой-то бит должен перейти из 0 в 1
+        bool need_erase = false;
+        for (uint32_t i = 0; i < hi - lo && !need_erase; i++) {
+            need_erase = (flash[i] & src[i]) != src[i];
+        }
+        if (need_erase) {
+            if (!rewrite_sector(sector, lo, hi, src)) {
+                return false;
+            }
+            continue;
+        }
+
+        // Иначе программируем только изменившиеся страницы, одним пакетом
+        flash_page_write_t pages[PAGES_PER_SECTOR];
+        size_t count = 0;
+        uint8_t *edge_pages = NULL;  // Первая и последняя страницы диапазона, если они неполные
+        for (uint32_t page = lo - (lo % FLASH_PAGE_SIZE); page < hi; page += FLASH_PAGE_SIZE) {
+            const uint32_t plo = page > lo ? page : lo;
+            const uint32_t phi = hi < page + FLASH_PAGE_SIZE ? hi : page + FLASH_PAGE_SIZE;
+            if (memcmp(flash_hal_xip_ptr(plo), data + (plo - offset), phi - plo) == 0) {
+                continue;  // Страница не изменилась
+            }
+            const uint8_t *page_data;
+            if (plo == page && phi == page + FLASH_PAGE_SIZE) {
+                page_data = data + (page - offset);
+            } else {
+                // Крайняя страница диапазона: недостающие байты берём из флеш-памяти
+                if (!edge_pages && !(edge_pages = flash_scratch_borrow(2 * FLASH_PAGE_SIZE))) {
+                    return false;
+                }
+                uint8_t *buf = edge_pages + (page == offset - (offset % FLASH_PAGE_SIZE) ? 0 : FLASH_PAGE_SIZE);
+                memcpy(buf, flash_hal_xip_ptr(page), FLASH_PAGE_SIZE);
+                memcpy(buf + (plo - page), data + (plo - offset), phi - plo);
+                page_data = buf;
+            }
+            pages[count].offset = page;
+            pages[count].data = page_data;
+            count++;
+        }
+        bool ok = count == 0 || program_flash_page_list(pages, count);
+        flash_scratch_release(edge_pages);
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool copy_flash_range(const uint32_t dst_offset, const uint32_t src_offset, size_t len) {
+    if (len == 0 || src_offset >= PICO_FLASH_SIZE_BYTES || len > PICO_FLASH_SIZE_BYTES - src_offset ||
+        (src_offset < dst_offset + len && dst_offset < src_offset + len)) {
+        LOG_ERROR("Invalid flash copy 0x%08X -> 0x%08X + %u", src_offset, dst_offset, (unsigned)len);
+        return false;
+    }
+
+    // Источник в окне XIP недоступен во время программирования: данные идут через страницу в RAM
+    uint8_t *chunk = flash_scratch_borrow(FLASH_PAGE_SIZE);
+    if (!chunk) {
+        return false;
+    }
+    bool ok = true;
+    for (size_t pos = 0; pos < len && ok;) {
+        size_t n = FLASH_PAGE_SIZE - (dst_offset + pos) % FLASH_PAGE_SIZE;
+        if (n > len - pos) {
+            n = len - pos;
+        }
+        memcpy(chunk, flash_hal_xip_ptr(src_offset + pos), n);
+        ok = write_flash_range(dst_offset + pos, chunk, n);
+        pos += n;
+    }
+    flash_scratch_release(chunk);
+    return ok;
+}
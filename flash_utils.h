@@ -5,6 +5,33 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+
+#ifndef FLASH_VERIFY_RETRIES
+#define FLASH_VERIFY_RETRIES    2          ///< Повторных программирований страницы при несовпадении
+#endif
+
+/**
+ * @brief Счётчики проверки записанных данных
+ */
+typedef struct {
+    uint32_t verify_ops;                    ///< Проверок после записи
+    uint32_t verify_pages;                  ///< Проверено страниц
+    uint32_t retries;                       ///< Повторных программирований страниц
+    uint32_t failures;                      ///< Проверок, не прошедших после всех повторов
+    uint32_t last_failed_offset;            ///< Смещение последней не записавшейся страницы
+    uint32_t last_us;                       ///< Время последней проверки вместе с повторами, мкс
+    uint32_t max_us;                        ///< Наибольшее время проверки, мкс
+    uint64_t total_us;                      ///< Суммарное время проверок, мкс
+} flash_verify_stats_t;
+
+/**
+ * @brief Описание страницы для пакетного программирования
+ */
+typedef struct {
+    uint32_t offset;        ///< Смещение страницы (выровнено по FLASH_PAGE_SIZE)
+    const uint8_t *data;    ///< Данные страницы (FLASH_PAGE_SIZE байт)
+} flash_page_write_t;
 
 /**
  * @brief Запись данных в сектор флеш-памяти
@@ -12,6 +39,7 @@
  * @param data Указатель на данные
  * @param len Длина данных (не более FLASH_SECTOR_SIZE)
  * @return true если запись успешна, false в противном случае
+ * @note Байты сектора за пределами len сохраняются; см. write_flash_range
  */
 bool write_flash_sector(const uint32_t offset, const uint8_t *data, size_t len);
 
@@ -19,7 +47,72 @@ bool write_flash_sector(const uint32_t offset, const uint8_t *data, size_t len);
  * @brief Очистка сектора флеш-памяти (заполнение 0xFF)
  * @param flash_offset Смещение во флеш-памяти
  * @return true если очистка успешна, false в противном случае
+ * @note Уже стёртый сектор повторно не стирается
  */
 bool erase_flash_sector(const uint32_t flash_offset);
 
+/**
+ * @brief Программирование страниц флеш-памяти без стирания сектора
+ * @param offset Смещение во флеш-памяти (должно быть выровнено по FLASH_PAGE_SIZE)
+ * @param data Указатель на данные
+ * @param len Длина данных (кратна FLASH_PAGE_SIZE, в пределах одного сектора)
+ * @return true если запись успешна, false в противном случае
+ * @note Целевые страницы должны быть предварительно стёрты (0xFF); несовпавшая при проверке
+ *       страница программируется повторно (до FLASH_VERIFY_RETRIES раз)
+ */
+bool program_flash_pages(const uint32_t offset, const uint8_t *data, size_t len);
+
+/**
+ * @brief Запись произвольного диапазона флеш-памяти с минимальным стиранием
+ *
+ * Программируются только изменившиеся страницы. Если новые данные лишь сбрасывают биты
+ * относительно текущего содержимого, сектор не стирается, а страницы программируются
+ * одним пакетом. Иначе сектор стирается с сохранением данных вне диапазона.
+ * @param offset Смещение во флеш-памяти (без требований к выравниванию)
+ * @param data Указатель на данные
+ * @param len Длина данных (диапазон может захватывать несколько секторов)
+ * @return true если запись успешна, false в противном случае
+ */
+bool write_flash_range(const uint32_t offset, const uint8_t *data, size_t len);
+
+/**
+ * @brief Копирование области флеш-памяти без буфера на весь объём
+ *
+ * Данные передаются через одну страницу арены flash_scratch: каждый фрагмент не пересекает
+ * границу страницы назначения и записывается write_flash_range.
+ * @param dst_offset Смещение назначения (без требований к выравниванию)
+ * @param src_offset Смещение источника
+ * @param len Длина (области не должны перекрываться)
+ * @return true если копирование успешно, false в противном случае
+ */
+bool copy_flash_range(const uint32_t dst_offset, const uint32_t src_offset, size_t len);
+
+/**
+ * @brief Программирование списка страниц за одно окно с отключёнными прерываниями
+ * @param pages Массив описаний страниц (каждая FLASH_PAGE_SIZE байт, без стирания)
+ * @param count Количество страниц
+ * @return true если все страницы записаны и проверены, false в противном случае
+ * @note Несовпавшая при проверке страница программируется повторно (до FLASH_VERIFY_RETRIES раз)
+ */
+bool program_flash_page_list(const flash_page_write_t *pages, size_t count);
+
+/**
+ * @brief Проверка, что область флеш-памяти стёрта (пословное сравнение с 0xFF)
+ * @param offset Смещение во флеш-памяти
+ * @param len Длина области
+ * @return true если все байты области равны 0xFF
+ */
+bool flash_is_blank(const uint32_t offset, size_t len);
+
+/**
+ * @brief Получение счётчиков проверки записи
+ * @param stats Указатель на структуру для заполнения
+ */
+void flash_verify_get_stats(flash_verify_stats_t *stats);
+
+/**
+ * @brief Сброс счётчиков проверки записи
+ */
+void flash_verify_reset_stats(void);
+
 #endif // FLASH_UTILS_H
\ No newline at end of file
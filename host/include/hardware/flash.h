@@ -0,0 +1,16 @@
+#ifndef HOST_HARDWARE_FLASH_H
+#define HOST_HARDWARE_FLASH_H
+
+// Геометрия флеш-памяти Pico W для эмулятора (см. flash_hal_host.c)
+
+#ifndef FLASH_PAGE_SIZE
+#define FLASH_PAGE_SIZE         (1u << 8)
+#endif
+#ifndef FLASH_SECTOR_SIZE
+#define FLASH_SECTOR_SIZE       (1u << 12)
+#endif
+#ifndef PICO_FLASH_SIZE_BYTES
+#define PICO_FLASH_SIZE_BYTES   (2 * 1024 * 1024)
+#endif
+
+#endif // HOST_HARDWARE_FLASH_H
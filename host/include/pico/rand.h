@@ -0,0 +1,17 @@
+#ifndef HOST_PICO_RAND_H
+#define HOST_PICO_RAND_H
+
+// Минимальная замена pico/rand.h для сборки на хосте (Linux)
+
+#include <stdint.h>
+#include <sys/random.h>
+
+static inline uint64_t get_rand_64(void) {
+    uint64_t value = 0;
+    if (getrandom(&value, sizeof(value), 0) != (ssize_t)sizeof(value)) {
+        value ^= (uint64_t)(uintptr_t)&value;
+    }
+    return value;
+}
+
+#endif // HOST_PICO_RAND_H
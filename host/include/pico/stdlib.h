@@ -0,0 +1,43 @@
+#ifndef HOST_PICO_STDLIB_H
+#define HOST_PICO_STDLIB_H
+
+// Минимальная замена pico/stdlib.h для сборки на хосте (Linux)
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <assert.h>
+#include <time.h>
+
+// На хосте весь код находится в RAM
+#define __not_in_flash_func(func_name) func_name
+// Секция .uninitialized_data: на хосте память процесса не переживает перезапуск,
+// программный сброс имитируется повторным вызовом в том же процессе
+#define __uninitialized_ram(group) group
+
+static inline void stdio_init_all(void) {
+}
+
+static inline void tight_loop_contents(void) {
+}
+
+static inline unsigned get_core_num(void) {
+    return 0;
+}
+
+static inline uint64_t time_us_64(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static inline void sleep_us(uint64_t us) {
+    struct timespec ts = { (time_t)(us / 1000000u), (long)(us % 1000000u) * 1000 };
+    nanosleep(&ts, NULL);
+}
+
+static inline void sleep_ms(uint32_t ms) {
+    sleep_us((uint64_t)ms * 1000u);
+}
+
+#endif // HOST_PICO_STDLIB_H
@@ -0,0 +1,494 @@
+#include <string.h>
+#include "pico/stdlib.h"
+#include "kvstore.h"
+#include "flash_hal.h"
+#include "flash_utils.h"
+#include "flash_scratch.h"
+#include "crc32.h"
+#include "logging.h"
+
+#define KV_SECTOR_MAGIC         0x5645564B  // "KVEV"
+#define KV_SLOT_EMPTY           0xFFFFFFFF
+#define KV_INFO_BLANK           0xFFFFFFFF
+#define KV_INFO_DELETED         0x80000000  // Запись-удаление
+#define KV_ALIGN(n)             (((n) + 3u) & ~3u)
+
+// Заголовок сектора: номер задаёт порядок секторов в кольце
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t seq_inv;
+} kv_sector_hdr_t;
+
+// Заголовок записи: info = ns | key_len << 8 | value_len << 16 | KV_INFO_DELETED;
+// CRC32 считается по info, ключу и значению
+typedef struct {
+    uint32_t info;
+    uint32_t info_inv;
+    uint32_t crc;
+} kv_record_hdr_t;
+
+#define KV_RECORD_MAX           KV_ALIGN(sizeof(kv_record_hdr_t) + KV_KEY_MAX + KV_VALUE_MAX)
+#define KV_SECTOR_PAYLOAD       (FLASH_SECTOR_SIZE - sizeof(kv_sector_hdr_t))
+// Объём актуальных записей, при котором освобождение сектора всегда находит место
+#define KV_CAPACITY             ((KV_SECTORS - 2) * (KV_SECTOR_PAYLOAD - KV_RECORD_MAX))
+
+// kv_write держит запись в арене, пока kv_reserve переносит записи через copy_flash_range
+_Static_assert(FLASH_SCRATCH_ALIGN(KV_RECORD_MAX) + FLASH_SCRATCH_COPY <= KV_WRITE_SCRATCH,
+               "KV_WRITE_SCRATCH must cover the record and a flash copy");
+_Static_assert(KV_WRITE_SCRATCH <= FLASH_SCRATCH_SIZE, "Key-value writes must fit the scratch arena");
+
+_Static_assert(KV_VALUE_MAX < 0x8000, "KV_VALUE_MAX must fit in 15 bits");
+_Static_assert(KV_RECORD_MAX <= KV_SECTOR_PAYLOAD, "Largest record must fit in a sector");
+
+static inline uint32_t kv_sector_offset(const kv_store_t *kv, uint32_t sector) {
+    return kv->flash_offset + sector * FLASH_SECTOR_SIZE;
+}
+
+static inline uint8_t kv_info_ns(uint32_t info) {
+    return info & 0xFF;
+}
+
+static inline uint32_t kv_info_key_len(uint32_t info) {
+    return (info >> 8) & 0xFF;
+}
+
+static inline uint32_t kv_info_value_len(uint32_t info) {
+    return (info >> 16) & 0x7FFF;
+}
+
+static inline uint32_t kv_record_size(uint32_t info) {
+    return KV_ALIGN(sizeof(kv_record_hdr_t) + kv_info_key_len(info) + kv_info_value_len(info));
+}
+
+static bool kv_info_valid(const kv_record_hdr_t *hdr) {
+    return hdr->info_inv == ~hdr->info && kv_info_ns(hdr->info) != 0 && kv_info_ns(hdr->info) <= KV_NS_MAX &&
+           kv_info_key_len(hdr->info) != 0 && kv_info_key_len(hdr->info) <= KV_KEY_MAX &&
+           kv_info_value_len(hdr->info) <= KV_VALUE_MAX;
+}
+
+static uint32_t kv_record_crc(uint32_t info, const uint8_t *key_value, size_t len) {
+    uint32_t crc = crc32_update(CRC32_INIT, (const uint8_t *)&info, sizeof(info));
+    return crc32_update(crc, key_value, len) ^ CRC32_INIT;
+}
+
+static bool kv_sector_valid(const kv_sector_hdr_t *hdr) {
+    return hdr->magic == KV_SECTOR_MAGIC && hdr->seq_inv == ~hdr->seq;
+}
+
+// FNV-1a по пространству имён и ключу; 0 не используется как признак пустой ячейки
+static uint32_t kv_hash(uint8_t ns, const char *key, size_t key_len) {
+    uint32_t hash = 2166136261u;
+    hash = (hash ^ ns) * 16777619u;
+    for (size_t i = 0; i < key_len; i++) {
+        hash = (hash ^ (uint8_t)key[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Поиск ячейки индекса: совпадение ключа проверяется по записи во флеш-памяти.
+// Возвращает номер ячейки ключа или первой пустой ячейки цепочки (*found = false)
+static uint32_t kv_find_slot(const kv_store_t *kv, uint32_t hash, uint8_t ns, const char *key,
+                             size_t key_len, bool *found) {
+    uint32_t mask = KV_INDEX_SLOTS - 1;
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+        const kv_slot_t *slot = &kv->index[i];
+        if (slot->offset == KV_SLOT_EMPTY) {
+            *found = false;
+            return i;
+        }
+        if (slot->hash != hash) {
+            continue;
+        }
+        const kv_record_hdr_t *hdr = (const kv_record_hdr_t *)flash_hal_xip_ptr(slot->offset);
+        if (kv_info_ns(hdr->info) == ns && kv_info_key_len(hdr->info) == key_len &&
+            memcmp(hdr + 1, key, key_len) == 0) {
+            *found = true;
+            return i;
+        }
+    }
+}
+
+// Удаление из индекса со сдвигом следующих ячеек цепочки (без меток удаления)
+static void kv_index_remove(kv_store_t *kv, uint32_t pos) {
+    uint32_t mask = KV_INDEX_SLOTS - 1;
+    uint32_t hole = pos;
+    for (uint32_t j = (pos + 1) & mask; kv->index[j].offset != KV_SLOT_EMPTY; j = (j + 1) & mask) {
+        uint32_t home = kv->index[j].hash & mask;
+        bool stays = hole <= j ? (hole < home && home <= j) : (hole < home || home <= j);
+        if (!stays) {
+            kv->index[hole] = kv->index[j];
+            hole = j;
+        }
+    }
+    kv->index[hole].offset = KV_SLOT_EMPTY;
+}
+
+// Учёт записи в индексе (при просмотре журнала и после дописывания)
+static bool kv_index_apply(kv_store_t *kv, uint32_t offset) {
+    const kv_record_hdr_t *hdr = (const kv_record_hdr_t *)flash_hal_xip_ptr(offset);
+    const char *key = (const char *)(hdr + 1);
+    uint32_t key_len = kv_info_key_len(hdr->info);
+    uint32_t hash = kv_hash(kv_info_ns(hdr->info), key, key_len);
+    bool found;
+    uint32_t pos = kv_find_slot(kv, hash, kv_info_ns(hdr->info), key, key_len, &found);
+
+    if (found) {
+        const kv_record_hdr_t *old = (const kv_record_hdr_t *)flash_hal_xip_ptr(kv->index[pos].offset);
+        kv->live_bytes -= kv_record_size(old->info);
+        if (hdr->info & KV_INFO_DELETED) {
+            kv_index_remove(kv, pos);
+            kv->keys--;
+            return true;
+        }
+    } else if (hdr->info & KV_INFO_DELETED) {
+        return true;
+    } else if (kv->keys >= KV_MAX_KEYS) {
+        LOG_ERROR("Key-value index full (%u keys)", (unsigned)kv->keys);
+        return false;
+    } else {
+        kv->keys++;
+    }
+    kv->index[pos].hash = hash;
+    kv->index[pos].offset = offset;
+    kv->live_bytes += kv_record_size(hdr->info);
+    return true;
+}
+
+// Открытие следующего сектора кольца: стирание и запись заголовка
+static bool kv_open_sector(kv_store_t *kv) {
+    uint32_t sector = (kv->head_sector + 1) % KV_SECTORS;
+    if (kv->used_sectors == 0) {
+        sector = kv->head_sector;
+    }
+    uint32_t offset = kv_sector_offset(kv, sector);
+    if (!erase_flash_sector(offset)) {
+        return false;
+    }
+    kv_sector_hdr_t hdr = { KV_SECTOR_MAGIC, kv->next_seq, ~kv->next_seq };
+    if (!write_flash_range(offset, (const uint8_t *)&hdr, sizeof(hdr))) {
+        return false;
+    }
+    if (kv->used_sectors == 0) {
+        kv->tail_sector = sector;
+    }
+    kv->head_sector = sector;
+    kv->head_pos = sizeof(hdr);
+    kv->next_seq++;
+    kv->used_sectors++;
+    return true;
+}
+
+static bool kv_collect_tail(kv_store_t *kv);
+
+// Место для записи size байт в текущем секторе: открытие следующего сектора и,
+// когда свободным остаётся только запасной, освобождение самого старого
+static bool kv_make_room(kv_store_t *kv, uint32_t size) {
+    for (uint32_t attempt = 0; attempt < 2 * KV_SECTORS + 2; attempt++) {
+        uint32_t offset = kv_sector_offset(kv, kv->head_sector) + kv->head_pos;
+        if (kv->head_pos + size <= FLASH_SECTOR_SIZE) {
+            if (flash_is_blank(offset, size)) {
+                return true;
+            }
+            // Остатки оборванной записи: сектор дальше не используется
+            LOG_WARN("Key-value sector %u has garbage at 0x%08X - closing it", (unsigned)kv->head_sector, offset);
+            kv->head_pos = FLASH_SECTOR_SIZE;
+        }
+        uint32_t free_sectors = KV_SECTORS - kv->used_sectors;
+        if (free_sectors > 1 || (free_sectors == 1 && (kv->compacting || kv->tail_sector == kv->head_sector))) {
+            if (!kv_open_sector(kv)) {
+                return false;
+            }
+        } else if (!kv->compacting && kv->tail_sector != kv->head_sector) {
+            if (!kv_collect_tail(kv)) {
+                return false;
+            }
+        } else {
+            break;
+        }
+    }
+    LOG_ERROR("No room for %u-byte key-value record", (unsigned)size);
+    return false;
+}
+
+// Место под запись size байт в конце журнала; *offset - её смещение во флеш-памяти
+static bool kv_reserve(kv_store_t *kv, uint32_t size, uint32_t *offset) {
+    if (!kv_make_room(kv, size)) {
+        return false;
+    }
+    *offset = kv_sector_offset(kv, kv->head_sector) + kv->head_pos;
+    kv->head_pos += size;  // Место занято даже при ошибке записи: сектор мог записаться частично
+    return true;
+}
+
+static bool kv_appended(kv_store_t *kv, uint32_t offset, bool ok) {
+    if (!ok) {
+        LOG_ERROR("Failed to append key-value record at 0x%08X", offset);
+        return false;
+    }
+    kv->stats.appends++;
+    return true;
+}
+
+// Перенос актуальных записей самого старого сектора в конец журнала и его стирание.
+// При отключении питания до стирания копии новее оригиналов и побеждают при просмотре.
+static bool kv_collect_tail(kv_store_t *kv) {
+    uint32_t sector = kv->tail_sector;
+    uint32_t base = kv_sector_offset(kv, sector);
+    bool ok = true;
+
+    kv->compacting = true;
+    for (uint32_t pos = sizeof(kv_sector_hdr_t); pos + sizeof(kv_record_hdr_t) <= FLASH_SECTOR_SIZE && ok;) {
+        const kv_record_hdr_t *hdr = (const kv_record_hdr_t *)flash_hal_xip_ptr(base + pos);
+        if (hdr->info == KV_INFO_BLANK || !kv_info_valid(hdr)) {
+            break;
+        }
+        uint32_t size = kv_record_size(hdr->info);
+        if (!(hdr->info & KV_INFO_DELETED)) {
+            bool found;
+            uint32_t slot = kv_find_slot(kv, kv_hash(kv_info_ns(hdr->info), (const char *)(hdr + 1),
+                                                     kv_info_key_len(hdr->info)),
+                                         kv_info_ns(hdr->info), (const char *)(hdr + 1),
+                                         kv_info_key_len(hdr->info), &found);
+            if (found && kv->index[slot].offset == base + pos) {
+                // Запись копируется во флеш-памяти постранично, без буфера на всю запись
+                uint32_t offset;
+                ok = kv_reserve(kv, size, &offset) && kv_appended(kv, offset, copy_flash_range(offset, base + pos, size));
+                if (ok) {
+                    kv->index[slot].offset = offset;
+                    kv->stats.moved_bytes += size;
+                }
+            }
+        }
+        pos += size;
+    }
+    kv->compacting = false;
+    if (!ok) {
+        return false;
+    }
+
+    if (!erase_flash_sector(base)) {
+        return false;
+    }
+    kv->tail_sector = (sector + 1) % KV_SECTORS;
+    kv->used_sectors--;
+    kv->stats.compactions++;
+    LOG_INFO("Key-value sector %u compacted (%u live bytes)", (unsigned)sector, (unsigned)kv->live_bytes);
+    return true;
+}
+
+// Просмотр записей сектора при запуске; возвращает позицию после последней записи
+static uint32_t kv_replay_sector(kv_store_t *kv, uint32_t sector) {
+    uint32_t base = kv_sector_offset(kv, sector);
+    uint32_t pos = sizeof(kv_sector_hdr_t);
+    while (pos + sizeof(kv_record_hdr_t) <= FLASH_SECTOR_SIZE) {
+        const kv_record_hdr_t *hdr = (const kv_record_hdr_t *)flash_hal_xip_ptr(base + pos);
+        if (hdr->info == KV_INFO_BLANK) {
+            return pos;
+        }
+        uint32_t size = kv_record_size(hdr->info);
+        if (!kv_info_valid(hdr) || pos + size > FLASH_SECTOR_SIZE) {
+            LOG_WARN("Corrupted key-value record header at 0x%08X", base + pos);
+            kv->stats.damaged++;
+            return FLASH_SECTOR_SIZE;  // Дальше сектора не доверяем
+        }
+        uint32_t data_len = kv_info_key_len(hdr->info) + kv_info_value_len(hdr->info);
+        if (kv_record_crc(hdr->info, (const uint8_t *)(hdr + 1), data_len) != hdr->crc) {
+            LOG_WARN("Key-value record at 0x%08X failed CRC32 - skipped", base + pos);
+            kv->stats.damaged++;
+        } else if (!kv_index_apply(kv, base + pos)) {
+            return FLASH_SECTOR_SIZE;
+        }
+        pos += size;
+    }
+    return pos;
+}
+
+bool kv_init(kv_store_t *kv, uint32_t flash_offset) {
+    if (!kv) {
+        LOG_ERROR("Null pointer passed to kv_init");
+        return false;
+    }
+    if (flash_offset % FLASH_SECTOR_SIZE != 0 || flash_offset > PICO_FLASH_SIZE_BYTES - KV_SIZE) {
+        LOG_ERROR("Invalid key-value store offset 0x%08X", flash_offset);
+        return false;
+    }
+
+    memset(kv, 0, sizeof(*kv));
+    kv->flash_offset = flash_offset;
+    for (uint32_t i = 0; i < KV_INDEX_SLOTS; i++) {
+        kv->index[i].offset = KV_SLOT_EMPTY;
+    }
+
+    // Самый новый сектор и непрерывная цепочка предшествующих ему номеров
+    uint32_t head = KV_SECTORS;
+    uint32_t head_seq = 0;
+    for (uint32_t sector = 0; sector < KV_SECTORS; sector++) {
+        const kv_sector_hdr_t *hdr = (const kv_sector_hdr_t *)flash_hal_xip_ptr(kv_sector_offset(kv, sector));
+        if (kv_sector_valid(hdr) && (head == KV_SECTORS || hdr->seq > head_seq)) {
+            head = sector;
+            head_seq = hdr->seq;
+        }
+    }
+    if (head == KV_SECTORS) {
+        kv->next_seq = 1;
+        LOG_INFO("Key-value store at 0x%08X is empty", flash_offset);
+        return kv_open_sector(kv);
+    }
+
+    uint32_t tail = head;
+    kv->used_sectors = 1;
+    while (kv->used_sectors < KV_SECTORS) {
+        uint32_t prev = (tail + KV_SECTORS - 1) % KV_SECTORS;
+        const kv_sector_hdr_t *hdr = (const kv_sector_hdr_t *)flash_hal_xip_ptr(kv_sector_offset(kv, prev));
+        if (!kv_sector_valid(hdr) || hdr->seq != head_seq - kv->used_sectors) {
+            break;
+        }
+        tail = prev;
+        kv->used_sectors++;
+    }
+
+    // Записи учитываются от старых к новым: более поздняя запись ключа заменяет раннюю
+    for (uint32_t i = 0, sector = tail; i < kv->used_sectors; i++, sector = (sector + 1) % KV_SECTORS) {
+        kv->head_pos = kv_replay_sector(kv, sector);
+    }
+    kv->tail_sector = tail;
+    kv->head_sector = head;
+    kv->next_seq = head_seq + 1;
+
+    LOG_INFO("Key-value store at 0x%08X: %u keys, %u live bytes in %u sectors", flash_offset,
+             (unsigned)kv->keys, (unsigned)kv->live_bytes, (unsigned)kv->used_sectors);
+    return true;
+}
+
+static bool kv_check_key(uint8_t ns, const char *key, size_t *key_len) {
+    if (!key || ns == 0 || ns > KV_NS_MAX) {
+        LOG_ERROR("Invalid key-value namespace %u or key", ns);
+        return false;
+    }
+    *key_len = strnlen(key, KV_KEY_MAX + 1);
+    if (*key_len == 0 || *key_len > KV_KEY_MAX) {
+        LOG_ERROR("Key-value key length out of range (max %u)", KV_KEY_MAX);
+        return false;
+    }
+    return true;
+}
+
+// Запись значения или удаления: подготовка записи в kv_buffer, дописывание и обновление индекса
+static bool kv_write(kv_store_t *kv, uint8_t ns, const char *key, size_t key_len,
+                     const void *value, size_t len, bool deleted) {
+    uint32_t info = ns | (uint32_t)key_len << 8 | (uint32_t)len << 16 | (deleted ? KV_INFO_DELETED : 0);
+    uint32_t size = kv_record_size(info);
+    // Заголовок, ключ и значение программируются одной операцией
+    uint8_t *record = flash_scratch_borrow(size);
+    if (!record) {
+        return false;
+    }
+    kv_record_hdr_t *hdr = (kv_record_hdr_t *)record;
+    memset(record, 0xFF, size);
+    memcpy(hdr + 1, key, key_len);
+    if (len) {
+        memcpy((uint8_t *)(hdr + 1) + key_len, value, len);
+    }
+    hdr->info = info;
+    hdr->info_inv = ~info;
+    hdr->crc = kv_record_crc(info, (const uint8_t *)(hdr + 1), key_len + len);
+
+    uint32_t offset;
+    bool ok = kv_reserve(kv, size, &offset) && kv_appended(kv, offset, write_flash_range(offset, record, size));
+    flash_scratch_release(record);
+    return ok && kv_index_apply(kv, offset);
+}
+
+bool kv_put(kv_store_t *kv, uint8_t ns, const char *key, const void *value, size_t len) {
+    size_t key_len;
+    if (!kv || !kv_check_key(ns, key, &key_len)) {
+        return false;
+    }
+    if ((!value && len) || len > KV_VALUE_MAX) {
+        LOG_ERROR("Key-value value length %u out of range (max %u)", (unsigned)len, KV_VALUE_MAX);
+        return false;
+    }
+
+    bool found;
+    uint32_t pos = kv_find_slot(kv, kv_hash(ns, key, key_len), ns, key, key_len, &found);
+    uint32_t old_size = 0;
+    if (found) {
+        const kv_record_hdr_t *old = (const kv_record_hdr_t *)flash_hal_xip_ptr(kv->index[pos].offset);
+        if (kv_info_value_len(old->info) == len &&
+            (len == 0 || memcmp((const uint8_t *)(old + 1) + key_len, value, len) == 0)) {
+            kv->stats.skipped++;
+            return true;  // Значение не изменилось - записи не нужно
+        }
+        old_size = kv_record_size(old->info);
+    } else if (kv->keys >= KV_MAX_KEYS) {
+        LOG_ERROR("Key-value index full (%u keys)", (unsigned)kv->keys);
+        return false;
+    }
+    uint32_t size = KV_ALIGN(sizeof(kv_record_hdr_t) + key_len + len);
+    if (kv->live_bytes - old_size + size > KV_CAPACITY) {
+        LOG_ERROR("Key-value store full (%u of %u bytes live)", (unsigned)kv->live_bytes, (unsigned)KV_CAPACITY);
+        return false;
+    }
+    return kv_write(kv, ns, key, key_len, value, len, false);
+}
+
+const uint8_t *kv_get_ptr(const kv_store_t *kv, uint8_t ns, const char *key, size_t *len) {
+    size_t key_len;
+    if (!kv || !kv_check_key(ns, key, &key_len)) {
+        return NULL;
+    }
+    bool found;
+    uint32_t pos = kv_find_slot(kv, kv_hash(ns, key, key_len), ns, key, key_len, &found);
+    if (!found) {
+        return NULL;
+    }
+    const kv_record_hdr_t *hdr = (const kv_record_hdr_t *)flash_hal_xip_ptr(kv->index[pos].offset);
+    if (len) {
+        *len = kv_info_value_len(hdr->info);
+    }
+    return (const uint8_t *)(hdr + 1) + key_len;
+}
+
+bool kv_get(const kv_store_t *kv, uint8_t ns, const char *key, void *buf, size_t buf_len, size_t *len) {
+    size_t value_len;
+    const uint8_t *value = kv_get_ptr(kv, ns, key, &value_len);
+    if (!value) {
+        return false;
+    }
+    if (len) {
+        *len = value_len;
+    }
+    if (!buf) {
+        return true;
+    }
+    if (value_len > buf_len) {
+        LOG_ERROR("Key-value buffer too small: %u (need %u)", (unsigned)buf_len, (unsigned)value_len);
+        return false;
+    }
+    memcpy(buf, value, value_len);
+    return true;
+}
+
+bool kv_delete(kv_store_t *kv, uint8_t ns, const char *key) {
+    size_t key_len;
+    if (!kv || !kv_check_key(ns, key, &key_len)) {
+        return false;
+    }
+    bool found;
+    kv_find_slot(kv, kv_hash(ns, key, key_len), ns, key, key_len, &found);
+    if (!found) {
+        return true;
+    }
+    return kv_write(kv, ns, key, key_len, NULL, 0, true);
+}
+
+bool kv_compact(kv_store_t *kv) {
+    if (!kv) {
+        return false;
+    }
+    if (kv->used_sectors < 2) {
+        return true;  // Единственный сектор - текущий, освобождать нечего
+    }
+    return kv_collect_tail(kv);
+}
@@ -0,0 +1,132 @@
+#ifndef KVSTORE_H
+#define KVSTORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "hardware/flash.h"
+
+/*
+ * Хранилище «ключ - значение» во флеш-памяти.
+ *
+ * Записи дописываются в кольцо секторов; каждый сектор начинается заголовком с порядковым
+ * номером. При запуске kv_init() один раз просматривает кольцо и строит в RAM хеш-индекс
+ * с открытой адресацией (смещение последней записи каждого ключа), после чего поиск
+ * не сканирует флеш-память. Когда свободным остаётся один сектор, актуальные записи
+ * самого старого сектора переносятся в конец журнала, а сектор стирается.
+ */
+
+#ifndef KV_SECTORS
+#define KV_SECTORS              4          ///< Количество секторов хранилища
+#endif
+#define KV_SIZE                 (KV_SECTORS * FLASH_SECTOR_SIZE)
+#define KV_INDEX_SLOTS          128        ///< Ячеек хеш-индекса (степень двойки)
+#define KV_MAX_KEYS             (KV_INDEX_SLOTS * 3 / 4)  ///< Заполнение индекса не более 75%
+#define KV_KEY_MAX              32         ///< Максимальная длина ключа
+#define KV_VALUE_MAX            1024       ///< Максимальная длина значения
+
+// Пространства имён
+#define KV_NS_SETTINGS          1          ///< Настройки (settings_kv.c)
+#define KV_NS_CALIBRATION       2          ///< Калибровочные кривые яркости
+#define KV_NS_NETWORKS          3          ///< Учётные данные сетей Wi-Fi (profiles.c)
+#define KV_NS_NTP               4          ///< Статистика дрейфа часов и кэш серверов NTP (ntp_cache.c)
+#define KV_NS_DISPLAY           5          ///< Наборы параметров дисплея (profiles.c)
+#define KV_NS_MAX               0xFE       ///< Наибольший номер пространства имён
+/// Наибольшая часть арены flash_scratch во время записи: запись хранилища и перенос записей
+#define KV_WRITE_SCRATCH        (KV_KEY_MAX + KV_VALUE_MAX + 16 + FLASH_PAGE_SIZE + FLASH_SECTOR_SIZE)
+
+_Static_assert((KV_INDEX_SLOTS & (KV_INDEX_SLOTS - 1)) == 0, "KV_INDEX_SLOTS must be a power of two");
+_Static_assert(KV_SECTORS >= 3, "Key-value store needs a spare sector for compaction");
+
+/**
+ * @brief Ячейка хеш-индекса
+ */
+typedef struct {
+    uint32_t hash;                          ///< Хеш пространства имён и ключа
+    uint32_t offset;                        ///< Смещение записи во флеш-памяти (KV_SLOT_EMPTY - пусто)
+} kv_slot_t;
+
+/**
+ * @brief Статистика хранилища
+ */
+typedef struct {
+    uint32_t appends;                       ///< Дописано записей (включая удаления)
+    uint32_t skipped;                       ///< Записей не потребовалось (значение не изменилось)
+    uint32_t compactions;                   ///< Освобождено секторов переносом записей
+    uint32_t moved_bytes;                   ///< Перенесено байт при освобождении секторов
+    uint32_t damaged;                       ///< Повреждённых записей при запуске
+} kv_stats_t;
+
+/**
+ * @brief Состояние хранилища в RAM
+ */
+typedef struct {
+    uint32_t flash_offset;                  ///< Смещение первого сектора хранилища
+    uint32_t head_sector;                   ///< Сектор, в который идёт запись
+    uint32_t head_pos;                      ///< Смещение следующей записи внутри сектора
+    uint32_t tail_sector;                   ///< Самый старый сектор с данными
+    uint32_t used_sectors;                  ///< Секторов с данными (от tail до head)
+    uint32_t next_seq;                      ///< Номер следующего открываемого сектора
+    uint32_t live_bytes;                    ///< Размер актуальных записей во флеш-памяти
+    uint32_t keys;                          ///< Количество ключей
+    bool compacting;                        ///< Идёт перенос записей старого сектора
+    kv_stats_t stats;                       ///< Статистика
+    kv_slot_t index[KV_INDEX_SLOTS];        ///< Хеш-индекс с линейным пробированием
+} kv_store_t;
+
+/**
+ * @brief Открытие хранилища: просмотр секторов и построение индекса
+ * @param kv Состояние хранилища
+ * @param flash_offset Смещение хранилища (выровнено по FLASH_SECTOR_SIZE, KV_SIZE байт)
+ * @return true если хранилище открыто, false при неверном смещении или ошибке флеш-памяти
+ * @note Пустая или стёртая область становится пустым хранилищем
+ */
+bool kv_init(kv_store_t *kv, uint32_t flash_offset);
+
+/**
+ * @brief Запись значения
+ * @param kv Состояние хранилища
+ * @param ns Пространство имён (1..KV_NS_MAX)
+ * @param key Ключ (строка, не длиннее KV_KEY_MAX)
+ * @param value Значение
+ * @param len Длина значения (не более KV_VALUE_MAX)
+ * @return true если значение записано (или совпадает с записанным), false в противном случае
+ */
+bool kv_put(kv_store_t *kv, uint8_t ns, const char *key, const void *value, size_t len);
+
+/**
+ * @brief Чтение значения в буфер
+ * @param kv Состояние хранилища
+ * @param ns Пространство имён
+ * @param key Ключ
+ * @param buf Буфер для значения (NULL - только длина)
+ * @param buf_len Размер буфера
+ * @param len Длина значения (может быть NULL)
+ * @return true если ключ найден и значение поместилось в буфер
+ */
+bool kv_get(const kv_store_t *kv, uint8_t ns, const char *key, void *buf, size_t buf_len, size_t *len);
+
+/**
+ * @brief Указатель на значение во флеш-памяти без копирования
+ * @param kv Состояние хранилища
+ * @param ns Пространство имён
+ * @param key Ключ
+ * @param len Длина значения
+ * @return Указатель на значение или NULL, если ключа нет
+ * @note Указатель действителен до следующей записи в хранилище
+ */
+const uint8_t *kv_get_ptr(const kv_store_t *kv, uint8_t ns, const char *key, size_t *len);
+
+/**
+ * @brief Удаление ключа
+ * @return true если ключ удалён или отсутствовал, false при ошибке записи
+ */
+bool kv_delete(kv_store_t *kv, uint8_t ns, const char *key);
+
+/**
+ * @brief Освобождение самого старого сектора заранее (например, в простое)
+ * @return true если сектор освобождён или освобождать нечего
+ */
+bool kv_compact(kv_store_t *kv);
+
+#endif // KVSTORE_H
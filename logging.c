@@ -0,0 +1,279 @@
+#include <stdarg.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "pico/stdlib.h"
+#include "logging.h"
+
+#define LOG_RING_WORDS      (LOG_RING_SIZE / sizeof(uint32_t))
+#define LOG_RECORD_MAX_WORDS 64             // Максимальный размер записи (256 байт)
+#define LOG_LEVEL_PAD       0xFF            // Заполнитель до конца кольца
+#define LOG_PTR_WORDS       ((sizeof(const char *) + sizeof(uint32_t) - 1) / sizeof(uint32_t))
+#define LOG_HEADER_WORDS    (1 + 2 + LOG_PTR_WORDS)  // Заголовок, время, адрес формата
+
+_Static_assert((LOG_RING_WORDS & (LOG_RING_WORDS - 1)) == 0, "LOG_RING_SIZE must be a power of two");
+_Static_assert(LOG_RING_WORDS >= 2 * LOG_RECORD_MAX_WORDS, "LOG_RING_SIZE too small for a record");
+
+// Кольцо одного ядра: единственный производитель (ядро) и единственный потребитель (log_drain).
+// Индексы в словах растут непрерывно и только читаются/записываются атомарно.
+typedef struct {
+    uint32_t words[LOG_RING_WORDS];
+    atomic_uint head;                       // Записывает только производитель
+    atomic_uint tail;                       // Записывает только потребитель
+    atomic_uint dropped;                    // Записывает только производитель
+} log_ring_t;
+
+static log_ring_t rings[LOG_MAX_CORES];
+static uint32_t dropped_reported;
+
+// Заголовок записи: длина в словах и уровень
+static inline uint32_t log_header(uint32_t len, uint8_t level) {
+    return (len << 8) | level;
+}
+
+// Разбор спецификатора формата: пропуск флагов, ширины, точности и длины.
+// Возвращает указатель на символ преобразования, в *wide - признак 64-битного аргумента.
+static const char *log_parse_spec(const char *p, int *wide) {
+    size_t size = sizeof(int);
+    int longs = 0;
+    while (*p && strchr("-+ #0123456789.", *p)) {
+        p++;
+    }
+    for (; *p && strchr("hlLqjzt", *p); p++) {
+        if (*p == 'l') {
+            size = (++longs > 1) ? sizeof(long long) : sizeof(long);
+        } else if (*p == 'L' || *p == 'q' || *p == 'j') {
+            size = sizeof(long long);
+        } else if (*p == 'z') {
+            size = sizeof(size_t);
+        } else if (*p == 't') {
+            size = sizeof(ptrdiff_t);
+        }
+    }
+    *wide = size > sizeof(uint32_t);
+    return p;
+}
+
+static void log_put_u64(uint32_t *rec, size_t *pos, uint64_t value) {
+    rec[(*pos)++] = (uint32_t)value;
+    rec[(*pos)++] = (uint32_t)(value >> 32);
+}
+
+static uint64_t log_get_u64(const uint32_t *rec, size_t *pos) {
+    uint64_t value = rec[*pos] | ((uint64_t)rec[*pos + 1] << 32);
+    *pos += 2;
+    return value;
+}
+
+void log_write(uint8_t level, const char *fmt, ...) {
+    uint32_t rec[LOG_RECORD_MAX_WORDS];
+    size_t pos = LOG_HEADER_WORDS;
+    memcpy(&rec[3], &fmt, sizeof(fmt));
+
+    // Аргументы сохраняются в порядке спецификаторов; форматирование - при разборе
+    va_list args;
+    va_start(args, fmt);
+    for (const char *p = fmt; *p; p++) {
+        if (*p != '%') {
+            continue;
+        }
+        if (p[1] == '%') {
+            p++;
+            continue;
+        }
+        int wide;
+        p = log_parse_spec(p + 1, &wide);
+        if (!*p) {
+            break;
+        }
+        if (pos + 2 > LOG_RECORD_MAX_WORDS) {
+            break;  // Лишние аргументы не помещаются: выводятся как есть
+        }
+        if (*p == 's') {
+            const char *str = va_arg(args, const char *);
+            if (!str) {
+                str = "(null)";
+            }
+            size_t n = strnlen(str, LOG_STR_MAX);
+            size_t words = (n + sizeof(uint32_t)) / sizeof(uint32_t);
+            if (pos + 1 + words > LOG_RECORD_MAX_WORDS) {
+                n = 0;
+                words = 1;
+            }
+            rec[pos++] = (uint32_t)n;
+            rec[pos + words - 1] = 0;
+            memcpy(&rec[pos], str, n);
+            ((char *)&rec[pos])[n] = '\0';
+            pos += words;
+        } else if (*p == 'p') {
+            log_put_u64(rec, &pos, (uintptr_t)va_arg(args, void *));
+        } else if (wide) {
+            log_put_u64(rec, &pos, va_arg(args, unsigned long long));
+        } else {
+            rec[pos++] = va_arg(args, unsigned int);
+        }
+    }
+    va_end(args);
+
+    uint64_t now = time_us_64();
+    rec[0] = log_header((uint32_t)pos, level);
+    rec[1] = (uint32_t)now;
+    rec[2] = (uint32_t)(now >> 32);
+
+    log_ring_t *ring = &rings[get_core_num() % LOG_MAX_CORES];
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    uint32_t index = head & (LOG_RING_WORDS - 1);
+    uint32_t pad = (index + pos > LOG_RING_WORDS) ? LOG_RING_WORDS - index : 0;
+    if (LOG_RING_WORDS - (head - tail) < pad + pos) {
+        unsigned dropped = atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+        atomic_store_explicit(&ring->dropped, dropped + 1, memory_order_relaxed);
+        return;
+    }
+    if (pad) {
+        // Запись не разрезается: остаток кольца занимает заполнитель
+        ring->words[index] = log_header(pad, LOG_LEVEL_PAD);
+        head += pad;
+        index = 0;
+    }
+    memcpy(&ring->words[index], rec, pos * sizeof(uint32_t));
+    atomic_store_explicit(&ring->head, head + pos, memory_order_release);
+}
+
+// Первая запись кольца (заполнители пропускаются); NULL, если кольцо пусто
+static const uint32_t *log_peek(log_ring_t *ring) {
+    for (;;) {
+        unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (tail == head) {
+            return NULL;
+        }
+        const uint32_t *rec = &ring->words[tail & (LOG_RING_WORDS - 1)];
+        if ((rec[0] & 0xFF) != LOG_LEVEL_PAD) {
+            return rec;
+        }
+        atomic_store_explicit(&ring->tail, tail + (rec[0] >> 8), memory_order_release);
+    }
+}
+
+// Форматирование записи по сохранённой строке формата
+static void log_format(const uint32_t *rec, char *buf, size_t len) {
+    const char *fmt;
+    memcpy(&fmt, &rec[3], sizeof(fmt));
+    size_t pos = LOG_HEADER_WORDS;
+    size_t words = rec[0] >> 8;
+    size_t out = 0;
+
+    for (const char *p = fmt; *p && out + 1 < len; p++) {
+        if (*p != '%' || p[1] == '%') {
+            buf[out++] = *p;
+            p += (*p == '%');
+            continue;
+        }
+        int wide;
+        const char *conv = log_parse_spec(p + 1, &wide);
+        if (!*conv || pos >= words) {
+            break;
+        }
+
+        // Спецификатор без модификатора длины; 64-битные значения выводятся через ll
+        char spec[24];
+        size_t flags_len = strspn(p, "%-+ #0123456789.");
+        if (flags_len > sizeof(spec) - 4) {
+            flags_len = sizeof(spec) - 4;
+        }
+        memcpy(spec, p, flags_len);
+        size_t spec_len = flags_len;
+        if (wide && *conv != 's' && *conv != 'p') {
+            spec[spec_len++] = 'l';
+            spec[spec_len++] = 'l';
+        }
+        spec[spec_len++] = *conv;
+        spec[spec_len] = '\0';
+
+        int n;
+        if (*conv == 's') {
+            size_t str_len = rec[pos++];
+            n = snprintf(buf + out, len - out, spec, (const char *)&rec[pos]);
+            pos += (str_len + sizeof(uint32_t)) / sizeof(uint32_t);
+        } else if (*conv == 'p') {
+            n = snprintf(buf + out, len - out, spec, (void *)(uintptr_t)log_get_u64(rec, &pos));
+        } else if (wide) {
+            n = snprintf(buf + out, len - out, spec, log_get_u64(rec, &pos));
+        } else if (*conv == 'd' || *conv == 'i' || *conv == 'c') {
+            n = snprintf(buf + out, len - out, spec, (int)rec[pos++]);
+        } else {
+            n = snprintf(buf + out, len - out, spec, (unsigned)rec[pos++]);
+        }
+        if (n > 0) {
+            out += (size_t)n < len - out ? (size_t)n : len - out - 1;
+        }
+        p = conv;
+    }
+    buf[out] = '\0';
+}
+
+int log_read(char *buf, size_t len, uint64_t *timestamp_us) {
+    if (!buf || len == 0) {
+        return LOG_LEVEL_NONE;
+    }
+
+    // Слияние колец ядер по времени записи
+    log_ring_t *oldest = NULL;
+    const uint32_t *oldest_rec = NULL;
+    uint64_t oldest_time = 0;
+    for (size_t core = 0; core < LOG_MAX_CORES; core++) {
+        const uint32_t *rec = log_peek(&rings[core]);
+        uint64_t time = rec ? (rec[1] | ((uint64_t)rec[2] << 32)) : 0;
+        if (rec && (!oldest || time < oldest_time)) {
+            oldest = &rings[core];
+            oldest_rec = rec;
+            oldest_time = time;
+        }
+    }
+    if (!oldest) {
+        return LOG_LEVEL_NONE;
+    }
+
+    int level = oldest_rec[0] & 0xFF;
+    log_format(oldest_rec, buf, len);
+    if (timestamp_us) {
+        *timestamp_us = oldest_time;
+    }
+    unsigned tail = atomic_load_explicit(&oldest->tail, memory_order_relaxed);
+    atomic_store_explicit(&oldest->tail, tail + (oldest_rec[0] >> 8), memory_order_release);
+    return level;
+}
+
+size_t log_drain(size_t max_records) {
+    static char line[256];
+    size_t printed = 0;
+
+    uint32_t dropped = log_dropped();
+    if (dropped != dropped_reported) {
+        printf(COLOR_YELLOW "[WARNING] %u log messages dropped" COLOR_RESET "\n",
+               (unsigned)(dropped - dropped_reported));
+        dropped_reported = dropped;
+    }
+
+    while (printed < max_records) {
+        uint64_t time;
+        int level = log_read(line, sizeof(line), &time);
+        if (level == LOG_LEVEL_NONE) {
+            break;
+        }
+        const char *color = level == LOG_LEVEL_ERROR ? COLOR_RED : level == LOG_LEVEL_WARN ? COLOR_YELLOW : COLOR_GREEN;
+        const char *prefix = level == LOG_LEVEL_ERROR ? "[ERROR]" : level == LOG_LEVEL_WARN ? "[WARNING]" : "[INFO]";
+        printf("%s[%6u.%06u] %s %s" COLOR_RESET "\n", color, (unsigned)(time / 1000000),
+               (unsigned)(time % 1000000), prefix, line);
+        printed++;
+    }
+    return printed;
+}
+
+uint32_t log_dropped(void) {
+    uint32_t total = 0;
+    for (size_t core = 0; core < LOG_MAX_CORES; core++) {
+        total += atomic_load_explicit(&rings[core].dropped, memory_order_relaxed);
+    }
+    return total;
+}
@@ -1,9 +1,28 @@
 
-
 #ifndef LOGGING_H
 #define LOGGING_H
 
 #include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// Уровни логирования
+#define LOG_LEVEL_NONE  0                  ///< Логирование отключено
+#define LOG_LEVEL_ERROR 1                  ///< Только ошибки
+#define LOG_LEVEL_WARN  2                  ///< Ошибки и предупреждения
+#define LOG_LEVEL_INFO  3                  ///< Все сообщения
+
+// Максимальный уровень в сборке: сообщения выше него удаляются компилятором вместе с форматированием
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// Отложенное логирование: кольцевой буфер на ядро
+#ifndef LOG_RING_SIZE
+#define LOG_RING_SIZE   2048               ///< Размер кольца одного ядра в байтах (степень двойки)
+#endif
+#define LOG_STR_MAX     64                 ///< Максимальная длина строкового аргумента (%s), копируемого в запись
+#define LOG_MAX_CORES   2                  ///< Количество ядер (по кольцу на ядро)
 
 #ifdef DEBUG_COLORS
 #define COLOR_RESET   "\033[0m"
@@ -12,9 +31,6 @@
 #define COLOR_YELLOW  "\033[33m"
 #define COLOR_BLUE    "\033[34m"
 #define COLOR_CYAN    "\033[36m"
-#define LOG_ERROR(fmt, ...)   printf(COLOR_RED "[ERROR] " fmt COLOR_RESET "\n", ##__VA_ARGS__)
-#define LOG_WARN(fmt, ...)    printf(COLOR_YELLOW "[WARNING] " fmt COLOR_RESET "\n", ##__VA_ARGS__)
-#define LOG_INFO(fmt, ...)    printf(COLOR_GREEN "[INFO] " fmt COLOR_RESET "\n", ##__VA_ARGS__)
 #else
 #define COLOR_RESET   ""
 #define COLOR_RED     ""
@@ -22,9 +38,72 @@
 #define COLOR_YELLOW  ""
 #define COLOR_BLUE    ""
 #define COLOR_CYAN    ""
-#define LOG_ERROR(fmt, ...)   printf("[ERROR] " fmt "\n", ##__VA_ARGS__)
-#define LOG_WARN(fmt, ...)    printf("[WARNING] " fmt "\n", ##__VA_ARGS__)
-#define LOG_INFO(fmt, ...)    printf("[INFO] " fmt "\n", ##__VA_ARGS__)
 #endif
 
-#endif // LOGGING_H
\ No newline at end of file
+#ifdef LOG_DEFERRED
+// Запись в кольцо: адрес строки формата, время и аргументы без форматирования
+#define LOG_EMIT(level, color, prefix, fmt, ...)  log_write(level, fmt, ##__VA_ARGS__)
+#else
+#define LOG_EMIT(level, color, prefix, fmt, ...)  printf(color prefix fmt COLOR_RESET "\n", ##__VA_ARGS__)
+#endif
+
+// Отключённый уровень: аргументы проверяются компилятором, но код не генерируется
+#define LOG_DISCARD(fmt, ...)  do { if (0) printf(fmt, ##__VA_ARGS__); } while (0)
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(fmt, ...)   LOG_EMIT(LOG_LEVEL_ERROR, COLOR_RED, "[ERROR] ", fmt, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(fmt, ...)   LOG_DISCARD(fmt, ##__VA_ARGS__)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(fmt, ...)    LOG_EMIT(LOG_LEVEL_WARN, COLOR_YELLOW, "[WARNING] ", fmt, ##__VA_ARGS__)
+#else
+#define LOG_WARN(fmt, ...)    LOG_DISCARD(fmt, ##__VA_ARGS__)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(fmt, ...)    LOG_EMIT(LOG_LEVEL_INFO, COLOR_GREEN, "[INFO] ", fmt, ##__VA_ARGS__)
+#else
+#define LOG_INFO(fmt, ...)    LOG_DISCARD(fmt, ##__VA_ARGS__)
+#endif
+
+/**
+ * @brief Запись сообщения в кольцо текущего ядра без форматирования
+ *
+ * Сохраняет адрес строки формата (идентификатор), время и аргументы; строки (%s)
+ * копируются в запись (до LOG_STR_MAX символов). Если места нет, сообщение
+ * отбрасывается и учитывается в log_dropped(). Не вызывать из обработчиков прерываний.
+ * @param level Уровень сообщения (LOG_LEVEL_*)
+ * @param fmt Строка формата printf (должна существовать до разбора записи)
+ */
+void log_write(uint8_t level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief Извлечение и форматирование самой старой записи из колец всех ядер
+ * @param buf Буфер для текста сообщения (с завершающим \0)
+ * @param len Размер буфера
+ * @param timestamp_us Время записи в микросекундах (может быть NULL)
+ * @return Уровень сообщения или LOG_LEVEL_NONE, если кольца пусты
+ */
+int log_read(char *buf, size_t len, uint64_t *timestamp_us);
+
+/**
+ * @brief Вывод накопленных сообщений (низкоприоритетная задача главного цикла)
+ * @param max_records Максимальное количество сообщений за вызов
+ * @return Количество выведенных сообщений
+ */
+size_t log_drain(size_t max_records);
+
+/**
+ * @brief Вывод всех накопленных сообщений
+ */
+static inline void log_flush(void) {
+    while (log_drain(16) > 0) {
+    }
+}
+
+/**
+ * @brief Количество отброшенных из-за переполнения сообщений
+ */
+uint32_t log_dropped(void);
+
+#endif // LOGGING_H
@@ -0,0 +1,72 @@
+# Отчёт о памяти подсистемы флеш-памяти: статические данные (.bss/.data) и наибольший кадр стека
+# каждого файла. Запускается целью memory_report после сборки объектов с -fstack-usage:
+#   cmake -DNM=<nm> -DOBJECT_DIR=<каталог объектов> -DOUTPUT=<файл> -P memory_report.cmake
+
+if(NOT NM OR NOT OBJECT_DIR OR NOT OUTPUT)
+    message(FATAL_ERROR "NM, OBJECT_DIR and OUTPUT must be set")
+endif()
+
+# Файлы подсистемы; прочие объекты каталога (тесты, бенчмарки) в отчёт не входят
+set(FLASH_SUBSYSTEM settings settings_schema settings_boot settings_shared settings_migrate settings_codec settings_sched
+        settings_kv kvstore tslog profiles ntp_cache ntp_sync provision flash_utils flash_async flash_scratch flash_hal_pico
+        flash_hal_host crc32 aead logging)
+
+set(report "")
+set(total_static 0)
+set(total_stack 0)
+string(APPEND report "File                      Static RAM   Max frame  Function\n")
+foreach(name ${FLASH_SUBSYSTEM})
+    set(object ${OBJECT_DIR}/${name}.c.o)
+    if(NOT EXISTS ${object})
+        continue()
+    endif()
+
+    # Размеры объектов в .bss/.data; крупные перечисляются отдельно
+    execute_process(COMMAND ${NM} -S --size-sort ${object} OUTPUT_VARIABLE symbols RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "${NM} failed on ${object}")
+    endif()
+    set(static_bytes 0)
+    set(large "")
+    string(REPLACE "\n" ";" symbols "${symbols}")
+    foreach(line ${symbols})
+        if(line MATCHES "^[0-9a-fA-F]+ ([0-9a-fA-F]+) [bBdDcC] (.+)$")
+            math(EXPR size "0x${CMAKE_MATCH_1}")
+            math(EXPR static_bytes "${static_bytes} + ${size}")
+            if(size GREATER_EQUAL 256)
+                string(APPEND large "    ${CMAKE_MATCH_2}: ${size}\n")
+            endif()
+        endif()
+    endforeach()
+
+    # Наибольший кадр стека из файла -fstack-usage
+    set(frame 0)
+    set(frame_fn "-")
+    if(EXISTS ${OBJECT_DIR}/${name}.c.su)
+        file(STRINGS ${OBJECT_DIR}/${name}.c.su frames)
+        foreach(line ${frames})
+            if(line MATCHES ":([^:\t]+)\t([0-9]+)\t")
+                if(CMAKE_MATCH_2 GREATER frame)
+                    set(frame ${CMAKE_MATCH_2})
+                    set(frame_fn ${CMAKE_MATCH_1})
+                endif()
+            endif()
+        endforeach()
+    endif()
+
+    math(EXPR total_static "${total_static} + ${static_bytes}")
+    math(EXPR total_stack "${total_stack} + ${frame}")
+    string(LENGTH "${name}.c" len)
+    math(EXPR pad "26 - ${len}")
+    string(REPEAT " " ${pad} spaces)
+    string(LENGTH "${static_bytes}" len)
+    math(EXPR pad1 "10 - ${len}")
+    string(REPEAT " " ${pad1} spaces1)
+    string(LENGTH "${frame}" len)
+    math(EXPR pad2 "12 - ${len}")
+    string(REPEAT " " ${pad2} spaces2)
+    string(APPEND report "${name}.c${spaces}${spaces1}${static_bytes}${spaces2}${frame}  ${frame_fn}\n${large}")
+endforeach()
+string(APPEND report "Total static RAM: ${total_static} bytes; sum of largest frames: ${total_stack} bytes\n")
+
+file(WRITE ${OUTPUT} "${report}")
@@ -0,0 +1,161 @@
+#include <string.h>
+#include "pico/stdlib.h"
+#include "ntp_cache.h"
+#include "logging.h"
+
+// Значение в хранилище: версия формата и записи серверов
+typedef struct {
+    uint32_t version;
+    ntp_cache_entry_t servers[NTP_MAX_SERVERS];
+} ntp_cache_value_t;
+
+_Static_assert(sizeof(ntp_cache_value_t) <= KV_VALUE_MAX, "NTP cache must fit in a key-value record");
+_Static_assert(NTP_MAX_SERVERS <= 32, "Server masks are 32-bit");
+
+uint32_t ntp_cache_name_hash(const char *host) {
+    uint32_t hash = 2166136261u;
+    for (const char *p = host; *p; p++) {
+        hash = (hash ^ (uint8_t)*p) * 16777619u;
+    }
+    return hash ? hash : 1;  // 0 обозначает пустую запись
+}
+
+bool ntp_cache_load(ntp_cache_t *cache, const kv_store_t *kv, const settings_t *cfg) {
+    if (!cache || !kv || !cfg) {
+        LOG_ERROR("Null pointer passed to ntp_cache_load");
+        return false;
+    }
+    memset(cache, 0, sizeof(*cache));
+
+    ntp_cache_value_t value;
+    size_t len;
+    if (!kv_get(kv, KV_NS_NTP, NTP_CACHE_KEY, &value, sizeof(value), &len) || len != sizeof(value) ||
+        value.version != NTP_CACHE_VERSION) {
+        LOG_INFO("NTP server cache is empty");
+        return false;
+    }
+
+    bool usable = false;
+    for (uint8_t i = 0; i < NTP_MAX_SERVERS; i++) {
+        const char *host = cfg->ntp_servers[i];
+        if (host[0] == '\0' || value.servers[i].name_hash != ntp_cache_name_hash(host)) {
+            continue;  // Имя сервера в настройках изменилось - сведения о прежнем не годятся
+        }
+        cache->servers[i] = value.servers[i];
+        usable |= cache->servers[i].ipv4 != 0;
+    }
+    return usable;
+}
+
+bool ntp_cache_save(ntp_cache_t *cache, kv_store_t *kv) {
+    if (!cache || !kv) {
+        LOG_ERROR("Null pointer passed to ntp_cache_save");
+        return false;
+    }
+    if (!cache->dirty) {
+        return true;
+    }
+    ntp_cache_value_t value;
+    memset(&value, 0, sizeof(value));
+    value.version = NTP_CACHE_VERSION;
+    memcpy(value.servers, cache->servers, sizeof(value.servers));
+    if (!kv_put(kv, KV_NS_NTP, NTP_CACHE_KEY, &value, sizeof(value))) {
+        LOG_ERROR("Failed to save NTP server cache");
+        return false;
+    }
+    cache->dirty = false;
+    return true;
+}
+
+void ntp_cache_resolved(ntp_cache_t *cache, uint8_t server, const char *host, uint32_t ipv4, uint32_t ttl_s,
+                        uint32_t now_s) {
+    if (!cache || !host || server >= NTP_MAX_SERVERS) {
+        return;
+    }
+    ntp_cache_entry_t *entry = &cache->servers[server];
+    uint32_t hash = ntp_cache_name_hash(host);
+    if (entry->name_hash != hash) {
+        memset(entry, 0, sizeof(*entry));
+        entry->name_hash = hash;
+    }
+    if (ipv4 == 0) {
+        return;  // Имя не разрешилось: последний известный адрес остаётся
+    }
+    if (entry->ipv4 != ipv4) {
+        // Новый адрес - другой узел: прежние измерения к нему не относятся
+        entry->srtt_us = 0;
+        entry->jitter_us = 0;
+        entry->score = 0;
+    }
+    entry->ipv4 = ipv4;
+    entry->ttl_s = ttl_s;
+    entry->expires = now_s ? now_s + ttl_s : 0;
+    cache->dirty = true;
+}
+
+void ntp_cache_success(ntp_cache_t *cache, uint8_t server, uint32_t rtt_us, int32_t offset_us) {
+    if (!cache || server >= NTP_MAX_SERVERS) {
+        return;
+    }
+    ntp_cache_entry_t *entry = &cache->servers[server];
+    if (entry->srtt_us == 0) {
+        entry->srtt_us = rtt_us ? rtt_us : 1;
+    } else {
+        entry->srtt_us = (uint32_t)(((int64_t)entry->srtt_us * ((1 << NTP_CACHE_RTT_SHIFT) - 1) + rtt_us) >>
+                                    NTP_CACHE_RTT_SHIFT);
+    }
+    if (entry->score > 0 || entry->last_offset_us != 0) {
+        int64_t diff = (int64_t)offset_us - entry->last_offset_us;
+        uint32_t step = (uint32_t)(diff < 0 ? -diff : diff);
+        entry->jitter_us = (uint32_t)(((int64_t)entry->jitter_us * ((1 << NTP_CACHE_JITTER_SHIFT) - 1) + step) >>
+                                      NTP_CACHE_JITTER_SHIFT);
+    }
+    entry->last_offset_us = offset_us;
+    if (entry->score < NTP_CACHE_SCORE_MAX) {
+        entry->score++;
+    }
+    cache->dirty = true;
+}
+
+void ntp_cache_failure(ntp_cache_t *cache, uint8_t server) {
+    if (!cache || server >= NTP_MAX_SERVERS) {
+        return;
+    }
+    // Неудача весит вдвое больше ответа: неотвечающий сервер быстро теряет первое место
+    ntp_cache_entry_t *entry = &cache->servers[server];
+    entry->score = entry->score - 2 < NTP_CACHE_SCORE_MIN ? NTP_CACHE_SCORE_MIN : (int8_t)(entry->score - 2);
+    cache->dirty = true;
+}
+
+bool ntp_cache_expired(const ntp_cache_t *cache, uint8_t server, uint32_t now_s) {
+    if (!cache || server >= NTP_MAX_SERVERS) {
+        return true;
+    }
+    const ntp_cache_entry_t *entry = &cache->servers[server];
+    return entry->ipv4 == 0 || now_s == 0 || entry->expires == 0 || entry->expires <= now_s;
+}
+
+int ntp_cache_best(const ntp_cache_t *cache, uint32_t exclude) {
+    if (!cache) {
+        return -1;
+    }
+    int best = -1;
+    for (int i = 0; i < NTP_MAX_SERVERS; i++) {
+        const ntp_cache_entry_t *entry = &cache->servers[i];
+        if (entry->ipv4 == 0 || (exclude & (1u << i))) {
+            continue;
+        }
+        if (best < 0) {
+            best = i;
+            continue;
+        }
+        // Сервер без измерений RTT уступает измеренному при равной оценке
+        const ntp_cache_entry_t *current = &cache->servers[best];
+        uint32_t rtt = entry->srtt_us ? entry->srtt_us : UINT32_MAX;
+        uint32_t best_rtt = current->srtt_us ? current->srtt_us : UINT32_MAX;
+        if (entry->score > current->score || (entry->score == current->score && rtt < best_rtt)) {
+            best = i;
+        }
+    }
+    return best;
+}
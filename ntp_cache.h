@@ -0,0 +1,102 @@
+#ifndef NTP_CACHE_H
+#define NTP_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "settings.h"
+#include "kvstore.h"
+
+/*
+ * Кэш разрешения имён и качества NTP-серверов.
+ *
+ * Для каждого сервера из settings_t.ntp_servers хранятся последний IPv4-адрес и его TTL,
+ * сглаженные RTT и разброс смещения, а также оценка успехов и неудач. Кэш сохраняется
+ * в хранилище «ключ - значение» рядом с настройками (KV_NS_NTP) и после перезагрузки позволяет
+ * сразу отправить запрос лучшему серверу, не дожидаясь DNS.
+ */
+
+#define NTP_CACHE_KEY           "servers"  ///< Ключ в пространстве имён KV_NS_NTP
+#define NTP_CACHE_VERSION       1
+#define NTP_CACHE_SCORE_MAX     16         ///< Наибольшая оценка сервера
+#define NTP_CACHE_SCORE_MIN     (-16)      ///< Наименьшая оценка сервера
+#define NTP_CACHE_RTT_SHIFT     3          ///< Вес нового RTT в сглаживании: 1/8
+#define NTP_CACHE_JITTER_SHIFT  2          ///< Вес нового разброса смещения: 1/4
+
+/**
+ * @brief Сведения об одном сервере
+ */
+typedef struct {
+    uint32_t name_hash;                     ///< Хеш имени сервера (0 - запись пуста)
+    uint32_t ipv4;                          ///< Последний адрес (0 - не разрешён)
+    uint32_t ttl_s;                         ///< TTL последнего ответа DNS, с
+    uint32_t expires;                       ///< Окончание TTL, Unix-время (0 - неизвестно)
+    uint32_t srtt_us;                       ///< Сглаженное RTT (0 - измерений не было)
+    uint32_t jitter_us;                     ///< Сглаженный разброс смещения между ответами
+    int32_t last_offset_us;                 ///< Смещение по последнему ответу
+    int8_t score;                           ///< Оценка: растёт с ответами, падает с неудачами
+    uint8_t reserved[3];
+} ntp_cache_entry_t;
+
+/**
+ * @brief Кэш серверов (индексы совпадают с settings_t.ntp_servers)
+ */
+typedef struct {
+    ntp_cache_entry_t servers[NTP_MAX_SERVERS]; ///< Сведения о серверах
+    bool dirty;                             ///< Есть изменения, не сохранённые в хранилище
+} ntp_cache_t;
+
+/**
+ * @brief Загрузка кэша из хранилища
+ * @param cache Кэш
+ * @param kv Хранилище «ключ - значение»
+ * @param cfg Настройки: записи серверов, имя которых изменилось, отбрасываются
+ * @return true если есть хотя бы один сервер с адресом
+ * @note При отсутствии или повреждении значения кэш становится пустым
+ */
+bool ntp_cache_load(ntp_cache_t *cache, const kv_store_t *kv, const settings_t *cfg);
+
+/**
+ * @brief Сохранение изменённого кэша в хранилище
+ * @return true если кэш сохранён или не изменялся
+ */
+bool ntp_cache_save(ntp_cache_t *cache, kv_store_t *kv);
+
+/**
+ * @brief Ответ DNS для сервера
+ * @param host Имя сервера (для хеша)
+ * @param ipv4 Адрес (0 - имя не разрешено)
+ * @param ttl_s TTL ответа, с
+ * @param now_s Текущее Unix-время (0 - ещё не синхронизировано)
+ */
+void ntp_cache_resolved(ntp_cache_t *cache, uint8_t server, const char *host, uint32_t ipv4, uint32_t ttl_s,
+                        uint32_t now_s);
+
+/**
+ * @brief Успешный ответ сервера: обновление RTT, разброса смещения и оценки
+ */
+void ntp_cache_success(ntp_cache_t *cache, uint8_t server, uint32_t rtt_us, int32_t offset_us);
+
+/**
+ * @brief Сервер не ответил
+ */
+void ntp_cache_failure(ntp_cache_t *cache, uint8_t server);
+
+/**
+ * @brief Нужно ли разрешать имя сервера заново
+ * @param now_s Текущее Unix-время (0 - неизвестно: адрес считается устаревшим)
+ */
+bool ntp_cache_expired(const ntp_cache_t *cache, uint8_t server, uint32_t now_s);
+
+/**
+ * @brief Лучший сервер с известным адресом
+ * @param exclude Маска серверов, которые не рассматриваются (бит i - сервер i)
+ * @return Индекс сервера или -1: наибольшая оценка, при равенстве - наименьшее RTT
+ */
+int ntp_cache_best(const ntp_cache_t *cache, uint32_t exclude);
+
+/**
+ * @brief Хеш имени сервера для привязки записи кэша
+ */
+uint32_t ntp_cache_name_hash(const char *host);
+
+#endif // NTP_CACHE_H
@@ -0,0 +1,118 @@
+#include <string.h>
+#include "pico/stdlib.h"
+#include "ntp_sync.h"
+#include "logging.h"
+
+// Отправка запроса лучшему из ещё не опрошенных серверов с известным адресом
+static void ntp_sync_request_best(ntp_sync_t *sync, uint64_t now_us) {
+    while (sync->current < 0) {
+        int best = ntp_cache_best(sync->cache, sync->tried);
+        if (best < 0) {
+            return;
+        }
+        sync->tried |= 1u << best;
+        uint32_t ipv4 = sync->cache->servers[best].ipv4;
+        if (!sync->transport->request(sync->transport->ctx, (uint8_t)best, ipv4)) {
+            LOG_WARN("NTP request to server %d could not be sent", best);
+            ntp_cache_failure(sync->cache, (uint8_t)best);
+            continue;
+        }
+        sync->current = (int8_t)best;
+        sync->current_ipv4 = ipv4;
+        sync->request_us = now_us;
+    }
+}
+
+bool ntp_sync_start(ntp_sync_t *sync, const settings_t *cfg, ntp_cache_t *cache, const ntp_transport_t *transport,
+                    uint32_t timeout_ms, uint32_t now_s, uint64_t now_us) {
+    if (!sync || !cfg || !cache || !transport || !transport->resolve || !transport->request) {
+        LOG_ERROR("Null pointer passed to ntp_sync_start");
+        return false;
+    }
+    memset(sync, 0, sizeof(*sync));
+    sync->cfg = cfg;
+    sync->cache = cache;
+    sync->transport = transport;
+    sync->timeout_us = timeout_ms * 1000u;
+    sync->current = -1;
+    sync->start_us = now_us;
+
+    bool configured = false;
+    for (uint8_t i = 0; i < NTP_MAX_SERVERS; i++) {
+        if (cfg->ntp_servers[i][0] == '\0') {
+            continue;
+        }
+        configured = true;
+        // Адрес с истёкшим TTL ещё пригоден для первого запроса, но имя разрешается заново
+        if (ntp_cache_expired(cache, i, now_s) && transport->resolve(transport->ctx, i, cfg->ntp_servers[i])) {
+            sync->pending_dns |= 1u << i;
+        }
+    }
+    if (!configured) {
+        LOG_WARN("No NTP servers configured");
+        sync->state = NTP_SYNC_FAILED;
+        return false;
+    }
+
+    sync->state = NTP_SYNC_RUNNING;
+    ntp_sync_request_best(sync, now_us);
+    sync->from_cache = sync->current >= 0;
+    if (sync->from_cache) {
+        LOG_INFO("NTP request sent to cached address of server %d", sync->current);
+    }
+    return true;
+}
+
+void ntp_sync_on_dns(ntp_sync_t *sync, uint8_t server, uint32_t ipv4, uint32_t ttl_s, uint32_t now_s,
+                     uint64_t now_us) {
+    if (!sync || server >= NTP_MAX_SERVERS || !(sync->pending_dns & (1u << server))) {
+        return;
+    }
+    sync->pending_dns &= ~(1u << server);
+    if (ipv4 == 0) {
+        LOG_WARN("DNS lookup failed for %s", sync->cfg->ntp_servers[server]);
+        return;
+    }
+    if (sync->cache->servers[server].ipv4 != ipv4) {
+        sync->tried &= ~(1u << server);  // Сервер сменил адрес: по новому ещё не спрашивали
+    }
+    ntp_cache_resolved(sync->cache, server, sync->cfg->ntp_servers[server], ipv4, ttl_s, now_s);
+    if (sync->state == NTP_SYNC_RUNNING) {
+        ntp_sync_request_best(sync, now_us);
+    }
+}
+
+bool ntp_sync_on_reply(ntp_sync_t *sync, uint8_t server, uint32_t ipv4, int32_t offset_us, uint32_t rtt_us,
+                       uint64_t now_us) {
+    if (!sync || sync->state != NTP_SYNC_RUNNING || server != sync->current || ipv4 != sync->current_ipv4) {
+        return false;
+    }
+    ntp_cache_success(sync->cache, server, rtt_us, offset_us);
+    sync->current = -1;
+    sync->offset_us = offset_us;
+    sync->first_sync_us = now_us - sync->start_us;
+    sync->state = NTP_SYNC_DONE;
+    LOG_INFO("Time synchronized from server %u in %u ms%s", server, (unsigned)(sync->first_sync_us / 1000),
+             sync->from_cache ? " (cached address)" : "");
+    return true;
+}
+
+ntp_sync_state_t ntp_sync_poll(ntp_sync_t *sync, uint64_t now_us) {
+    if (!sync) {
+        return NTP_SYNC_FAILED;
+    }
+    if (sync->state != NTP_SYNC_RUNNING) {
+        return sync->state;
+    }
+    if (sync->current >= 0 && now_us - sync->request_us >= sync->timeout_us) {
+        LOG_WARN("NTP server %d did not answer", sync->current);
+        ntp_cache_failure(sync->cache, (uint8_t)sync->current);
+        sync->current = -1;
+    }
+    ntp_sync_request_best(sync, now_us);
+    if (sync->current < 0 && sync->pending_dns == 0) {
+        LOG_ERROR("No NTP server answered");
+        sync->state = NTP_SYNC_FAILED;
+    }
+    return sync->state;
+}
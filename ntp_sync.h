@@ -0,0 +1,101 @@
+#ifndef NTP_SYNC_H
+#define NTP_SYNC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "settings.h"
+#include "ntp_cache.h"
+
+/*
+ * Первая синхронизация времени после загрузки.
+ *
+ * Сетевой стек подключается через ntp_transport_t: клиент только запускает DNS- и NTP-запросы,
+ * а ответы передаются ему вызовами ntp_sync_on_dns и ntp_sync_on_reply. Если в кэше есть адрес,
+ * запрос лучшему серверу отправляется сразу при старте, а имена разрешаются заново в фоне;
+ * без кэша первый запрос ждёт первого ответа DNS.
+ */
+
+#define NTP_SYNC_TIMEOUT_MS     1000       ///< Ожидание ответа сервера по умолчанию
+
+/**
+ * @brief Транспорт: запуск запросов (ответы приходят асинхронно)
+ */
+typedef struct {
+    void *ctx;                                                          ///< Контекст транспорта
+    bool (*resolve)(void *ctx, uint8_t server, const char *host);       ///< Запрос DNS
+    bool (*request)(void *ctx, uint8_t server, uint32_t ipv4);          ///< Отправка запроса NTP
+} ntp_transport_t;
+
+/**
+ * @brief Состояние синхронизации
+ */
+typedef enum {
+    NTP_SYNC_IDLE = 0,
+    NTP_SYNC_RUNNING,                       ///< Ожидание ответов
+    NTP_SYNC_DONE,                          ///< Время получено
+    NTP_SYNC_FAILED                         ///< Ни один сервер не ответил
+} ntp_sync_state_t;
+
+/**
+ * @brief Клиент первой синхронизации
+ */
+typedef struct {
+    const settings_t *cfg;                  ///< Настройки (имена серверов)
+    ntp_cache_t *cache;                     ///< Кэш серверов
+    const ntp_transport_t *transport;       ///< Транспорт
+    uint32_t timeout_us;                    ///< Ожидание ответа сервера
+    ntp_sync_state_t state;                 ///< Состояние
+    uint32_t pending_dns;                   ///< Маска серверов, ожидающих ответа DNS
+    uint32_t tried;                         ///< Маска серверов, которым уже отправлен запрос
+    int8_t current;                         ///< Сервер с неотвеченным запросом (-1 - нет)
+    uint32_t current_ipv4;                  ///< Адрес, на который отправлен запрос
+    uint64_t start_us;                      ///< Время старта
+    uint64_t request_us;                    ///< Время отправки текущего запроса
+    uint64_t first_sync_us;                 ///< Время от старта до первого ответа
+    int32_t offset_us;                      ///< Смещение по первому ответу
+    bool from_cache;                        ///< Первый запрос отправлен по адресу из кэша
+} ntp_sync_t;
+
+/**
+ * @brief Старт синхронизации
+ * @param sync Клиент
+ * @param cfg Настройки
+ * @param cache Кэш серверов (загруженный ntp_cache_load)
+ * @param transport Транспорт
+ * @param timeout_ms Ожидание ответа сервера
+ * @param now_s Текущее Unix-время (0 - неизвестно: все имена разрешаются заново)
+ * @param now_us Текущее время в микросекундах (time_us_64)
+ * @return false если ни одного сервера не настроено
+ */
+bool ntp_sync_start(ntp_sync_t *sync, const settings_t *cfg, ntp_cache_t *cache, const ntp_transport_t *transport,
+                    uint32_t timeout_ms, uint32_t now_s, uint64_t now_us);
+
+/**
+ * @brief Ответ DNS
+ * @param ipv4 Адрес (0 - имя не разрешено)
+ * @param ttl_s TTL ответа, с
+ * @param now_s Текущее Unix-время (0 - неизвестно)
+ * @param now_us Текущее время в микросекундах
+ */
+void ntp_sync_on_dns(ntp_sync_t *sync, uint8_t server, uint32_t ipv4, uint32_t ttl_s, uint32_t now_s,
+                     uint64_t now_us);
+
+/**
+ * @brief Ответ сервера NTP
+ * @param ipv4 Адрес отправителя (ответ с другого адреса отбрасывается)
+ * @param offset_us Смещение локальных часов
+ * @param rtt_us Время обмена
+ * @param now_us Текущее время в микросекундах
+ * @return true если ответ принят
+ */
+bool ntp_sync_on_reply(ntp_sync_t *sync, uint8_t server, uint32_t ipv4, int32_t offset_us, uint32_t rtt_us,
+                       uint64_t now_us);
+
+/**
+ * @brief Периодическая проверка: истечение ожидания и переход к следующему серверу
+ * @param now_us Текущее время в микросекундах
+ * @return Состояние синхронизации
+ */
+ntp_sync_state_t ntp_sync_poll(ntp_sync_t *sync, uint64_t now_us);
+
+#endif // NTP_SYNC_H
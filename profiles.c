@@ -0,0 +1,328 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/rand.h"
+#include "profiles.h"
+#include "flash_utils.h"
+#include "flash_hal.h"
+#include "aead.h"
+#include "crc32.h"
+#include "logging.h"
+
+#define PROFILE_SELECT_MAGIC    0x4C53     // "SL"
+#define PROFILE_KEY_LEN         12
+#define PROFILE_NETWORK_VALUE   (AEAD_NONCE_LEN + sizeof(profile_network_t) + AEAD_TAG_LEN)
+
+// Запись выбора активных профилей в секторе выбора
+typedef struct {
+    uint16_t magic;
+    uint8_t network;                        // PROFILE_NONE - не выбрана
+    uint8_t display;
+    uint32_t seq;
+    uint32_t reserved;                      // 0xFFFFFFFF
+    uint32_t crc;                           // CRC32 предыдущих 12 байт
+} profile_select_t;
+
+_Static_assert(sizeof(profile_select_t) == PROFILE_SELECT_SIZE, "Select record size mismatch");
+_Static_assert(FLASH_PAGE_SIZE % PROFILE_SELECT_SIZE == 0, "Select record must not cross a page");
+_Static_assert(PROFILE_MAX_NETWORKS <= 8 && PROFILE_MAX_DISPLAYS <= 8, "Profile masks are 8-bit");
+_Static_assert(PROFILE_NETWORK_VALUE <= KV_VALUE_MAX, "Network profile must fit in a key-value record");
+
+static void network_key(char *key, uint8_t index) {
+    snprintf(key, PROFILE_KEY_LEN, "wifi%u", index);
+}
+
+static void display_key(char *key, uint8_t index) {
+    snprintf(key, PROFILE_KEY_LEN, "display%u", index);
+}
+
+static bool string_fits(const char *str, size_t size) {
+    return memchr(str, '\0', size) != NULL;
+}
+
+static bool network_valid(const profile_network_t *net) {
+    return string_fits(net->name, PROFILE_NAME_LEN) && string_fits(net->ssid, WIFI_SSID_MAX_LEN) &&
+           string_fits(net->pass, WIFI_PASS_MAX_LEN) && net->ssid[0] != '\0';
+}
+
+static bool display_valid(const profile_display_t *display) {
+    return string_fits(display->name, PROFILE_NAME_LEN) && display->brightness <= BRIGHTNESS_MAX &&
+           display->night_off_hour <= HOUR_MAX && display->night_on_hour <= HOUR_MAX &&
+           (display->flags & ~(FLAG_ADAPTIVE_BRIGHTNESS | FLAG_NIGHT_MODE)) == 0;
+}
+
+static uint32_t select_crc(const profile_select_t *rec) {
+    return crc32_compute((const uint8_t *)rec, offsetof(profile_select_t, crc));
+}
+
+// Профиль сети хранится зашифрованным: nonce, шифротекст, тег; ключ записи входит в AAD
+static bool network_load(const kv_store_t *kv, uint8_t index, profile_network_t *net) {
+    char key[PROFILE_KEY_LEN];
+    network_key(key, index);
+    uint8_t value[PROFILE_NETWORK_VALUE];
+    size_t len;
+    if (!kv_get(kv, KV_NS_NETWORKS, key, value, sizeof(value), &len)) {
+        return false;
+    }
+    uint8_t *data = value + AEAD_NONCE_LEN;
+    bool ok = len == sizeof(value) &&
+              settings_blob_open(value, (const uint8_t *)key, strlen(key), data, sizeof(*net),
+                                 data + sizeof(*net));
+    if (ok) {
+        memcpy(net, data, sizeof(*net));
+        ok = network_valid(net);
+    }
+    memset(value, 0, sizeof(value));
+    if (!ok) {
+        memset(net, 0, sizeof(*net));
+        LOG_ERROR("Network profile %u rejected", index);
+    }
+    return ok;
+}
+
+static bool display_load(const kv_store_t *kv, uint8_t index, profile_display_t *display) {
+    char key[PROFILE_KEY_LEN];
+    display_key(key, index);
+    size_t len;
+    if (!kv_get(kv, KV_NS_DISPLAY, key, display, sizeof(*display), &len)) {
+        return false;
+    }
+    if (len != sizeof(*display) || !display_valid(display)) {
+        LOG_ERROR("Display profile %u rejected", index);
+        return false;
+    }
+    return true;
+}
+
+static uint32_t select_sector_offset(const profiles_t *p, uint32_t sector) {
+    return p->select_offset + sector * FLASH_SECTOR_SIZE;
+}
+
+// Последняя целая запись секторов выбора. Записи в секторе дописываются по порядку до первой
+// стёртой; текущим становится сектор с наибольшим порядковым номером
+static const profile_select_t *select_scan(profiles_t *p) {
+    const profile_select_t *last = NULL;
+    uint32_t free_slot[PROFILE_SELECT_SECTORS];
+    p->select_sector = 0;
+    p->select_seq = 1;
+    for (uint32_t sector = 0; sector < PROFILE_SELECT_SECTORS; sector++) {
+        free_slot[sector] = PROFILE_SELECT_SLOTS;
+        for (uint32_t slot = 0; slot < PROFILE_SELECT_SLOTS; slot++) {
+            uint32_t offset = select_sector_offset(p, sector) + slot * PROFILE_SELECT_SIZE;
+            const profile_select_t *rec = (const profile_select_t *)flash_hal_xip_ptr(offset);
+            if (flash_is_blank(offset, PROFILE_SELECT_SIZE)) {
+                free_slot[sector] = slot;
+                break;
+            }
+            // Повреждённая запись (отключение питания при записи) занимает слот, но не учитывается
+            if (rec->magic == PROFILE_SELECT_MAGIC && rec->crc == select_crc(rec) && (!last || rec->seq > last->seq)) {
+                last = rec;
+                p->select_sector = sector;
+                p->select_seq = rec->seq + 1;
+            }
+        }
+    }
+    p->select_slot = free_slot[p->select_sector];
+    return last;
+}
+
+bool profiles_init(profiles_t *p, kv_store_t *kv, uint32_t select_offset) {
+    if (!p || !kv) {
+        LOG_ERROR("Null pointer passed to profiles_init");
+        return false;
+    }
+    if (select_offset % FLASH_SECTOR_SIZE != 0) {
+        LOG_ERROR("Profile select offset 0x%08X is not sector-aligned", select_offset);
+        return false;
+    }
+    memset(p, 0, sizeof(*p));
+    p->kv = kv;
+    p->select_offset = select_offset;
+
+    for (uint8_t i = 0; i < PROFILE_MAX_NETWORKS; i++) {
+        if (network_load(kv, i, &p->networks[i])) {
+            p->networks_used |= 1u << i;
+        }
+    }
+    for (uint8_t i = 0; i < PROFILE_MAX_DISPLAYS; i++) {
+        if (display_load(kv, i, &p->displays[i])) {
+            p->displays_used |= 1u << i;
+        }
+    }
+
+    const profile_select_t *rec = select_scan(p);
+    uint8_t network = rec ? rec->network : PROFILE_NONE;
+    uint8_t display = rec ? rec->display : PROFILE_NONE;
+    // Выбранный профиль мог быть удалён: тогда сеть с наибольшим приоритетом и первый набор
+    if (network >= PROFILE_MAX_NETWORKS || !(p->networks_used & (1u << network))) {
+        int best = profiles_next_network(p, 0);
+        network = best < 0 ? PROFILE_NONE : (uint8_t)best;
+    }
+    if (display >= PROFILE_MAX_DISPLAYS || !(p->displays_used & (1u << display))) {
+        display = p->displays_used ? (uint8_t)__builtin_ctz(p->displays_used) : PROFILE_NONE;
+    }
+    p->network = network == PROFILE_NONE ? NULL : &p->networks[network];
+    p->display = display == PROFILE_NONE ? NULL : &p->displays[display];
+    LOG_INFO("Profiles loaded: %u networks, %u display presets, active %u/%u",
+             (unsigned)__builtin_popcount(p->networks_used), (unsigned)__builtin_popcount(p->displays_used),
+             network, display);
+    return true;
+}
+
+bool profiles_set_network(profiles_t *p, uint8_t index, const profile_network_t *net) {
+    if (!p || index >= PROFILE_MAX_NETWORKS) {
+        LOG_ERROR("Invalid network profile %u", index);
+        return false;
+    }
+    char key[PROFILE_KEY_LEN];
+    network_key(key, index);
+    if (!net) {
+        if (!kv_delete(p->kv, KV_NS_NETWORKS, key)) {
+            return false;
+        }
+        p->networks_used &= ~(1u << index);
+        if (p->network == &p->networks[index]) {
+            p->network = NULL;
+        }
+        memset(&p->networks[index], 0, sizeof(p->networks[index]));
+        return true;
+    }
+    if (!network_valid(net)) {
+        LOG_ERROR("Network profile %u has invalid fields", index);
+        return false;
+    }
+
+    uint8_t value[PROFILE_NETWORK_VALUE];
+    uint8_t *data = value + AEAD_NONCE_LEN;
+    uint64_t random[2] = { get_rand_64(), get_rand_64() };
+    memcpy(value, random, AEAD_NONCE_LEN);
+    memcpy(data, net, sizeof(*net));
+    settings_blob_seal(value, (const uint8_t *)key, strlen(key), data, sizeof(*net), data + sizeof(*net));
+    bool ok = kv_put(p->kv, KV_NS_NETWORKS, key, value, sizeof(value));
+    memset(value, 0, sizeof(value));
+    if (!ok) {
+        return false;
+    }
+    p->networks[index] = *net;
+    p->networks_used |= 1u << index;
+    return true;
+}
+
+bool profiles_set_display(profiles_t *p, uint8_t index, const profile_display_t *display) {
+    if (!p || index >= PROFILE_MAX_DISPLAYS) {
+        LOG_ERROR("Invalid display profile %u", index);
+        return false;
+    }
+    char key[PROFILE_KEY_LEN];
+    display_key(key, index);
+    if (!display) {
+        if (!kv_delete(p->kv, KV_NS_DISPLAY, key)) {
+            return false;
+        }
+        p->displays_used &= ~(1u << index);
+        if (p->display == &p->displays[index]) {
+            p->display = NULL;
+        }
+        memset(&p->displays[index], 0, sizeof(p->displays[index]));
+        return true;
+    }
+    if (!display_valid(display)) {
+        LOG_ERROR("Display profile %u has invalid fields", index);
+        return false;
+    }
+    if (!kv_put(p->kv, KV_NS_DISPLAY, key, display, sizeof(*display))) {
+        return false;
+    }
+    p->displays[index] = *display;
+    p->displays_used |= 1u << index;
+    return true;
+}
+
+bool profiles_select(profiles_t *p, uint8_t network, uint8_t display) {
+    if (!p) {
+        LOG_ERROR("Null pointer passed to profiles_select");
+        return false;
+    }
+    if ((network != PROFILE_NONE && (network >= PROFILE_MAX_NETWORKS || !(p->networks_used & (1u << network)))) ||
+        (display != PROFILE_NONE && (display >= PROFILE_MAX_DISPLAYS || !(p->displays_used & (1u << display))))) {
+        LOG_ERROR("Profile %u/%u does not exist", network, display);
+        return false;
+    }
+    if (profiles_network_index(p) == network && profiles_display_index(p) == display) {
+        return true;
+    }
+
+    // Переключение в RAM: следующее чтение профилей видит новый выбор
+    p->network = network == PROFILE_NONE ? NULL : &p->networks[network];
+    p->display = display == PROFILE_NONE ? NULL : &p->displays[display];
+    p->stats.switches++;
+
+    // Заполненный сектор не стирается: его последняя запись действует, пока не записана новая
+    if (p->select_slot >= PROFILE_SELECT_SLOTS) {
+        uint32_t next = (p->select_sector + 1) % PROFILE_SELECT_SECTORS;
+        if (!erase_flash_sector(select_sector_offset(p, next))) {
+            return false;
+        }
+        p->select_sector = next;
+        p->select_slot = 0;
+        p->stats.select_erases++;
+    }
+    profile_select_t rec = {
+        .magic = PROFILE_SELECT_MAGIC,
+        .network = network,
+        .display = display,
+        .seq = p->select_seq,
+        .reserved = 0xFFFFFFFF,
+    };
+    rec.crc = select_crc(&rec);
+    uint32_t offset = select_sector_offset(p, p->select_sector) + p->select_slot * PROFILE_SELECT_SIZE;
+    // Слот занят даже при ошибке: частично записанные байты нельзя дописать повторно
+    p->select_slot++;
+    if (!write_flash_range(offset, (const uint8_t *)&rec, sizeof(rec))) {
+        LOG_ERROR("Failed to store profile selection at 0x%08X", offset);
+        return false;
+    }
+    p->select_seq++;
+    return true;
+}
+
+int profiles_next_network(const profiles_t *p, uint32_t exclude) {
+    if (!p) {
+        return -1;
+    }
+    int best = -1;
+    for (int i = 0; i < PROFILE_MAX_NETWORKS; i++) {
+        if (!(p->networks_used & (1u << i)) || (exclude & (1u << i))) {
+            continue;
+        }
+        if (best < 0 || p->networks[i].priority > p->networks[best].priority) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+uint8_t profiles_network_index(const profiles_t *p) {
+    return p->network ? (uint8_t)(p->network - p->networks) : PROFILE_NONE;
+}
+
+uint8_t profiles_display_index(const profiles_t *p) {
+    return p->display ? (uint8_t)(p->display - p->displays) : PROFILE_NONE;
+}
+
+void profiles_apply(const profiles_t *p, settings_t *cfg) {
+    if (!p || !cfg) {
+        return;
+    }
+    if (p->network) {
+        memcpy(cfg->wifi_ssid, p->network->ssid, WIFI_SSID_MAX_LEN);
+        memcpy(cfg->wifi_pass, p->network->pass, WIFI_PASS_MAX_LEN);
+    }
+    if (p->display) {
+        cfg->brightness = p->display->brightness;
+        cfg->flags = (uint8_t)((cfg->flags & ~(FLAG_ADAPTIVE_BRIGHTNESS | FLAG_NIGHT_MODE)) | p->display->flags);
+        cfg->anim_flags = p->display->anim_flags;
+        cfg->night_off_hour = p->display->night_off_hour;
+        cfg->night_on_hour = p->display->night_on_hour;
+    }
+}
@@ -0,0 +1,133 @@
+#ifndef PROFILES_H
+#define PROFILES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "settings.h"
+#include "kvstore.h"
+
+/*
+ * Профили: несколько сетей Wi-Fi с приоритетами и несколько наборов параметров дисплея
+ * (яркость, анимации, ночные часы).
+ *
+ * Таблицы профилей хранятся в хранилище «ключ - значение» (сети - в KV_NS_NETWORKS, зашифрованные
+ * ключом настроек устройства; наборы дисплея - в KV_NS_DISPLAY) и при profiles_init() читаются
+ * в RAM. Выбор активных профилей хранится отдельно, в двух секторах выбора: каждое переключение
+ * дописывает запись из 16 байт в текущий сектор, поэтому программируется одна страница без
+ * стирания. Когда все PROFILE_SELECT_SLOTS записей сектора заняты, стирается другой сектор и
+ * запись идёт в него - последний выбор остаётся во флеш-памяти, даже если питание пропадёт
+ * между стиранием и записью.
+ */
+
+#define PROFILE_MAX_NETWORKS    8          ///< Количество профилей сетей Wi-Fi
+#define PROFILE_MAX_DISPLAYS    4          ///< Количество наборов параметров дисплея
+#define PROFILE_NAME_LEN        16         ///< Размер имени профиля (15 символов + \0)
+#define PROFILE_NONE            0xFF       ///< Профиль не выбран
+#define PROFILE_SELECT_SIZE     16         ///< Размер записи выбора
+#define PROFILE_SELECT_SLOTS    (FLASH_SECTOR_SIZE / PROFILE_SELECT_SIZE)  ///< Записей в одном секторе выбора
+#define PROFILE_SELECT_SECTORS  2          ///< Секторов выбора (чередуются)
+#define PROFILE_SELECT_SIZE_BYTES (PROFILE_SELECT_SECTORS * FLASH_SECTOR_SIZE)
+
+/**
+ * @brief Профиль сети Wi-Fi
+ */
+typedef struct {
+    char name[PROFILE_NAME_LEN];            ///< Имя профиля («home», «office»)
+    char ssid[WIFI_SSID_MAX_LEN];           ///< SSID
+    char pass[WIFI_PASS_MAX_LEN];           ///< Пароль (в RAM в открытом виде)
+    int8_t priority;                        ///< Приоритет: сеть с большим значением пробуется раньше
+} profile_network_t;
+
+/**
+ * @brief Набор параметров дисплея
+ */
+typedef struct {
+    char name[PROFILE_NAME_LEN];            ///< Имя набора («day», «night»)
+    uint8_t brightness;                     ///< Яркость (0-100)
+    uint8_t flags;                          ///< FLAG_ADAPTIVE_BRIGHTNESS, FLAG_NIGHT_MODE
+    uint16_t anim_flags;                    ///< Флаги анимаций (ANIM_FLAG_*)
+    uint8_t night_off_hour;                 ///< Час выключения ночного режима (0-23)
+    uint8_t night_on_hour;                  ///< Час включения ночного режима (0-23)
+} profile_display_t;
+
+/**
+ * @brief Статистика переключений
+ */
+typedef struct {
+    uint32_t switches;                      ///< Переключений профилей
+    uint32_t select_erases;                 ///< Стираний секторов выбора
+} profiles_stats_t;
+
+/**
+ * @brief Профили в RAM
+ */
+typedef struct {
+    kv_store_t *kv;                         ///< Хранилище таблиц профилей
+    uint32_t select_offset;                 ///< Смещение первого из PROFILE_SELECT_SECTORS секторов выбора
+    uint32_t select_sector;                 ///< Текущий сектор выбора (0 или 1)
+    uint32_t select_slot;                   ///< Следующая свободная запись текущего сектора
+    uint32_t select_seq;                    ///< Номер следующей записи выбора
+    uint8_t networks_used;                  ///< Маска заданных профилей сетей
+    uint8_t displays_used;                  ///< Маска заданных наборов дисплея
+    const profile_network_t *network;       ///< Активная сеть (NULL - не выбрана)
+    const profile_display_t *display;       ///< Активный набор дисплея (NULL - не выбран)
+    profiles_stats_t stats;                 ///< Статистика
+    profile_network_t networks[PROFILE_MAX_NETWORKS];
+    profile_display_t displays[PROFILE_MAX_DISPLAYS];
+} profiles_t;
+
+/**
+ * @brief Загрузка таблиц профилей и последнего выбора
+ * @param p Профили
+ * @param kv Открытое хранилище «ключ - значение»
+ * @param select_offset Смещение PROFILE_SELECT_SIZE_BYTES байт секторов выбора (выровнено по FLASH_SECTOR_SIZE)
+ * @return true если профили загружены; повреждённые значения пропускаются
+ * @note Если выбора ещё не было, активными становятся сеть с наибольшим приоритетом и первый набор
+ */
+bool profiles_init(profiles_t *p, kv_store_t *kv, uint32_t select_offset);
+
+/**
+ * @brief Запись профиля сети
+ * @param index Номер профиля (0..PROFILE_MAX_NETWORKS-1)
+ * @param net Профиль (NULL - удаление)
+ */
+bool profiles_set_network(profiles_t *p, uint8_t index, const profile_network_t *net);
+
+/**
+ * @brief Запись набора параметров дисплея
+ * @param index Номер набора (0..PROFILE_MAX_DISPLAYS-1)
+ * @param display Набор (NULL - удаление)
+ */
+bool profiles_set_display(profiles_t *p, uint8_t index, const profile_display_t *display);
+
+/**
+ * @brief Переключение активных профилей
+ *
+ * Указатели в RAM меняются сразу; выбор дописывается в текущий сектор выбора одной записью,
+ * а при заполненном секторе - в стёртый другой.
+ * @param network Номер сети или PROFILE_NONE
+ * @param display Номер набора дисплея или PROFILE_NONE
+ * @return true если профили существуют и выбор сохранён
+ */
+bool profiles_select(profiles_t *p, uint8_t network, uint8_t display);
+
+/**
+ * @brief Сеть для следующей попытки подключения
+ * @param exclude Маска сетей, которые уже пробовали (бит i - профиль i)
+ * @return Номер сети с наибольшим приоритетом или -1
+ */
+int profiles_next_network(const profiles_t *p, uint32_t exclude);
+
+/**
+ * @brief Номер активной сети или набора (PROFILE_NONE, если не выбран)
+ */
+uint8_t profiles_network_index(const profiles_t *p);
+uint8_t profiles_display_index(const profiles_t *p);
+
+/**
+ * @brief Перенос активных профилей в настройки в RAM (без записи во флеш-память)
+ * @param cfg Настройки: SSID, пароль, яркость, флаги дисплея, анимации и ночные часы
+ */
+void profiles_apply(const profiles_t *p, settings_t *cfg);
+
+#endif // PROFILES_H
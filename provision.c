@@ -0,0 +1,356 @@
+#include <string.h>
+#include "provision.h"
+#include "settings_schema.h"
+#include "settings_shared.h"
+#include "flash_scratch.h"
+#include "crc32.h"
+#include "logging.h"
+#ifndef VFD_HOST_BUILD
+#include "hardware/uart.h"
+#endif
+
+_Static_assert(PROVISION_MAX_DATA >= NTP_MAX_SERVERS * NTP_SERVER_MAX_LEN, "Largest field must fit in one frame");
+_Static_assert(PROVISION_RX_SIZE >= PROVISION_FRAME_MAX, "Receive buffer must hold a whole frame");
+_Static_assert(PROVISION_XFER_SIZE <= UINT16_MAX, "Transfer offsets are 16-bit");
+
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    put_u16(p, (uint16_t)v);
+    put_u16(p + 2, (uint16_t)(v >> 16));
+}
+
+size_t provision_frame_encode(uint8_t cmd, uint8_t seq, const uint8_t *data, size_t len, uint8_t *out) {
+    out[0] = PROVISION_SYNC0;
+    out[1] = PROVISION_SYNC1;
+    out[2] = cmd;
+    out[3] = seq;
+    put_u16(out + 4, (uint16_t)len);
+    if (len) {
+        memmove(out + PROVISION_HEADER_LEN, data, len);
+    }
+    uint32_t crc = crc32_compute(out + 2, PROVISION_HEADER_LEN - 2 + len);
+    put_u32(out + PROVISION_HEADER_LEN + len, crc);
+    return PROVISION_HEADER_LEN + len + PROVISION_CRC_LEN;
+}
+
+provision_frame_result_t provision_frame_find(const uint8_t *buf, size_t len, provision_frame_t *frame,
+                                              size_t *consumed) {
+    // Пропуск байт до синхробайтов (текст журнала, остатки повреждённых кадров)
+    size_t start = 0;
+    while (start < len && !(buf[start] == PROVISION_SYNC0 && (start + 1 == len || buf[start + 1] == PROVISION_SYNC1))) {
+        start++;
+    }
+    *consumed = start;
+    if (len - start < PROVISION_HEADER_LEN) {
+        return PROVISION_FRAME_NONE;
+    }
+
+    const uint8_t *hdr = buf + start;
+    uint16_t data_len = get_u16(hdr + 4);
+    if (data_len > PROVISION_MAX_PAYLOAD) {
+        *consumed = start + 1;
+        return PROVISION_FRAME_BAD;
+    }
+    size_t total = PROVISION_HEADER_LEN + data_len + PROVISION_CRC_LEN;
+    if (len - start < total) {
+        return PROVISION_FRAME_NONE;
+    }
+    uint32_t crc = crc32_compute(hdr + 2, PROVISION_HEADER_LEN - 2 + data_len);
+    const uint8_t *tail = hdr + PROVISION_HEADER_LEN + data_len;
+    if (crc != ((uint32_t)get_u16(tail) | ((uint32_t)get_u16(tail + 2) << 16))) {
+        *consumed = start + 1;
+        return PROVISION_FRAME_BAD;
+    }
+
+    frame->cmd = hdr[2];
+    frame->seq = hdr[3];
+    frame->len = data_len;
+    frame->data = hdr + PROVISION_HEADER_LEN;
+    *consumed = start + total;
+    return PROVISION_FRAME_OK;
+}
+
+void provision_init(provision_t *p, const provision_io_t *io, uint32_t flash_offset, const settings_t *cfg) {
+    memset(p, 0, sizeof(*p));
+    p->io = io;
+    p->flash_offset = flash_offset;
+    if (cfg) {
+        p->draft = *cfg;
+    } else {
+        settings_init_default(&p->draft);
+    }
+}
+
+// Ответ собирается прямо в буфере ответов: данные пишутся после заголовка и кода результата
+static uint8_t *reply_data(provision_t *p) {
+    return p->tx + p->tx_len + PROVISION_HEADER_LEN + 1;
+}
+
+static void reply(provision_t *p, const provision_frame_t *req, provision_status_t status, size_t len) {
+    uint8_t *out = p->tx + p->tx_len;
+    out[PROVISION_HEADER_LEN] = (uint8_t)status;
+    p->tx_len += (uint16_t)provision_frame_encode(req->cmd | PROVISION_RESPONSE, req->seq,
+                                                  out + PROVISION_HEADER_LEN, len + 1, out);
+    if (status != PROVISION_OK) {
+        p->stats.errors++;
+    }
+}
+
+static const settings_field_t *request_field(const provision_frame_t *req) {
+    if (req->len < 1 || req->data[0] >= SETTINGS_FIELD_COUNT) {
+        return NULL;
+    }
+    const settings_field_t *field = &settings_fields[req->data[0]];
+    return (field->attr & SETTINGS_FIELD_META) ? NULL : field;
+}
+
+static provision_status_t field_set(provision_t *p, const provision_frame_t *req) {
+    const settings_field_t *field = request_field(req);
+    size_t size = field ? (size_t)field->size * field->count : 0;
+    if (!field || req->len != 1 + size) {
+        return PROVISION_ERR_ARGUMENT;
+    }
+    // Черновик не меняется, если значение не проходит проверку схемы
+    settings_t candidate = p->draft;
+    memcpy((uint8_t *)&candidate + field->offset, req->data + 1, size);
+    if (!settings_schema_validate(&candidate)) {
+        return PROVISION_ERR_INVALID;
+    }
+    p->draft = candidate;
+    return PROVISION_OK;
+}
+
+// Блок «смещение, данные» в буфер размера limit
+static provision_status_t chunk_write(const provision_frame_t *req, uint8_t *dst, size_t limit) {
+    if (req->len < 2) {
+        return PROVISION_ERR_ARGUMENT;
+    }
+    size_t offset = get_u16(req->data);
+    size_t len = req->len - 2u;
+    if (len > PROVISION_MAX_DATA || offset > limit || len > limit - offset) {
+        return PROVISION_ERR_ARGUMENT;
+    }
+    memcpy(dst + offset, req->data + 2, len);
+    return PROVISION_OK;
+}
+
+// Блок «смещение, длина» из src размера limit в ответ
+static provision_status_t chunk_read(provision_t *p, const provision_frame_t *req, const uint8_t *src,
+                                     size_t limit, size_t *out_len) {
+    if (req->len != 4) {
+        return PROVISION_ERR_ARGUMENT;
+    }
+    size_t offset = get_u16(req->data);
+    size_t len = get_u16(req->data + 2);
+    if (len > PROVISION_MAX_DATA || offset > limit || len > limit - offset) {
+        return PROVISION_ERR_ARGUMENT;
+    }
+    uint8_t *out = reply_data(p);
+    put_u16(out, (uint16_t)limit);
+    memcpy(out + 2, src + offset, len);
+    *out_len = 2 + len;
+    return PROVISION_OK;
+}
+
+static const settings_record_t *live_record(const provision_t *p) {
+    const settings_t *view = settings_view(p->flash_offset);
+    if (!view) {
+        return NULL;
+    }
+    return (const settings_record_t *)((const uint8_t *)view - offsetof(settings_record_t, data));
+}
+
+static void handle_frame(provision_t *p, const provision_frame_t *req) {
+    provision_status_t status = PROVISION_OK;
+    size_t len = 0;
+    uint8_t *out = reply_data(p);
+
+    switch (req->cmd) {
+        case PROVISION_CMD_PING:
+            put_u16(out, PROVISION_VERSION);
+            put_u16(out + 2, SETTINGS_VERSION);
+            put_u16(out + 4, (uint16_t)sizeof(settings_t));
+            put_u16(out + 6, PROVISION_MAX_DATA);
+            len = 8;
+            break;
+
+        case PROVISION_CMD_FIELD_GET: {
+            const settings_field_t *field = request_field(req);
+            if (!field || req->len != 1) {
+                status = PROVISION_ERR_ARGUMENT;
+                break;
+            }
+            len = (size_t)field->size * field->count;
+            memcpy(out, (const uint8_t *)&p->draft + field->offset, len);
+            break;
+        }
+
+        case PROVISION_CMD_FIELD_SET:
+            status = field_set(p, req);
+            break;
+
+        case PROVISION_CMD_PATCH:
+            status = chunk_write(req, (uint8_t *)&p->draft, sizeof(settings_t));
+            break;
+
+        case PROVISION_CMD_BLOB_READ: {
+            // Черновик кодируется заново для каждого блока в участок арены: буфер блочных
+            // передач может хранить незавершённую загрузку BLOB_WRITE
+            uint8_t *blob = flash_scratch_borrow(SETTINGS_CODEC_MAX_LEN);
+            if (!blob) {
+                status = PROVISION_ERR_FLASH;
+                break;
+            }
+            size_t encoded = settings_encode(&p->draft, blob, SETTINGS_CODEC_MAX_LEN);
+            status = encoded ? chunk_read(p, req, blob, encoded, &len) : PROVISION_ERR_INVALID;
+            flash_scratch_release(blob);
+            break;
+        }
+
+        case PROVISION_CMD_BLOB_WRITE:
+            status = chunk_write(req, p->xfer.bytes, SETTINGS_CODEC_MAX_LEN);
+            break;
+
+        case PROVISION_CMD_BLOB_APPLY: {
+            settings_t candidate;
+            if (req->len != 2 || get_u16(req->data) > SETTINGS_CODEC_MAX_LEN) {
+                status = PROVISION_ERR_ARGUMENT;
+            } else if (!settings_decode(p->xfer.bytes, get_u16(req->data), &candidate) ||
+                       !settings_validate(&candidate)) {
+                status = PROVISION_ERR_INVALID;
+            } else {
+                p->draft = candidate;
+            }
+            break;
+        }
+
+        case PROVISION_CMD_RECORD_READ: {
+            const settings_record_t *rec = live_record(p);
+            status = rec ? chunk_read(p, req, (const uint8_t *)rec, sizeof(*rec), &len) : PROVISION_ERR_FLASH;
+            break;
+        }
+
+        case PROVISION_CMD_RECORD_WRITE:
+            status = chunk_write(req, (uint8_t *)&p->xfer.record, sizeof(settings_record_t));
+            break;
+
+        case PROVISION_CMD_RECORD_APPLY: {
+            settings_t candidate;
+            if (req->len != 0) {
+                status = PROVISION_ERR_ARGUMENT;
+            } else if (!settings_record_open(&p->xfer.record, &candidate) || !settings_validate(&candidate)) {
+                status = PROVISION_ERR_INVALID;
+            } else {
+                p->draft = candidate;
+            }
+            break;
+        }
+
+        case PROVISION_CMD_COMMIT:
+            if (!settings_validate(&p->draft)) {
+                status = PROVISION_ERR_INVALID;
+            } else if (!settings_save(&p->draft, p->flash_offset)) {
+                status = PROVISION_ERR_FLASH;
+            } else {
+                settings_shared_publish(&p->draft);
+                p->stats.commits++;
+                put_u32(out, settings_generation(p->flash_offset));
+                len = 4;
+            }
+            break;
+
+        case PROVISION_CMD_REVERT:
+            status = settings_load(&p->draft, p->flash_offset) ? PROVISION_OK : PROVISION_ERR_FLASH;
+            break;
+
+        default:
+            LOG_WARN("Unknown provisioning command 0x%02X", req->cmd);
+            status = PROVISION_ERR_COMMAND;
+            break;
+    }
+
+    reply(p, req, status, status == PROVISION_OK ? len : 0);
+    p->stats.frames++;
+}
+
+static void flush_tx(provision_t *p) {
+    if (p->tx_pos < p->tx_len) {
+        size_t sent = p->io->write(p->io->ctx, p->tx + p->tx_pos, p->tx_len - p->tx_pos);
+        p->tx_pos += (uint16_t)sent;
+        p->stats.bytes_out += (uint32_t)sent;
+    }
+    if (p->tx_pos == p->tx_len) {
+        p->tx_pos = p->tx_len = 0;
+    } else if (p->tx_pos > 0 && p->tx_len > PROVISION_TX_SIZE - PROVISION_FRAME_MAX) {
+        memmove(p->tx, p->tx + p->tx_pos, p->tx_len - p->tx_pos);
+        p->tx_len -= p->tx_pos;
+        p->tx_pos = 0;
+    }
+}
+
+uint32_t provision_poll(provision_t *p) {
+    if (!p || !p->io) {
+        return 0;
+    }
+    flush_tx(p);
+
+    size_t got = p->io->read(p->io->ctx, p->rx + p->rx_len, PROVISION_RX_SIZE - p->rx_len);
+    p->rx_len += (uint16_t)got;
+    p->stats.bytes_in += (uint32_t)got;
+
+    uint32_t handled = 0;
+    size_t pos = 0;
+    while (p->tx_len <= PROVISION_TX_SIZE - PROVISION_FRAME_MAX) {
+        provision_frame_t frame;
+        size_t consumed;
+        provision_frame_result_t result = provision_frame_find(p->rx + pos, p->rx_len - pos, &frame, &consumed);
+        pos += consumed;
+        if (result == PROVISION_FRAME_NONE) {
+            break;
+        }
+        if (result == PROVISION_FRAME_BAD) {
+            p->stats.bad_frames++;
+            continue;
+        }
+        handle_frame(p, &frame);
+        handled++;
+        flush_tx(p);
+    }
+
+    if (pos) {
+        memmove(p->rx, p->rx + pos, p->rx_len - pos);
+        p->rx_len -= (uint16_t)pos;
+    }
+    return handled;
+}
+
+#ifndef VFD_HOST_BUILD
+// Прямой доступ к UART stdio: запись stdio блокируется до отправки, а протоколу нужен неблокирующий вывод
+static size_t uart_read(void *ctx, uint8_t *buf, size_t len) {
+    (void)ctx;
+    size_t n = 0;
+    while (n < len && uart_is_readable(uart_default)) {
+        buf[n++] = (uint8_t)uart_getc(uart_default);
+    }
+    return n;
+}
+
+static size_t uart_write(void *ctx, const uint8_t *buf, size_t len) {
+    (void)ctx;
+    size_t n = 0;
+    while (n < len && uart_is_writable(uart_default)) {
+        uart_putc_raw(uart_default, (char)buf[n++]);
+    }
+    return n;
+}
+
+const provision_io_t provision_stdio_uart = { NULL, uart_read, uart_write };
+#endif
@@ -0,0 +1,173 @@
+#ifndef PROVISION_H
+#define PROVISION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "settings.h"
+#include "settings_codec.h"
+
+/*
+ * Двоичный протокол настройки устройства по UART (stdio).
+ *
+ * Кадр: синхробайты 0xA5 0xC3, команда, номер кадра, длина данных (2 байта, little-endian),
+ * данные и CRC32 (little-endian) от команды до конца данных. Ответ - кадр с командой | 0x80
+ * и тем же номером; первый байт данных ответа - код результата (PROVISION_OK и т.д.).
+ * Кадры с неверной CRC32 отбрасываются без ответа, поиск следующего кадра идёт по синхробайтам,
+ * поэтому текст журнала в том же UART кадрам не мешает.
+ *
+ * Команды изменяют черновик настроек в RAM; во флеш-память он записывается командой
+ * PROVISION_CMD_COMMIT. Ответы приходят в порядке запросов, поэтому клиент может отправлять
+ * кадры, не дожидаясь ответов, пока неподтверждённых байт не больше PROVISION_WINDOW.
+ * COMMIT выполняется с запретом прерываний - после него клиент ждёт ответа.
+ */
+
+#define PROVISION_SYNC0         0xA5
+#define PROVISION_SYNC1         0xC3
+#define PROVISION_VERSION       1          ///< Версия протокола (ответ PROVISION_CMD_PING)
+#define PROVISION_HEADER_LEN    6          ///< Синхробайты, команда, номер, длина
+#define PROVISION_CRC_LEN       4
+#define PROVISION_MAX_DATA      256        ///< Наибольший блок данных в одном кадре
+#define PROVISION_MAX_PAYLOAD   (PROVISION_MAX_DATA + 4)   ///< Блок и его заголовок (номер поля, смещение)
+#define PROVISION_FRAME_MAX     (PROVISION_HEADER_LEN + PROVISION_MAX_PAYLOAD + PROVISION_CRC_LEN)
+#define PROVISION_RX_SIZE       1024       ///< Приёмный буфер устройства
+#define PROVISION_TX_SIZE       (2 * PROVISION_FRAME_MAX)  ///< Буфер ответов устройства
+#define PROVISION_WINDOW        PROVISION_RX_SIZE          ///< Наибольший объём неподтверждённых запросов
+#define PROVISION_RESPONSE      0x80       ///< Признак ответа в поле команды
+
+/// Буфер загрузки блоками: закодированные настройки (BLOB_WRITE) или запись журнала (RECORD_WRITE)
+#define PROVISION_XFER_SIZE \
+    (SETTINGS_CODEC_MAX_LEN > sizeof(settings_record_t) ? SETTINGS_CODEC_MAX_LEN : sizeof(settings_record_t))
+
+/**
+ * @brief Команды
+ */
+typedef enum {
+    PROVISION_CMD_PING = 0x01,              ///< -> версия протокола, версия и размер settings_t, PROVISION_MAX_DATA
+    PROVISION_CMD_FIELD_GET = 0x02,         ///< номер поля -> значение
+    PROVISION_CMD_FIELD_SET = 0x03,         ///< номер поля, значение (проверяется по схеме)
+    PROVISION_CMD_PATCH = 0x04,             ///< смещение в settings_t (2 байта), байты (проверка при COMMIT)
+    PROVISION_CMD_BLOB_READ = 0x05,         ///< смещение, длина -> полный размер (2 байта), блок settings_encode черновика
+    PROVISION_CMD_BLOB_WRITE = 0x06,        ///< смещение, блок закодированных настроек
+    PROVISION_CMD_BLOB_APPLY = 0x07,        ///< полный размер -> разбор settings_decode в черновик
+    PROVISION_CMD_RECORD_READ = 0x08,       ///< смещение, длина -> блок актуальной записи журнала во флеш-памяти
+    PROVISION_CMD_RECORD_WRITE = 0x09,      ///< смещение, блок записи журнала
+    PROVISION_CMD_RECORD_APPLY = 0x0A,      ///< проверка записи (тег или CRC32) и извлечение в черновик
+    PROVISION_CMD_COMMIT = 0x0B,            ///< сохранение черновика -> поколение настроек (4 байта)
+    PROVISION_CMD_REVERT = 0x0C             ///< черновик заново из флеш-памяти
+} provision_cmd_t;
+
+/**
+ * @brief Коды результата
+ */
+typedef enum {
+    PROVISION_OK = 0,
+    PROVISION_ERR_COMMAND,                  ///< Неизвестная команда
+    PROVISION_ERR_ARGUMENT,                 ///< Неверный номер поля, смещение или длина
+    PROVISION_ERR_INVALID,                  ///< Значения не прошли проверку
+    PROVISION_ERR_FLASH                     ///< Ошибка чтения или записи флеш-памяти
+} provision_status_t;
+
+/**
+ * @brief Результат поиска кадра
+ */
+typedef enum {
+    PROVISION_FRAME_NONE = 0,               ///< Кадр не полон (consumed - байты до синхробайтов)
+    PROVISION_FRAME_OK,                     ///< Кадр найден
+    PROVISION_FRAME_BAD                     ///< Неверная CRC32 или длина (кадр пропускается)
+} provision_frame_result_t;
+
+/**
+ * @brief Разобранный кадр (данные указывают в буфер приёма)
+ */
+typedef struct {
+    uint8_t cmd;
+    uint8_t seq;
+    uint16_t len;
+    const uint8_t *data;
+} provision_frame_t;
+
+/**
+ * @brief Последовательный порт: неблокирующие чтение и запись
+ */
+typedef struct {
+    void *ctx;                                                      ///< Контекст порта
+    size_t (*read)(void *ctx, uint8_t *buf, size_t len);            ///< Чтение доступных байт
+    size_t (*write)(void *ctx, const uint8_t *buf, size_t len);     ///< Запись, сколько принято
+} provision_io_t;
+
+/**
+ * @brief Статистика обмена
+ */
+typedef struct {
+    uint32_t frames;                        ///< Обработанных кадров
+    uint32_t bad_frames;                    ///< Отброшенных кадров (CRC32, длина)
+    uint32_t errors;                        ///< Ответов с ошибкой
+    uint32_t commits;                       ///< Сохранений во флеш-память
+    uint32_t bytes_in;                      ///< Принято байт
+    uint32_t bytes_out;                     ///< Отправлено байт
+} provision_stats_t;
+
+/**
+ * @brief Сторона устройства
+ */
+typedef struct {
+    const provision_io_t *io;               ///< Порт
+    uint32_t flash_offset;                  ///< Журнал настроек
+    settings_t draft;                       ///< Черновик настроек
+    provision_stats_t stats;                ///< Статистика
+    uint16_t rx_len;                        ///< Байт в приёмном буфере
+    uint16_t tx_pos;                        ///< Отправлено байт из буфера ответов
+    uint16_t tx_len;                        ///< Байт в буфере ответов
+    uint8_t rx[PROVISION_RX_SIZE];
+    uint8_t tx[PROVISION_TX_SIZE];
+    union {
+        settings_record_t record;
+        uint8_t bytes[PROVISION_XFER_SIZE];
+    } xfer;                                 ///< Буфер блочных передач
+} provision_t;
+
+/**
+ * @brief Запуск обработки протокола
+ * @param p Состояние
+ * @param io Порт
+ * @param flash_offset Смещение журнала настроек
+ * @param cfg Действующие настройки (начальный черновик)
+ */
+void provision_init(provision_t *p, const provision_io_t *io, uint32_t flash_offset, const settings_t *cfg);
+
+/**
+ * @brief Приём, обработка кадров и отправка ответов
+ *
+ * Вызывается из главного цикла. Принятые байты забираются из порта всегда; кадры обрабатываются,
+ * пока в буфере ответов есть место для ответа наибольшего размера.
+ * @return Количество обработанных кадров
+ * @note На RP2040 FIFO UART вмещает 32 байта: при 115200 бод вызов нужен не реже чем раз в 2 мс
+ */
+uint32_t provision_poll(provision_t *p);
+
+/**
+ * @brief Сборка кадра
+ * @param out Буфер (не менее PROVISION_HEADER_LEN + len + PROVISION_CRC_LEN байт)
+ * @return Размер кадра
+ */
+size_t provision_frame_encode(uint8_t cmd, uint8_t seq, const uint8_t *data, size_t len, uint8_t *out);
+
+/**
+ * @brief Поиск кадра в начале буфера
+ * @param buf Принятые байты
+ * @param len Количество байт
+ * @param frame Найденный кадр
+ * @param consumed Количество байт, которые можно удалить из начала буфера
+ */
+provision_frame_result_t provision_frame_find(const uint8_t *buf, size_t len, provision_frame_t *frame,
+                                              size_t *consumed);
+
+/**
+ * @brief Порт stdio UART (только для устройства)
+ */
+#ifndef VFD_HOST_BUILD
+extern const provision_io_t provision_stdio_uart;
+#endif
+
+#endif // PROVISION_H
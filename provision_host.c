@@ -0,0 +1,515 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "pico/stdlib.h"
+#include "settings.h"
+#include "settings_schema.h"
+#include "settings_codec.h"
+#include "provision.h"
+#include "flash_hal.h"
+#include "flash_utils.h"
+#include "logging.h"
+
+/*
+ * Клиент протокола настройки по UART и замер скорости (только сборка для хоста).
+ *
+ * Без -p устройство заменяется потоком, который вызывает provision_poll() на ведущей стороне
+ * псевдотерминала поверх эмулятора флеш-памяти; клиент открывает ведомую сторону как
+ * последовательный порт. С -p клиент работает с настоящим устройством (115200 бод, 8N1).
+ *
+ * Каждая передача выполняется дважды: с ожиданием ответа на каждый кадр и с конвейером
+ * (до PROVISION_WINDOW неподтверждённых байт). Результат - один JSON-объект в stdout
+ * или в файл из аргумента.
+ */
+
+#define FLASH_OFFSET        (PICO_FLASH_SIZE_BYTES - SETTINGS_LOG_SIZE)
+#define HOST_PASSES_PTY     100             ///< Повторов передачи через псевдотерминал
+#define HOST_PASSES_SERIAL  4               ///< Повторов передачи через настоящий порт
+#define HOST_PINGS          200             ///< Кадров для замера времени обхода
+#define HOST_TIMEOUT_MS     1000            ///< Ожидание ответа
+#define HOST_STOP_AND_WAIT  1               ///< Окно «ожидание ответа на каждый кадр»
+#define HOST_UART_BAUD      115200          ///< Скорость UART для оценки времени передачи
+#define HOST_UART_BITS      10              ///< Бит на байт (8N1)
+#define HOST_TURNAROUND_US  1000            ///< Задержка переходника USB-UART на один обход (кадр USB)
+
+// Ожидаемый ответ: куда копировать данные и сколько байт пропустить в их начале
+typedef struct {
+    uint16_t frame_len;
+    uint8_t cmd;
+    uint8_t skip;
+    uint8_t *dst;
+    size_t dst_len;
+} pending_t;
+
+typedef struct {
+    int fd;
+    size_t window;                          // Наибольший объём неподтверждённых запросов
+    size_t in_flight;
+    uint32_t outstanding;
+    uint8_t seq;                            // Номер следующего запроса
+    uint8_t expect;                         // Номер следующего ответа
+    uint8_t last_status;
+    uint32_t last_u32;                      // Поколение из ответа на COMMIT
+    uint32_t frames;
+    uint64_t bytes_out;                     // Отправлено байт кадров
+    uint64_t bytes_in;                      // Принято байт кадров
+    bool ok;
+    size_t rx_len;
+    uint8_t rx[4 * PROVISION_FRAME_MAX];
+    pending_t pending[256];
+} client_t;
+
+static bool first_result = true;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// ---- Клиент ----
+
+static void client_fail(client_t *c, const char *what) {
+    if (c->ok) {
+        fprintf(stderr, "provision_host: %s\n", what);
+    }
+    c->ok = false;
+}
+
+static void client_on_reply(client_t *c, const provision_frame_t *frame) {
+    pending_t *req = &c->pending[frame->seq];
+    if (frame->seq != c->expect || frame->cmd != (req->cmd | PROVISION_RESPONSE) || frame->len < 1) {
+        client_fail(c, "unexpected reply");
+        return;
+    }
+    c->expect++;
+    c->outstanding--;
+    c->in_flight -= req->frame_len;
+    c->last_status = frame->data[0];
+    if (frame->data[0] != PROVISION_OK) {
+        client_fail(c, "request rejected by device");
+        return;
+    }
+    size_t len = frame->len - 1u;
+    if (req->dst && len >= req->skip) {
+        len -= req->skip;
+        memcpy(req->dst, frame->data + 1 + req->skip, len < req->dst_len ? len : req->dst_len);
+    }
+    if (frame->cmd == (PROVISION_CMD_COMMIT | PROVISION_RESPONSE) && len == 4) {
+        memcpy(&c->last_u32, frame->data + 1, 4);
+    }
+}
+
+// Приём хотя бы одного ответа
+static bool client_receive(client_t *c) {
+    uint32_t before = c->outstanding;
+    while (c->ok && c->outstanding == before) {
+        struct pollfd pfd = { .fd = c->fd, .events = POLLIN };
+        if (poll(&pfd, 1, HOST_TIMEOUT_MS) <= 0) {
+            client_fail(c, "reply timeout");
+            return false;
+        }
+        ssize_t got = read(c->fd, c->rx + c->rx_len, sizeof(c->rx) - c->rx_len);
+        if (got <= 0) {
+            if (got < 0 && (errno == EAGAIN || errno == EINTR)) {
+                continue;
+            }
+            client_fail(c, "port read failed");
+            return false;
+        }
+        c->rx_len += (size_t)got;
+
+        size_t pos = 0;
+        for (;;) {
+            provision_frame_t frame;
+            size_t consumed;
+            provision_frame_result_t result = provision_frame_find(c->rx + pos, c->rx_len - pos, &frame, &consumed);
+            pos += consumed;
+            if (result == PROVISION_FRAME_NONE) {
+                break;
+            }
+            if (result == PROVISION_FRAME_OK) {
+                c->bytes_in += PROVISION_HEADER_LEN + frame.len + PROVISION_CRC_LEN;
+                client_on_reply(c, &frame);
+            }
+        }
+        memmove(c->rx, c->rx + pos, c->rx_len - pos);
+        c->rx_len -= pos;
+    }
+    return c->ok;
+}
+
+static bool client_drain(client_t *c) {
+    while (c->ok && c->outstanding) {
+        client_receive(c);
+    }
+    return c->ok;
+}
+
+static bool write_all(int fd, const uint8_t *buf, size_t len) {
+    while (len) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EINTR) {
+                struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+                poll(&pfd, 1, HOST_TIMEOUT_MS);
+                continue;
+            }
+            return false;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+// Отправка запроса; при заполненном окне сначала принимаются ответы
+static bool client_send(client_t *c, uint8_t cmd, const uint8_t *data, size_t len, uint8_t *dst, size_t dst_len,
+                        uint8_t skip) {
+    uint8_t frame[PROVISION_FRAME_MAX];
+    size_t frame_len = provision_frame_encode(cmd, c->seq, data, len, frame);
+    while (c->ok && c->outstanding && c->in_flight + frame_len > c->window) {
+        client_receive(c);
+    }
+    if (!c->ok) {
+        return false;
+    }
+    c->pending[c->seq] = (pending_t){ (uint16_t)frame_len, cmd, skip, dst, dst_len };
+    c->seq++;
+    c->outstanding++;
+    c->in_flight += frame_len;
+    c->frames++;
+    c->bytes_out += frame_len;
+    if (!write_all(c->fd, frame, frame_len)) {
+        client_fail(c, "port write failed");
+    }
+    return c->ok;
+}
+
+static bool client_call(client_t *c, uint8_t cmd, const uint8_t *data, size_t len, uint8_t *dst, size_t dst_len) {
+    return client_send(c, cmd, data, len, dst, dst_len, 0) && client_drain(c);
+}
+
+// ---- Передачи ----
+
+static void put_u16(uint8_t *p, size_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void send_fields(client_t *c, const settings_t *cfg) {
+    uint8_t data[1 + PROVISION_MAX_DATA];
+    for (uint8_t i = 0; i < SETTINGS_FIELD_COUNT; i++) {
+        const settings_field_t *field = &settings_fields[i];
+        if (field->attr & SETTINGS_FIELD_META) {
+            continue;
+        }
+        size_t size = (size_t)field->size * field->count;
+        data[0] = i;
+        memcpy(data + 1, (const uint8_t *)cfg + field->offset, size);
+        client_send(c, PROVISION_CMD_FIELD_SET, data, 1 + size, NULL, 0, 0);
+    }
+}
+
+static void send_chunks(client_t *c, uint8_t cmd, const uint8_t *src, size_t len) {
+    uint8_t data[2 + PROVISION_MAX_DATA];
+    for (size_t offset = 0; offset < len; offset += PROVISION_MAX_DATA) {
+        size_t n = len - offset < PROVISION_MAX_DATA ? len - offset : PROVISION_MAX_DATA;
+        put_u16(data, offset);
+        memcpy(data + 2, src + offset, n);
+        client_send(c, cmd, data, 2 + n, NULL, 0, 0);
+    }
+}
+
+static void read_chunks(client_t *c, uint8_t cmd, uint8_t *dst, size_t len) {
+    uint8_t data[4];
+    for (size_t offset = 0; offset < len; offset += PROVISION_MAX_DATA) {
+        size_t n = len - offset < PROVISION_MAX_DATA ? len - offset : PROVISION_MAX_DATA;
+        put_u16(data, offset);
+        put_u16(data + 2, n);
+        client_send(c, cmd, data, sizeof(data), dst + offset, n, 2);
+    }
+}
+
+static void send_blob(client_t *c, const uint8_t *blob, size_t len) {
+    uint8_t total[2];
+    put_u16(total, len);
+    send_chunks(c, PROVISION_CMD_BLOB_WRITE, blob, len);
+    client_send(c, PROVISION_CMD_BLOB_APPLY, total, sizeof(total), NULL, 0, 0);
+}
+
+// ---- Замеры ----
+
+typedef enum { XFER_FIELDS, XFER_BLOB, XFER_RECORD_READ, XFER_RECORD_WRITE } xfer_kind_t;
+
+typedef struct {
+    const settings_t *cfg;
+    const uint8_t *blob;
+    size_t blob_len;
+    settings_record_t *record;
+} xfer_args_t;
+
+static void run_xfer(client_t *c, xfer_kind_t kind, const xfer_args_t *args) {
+    switch (kind) {
+        case XFER_FIELDS:
+            send_fields(c, args->cfg);
+            break;
+        case XFER_BLOB:
+            send_blob(c, args->blob, args->blob_len);
+            break;
+        case XFER_RECORD_READ:
+            read_chunks(c, PROVISION_CMD_RECORD_READ, (uint8_t *)args->record, sizeof(settings_record_t));
+            break;
+        case XFER_RECORD_WRITE:
+            send_chunks(c, PROVISION_CMD_RECORD_WRITE, (const uint8_t *)args->record, sizeof(settings_record_t));
+            client_send(c, PROVISION_CMD_RECORD_APPLY, NULL, 0, NULL, 0, 0);
+            break;
+    }
+}
+
+typedef struct {
+    uint32_t frames;
+    uint64_t bytes_out;
+    uint64_t bytes_in;
+    uint64_t start_ns;
+} mark_t;
+
+static mark_t mark(const client_t *c) {
+    return (mark_t){ c->frames, c->bytes_out, c->bytes_in, now_ns() };
+}
+
+// Оценка для UART: без конвейера запросы и ответы передаются по очереди и каждый кадр ждёт обхода
+// через переходник, с конвейером байты идут одновременно в обе стороны, время определяет более
+// загруженное направление, а задержка обхода добавляется один раз
+static void report(const client_t *c, const char *name, const mark_t *from, uint32_t passes, bool pipelined) {
+    uint64_t elapsed = now_ns() - from->start_ns;
+    uint64_t out = c->bytes_out - from->bytes_out;
+    uint64_t in = c->bytes_in - from->bytes_in;
+    uint64_t line = pipelined ? (out > in ? out : in) : out + in;
+    uint32_t turnarounds = pipelined ? 1 : c->frames - from->frames;
+    double uart_ms = line * HOST_UART_BITS * 1e3 / HOST_UART_BAUD + turnarounds * HOST_TURNAROUND_US / 1e3;
+    printf("%s\n    {\"name\": \"%s\", \"passes\": %u, \"frames\": %u, \"bytes_out\": %llu, \"bytes_in\": %llu, "
+           "\"ms\": %.3f, \"us_per_pass\": %.1f, \"bytes_per_s\": %.0f, \"uart_ms\": %.1f}",
+           first_result ? "" : ",", name, passes, c->frames - from->frames, (unsigned long long)out,
+           (unsigned long long)in, elapsed / 1e6, elapsed / 1e3 / passes,
+           elapsed ? (out + in) * 1e9 / elapsed : 0.0, uart_ms);
+    first_result = false;
+}
+
+static void measure(client_t *c, const char *name, xfer_kind_t kind, const xfer_args_t *args, uint32_t passes) {
+    static const struct {
+        const char *suffix;
+        size_t window;
+    } modes[] = { { "stop_and_wait", HOST_STOP_AND_WAIT }, { "pipelined", PROVISION_WINDOW } };
+
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        c->window = modes[m].window;
+        mark_t from = mark(c);
+        for (uint32_t i = 0; i < passes && c->ok; i++) {
+            run_xfer(c, kind, args);
+        }
+        client_drain(c);
+        char label[64];
+        snprintf(label, sizeof(label), "%s/%s", name, modes[m].suffix);
+        report(c, label, &from, passes, modes[m].window != HOST_STOP_AND_WAIT);
+    }
+}
+
+static void measure_ping(client_t *c) {
+    c->window = HOST_STOP_AND_WAIT;
+    mark_t from = mark(c);
+    for (uint32_t i = 0; i < HOST_PINGS && c->ok; i++) {
+        client_call(c, PROVISION_CMD_PING, NULL, 0, NULL, 0);
+    }
+    report(c, "ping", &from, HOST_PINGS, false);
+}
+
+// Настройка устройства целиком: проверка связи, настройки одним блоком, сохранение, проверка чтением
+static bool provision_device(client_t *c, const settings_t *target, settings_record_t *backup) {
+    uint8_t blob[SETTINGS_CODEC_MAX_LEN];
+    uint8_t readback[SETTINGS_CODEC_MAX_LEN];
+    uint8_t info[8] = { 0 };
+    size_t len = settings_encode(target, blob, sizeof(blob));
+
+    mark_t from = mark(c);
+    c->window = PROVISION_WINDOW;
+    client_call(c, PROVISION_CMD_PING, NULL, 0, info, sizeof(info));
+    if (c->ok && (info[0] != PROVISION_VERSION || (size_t)(info[4] | info[5] << 8) != sizeof(settings_t))) {
+        client_fail(c, "protocol or settings layout mismatch");
+    }
+    send_blob(c, blob, len);
+    client_call(c, PROVISION_CMD_COMMIT, NULL, 0, NULL, 0);
+    read_chunks(c, PROVISION_CMD_BLOB_READ, readback, len);
+    read_chunks(c, PROVISION_CMD_RECORD_READ, (uint8_t *)backup, sizeof(*backup));
+    client_drain(c);
+    report(c, "end_to_end", &from, 1, true);
+
+    settings_t check;
+    if (c->ok && (!settings_decode(readback, len, &check) || (settings_diff(&check, target) & SETTINGS_USER_FIELDS))) {
+        client_fail(c, "readback differs from provisioned settings");
+    }
+    if (c->ok && !settings_record_open(backup, NULL)) {
+        client_fail(c, "record backup does not verify");
+    }
+    return c->ok;
+}
+
+// ---- Устройство на псевдотерминале ----
+
+static provision_t device;
+static volatile bool device_stop;
+
+static size_t pty_read(void *ctx, uint8_t *buf, size_t len) {
+    ssize_t n = read(*(int *)ctx, buf, len);
+    return n > 0 ? (size_t)n : 0;
+}
+
+static size_t pty_write(void *ctx, const uint8_t *buf, size_t len) {
+    ssize_t n = write(*(int *)ctx, buf, len);
+    return n > 0 ? (size_t)n : 0;
+}
+
+static void *device_thread(void *arg) {
+    int *master = arg;
+    while (!device_stop) {
+        struct pollfd pfd = { .fd = *master, .events = POLLIN | (device.tx_len ? POLLOUT : 0) };
+        poll(&pfd, 1, 10);
+        provision_poll(&device);
+    }
+    return NULL;
+}
+
+static bool set_raw(int fd, speed_t speed) {
+    struct termios tio;
+    if (tcgetattr(fd, &tio) != 0) {
+        return false;
+    }
+    cfmakeraw(&tio);
+    if (speed) {
+        cfsetispeed(&tio, speed);
+        cfsetospeed(&tio, speed);
+    }
+    return tcsetattr(fd, TCSANOW, &tio) == 0;
+}
+
+static int open_pty(int *master) {
+    *master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (*master < 0 || grantpt(*master) != 0 || unlockpt(*master) != 0) {
+        return -1;
+    }
+    fcntl(*master, F_SETFL, fcntl(*master, F_GETFL) | O_NONBLOCK);
+    int fd = open(ptsname(*master), O_RDWR | O_NOCTTY);
+    if (fd >= 0 && !set_raw(fd, 0)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool prepare_flash(settings_t *cfg) {
+    bool ok = true;
+    for (uint32_t s = 0; s < SETTINGS_LOG_SECTORS; s++) {
+        ok &= erase_flash_sector(FLASH_OFFSET + s * FLASH_SECTOR_SIZE);
+    }
+    settings_init_default(cfg);
+    return ok && settings_save(cfg, FLASH_OFFSET);
+}
+
+static void make_target(settings_t *cfg) {
+    settings_init_default(cfg);
+    snprintf(cfg->wifi_ssid, WIFI_SSID_MAX_LEN, "%s", "Factory-AP");
+    snprintf(cfg->wifi_pass, WIFI_PASS_MAX_LEN, "%s", "ProvisionedPass42");
+    snprintf(cfg->ntp_servers[0], NTP_SERVER_MAX_LEN, "%s", "0.pool.ntp.org");
+    snprintf(cfg->ntp_servers[1], NTP_SERVER_MAX_LEN, "%s", "time.cloudflare.com");
+    cfg->brightness = 75;
+    cfg->anim_lags_period_s = 180;
+    cfg->anim_flags = ANIM_FLAG_1 | ANIM_FLAG_3;
+}
+
+int main(int argc, char **argv) {
+    const char *port = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:")) != -1) {
+        if (opt != 'p') {
+            fprintf(stderr, "usage: %s [-p serial-port] [output.json]\n", argv[0]);
+            return 2;
+        }
+        port = optarg;
+    }
+    if (optind < argc && !freopen(argv[optind], "w", stdout)) {
+        perror(argv[optind]);
+        return 1;
+    }
+
+    static client_t client;
+    static settings_record_t backup;
+    static int master = -1;
+    static const provision_io_t pty_io = { &master, pty_read, pty_write };
+    pthread_t thread;
+    settings_t target;
+    make_target(&target);
+    client.ok = true;
+
+    if (port) {
+        client.fd = open(port, O_RDWR | O_NOCTTY);
+        if (client.fd < 0 || !set_raw(client.fd, B115200)) {
+            perror(port);
+            return 1;
+        }
+    } else {
+        settings_t initial;
+        if (!flash_hal_host_open(NULL) || !prepare_flash(&initial)) {
+            fprintf(stderr, "Flash image unavailable\n");
+            return 1;
+        }
+        client.fd = open_pty(&master);
+        if (client.fd < 0) {
+            perror("pty");
+            return 1;
+        }
+        provision_init(&device, &pty_io, FLASH_OFFSET, &initial);
+        pthread_create(&thread, NULL, device_thread, &master);
+    }
+    fcntl(client.fd, F_SETFL, fcntl(client.fd, F_GETFL) | O_NONBLOCK);
+    uint32_t passes = port ? HOST_PASSES_SERIAL : HOST_PASSES_PTY;
+
+    printf("{\n  \"transport\": \"%s\", \"window\": %u, \"max_data\": %u,\n  \"results\": [",
+           port ? "serial" : "pty", (unsigned)PROVISION_WINDOW, (unsigned)PROVISION_MAX_DATA);
+
+    // Сначала настройка целиком: резервная копия записи нужна для замеров восстановления
+    provision_device(&client, &target, &backup);
+
+    uint8_t blob[SETTINGS_CODEC_MAX_LEN];
+    xfer_args_t args = { &target, blob, settings_encode(&target, blob, sizeof(blob)), &backup };
+    measure_ping(&client);
+    measure(&client, "field_set", XFER_FIELDS, &args, passes);
+    measure(&client, "blob_write", XFER_BLOB, &args, passes);
+    measure(&client, "record_read", XFER_RECORD_READ, &args, passes);
+    measure(&client, "record_write", XFER_RECORD_WRITE, &args, passes);
+
+    // Черновик после замеров совпадает с сохранёнными настройками
+    client.window = HOST_STOP_AND_WAIT;
+    client_call(&client, PROVISION_CMD_REVERT, NULL, 0, NULL, 0);
+
+    printf("\n  ],\n  \"generation\": %u", client.last_u32);
+    if (!port) {
+        device_stop = true;
+        pthread_join(thread, NULL);
+        printf(", \"device\": {\"frames\": %u, \"bad_frames\": %u, \"errors\": %u, \"commits\": %u}",
+               device.stats.frames, device.stats.bad_frames, device.stats.errors, device.stats.commits);
+        client.ok &= device.stats.errors == 0 && device.stats.commits == 1;
+        close(master);
+        flash_hal_host_close();
+    }
+    printf(",\n  \"ok\": %s\n}\n", client.ok ? "true" : "false");
+    close(client.fd);
+    return client.ok ? 0 : 1;
+}
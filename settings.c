@@ -1,48 +1,173 @@
 
 
-#include <stdio.h>
 #include <string.h>
 #include "pico/stdlib.h"
+#include "pico/rand.h"
 #include "settings.h"
+#include "settings_schema.h"
+#include "settings_migrate.h"
+#include "settings_boot.h"
+#include "flash_hal.h"
 #include "flash_utils.h"
+#include "flash_scratch.h"
+#include "crc32.h"
+#include "aead.h"
 #include "logging.h"
-#include "config.h"
 
-// Статический буфер для операций с флеш-памятью
-static uint8_t flash_buffer[FLASH_SECTOR_SIZE];
+#define SETTINGS_LOG_TOTAL_SLOTS (SETTINGS_LOG_SECTORS * SETTINGS_SLOTS_PER_SECTOR)
+#define SETTINGS_SLOT_NONE       0xFFFFFFFF
 
-// Функция шифрования/дешифрования пароля (XOR с SETTINGS_MAGIC)
+// Состояние журнала настроек в RAM (заполняется при сканировании)
+typedef struct {
+    bool valid;             // Состояние соответствует журналу по base_offset
+    uint32_t base_offset;   // Смещение начала кольца во флеш-памяти
+    uint32_t next_slot;     // Слот для следующей записи
+    uint32_t next_seq;      // Порядковый номер следующей записи
+    uint32_t live_slot;     // Слот актуальной записи (SETTINGS_SLOT_NONE, если её нет)
+    bool legacy;            // Записи нет, актуальны настройки прошивки до журнала (SETTINGS_LEGACY_OFFSET)
+} settings_log_t;
+
+static settings_log_t settings_log;
+
+// Ключ ChaCha20-Poly1305: выводится из ключа сборки и уникального идентификатора устройства
+static uint8_t settings_key[AEAD_KEY_LEN];
+static uint8_t settings_key_id[FLASH_HAL_UNIQUE_ID_LEN];
+static bool settings_key_ready;
+
+// Области записи: пароль шифруется, остальные поля только аутентифицируются
+#define PASS_OFFSET   offsetof(settings_t, wifi_pass)
+#define PASS_END      (PASS_OFFSET + WIFI_PASS_MAX_LEN)
+
+// Функция шифрования/дешифрования пароля (XOR с SETTINGS_MAGIC).
+// Используется только для записей SETTINGS_PROTECT_CRC; ключ для новых записей - см. settings_aead_key.
 static void xor_wifi_pass(char *pass, size_t len) {
 #ifdef ENCRYPT_WIFI_PASS
     size_t real_len = strnlen(pass, len);
-    LOG_INFO("Encrypting/Decrypting password: %s (len %u)", pass, (unsigned)real_len);
     for (size_t i = 0; i < real_len && i < WIFI_PASS_MAX_LEN; i++) {
         pass[i] ^= (SETTINGS_MAGIC >> (i % 32)) & 0xFF;
     }
-    char temp[WIFI_PASS_MAX_LEN + 1];
-    strncpy(temp, pass, WIFI_PASS_MAX_LEN);
-    temp[WIFI_PASS_MAX_LEN] = '\0';
-    LOG_INFO("Result: %s", temp);
-    // TODO: Consider making encryption key configurable via CMake (e.g., -DENCRYPTION_KEY=0xDEADBEEF)
 #else
     LOG_WARN("Encryption disabled - ENCRYPT_WIFI_PASS not defined");
 #endif
 }
 
+#ifdef SETTINGS_AEAD_KEY
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+#endif
+
+// Ключ устройства = блок ChaCha20(ключ сборки, nonce = уникальный идентификатор).
+// Ключ сборки задаётся SETTINGS_AEAD_KEY (64 hex-символа); без него используется
+// ключ по умолчанию, и ключ устройства зависит только от идентификатора.
+static void settings_derive_key(const uint8_t *unique_id, uint8_t *key) {
+    static const uint8_t default_key[AEAD_KEY_LEN] = "VFDVault-settings-default-key-v1";
+    uint8_t build_key[AEAD_KEY_LEN];
+    memcpy(build_key, default_key, AEAD_KEY_LEN);
+#ifdef SETTINGS_AEAD_KEY
+    static_assert(sizeof(SETTINGS_AEAD_KEY) == 2 * AEAD_KEY_LEN + 1, "SETTINGS_AEAD_KEY must be 64 hex digits");
+    for (size_t i = 0; i < AEAD_KEY_LEN; i++) {
+        int hi = hex_digit(SETTINGS_AEAD_KEY[2 * i]);
+        int lo = hex_digit(SETTINGS_AEAD_KEY[2 * i + 1]);
+        if (hi < 0 || lo < 0) {
+            LOG_ERROR("Invalid SETTINGS_AEAD_KEY - using default key");
+            memcpy(build_key, default_key, AEAD_KEY_LEN);
+            break;
+        }
+        build_key[i] = (uint8_t)(hi << 4 | lo);
+    }
+#endif
+    uint8_t nonce[AEAD_NONCE_LEN] = { 0 };
+    memcpy(nonce + AEAD_NONCE_LEN - FLASH_HAL_UNIQUE_ID_LEN, unique_id, FLASH_HAL_UNIQUE_ID_LEN);
+    uint8_t block[AEAD_BLOCK_LEN];
+    aead_chacha20_block(build_key, 0, nonce, block);
+    memcpy(key, block, AEAD_KEY_LEN);
+    memset(block, 0, sizeof(block));
+    memset(build_key, 0, sizeof(build_key));
+}
+
+// Ключ этого устройства; пересчитывается, если идентификатор изменился
+// (эмулятор на хосте подставляет идентификаторы плат при проверке образов)
+static const uint8_t *settings_aead_key(void) {
+    uint8_t id[FLASH_HAL_UNIQUE_ID_LEN];
+    flash_hal_unique_id(id);
+    if (!settings_key_ready || memcmp(id, settings_key_id, sizeof(id)) != 0) {
+        settings_derive_key(id, settings_key);
+        memcpy(settings_key_id, id, sizeof(id));
+        settings_key_ready = true;
+    }
+    return settings_key;
+}
+
+// Nonce записи: seq (уникален в пределах журнала) и случайная часть (на случай очистки журнала)
+static void record_nonce(const settings_record_t *rec, uint8_t *nonce) {
+    memcpy(nonce, &rec->seq, sizeof(rec->seq));
+    memcpy(nonce + sizeof(rec->seq), rec->nonce, SETTINGS_NONCE_LEN);
+}
+
+// Один проход по записи: копирование, шифрование пароля и расчёт тега.
+// Поле crc32 записывается нулём и входит в тег; dst == NULL - только проверка.
+static void record_aead_pass(aead_ctx_t *ctx, const uint8_t *key, const settings_record_t *rec,
+                             const uint8_t *src, uint8_t *dst, size_t size, bool encrypt) {
+    uint8_t nonce[AEAD_NONCE_LEN];
+    record_nonce(rec, nonce);
+    aead_init(ctx, key, nonce);
+    aead_aad(ctx, (const uint8_t *)&rec->protect, sizeof(rec->protect));
+
+    bool secret = ((const settings_t *)src)->flags & FLAG_SETTINGS_ENCRYPTED;
+    aead_authenticate(ctx, dst, src, PASS_OFFSET);
+    if (!secret) {
+        aead_authenticate(ctx, dst ? dst + PASS_OFFSET : NULL, src + PASS_OFFSET, WIFI_PASS_MAX_LEN);
+    } else if (encrypt) {
+        aead_encrypt(ctx, dst + PASS_OFFSET, src + PASS_OFFSET, WIFI_PASS_MAX_LEN);
+    } else {
+        aead_decrypt(ctx, dst ? dst + PASS_OFFSET : NULL, src + PASS_OFFSET, WIFI_PASS_MAX_LEN);
+    }
+    size_t crc_offset = size - sizeof(uint32_t);
+    static const uint8_t zero_crc[sizeof(uint32_t)] = { 0 };
+    aead_authenticate(ctx, dst ? dst + PASS_END : NULL, src + PASS_END, crc_offset - PASS_END);
+    aead_authenticate(ctx, dst ? dst + crc_offset : NULL, encrypt ? zero_crc : src + crc_offset, sizeof(zero_crc));
+}
+
+void settings_blob_seal(const uint8_t *nonce, const uint8_t *aad, size_t aad_len,
+                        uint8_t *data, size_t len, uint8_t *tag) {
+    aead_ctx_t ctx;
+    aead_init(&ctx, settings_aead_key(), nonce);
+    if (aad_len) {
+        aead_aad(&ctx, aad, aad_len);
+    }
+    aead_encrypt(&ctx, data, data, len);
+    aead_finish(&ctx, tag);
+}
+
+bool settings_blob_open(const uint8_t *nonce, const uint8_t *aad, size_t aad_len,
+                        uint8_t *data, size_t len, const uint8_t *tag) {
+    // Сначала проверка тега, расшифровка - только подлинных данных
+    aead_ctx_t ctx;
+    aead_init(&ctx, settings_aead_key(), nonce);
+    if (aad_len) {
+        aead_aad(&ctx, aad, aad_len);
+    }
+    aead_decrypt(&ctx, NULL, data, len);
+    if (!aead_verify(&ctx, tag)) {
+        return false;
+    }
+    aead_init(&ctx, settings_aead_key(), nonce);
+    aead_decrypt(&ctx, data, data, len);
+    return true;
+}
+
 uint32_t calculate_crc32(const uint8_t *data, size_t len) {
     if (!data || len == 0) {
         LOG_ERROR("Invalid input to calculate_crc32");
         return CRC32_ERROR;
     }
 
-    uint32_t crc = 0xFFFFFFFF;
-    for (size_t i = 0; i < len; i++) {
-        crc ^= data[i];
-        for (int j = 0; j < 8; j++) {
-            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
-        }
-    }
-    return crc ^ 0xFFFFFFFF;
+    return crc32_compute(data, len);
 }
 
 void settings_init_default(settings_t *cfg) {
@@ -50,131 +175,521 @@ void settings_init_default(settings_t *cfg) {
         LOG_ERROR("Null pointer passed to settings_init_default");
         return;
     }
+    memcpy(cfg, &settings_default_image, sizeof(settings_t));
+}
 
-    memset(cfg, 0, sizeof(settings_t));
-    cfg->magic = SETTINGS_MAGIC;
-    cfg->version = SETTINGS_VERSION;
-    cfg->size = sizeof(settings_t);
-    snprintf(cfg->wifi_ssid, WIFI_SSID_MAX_LEN, "%s", DEFAULT_SSID);
-    snprintf(cfg->wifi_pass, WIFI_PASS_MAX_LEN, "%s", DEFAULT_PASS);
-    cfg->brightness = 50;
-    cfg->night_off_hour = 22;
-    cfg->night_on_hour = 6;
-    cfg->anim_lags_period_s = 5;
-    snprintf(cfg->ntp_servers[0], NTP_SERVER_MAX_LEN, "%s", DEFAULT_NTP_SERVER);
-    cfg->ntp_sync_period_minutes = 60;
-#ifdef ENCRYPT_WIFI_PASS
-    if (!(cfg->flags & FLAG_SETTINGS_ENCRYPTED)) {
-        LOG_INFO("Encryption enabled via ENCRYPT_WIFI_PASS - setting FLAG_SETTINGS_ENCRYPTED");
-        cfg->flags |= FLAG_SETTINGS_ENCRYPTED;
+static inline uint32_t log_slot_offset(uint32_t base_offset, uint32_t slot) {
+    return base_offset + slot * SETTINGS_RECORD_SLOT_SIZE;
+}
+
+static inline const settings_record_t *log_slot_record(uint32_t base_offset, uint32_t slot) {
+    return (const settings_record_t *)flash_hal_xip_ptr(log_slot_offset(base_offset, slot));
+}
+
+static bool check_log_offset(const uint32_t flash_offset) {
+    if (flash_offset % FLASH_SECTOR_SIZE != 0 || flash_offset > PICO_FLASH_SIZE_BYTES - SETTINGS_LOG_SIZE) {
+        LOG_ERROR("Invalid or unaligned flash offset 0x%08X", flash_offset);
+        return false;
     }
+    return true;
+}
+
+static inline bool record_slot_blank(const settings_record_t *rec) {
+    return rec->seq == 0xFFFFFFFF && rec->seq_inv == 0xFFFFFFFF;
+}
+
+static inline bool record_seq_valid(const settings_record_t *rec) {
+    return (rec->seq ^ rec->seq_inv) == 0xFFFFFFFF;
+}
+
+// Первый слот сектора SETTINGS_LEGACY_OFFSET ещё занят настройками прошивки до журнала
+// (на месте номера записи - SETTINGS_MAGIC): для журнала это пустой слот, а не повреждённый
+static inline bool record_is_legacy(const settings_record_t *rec) {
+    return (const uint8_t *)rec == flash_hal_xip_ptr(SETTINGS_LEGACY_OFFSET) && rec->seq == SETTINGS_MAGIC;
+}
+
+// Быстрая проверка заголовка записи (номер, magic, версия, размер) без расчёта CRC32.
+// Записи старых версий, для которых есть миграция, тоже считаются валидными.
+static bool record_header_valid(const settings_record_t *rec) {
+    return record_seq_valid(rec) &&
+           rec->data.magic == SETTINGS_MAGIC &&
+           settings_migrate_supported(rec->data.version, rec->data.size);
+}
+
+// Запись текущей версии (может быть прочитана напрямую как settings_t)
+static inline bool record_is_current(const settings_record_t *rec) {
+    return rec->data.version == SETTINGS_VERSION && rec->data.size == sizeof(settings_t);
+}
+
+// Проверка CRC32 настроек без тега (запись SETTINGS_PROTECT_CRC или настройки до журнала).
+// Если out != NULL, настройки копируются в out тем же проходом, а пароль расшифровывается.
+static bool crc_open(const settings_t *cfg, settings_t *out) {
+#ifdef SETTINGS_AEAD_REQUIRED
+    (void)cfg;
+    (void)out;
+    LOG_ERROR("Unauthenticated settings rejected");
+    return false;
 #else
-    if (cfg->flags & FLAG_SETTINGS_ENCRYPTED) {
-        LOG_WARN("Encryption flag set but ENCRYPT_WIFI_PASS not defined - disabling");
-        cfg->flags &= ~FLAG_SETTINGS_ENCRYPTED;
+    // CRC32 всегда последнее поле структуры своей версии
+    size_t crc_offset = cfg->size - sizeof(uint32_t);
+    uint32_t stored_crc;
+    memcpy(&stored_crc, (const uint8_t *)cfg + crc_offset, sizeof(stored_crc));
+    uint32_t computed_crc = crc32_copy(out, cfg, crc_offset);
+    if (computed_crc != stored_crc) {
+        LOG_ERROR("CRC32 mismatch: computed 0x%08X, stored 0x%08X", computed_crc, stored_crc);
+        return false;
+    }
+    if (out) {
+        memcpy((uint8_t *)out + crc_offset, &stored_crc, sizeof(stored_crc));
+        if (out->flags & FLAG_SETTINGS_ENCRYPTED) {
+            xor_wifi_pass(out->wifi_pass, WIFI_PASS_MAX_LEN);
+        }
     }
+    return true;
 #endif
-    cfg->crc32 = calculate_crc32((const uint8_t *)cfg, sizeof(settings_t) - sizeof(uint32_t));
 }
 
-bool settings_load(settings_t *cfg, const uint32_t flash_offset) {
-    if (!cfg) {
-        LOG_ERROR("Null pointer passed to settings_load");
+// Проверка заголовка и целостности записи (тег ChaCha20-Poly1305 или CRC32).
+// Если out != NULL, запись копируется в out тем же проходом, что и проверка, пароль
+// расшифровывается, а запись старой версии обновляется до текущей.
+static bool validate_record(const settings_record_t *rec, settings_t *out) {
+    const settings_t *cfg = &rec->data;
+    if (cfg->magic != SETTINGS_MAGIC) {
+        LOG_ERROR("Invalid magic number: 0x%08X (expected 0x%08X)", cfg->magic, SETTINGS_MAGIC);
+        return false;
+    }
+    if (!settings_migrate_supported(cfg->version, cfg->size)) {
+        LOG_ERROR("Unsupported version: 0x%04X, size %u (expected 0x%04X, size %u)",
+                  cfg->version, cfg->size, SETTINGS_VERSION, (unsigned)sizeof(settings_t));
         return false;
     }
 
-    if (flash_offset % FLASH_SECTOR_SIZE != 0 || flash_offset >= PICO_FLASH_SIZE_BYTES) {
-        LOG_ERROR("Invalid or unaligned flash offset 0x%08X", flash_offset);
+    if (rec->protect == SETTINGS_PROTECT_AEAD) {
+        aead_ctx_t ctx;
+        record_aead_pass(&ctx, settings_aead_key(), rec, (const uint8_t *)cfg, (uint8_t *)out, cfg->size, false);
+        if (!aead_verify(&ctx, rec->tag)) {
+            LOG_ERROR("Settings record authentication failed");
+            if (out) {
+                memset(out->wifi_pass, 0, WIFI_PASS_MAX_LEN);
+            }
+            return false;
+        }
+    } else if (!crc_open(cfg, out)) {
         return false;
     }
 
-    const uint8_t *flash = (const uint8_t *)(XIP_BASE + flash_offset);
-    static const uint8_t blank[sizeof(settings_t)] = { [0 ... sizeof(settings_t)-1] = 0xFF };
-    if (memcmp(flash, blank, sizeof(settings_t)) == 0) {
-        LOG_WARN("Flash sector is blank at offset 0x%08X", flash_offset);
+    if (out && cfg->version != SETTINGS_VERSION) {
+        return settings_migrate(out);
+    }
+    return true;
+}
+
+// Настройки прошивки до журнала: тот же формат, что у записи SETTINGS_PROTECT_CRC, без заголовка.
+// Если out != NULL, настройки копируются в out с расшифровкой пароля и обновлением версии.
+static bool legacy_open(settings_t *out) {
+    const settings_t *cfg = (const settings_t *)flash_hal_xip_ptr(SETTINGS_LEGACY_OFFSET);
+    if (cfg->magic != SETTINGS_MAGIC || !settings_migrate_supported(cfg->version, cfg->size)) {
+        return false;
+    }
+    if (!crc_open(cfg, out)) {
         return false;
     }
+    LOG_INFO("Found settings of version 0x%04X at legacy offset 0x%08X", cfg->version, SETTINGS_LEGACY_OFFSET);
+    if (out && cfg->version != SETTINGS_VERSION) {
+        return settings_migrate(out);
+    }
+    return true;
+}
 
-    memcpy(cfg, flash, sizeof(settings_t));
-    if (cfg->magic != SETTINGS_MAGIC) {
-        LOG_ERROR("Invalid magic number: 0x%08X (expected 0x%08X)", cfg->magic, SETTINGS_MAGIC);
+// Перенесённые в журнал настройки прошивки до журнала стираются: иначе при повреждении записей
+// они загрузились бы снова. Прерванное стирание повторяется при следующей загрузке.
+static void legacy_retire(void) {
+    if (!record_is_legacy((const settings_record_t *)flash_hal_xip_ptr(SETTINGS_LEGACY_OFFSET))) {
+        return;
+    }
+    LOG_INFO("Erasing moved settings at legacy offset 0x%08X", SETTINGS_LEGACY_OFFSET);
+    if (!erase_flash_sector(SETTINGS_LEGACY_OFFSET)) {
+        LOG_WARN("Failed to erase legacy settings - will retry on next load");
+    }
+}
+
+void settings_record_seal(settings_record_t *rec, const settings_t *cfg, uint32_t protect) {
+    settings_record_seal_device(rec, cfg, protect, NULL);
+}
+
+void settings_record_seal_device(settings_record_t *rec, const settings_t *cfg, uint32_t protect,
+                                 const uint8_t *unique_id) {
+    rec->protect = protect;
+    if (protect == SETTINGS_PROTECT_AEAD) {
+        uint64_t random = get_rand_64();
+        memcpy(rec->nonce, &random, SETTINGS_NONCE_LEN);
+        uint8_t device_key[AEAD_KEY_LEN];
+        if (unique_id) {
+            settings_derive_key(unique_id, device_key);
+        }
+        aead_ctx_t ctx;
+        record_aead_pass(&ctx, unique_id ? device_key : settings_aead_key(), rec, (const uint8_t *)cfg,
+                         (uint8_t *)&rec->data, sizeof(settings_t), true);
+        aead_finish(&ctx, rec->tag);
+        memset(device_key, 0, sizeof(device_key));
+        return;
+    }
+
+    memset(rec->nonce, 0xFF, SETTINGS_NONCE_LEN);
+    memset(rec->tag, 0xFF, SETTINGS_TAG_LEN);
+    settings_t *temp = &rec->data;
+    memcpy(temp, cfg, sizeof(settings_t));
+    // Шифруем пароль перед сохранением, если установлен флаг
+    if (temp->flags & FLAG_SETTINGS_ENCRYPTED) {
+        xor_wifi_pass(temp->wifi_pass, WIFI_PASS_MAX_LEN);
+    }
+    temp->crc32 = calculate_crc32((const uint8_t *)temp, sizeof(settings_t) - sizeof(uint32_t));
+}
+
+bool settings_record_open(const settings_record_t *rec, settings_t *out) {
+    if (!rec) {
+        LOG_ERROR("Null pointer passed to settings_record_open");
         return false;
     }
-    if (cfg->version != SETTINGS_VERSION) {
-        LOG_ERROR("Unsupported version: 0x%04X (expected 0x%04X)", cfg->version, SETTINGS_VERSION);
+    return validate_record(rec, out);
+}
+
+// Быстрый поиск последней записанной позиции: активный сектор выбирается по заголовку
+// первого слота каждого сектора (как A/B-слоты), внутри него - двоичный поиск.
+// Возвращает false, если заголовки повреждены и нужен полный просмотр журнала.
+static bool settings_log_locate_newest(const uint32_t base_offset, uint32_t *newest_slot) {
+    uint32_t best_sector = SETTINGS_SLOT_NONE;
+    uint32_t best_seq = 0;
+
+    for (uint32_t sector = 0; sector < SETTINGS_LOG_SECTORS; sector++) {
+        const settings_record_t *rec = log_slot_record(base_offset, sector * SETTINGS_SLOTS_PER_SECTOR);
+        if (record_slot_blank(rec) || record_is_legacy(rec)) {
+            continue;
+        }
+        if (!record_seq_valid(rec)) {
+            return false;  // Оборванная запись в начале сектора
+        }
+        if (best_sector == SETTINGS_SLOT_NONE || rec->seq > best_seq) {
+            best_seq = rec->seq;
+            best_sector = sector;
+        }
+    }
+
+    if (best_sector == SETTINGS_SLOT_NONE) {
+        *newest_slot = SETTINGS_SLOT_NONE;
+        return true;
+    }
+
+    // Слоты сектора заполняются по порядку: ищем последний непустой
+    uint32_t first = best_sector * SETTINGS_SLOTS_PER_SECTOR;
+    uint32_t lo = 0, hi = SETTINGS_SLOTS_PER_SECTOR;
+    while (hi - lo > 1) {
+        uint32_t mid = (lo + hi) / 2;
+        if (record_slot_blank(log_slot_record(base_offset, first + mid))) {
+            hi = mid;
+        } else {
+            lo = mid;
+        }
+    }
+    *newest_slot = first + lo;
+    return record_seq_valid(log_slot_record(base_offset, *newest_slot));
+}
+
+// Полный просмотр журнала: используется только если самая новая запись повреждена.
+// Кандидаты проверяются от новых к старым, CRC32 считается до первой валидной записи.
+static void settings_log_scan_full(const uint32_t base_offset, settings_t *out,
+                                   uint32_t *last_slot, uint32_t *last_seq) {
+    *last_slot = SETTINGS_SLOT_NONE;
+    *last_seq = 0;
+    for (uint32_t slot = 0; slot < SETTINGS_LOG_TOTAL_SLOTS; slot++) {
+        const settings_record_t *rec = log_slot_record(base_offset, slot);
+        if (record_slot_blank(rec) || record_is_legacy(rec)) {
+            continue;
+        }
+        if (!record_seq_valid(rec)) {
+            LOG_WARN("Corrupted record header in settings log slot %u", (unsigned)slot);
+            continue;
+        }
+        if (*last_slot == SETTINGS_SLOT_NONE || rec->seq > *last_seq) {
+            *last_seq = rec->seq;
+            *last_slot = slot;
+        }
+    }
+
+    uint32_t bound = 0xFFFFFFFF;
+    while (settings_log.live_slot == SETTINGS_SLOT_NONE) {
+        uint32_t candidate = SETTINGS_SLOT_NONE;
+        uint32_t candidate_seq = 0;
+        for (uint32_t slot = 0; slot < SETTINGS_LOG_TOTAL_SLOTS; slot++) {
+            const settings_record_t *rec = log_slot_record(base_offset, slot);
+            if (record_header_valid(rec) && rec->seq < bound &&
+                (candidate == SETTINGS_SLOT_NONE || rec->seq > candidate_seq)) {
+                candidate = slot;
+                candidate_seq = rec->seq;
+            }
+        }
+        if (candidate == SETTINGS_SLOT_NONE) {
+            break;
+        }
+        if (validate_record(log_slot_record(base_offset, candidate), out)) {
+            settings_log.live_slot = candidate;
+        } else {
+            LOG_WARN("Settings record seq %u is damaged - trying older copy", (unsigned)candidate_seq);
+            bound = candidate_seq;
+        }
+    }
+}
+
+// Сканирование журнала: поиск актуальной записи и позиции для следующей записи.
+// В обычном случае читаются только заголовки, а CRC32 считается для одной записи.
+static void settings_log_scan(const uint32_t base_offset, settings_t *out) {
+    uint32_t last_slot = SETTINGS_SLOT_NONE;
+    uint32_t last_seq = 0;
+
+    settings_log.live_slot = SETTINGS_SLOT_NONE;
+    if (settings_log_locate_newest(base_offset, &last_slot)) {
+        if (last_slot != SETTINGS_SLOT_NONE) {
+            const settings_record_t *rec = log_slot_record(base_offset, last_slot);
+            last_seq = rec->seq;
+            if (record_header_valid(rec) && validate_record(rec, out)) {
+                settings_log.live_slot = last_slot;
+            }
+        }
+        if (last_slot != SETTINGS_SLOT_NONE && settings_log.live_slot == SETTINGS_SLOT_NONE) {
+            settings_log_scan_full(base_offset, out, &last_slot, &last_seq);
+        }
+    } else {
+        settings_log_scan_full(base_offset, out, &last_slot, &last_seq);
+    }
+
+    // Журнал пуст или все записи повреждены: настройки прошивки до журнала ещё не перенесены
+    settings_log.legacy = settings_log.live_slot == SETTINGS_SLOT_NONE && legacy_open(out);
+
+    settings_log.base_offset = base_offset;
+    settings_log.next_seq = (last_slot == SETTINGS_SLOT_NONE) ? 1 : last_seq + 1;
+    settings_log.next_slot = (last_slot == SETTINGS_SLOT_NONE) ? 0 : (last_slot + 1) % SETTINGS_LOG_TOTAL_SLOTS;
+    settings_log.valid = true;
+}
+
+// Поиск чистого слота для записи; при переходе на новый сектор он стирается
+static bool settings_log_prepare_slot(void) {
+    for (uint32_t attempt = 0; attempt < SETTINGS_LOG_TOTAL_SLOTS; attempt++) {
+        uint32_t slot = settings_log.next_slot;
+        uint32_t offset = log_slot_offset(settings_log.base_offset, slot);
+
+        if (slot % SETTINGS_SLOTS_PER_SECTOR == 0) {
+            // Актуальная запись и не перенесённые настройки до журнала не должны оказаться в стираемом секторе
+            if ((settings_log.live_slot != SETTINGS_SLOT_NONE &&
+                 settings_log.live_slot / SETTINGS_SLOTS_PER_SECTOR == slot / SETTINGS_SLOTS_PER_SECTOR) ||
+                (settings_log.legacy && offset == SETTINGS_LEGACY_OFFSET)) {
+                LOG_WARN("Settings log sector at 0x%08X holds live record - skipping", offset);
+                settings_log.next_slot = (slot + SETTINGS_SLOTS_PER_SECTOR) % SETTINGS_LOG_TOTAL_SLOTS;
+                continue;
+            }
+            if (!flash_is_blank(offset, FLASH_SECTOR_SIZE)) {
+                LOG_INFO("Recycling settings log sector at offset 0x%08X", offset);
+                if (!erase_flash_sector(offset)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        if (flash_is_blank(offset, SETTINGS_RECORD_SLOT_SIZE)) {
+            // Слоты сектора заполняются с начала: если сектор стёрт целиком, пишем в первый слот
+            uint32_t first = slot - (slot % SETTINGS_SLOTS_PER_SECTOR);
+            if (record_slot_blank(log_slot_record(settings_log.base_offset, first))) {
+                settings_log.next_slot = first;
+            }
+            return true;
+        }
+        LOG_WARN("Skipping dirty settings log slot %u", (unsigned)slot);
+        settings_log.next_slot = (slot + 1) % SETTINGS_LOG_TOTAL_SLOTS;
+    }
+    return false;
+}
+
+bool settings_load(settings_t *cfg, const uint32_t flash_offset) {
+    if (!cfg) {
+        LOG_ERROR("Null pointer passed to settings_load");
         return false;
     }
-    if (cfg->size != sizeof(settings_t)) {
-        LOG_ERROR("Size mismatch: stored %u, expected %u", cfg->size, (unsigned)sizeof(settings_t));
+
+    if (!check_log_offset(flash_offset)) {
         return false;
     }
 
-    uint32_t computed_crc = calculate_crc32((const uint8_t *)cfg, sizeof(settings_t) - sizeof(uint32_t));
-    if (computed_crc != cfg->crc32) {
-        LOG_ERROR("CRC32 mismatch: computed 0x%08X, stored 0x%08X", computed_crc, cfg->crc32);
+    // Актуальная запись копируется в cfg тем же проходом, что и проверка целостности
+    // (для ChaCha20-Poly1305 - и расшифровка пароля)
+    settings_log_scan(flash_offset, cfg);
+    if (settings_log.legacy) {
+        // Первая загрузка после обновления прошивки: настройки переносятся в журнал записью seq 1
+        LOG_INFO("Moving settings from legacy offset 0x%08X into the log", SETTINGS_LEGACY_OFFSET);
+        if (!settings_save(cfg, flash_offset)) {
+            LOG_WARN("Failed to move legacy settings into the log - will retry on next load");
+        }
+        return true;
+    }
+    if (settings_log.live_slot == SETTINGS_SLOT_NONE) {
+        LOG_WARN("No valid settings record in log at offset 0x%08X", flash_offset);
         return false;
     }
 
-    // Дешифруем пароль после загрузки, если установлен флаг
-    if (cfg->flags & FLAG_SETTINGS_ENCRYPTED) {
-        xor_wifi_pass(cfg->wifi_pass, WIFI_PASS_MAX_LEN);
+    LOG_INFO("Settings loaded successfully from offset 0x%08X (slot %u)",
+             log_slot_offset(flash_offset, settings_log.live_slot), (unsigned)settings_log.live_slot);
+    legacy_retire();  // Перенос был прерван до стирания
+
+    // Запись старой версии уже обновлена в cfg: сохраняем её один раз, чтобы
+    // следующие загрузки не повторяли миграцию
+    if (!record_is_current(log_slot_record(flash_offset, settings_log.live_slot))) {
+        LOG_INFO("Writing back settings migrated to version 0x%04X", SETTINGS_VERSION);
+        if (!settings_save(cfg, flash_offset)) {
+            LOG_WARN("Failed to write back migrated settings - will retry on next load");
+        }
+    }
+    return true;
+}
+
+uint32_t settings_generation(const uint32_t flash_offset) {
+    if (!settings_log.valid || settings_log.base_offset != flash_offset ||
+        settings_log.live_slot == SETTINGS_SLOT_NONE) {
+        return 0;
     }
+    return log_slot_record(flash_offset, settings_log.live_slot)->seq;
+}
 
-    LOG_INFO("Settings loaded successfully from offset 0x%08X", flash_offset);
+bool settings_live_record_offset(const uint32_t flash_offset, uint32_t *record_offset) {
+    if (!record_offset || settings_generation(flash_offset) == 0) {
+        return false;
+    }
+    *record_offset = log_slot_offset(flash_offset, settings_log.live_slot);
     return true;
 }
 
-bool settings_save(const settings_t *cfg, const uint32_t flash_offset) {
+bool settings_validate(const settings_t *cfg) {
     if (!cfg) {
-        LOG_ERROR("Null pointer passed to settings_save");
+        LOG_ERROR("Null pointer passed to settings_validate");
         return false;
     }
+    return settings_schema_validate(cfg);
+}
 
-    if (cfg->magic != SETTINGS_MAGIC || cfg->version != SETTINGS_VERSION) {
-        LOG_ERROR("Invalid magic (0x%08X) or version (0x%04X) in settings", cfg->magic, cfg->version);
+bool settings_save(const settings_t *cfg, const uint32_t flash_offset) {
+    if (!cfg) {
+        LOG_ERROR("Null pointer passed to settings_save");
         return false;
     }
-    if (cfg->size != sizeof(settings_t)) {
-        LOG_ERROR("Invalid size: %u (expected %u)", cfg->size, (unsigned)sizeof(settings_t));
+    if (!settings_validate(cfg)) {
         return false;
     }
-    if (cfg->brightness > BRIGHTNESS_MAX) {
-        LOG_ERROR("Brightness out of range: %u (max %u)", cfg->brightness, BRIGHTNESS_MAX);
+
+    if (!check_log_offset(flash_offset)) {
         return false;
     }
-    if (cfg->night_off_hour > HOUR_MAX || cfg->night_on_hour > HOUR_MAX) {
-        LOG_ERROR("Invalid hour: night_off %u, night_on %u (max %u)", 
-                  cfg->night_off_hour, cfg->night_on_hour, HOUR_MAX);
+    settings_boot_invalidate();  // Копия в RAM перестаёт соответствовать журналу
+    if (!settings_log.valid || settings_log.base_offset != flash_offset) {
+        settings_log_scan(flash_offset, NULL);
+    }
+
+    if (!settings_log_prepare_slot()) {
+        LOG_ERROR("No free slot in settings log at offset 0x%08X", flash_offset);
+        settings_log.valid = false;
         return false;
     }
-    if (strlen(cfg->wifi_ssid) >= WIFI_SSID_MAX_LEN) {
-        LOG_ERROR("WiFi SSID too long: %s (max %u chars)", cfg->wifi_ssid, WIFI_SSID_MAX_LEN - 1);
+
+    // Слот журнала готовится в арене и программируется целиком
+    uint8_t *record_buffer = flash_scratch_borrow(SETTINGS_RECORD_SLOT_SIZE);
+    if (!record_buffer) {
         return false;
     }
-    if (strlen(cfg->wifi_pass) >= WIFI_PASS_MAX_LEN) {
-        LOG_ERROR("WiFi password too long: %s (max %u chars)", cfg->wifi_pass, WIFI_PASS_MAX_LEN - 1);
+    uint32_t slot = settings_log.next_slot;
+    uint32_t offset = log_slot_offset(flash_offset, slot);
+    uint32_t seq = settings_log.next_seq;
+    memset(record_buffer, 0xFF, SETTINGS_RECORD_SLOT_SIZE);
+    settings_record_t *rec = (settings_record_t *)record_buffer;
+    rec->seq = seq;
+    rec->seq_inv = ~seq;
+    settings_record_seal(rec, cfg, SETTINGS_PROTECT_DEFAULT);
+    bool ok = program_flash_pages(offset, record_buffer, SETTINGS_RECORD_SLOT_SIZE);
+    flash_scratch_release(record_buffer);
+    if (!ok) {
+        settings_log.valid = false;  // Слот мог остаться частично записанным - пересканируем
         return false;
     }
-    for (int i = 0; i < NTP_MAX_SERVERS; i++) {
-        if (strlen(cfg->ntp_servers[i]) >= NTP_SERVER_MAX_LEN) {
-            LOG_ERROR("NTP server %d too long: %s (max %u chars)", i, cfg->ntp_servers[i], NTP_SERVER_MAX_LEN - 1);
-            return false;
-        }
+
+    settings_log.live_slot = slot;
+    settings_log.legacy = false;
+    settings_log.next_slot = (slot + 1) % SETTINGS_LOG_TOTAL_SLOTS;
+    settings_log.next_seq++;
+    legacy_retire();
+
+    LOG_INFO("Settings saved successfully to offset 0x%08X (slot %u, seq %u)",
+             offset, (unsigned)slot, (unsigned)seq);
+    return true;
+}
+
+const settings_t *settings_view(const uint32_t flash_offset) {
+    if (!check_log_offset(flash_offset)) {
+        return NULL;
     }
 
-    memset(flash_buffer, 0xFF, FLASH_SECTOR_SIZE);
-    settings_t *temp = (settings_t *)flash_buffer;
-    memcpy(temp, cfg, sizeof(settings_t));
-    // Шифруем пароль перед сохранением, если установлен флаг
-    if (temp->flags & FLAG_SETTINGS_ENCRYPTED) {
-        xor_wifi_pass(temp->wifi_pass, WIFI_PASS_MAX_LEN);
+    // Актуальная запись уже проверена при сканировании или при записи (сверка после программирования);
+    // повторно проверяется только заголовок, на случай стирания области в обход журнала
+    if (!settings_log.valid || settings_log.base_offset != flash_offset ||
+        settings_log.live_slot == SETTINGS_SLOT_NONE ||
+        !record_header_valid(log_slot_record(flash_offset, settings_log.live_slot))) {
+        settings_log_scan(flash_offset, NULL);
     }
-    temp->crc32 = calculate_crc32((const uint8_t *)temp, sizeof(settings_t) - sizeof(uint32_t));
+    if (settings_log.live_slot == SETTINGS_SLOT_NONE) {
+        LOG_WARN("No valid settings record in log at offset 0x%08X", flash_offset);
+        return NULL;
+    }
+    if (!record_is_current(log_slot_record(flash_offset, settings_log.live_slot))) {
+        LOG_WARN("Settings record has old version - settings_load() must migrate it first");
+        return NULL;
+    }
+    return &log_slot_record(flash_offset, settings_log.live_slot)->data;
+}
 
-    if (!write_flash_sector(flash_offset, flash_buffer, FLASH_SECTOR_SIZE)) {
+bool settings_view_wifi_pass(const settings_t *view, char *buf, size_t len) {
+    if (!view || !buf || len == 0) {
+        LOG_ERROR("Invalid arguments passed to settings_view_wifi_pass");
         return false;
     }
 
-    LOG_INFO("Settings saved successfully to offset 0x%08X", flash_offset);
+    // Запись ChaCha20-Poly1305: расшифровывается только поле пароля (тег проверен при сканировании)
+    const settings_record_t *rec = (const settings_record_t *)((const uint8_t *)view - offsetof(settings_record_t, data));
+    if (rec->protect == SETTINGS_PROTECT_AEAD && (view->flags & FLAG_SETTINGS_ENCRYPTED)) {
+        char pass[WIFI_PASS_MAX_LEN];
+        uint8_t nonce[AEAD_NONCE_LEN];
+        aead_ctx_t ctx;
+        record_nonce(rec, nonce);
+        aead_init(&ctx, settings_aead_key(), nonce);
+        aead_decrypt(&ctx, (uint8_t *)pass, (const uint8_t *)view->wifi_pass, WIFI_PASS_MAX_LEN);
+        memset(&ctx, 0, sizeof(ctx));
+        size_t real_len = strnlen(pass, WIFI_PASS_MAX_LEN);
+        bool fits = real_len < len;
+        if (fits) {
+            memcpy(buf, pass, real_len);
+            buf[real_len] = '\0';
+        }
+        memset(pass, 0, sizeof(pass));
+        if (!fits) {
+            LOG_ERROR("Buffer too small for WiFi password (%u bytes needed)", (unsigned)(real_len + 1));
+        }
+        return fits;
+    }
+
+    size_t real_len = strnlen(view->wifi_pass, WIFI_PASS_MAX_LEN);
+    if (real_len >= len) {
+        LOG_ERROR("Buffer too small for WiFi password (%u bytes needed)", (unsigned)(real_len + 1));
+        return false;
+    }
+    memcpy(buf, view->wifi_pass, real_len);
+    buf[real_len] = '\0';
+    if (view->flags & FLAG_SETTINGS_ENCRYPTED) {
+        xor_wifi_pass(buf, real_len);
+    }
     return true;
-}
\ No newline at end of file
+}
+
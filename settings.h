@@ -5,10 +5,13 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <assert.h>
+#include "hardware/flash.h"
 
 // Константы
 #define SETTINGS_MAGIC          0xCAFE0000  ///< Уникальный идентификатор структуры
-#define SETTINGS_VERSION        0x0100      ///< Версия структуры
+#define SETTINGS_VERSION        0x0100      ///< Версия структуры (старые версии обновляются, см. settings_migrate.h)
 #define NTP_MAX_SERVERS         4          ///< Максимальное количество NTP-серверов
 #define WIFI_SSID_MAX_LEN       32         ///< Максимальная длина SSID (31 символ + \0)
 #define WIFI_PASS_MAX_LEN       64         ///< Максимальная длина пароля (63 символа + \0)
@@ -19,6 +22,23 @@
 #define HOUR_MAX                23         ///< Максимальное значение часа
 #define CRC32_ERROR             0xFFFFFFFF ///< Значение CRC32 при ошибке вычисления
 
+// Защита записи журнала (settings_record_t.protect)
+#define SETTINGS_PROTECT_CRC    0xFFFFFFFF ///< CRC32 и XOR-шифрование пароля (формат до ChaCha20-Poly1305)
+#define SETTINGS_PROTECT_AEAD   0x44414541 ///< ChaCha20-Poly1305: шифрование пароля и тег для всей записи
+#define SETTINGS_NONCE_LEN      8          ///< Случайная часть nonce в записи (остальное - seq)
+#define SETTINGS_TAG_LEN        16         ///< Длина тега аутентификации
+
+#ifdef SETTINGS_AEAD
+#define SETTINGS_PROTECT_DEFAULT SETTINGS_PROTECT_AEAD
+#else
+#define SETTINGS_PROTECT_DEFAULT SETTINGS_PROTECT_CRC
+#endif
+
+// Журнал настроек (кольцо секторов)
+#ifndef SETTINGS_LOG_SECTORS
+#define SETTINGS_LOG_SECTORS    4          ///< Количество секторов в кольце журнала настроек
+#endif
+
 // Флаги для settings_t.flags
 #define FLAG_ADAPTIVE_BRIGHTNESS 0x01      ///< Адаптивная яркость
 #define FLAG_NIGHT_MODE         0x02       ///< Ночной режим
@@ -31,36 +51,105 @@
 #define ANIM_FLAG_4             0x08       ///< Анимация 4
 #define ANIM_FLAG_LAGS          0x10       ///< Включение задержек
 
+// Флаги по умолчанию: шифрование пароля задаётся при сборке
+#ifdef ENCRYPT_WIFI_PASS
+#define SETTINGS_DEFAULT_FLAGS  FLAG_SETTINGS_ENCRYPTED
+#else
+#define SETTINGS_DEFAULT_FLAGS  0
+#endif
+
 #ifdef __GNUC__
 #pragma pack(push, 1)  // Выравнивание 1 байт для Pico SDK
 #else
 #error "Unsupported compiler: only GCC is supported due to #pragma pack requirement"
 #endif
 
+/*
+ * Схема настроек - единственный список полей. Из него строятся структура settings_t, образ
+ * значений по умолчанию, проверка диапазонов и длин, поэлементное сравнение и печать
+ * (settings_schema.c). Порядок полей задаёт раскладку записи во флеш-памяти: поля добавляются
+ * только перед crc32 вместе с новой версией структуры (см. settings_migrate.h).
+ *
+ *   NUM(тип, имя, минимум, максимум, по умолчанию, признаки, вид печати, подпись)
+ *   STR(имя, размер буфера, по умолчанию, признаки, подпись)
+ *   STRS(имя, количество, размер буфера, по умолчанию для первой строки, признаки, подпись)
+ *
+ * magic, version и size допускают единственное значение; пароль WiFi зашифрован XOR, если
+ * установлен FLAG_SETTINGS_ENCRYPTED; crc32 заполняется при записи в журнал.
+ */
+#define SETTINGS_SCHEMA(NUM, STR, STRS) \
+    NUM(uint32_t, magic, SETTINGS_MAGIC, SETTINGS_MAGIC, SETTINGS_MAGIC, SETTINGS_FIELD_META, \
+        SETTINGS_FMT_HEX, "Magic Number") \
+    NUM(uint16_t, version, SETTINGS_VERSION, SETTINGS_VERSION, SETTINGS_VERSION, SETTINGS_FIELD_META, \
+        SETTINGS_FMT_HEX, "Version") \
+    NUM(uint16_t, size, sizeof(settings_t), sizeof(settings_t), sizeof(settings_t), SETTINGS_FIELD_META, \
+        SETTINGS_FMT_BYTES, "Settings Size") \
+    STR(wifi_ssid, WIFI_SSID_MAX_LEN, DEFAULT_SSID, 0, "WiFi SSID") \
+    STR(wifi_pass, WIFI_PASS_MAX_LEN, DEFAULT_PASS, 0, "WiFi Password") \
+    NUM(uint8_t, brightness, BRIGHTNESS_MIN, BRIGHTNESS_MAX, 50, 0, SETTINGS_FMT_PERCENT, "Brightness") \
+    NUM(uint8_t, flags, 0, UINT8_MAX, SETTINGS_DEFAULT_FLAGS, 0, SETTINGS_FMT_FLAGS, "Flags") \
+    NUM(uint8_t, night_off_hour, HOUR_MIN, HOUR_MAX, 22, 0, SETTINGS_FMT_HOUR, "Night Off Hour") \
+    NUM(uint8_t, night_on_hour, HOUR_MIN, HOUR_MAX, 6, 0, SETTINGS_FMT_HOUR, "Night On Hour") \
+    NUM(uint16_t, anim_flags, 0, UINT16_MAX, 0, 0, SETTINGS_FMT_ANIM, "Animations") \
+    NUM(uint16_t, anim_lags_period_s, 0, UINT16_MAX, 5, 0, SETTINGS_FMT_SEC, "Anim Lags Period") \
+    STRS(ntp_servers, NTP_MAX_SERVERS, NTP_SERVER_MAX_LEN, DEFAULT_NTP_SERVER, 0, "NTP Servers") \
+    NUM(uint16_t, ntp_sync_period_minutes, 0, UINT16_MAX, 60, 0, SETTINGS_FMT_MIN, "NTP Sync Period") \
+    NUM(uint32_t, crc32, 0, UINT32_MAX, 0, SETTINGS_FIELD_META, SETTINGS_FMT_HEX, "CRC32")
+
+// Признаки полей схемы
+#define SETTINGS_FIELD_META     0x01       ///< Служебное поле (не входит в SETTINGS_USER_FIELDS)
+
+// Вид печати числовых полей (settings_print)
+#define SETTINGS_FMT_DEC        0          ///< Десятичное число
+#define SETTINGS_FMT_HEX        1          ///< Шестнадцатеричное число во всю ширину типа
+#define SETTINGS_FMT_BYTES      2          ///< Размер в байтах
+#define SETTINGS_FMT_PERCENT    3          ///< Проценты
+#define SETTINGS_FMT_HOUR       4          ///< Час суток (ЧЧ:00)
+#define SETTINGS_FMT_SEC        5          ///< Секунды
+#define SETTINGS_FMT_MIN        6          ///< Минуты
+#define SETTINGS_FMT_FLAGS      7          ///< Признаки FLAG_* (строка на каждый вместо подписи)
+#define SETTINGS_FMT_ANIM       8          ///< Отметки анимаций ANIM_FLAG_*
+
+#define SETTINGS_STRUCT_NUM(type, name, min, max, def, attr, fmt, label)     type name;
+#define SETTINGS_STRUCT_STR(name, len, def, attr, label)                     char name[len];
+#define SETTINGS_STRUCT_STRS(name, count, len, def, attr, label)             char name[count][len];
+
 /**
- * @brief Структура настроек, сохраняемая во флеш-памяти
+ * @brief Структура настроек, сохраняемая во флеш-памяти (поля - SETTINGS_SCHEMA)
  */
 typedef struct {
-    uint32_t magic;                         ///< Уникальный идентификатор (SETTINGS_MAGIC)
-    uint16_t version;                       ///< Версия структуры (SETTINGS_VERSION)
-    uint16_t size;                          ///< Размер структуры для масштабируемости
-    char wifi_ssid[WIFI_SSID_MAX_LEN];      ///< WiFi SSID
-    char wifi_pass[WIFI_PASS_MAX_LEN];      ///< WiFi пароль (зашифрован с XOR и SETTINGS_MAGIC, если FLAG_SETTINGS_ENCRYPTED установлен)
-    uint8_t brightness;                     ///< Уровень яркости (0-100)
-    uint8_t flags;                          ///< Биты: 0 - адаптивная яркость, 1 - ночной режим, 2 - шифрование пароля
-    uint8_t night_off_hour;                 ///< Час выключения ночного режима (0-23)
-    uint8_t night_on_hour;                  ///< Час включения ночного режима (0-23)
-    uint16_t anim_flags;                    ///< Флаги анимаций (см. ANIM_FLAG_*)
-    uint16_t anim_lags_period_s;            ///< Период задержек анимации в секундах
-    char ntp_servers[NTP_MAX_SERVERS][NTP_SERVER_MAX_LEN]; ///< Адреса NTP-серверов
-    uint16_t ntp_sync_period_minutes;       ///< Период синхронизации NTP в минутах
-    uint32_t crc32;                         ///< CRC32 для проверки целостности
+    SETTINGS_SCHEMA(SETTINGS_STRUCT_NUM, SETTINGS_STRUCT_STR, SETTINGS_STRUCT_STRS)
 } settings_t;
 
+/**
+ * @brief Запись журнала настроек во флеш-памяти
+ *
+ * Каждое сохранение добавляет новую запись в следующий свободный слот кольца.
+ * Актуальной считается валидная запись с наибольшим порядковым номером.
+ */
+typedef struct {
+    uint32_t seq;                           ///< Порядковый номер записи (растёт с каждым сохранением)
+    uint32_t seq_inv;                       ///< Инверсия seq для проверки целостности заголовка
+    settings_t data;                        ///< Сохранённые настройки
+    uint32_t protect;                       ///< Способ защиты записи (SETTINGS_PROTECT_*)
+    uint8_t nonce[SETTINGS_NONCE_LEN];      ///< Случайная часть nonce (для SETTINGS_PROTECT_AEAD)
+    uint8_t tag[SETTINGS_TAG_LEN];          ///< Тег Poly1305 (для SETTINGS_PROTECT_AEAD)
+} settings_record_t;
+
 #ifdef __GNUC__
 #pragma pack(pop)
 #endif
 
+/// Размер слота записи, округлённый до страниц флеш-памяти
+#define SETTINGS_RECORD_SLOT_SIZE \
+    (((sizeof(settings_record_t) + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE) * FLASH_PAGE_SIZE)
+/// Количество слотов записей в одном секторе
+#define SETTINGS_SLOTS_PER_SECTOR   (FLASH_SECTOR_SIZE / SETTINGS_RECORD_SLOT_SIZE)
+/// Общий размер области журнала настроек во флеш-памяти
+#define SETTINGS_LOG_SIZE           (SETTINGS_LOG_SECTORS * FLASH_SECTOR_SIZE)
+/// Настройки прошивки до журнала: settings_t в начале последнего сектора (пароль - XOR, CRC32 в конце)
+#define SETTINGS_LEGACY_OFFSET      (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
+
 /**
  * @brief Инициализация структуры настроек значениями по умолчанию
  * @param cfg Указатель на структуру настроек
@@ -69,22 +158,137 @@ void settings_init_default(settings_t *cfg);
 
 /**
  * @brief Загрузка настроек из флеш-памяти
+ *
+ * Просматривает заголовки всех слотов журнала и загружает самую новую валидную запись.
+ * Запись старой версии обновляется до текущей и однократно сохраняется обратно в журнал.
+ * Если в журнале нет валидной записи, загружаются настройки прошивки до журнала
+ * (SETTINGS_LEGACY_OFFSET) и сохраняются первой записью; их сектор не стирается, пока
+ * перенос не выполнен, и стирается сразу после него.
  * @param cfg Указатель на структуру для загрузки
- * @param flash_offset Смещение во флеш-памяти
+ * @param flash_offset Смещение начала журнала во флеш-памяти (выровнено по FLASH_SECTOR_SIZE)
  * @return true если загрузка успешна, false в противном случае
  */
 bool settings_load(settings_t *cfg, const uint32_t flash_offset);
 
+/**
+ * @brief Поколение настроек во флеш-памяти - номер актуальной записи журнала
+ * @param flash_offset Смещение начала журнала во флеш-памяти
+ * @return Номер записи, найденной последней загрузкой или записанной последним сохранением;
+ *         0, если записи нет или журнал ещё не просматривался
+ */
+uint32_t settings_generation(const uint32_t flash_offset);
+
+/**
+ * @brief Смещение актуальной записи журнала во флеш-памяти
+ * @param flash_offset Смещение начала журнала во флеш-памяти
+ * @param record_offset Смещение записи с номером settings_generation()
+ * @return false, если записи нет или журнал ещё не просматривался
+ */
+bool settings_live_record_offset(const uint32_t flash_offset, uint32_t *record_offset);
+
 /**
  * @brief Сохранение настроек во флеш-память
+ *
+ * Дописывает новую запись в следующий свободный слот журнала. Сектор стирается
+ * только при переходе кольца на него, когда актуальная запись уже находится впереди.
  * @param cfg Указатель на структуру с настройками
- * @param flash_offset Смещение во флеш-памяти
+ * @param flash_offset Смещение начала журнала во флеш-памяти (выровнено по FLASH_SECTOR_SIZE)
  * @return true если сохранение успешно, false в противном случае
  */
 bool settings_save(const settings_t *cfg, const uint32_t flash_offset);
 
+/**
+ * @brief Подготовка записи журнала из настроек
+ *
+ * Для SETTINGS_PROTECT_AEAD пароль WiFi шифруется (если установлен FLAG_SETTINGS_ENCRYPTED),
+ * а тег вычисляется для всей записи за тот же проход, что и копирование; CRC32 не считается.
+ * Для SETTINGS_PROTECT_CRC пароль шифруется XOR и считается CRC32.
+ * @param rec Запись с заполненным seq (входит в nonce)
+ * @param cfg Настройки (пароль в открытом виде)
+ * @param protect Способ защиты (SETTINGS_PROTECT_*)
+ */
+void settings_record_seal(settings_record_t *rec, const settings_t *cfg, uint32_t protect);
+
+/**
+ * @brief Подготовка записи журнала для другой платы (генерация образов на хосте)
+ *
+ * То же, что settings_record_seal, но ключ выводится из переданного идентификатора, а не из
+ * идентификатора этого устройства; ключ не кэшируется, поэтому вызов можно выполнять из
+ * нескольких потоков.
+ * @param unique_id Уникальный идентификатор платы (FLASH_HAL_UNIQUE_ID_LEN байт, NULL - это устройство)
+ */
+void settings_record_seal_device(settings_record_t *rec, const settings_t *cfg, uint32_t protect,
+                                 const uint8_t *unique_id);
+
+/**
+ * @brief Проверка допустимости значений настроек (как при settings_save)
+ * @param cfg Указатель на настройки
+ * @return true если настройки можно сохранить, false в противном случае
+ */
+bool settings_validate(const settings_t *cfg);
+
+/**
+ * @brief Шифрование блока данных ключом настроек устройства (ChaCha20-Poly1305)
+ * @param nonce Nonce (12 байт, уникальный для каждого вызова)
+ * @param aad Дополнительные аутентифицируемые данные (может быть NULL)
+ * @param aad_len Длина aad
+ * @param data Данные (шифруются на месте)
+ * @param len Длина данных
+ * @param tag Буфер для тега (SETTINGS_TAG_LEN байт)
+ */
+void settings_blob_seal(const uint8_t *nonce, const uint8_t *aad, size_t aad_len,
+                        uint8_t *data, size_t len, uint8_t *tag);
+
+/**
+ * @brief Проверка и расшифровка блока, зашифрованного settings_blob_seal
+ * @return true если тег совпал (data расшифрованы на месте), false в противном случае
+ */
+bool settings_blob_open(const uint8_t *nonce, const uint8_t *aad, size_t aad_len,
+                        uint8_t *data, size_t len, const uint8_t *tag);
+
+/**
+ * @brief Проверка записи журнала и извлечение настроек с расшифровкой пароля
+ * @param rec Запись (во флеш-памяти или в RAM)
+ * @param out Буфер для настроек (NULL - только проверка)
+ * @return true если запись подлинная и целая, false в противном случае
+ */
+bool settings_record_open(const settings_record_t *rec, settings_t *out);
+
+/**
+ * @brief Получение актуальных настроек напрямую из флеш-памяти, без копирования в RAM
+ *
+ * Запись проверяется (тег или CRC32) один раз при старте или при сохранении; последующие вызовы
+ * сверяют только заголовок. Указатель действителен до следующего settings_save().
+ * @param flash_offset Смещение начала журнала во флеш-памяти
+ * @return Указатель на настройки в окне XIP или NULL, если валидной записи текущей версии нет
+ * @note Пароль WiFi в записи хранится зашифрованным, см. settings_view_wifi_pass
+ */
+const settings_t *settings_view(const uint32_t flash_offset);
+
+/**
+ * @brief Расшифровка пароля WiFi из записи во флеш-памяти в буфер вызывающего
+ * @param view Указатель, полученный от settings_view
+ * @param buf Буфер для пароля (с завершающим \0)
+ * @param len Размер буфера (не менее WIFI_PASS_MAX_LEN для любого пароля)
+ * @return true если пароль записан в buf, false в противном случае
+ */
+bool settings_view_wifi_pass(const settings_t *view, char *buf, size_t len);
+
+// Доступ к отдельным полям записи во флеш-памяти
+static inline uint8_t settings_view_brightness(const settings_t *view) { return view->brightness; }
+static inline uint8_t settings_view_flags(const settings_t *view) { return view->flags; }
+static inline uint8_t settings_view_night_off_hour(const settings_t *view) { return view->night_off_hour; }
+static inline uint8_t settings_view_night_on_hour(const settings_t *view) { return view->night_on_hour; }
+static inline uint16_t settings_view_anim_flags(const settings_t *view) { return view->anim_flags; }
+static inline uint16_t settings_view_anim_lags_period_s(const settings_t *view) { return view->anim_lags_period_s; }
+static inline uint16_t settings_view_ntp_sync_period(const settings_t *view) { return view->ntp_sync_period_minutes; }
+static inline const char *settings_view_wifi_ssid(const settings_t *view) { return view->wifi_ssid; }
+static inline const char *settings_view_ntp_server(const settings_t *view, int index) { return view->ntp_servers[index]; }
+
 /**
  * @brief Вычисление CRC32 для данных
+ *
+ * Реализация выбирается при сборке (CRC32_BACKEND, см. crc32.h); результат не зависит от выбора.
  * @param data Указатель на данные
  * @param len Длина данных в байтах
  * @return Вычисленное значение CRC32 или CRC32_ERROR при ошибке ввода (data == NULL или len == 0)
@@ -92,7 +296,9 @@ bool settings_save(const settings_t *cfg, const uint32_t flash_offset);
 uint32_t calculate_crc32(const uint8_t *data, size_t len);
 
 // Проверка размера структуры
-#include "hardware/flash.h"
 static_assert(sizeof(settings_t) <= FLASH_SECTOR_SIZE, "Settings structure too large for flash sector");
+static_assert(sizeof(settings_record_t) <= SETTINGS_RECORD_SLOT_SIZE, "Settings record must fit its slot");
+static_assert(FLASH_SECTOR_SIZE % SETTINGS_RECORD_SLOT_SIZE == 0, "Record slot must evenly divide flash sector");
+static_assert(SETTINGS_LOG_SECTORS >= 2, "Settings log needs at least two sectors to erase safely");
 
 #endif // SETTINGS_H
\ No newline at end of file
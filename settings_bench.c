@@ -0,0 +1,304 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <time.h>
+#include <malloc.h>
+#include <pthread.h>
+#include "pico/stdlib.h"
+#include "settings.h"
+#include "settings_schema.h"
+#include "settings_boot.h"
+#include "settings_codec.h"
+#include "flash_hal.h"
+#include "flash_utils.h"
+#include "crc32.h"
+#include "logging.h"
+
+/*
+ * Бенчмарк настроек и флеш-памяти (только сборка для хоста).
+ *
+ * Каждая операция выполняется в цикле над анонимным образом флеш-памяти,
+ * результат выводится одним JSON-объектом (в stdout или в файл из первого аргумента)
+ * для отслеживания регрессий.
+ * Количество секторов журнала задаётся при сборке (SETTINGS_LOG_SECTORS),
+ * поэтому CMake собирает по программе на каждое значение из SETTINGS_BENCH_SECTORS.
+ */
+
+#define FLASH_OFFSET        (PICO_FLASH_SIZE_BYTES - SETTINGS_LOG_SIZE)
+#define SCRATCH_OFFSET      (FLASH_OFFSET - FLASH_SECTOR_SIZE)   ///< Сектор для write_flash_sector
+#define BENCH_MIN_NS        50000000ull     ///< Минимальная длительность одного измерения
+#define BENCH_MAX_ITERATIONS (1u << 24)
+#define BENCH_STACK_SIZE    (256 * 1024)    ///< Стек потока для замера глубины
+#define BENCH_STACK_FILL    0xA5
+
+typedef void (*bench_fn_t)(void *arg);
+
+static uint8_t crc_buf[16 * 1024];
+static uint8_t sector_buf[2][FLASH_SECTOR_SIZE];
+static uint8_t codec_buf[SETTINGS_CODEC_MAX_LEN];
+static settings_t bench_cfg;
+static volatile uint32_t sink;              // Не даёт компилятору выбросить результат
+static uint32_t counter;
+static bool bench_ok = true;
+static bool first_result = true;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// ---- Измеряемые операции ----
+
+static void op_crc32(void *arg) {
+    sink += calculate_crc32(crc_buf, (size_t)(uintptr_t)arg);
+}
+
+static void op_init_default(void *arg) {
+    (void)arg;
+    settings_init_default(&bench_cfg);
+    sink += bench_cfg.brightness;
+}
+
+static void op_validate(void *arg) {
+    (void)arg;
+    sink += settings_validate(&bench_cfg);
+}
+
+static void op_diff(void *arg) {
+    sink += settings_diff(&bench_cfg, (const settings_t *)arg);
+}
+
+static void op_save(void *arg) {
+    (void)arg;
+    bench_cfg.brightness = (uint8_t)(counter++ % (BRIGHTNESS_MAX + 1));
+    bench_ok &= settings_save(&bench_cfg, FLASH_OFFSET);
+}
+
+static void op_load(void *arg) {
+    (void)arg;
+    settings_t loaded;
+    bench_ok &= settings_load(&loaded, FLASH_OFFSET);
+    sink += loaded.crc32;
+}
+
+static void op_view(void *arg) {
+    (void)arg;
+    const settings_t *view = settings_view(FLASH_OFFSET);
+    bench_ok &= view != NULL;
+    sink += view ? view->crc32 : 0;
+}
+
+static void op_boot_load(void *arg) {
+    if (arg) {
+        settings_boot_invalidate();  // Холодный старт: кэш в RAM недействителен
+    }
+    settings_t loaded;
+    bench_ok &= settings_boot_load(&loaded, FLASH_OFFSET);
+    sink += loaded.crc32;
+}
+
+static void op_write_sector(void *arg) {
+    (void)arg;
+    // Чередование образов: каждая запись требует стирания и программирования
+    bench_ok &= write_flash_sector(SCRATCH_OFFSET, sector_buf[counter++ & 1], FLASH_SECTOR_SIZE);
+}
+
+static void op_encode(void *arg) {
+    (void)arg;
+    sink += (uint32_t)settings_encode(&bench_cfg, codec_buf, sizeof(codec_buf));
+}
+
+static void op_decode(void *arg) {
+    settings_t decoded;
+    bench_ok &= settings_decode(codec_buf, (size_t)(uintptr_t)arg, &decoded);
+    sink += decoded.crc32;
+}
+
+static void op_empty(void *arg) {
+    (void)arg;
+}
+
+// ---- Замер глубины стека ----
+
+typedef struct {
+    bench_fn_t fn;
+    void *arg;
+} stack_job_t;
+
+static void *stack_thread(void *param) {
+    stack_job_t *job = param;
+    job->fn(job->arg);
+    return NULL;
+}
+
+// Максимальная глубина стека потока, выполнившего fn один раз. Стек заполняется
+// шаблоном, после завершения ищется самый глубокий изменённый байт.
+static size_t stack_depth(bench_fn_t fn, void *arg) {
+    void *stack;
+    if (posix_memalign(&stack, 4096, BENCH_STACK_SIZE) != 0) {
+        return 0;
+    }
+    memset(stack, BENCH_STACK_FILL, BENCH_STACK_SIZE);
+
+    pthread_attr_t attr;
+    pthread_t thread;
+    stack_job_t job = { fn, arg };
+    size_t depth = 0;
+    pthread_attr_init(&attr);
+    if (pthread_attr_setstack(&attr, stack, BENCH_STACK_SIZE) == 0 &&
+        pthread_create(&thread, &attr, stack_thread, &job) == 0) {
+        pthread_join(thread, NULL);
+        const uint8_t *bytes = stack;
+        size_t untouched = 0;
+        while (untouched < BENCH_STACK_SIZE && bytes[untouched] == BENCH_STACK_FILL) {
+            untouched++;
+        }
+        depth = BENCH_STACK_SIZE - untouched;
+    }
+    pthread_attr_destroy(&attr);
+    free(stack);
+    return depth;
+}
+
+// Глубина стека потока без полезной нагрузки (TLS, дескриптор потока)
+static size_t stack_baseline;
+
+// ---- Прогон и вывод ----
+
+static size_t heap_in_use(void) {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    return mallinfo2().uordblks;
+#else
+    return (size_t)mallinfo().uordblks;
+#endif
+}
+
+static void json_string(const char *key, const char *value, bool comma) {
+    printf("\"%s\": \"%s\"%s", key, value, comma ? ", " : "");
+}
+
+static void bench_run(const char *name, size_t bytes, bench_fn_t fn, void *arg) {
+    // Прогрев и замер выделений кучи на одном вызове
+    size_t heap_before = heap_in_use();
+    fn(arg);
+    size_t heap_after = heap_in_use();
+    size_t heap = heap_after > heap_before ? heap_after - heap_before : 0;
+
+    // Удвоение числа повторов до минимальной длительности измерения
+    uint32_t iterations = 1;
+    uint64_t elapsed;
+    for (;;) {
+        uint64_t start = now_ns();
+        for (uint32_t i = 0; i < iterations; i++) {
+            fn(arg);
+        }
+        elapsed = now_ns() - start;
+        if (elapsed >= BENCH_MIN_NS || iterations >= BENCH_MAX_ITERATIONS) {
+            break;
+        }
+        iterations *= 2;
+    }
+
+    size_t depth = stack_depth(fn, arg);
+    size_t stack = depth > stack_baseline ? depth - stack_baseline : 0;
+    double ns_per_op = (double)elapsed / iterations;
+    double bytes_per_s = bytes ? (double)bytes * 1e9 / ns_per_op : 0.0;
+
+    printf("%s\n    {", first_result ? "" : ",");
+    json_string("name", name, true);
+    printf("\"bytes\": %zu, \"iterations\": %u, \"ns_per_op\": %.1f, \"bytes_per_s\": %.0f, "
+           "\"stack_bytes\": %zu, \"heap_bytes\": %zu}",
+           bytes, iterations, ns_per_op, bytes_per_s, stack, heap);
+    first_result = false;
+}
+
+// Повреждение последней записи: загрузка уходит в полное сканирование журнала
+static bool damage_newest(void) {
+    const settings_t *view = settings_view(FLASH_OFFSET);
+    if (!view) {
+        return false;
+    }
+    uint32_t slot = (uint32_t)((const uint8_t *)view - flash_hal_xip_ptr(0) - offsetof(settings_record_t, data));
+    static uint8_t zero_page[FLASH_PAGE_SIZE];
+    return program_flash_pages(slot + FLASH_PAGE_SIZE, zero_page, FLASH_PAGE_SIZE);
+}
+
+static bool fill_log(size_t records) {
+    for (size_t i = 0; i < records; i++) {
+        bench_cfg.brightness = (uint8_t)(i % (BRIGHTNESS_MAX + 1));
+        if (!settings_save(&bench_cfg, FLASH_OFFSET)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && !freopen(argv[1], "w", stdout)) {
+        perror(argv[1]);
+        return 1;
+    }
+    if (!flash_hal_host_open(NULL)) {
+        fprintf(stderr, "Flash image unavailable\n");
+        return 1;
+    }
+    for (size_t i = 0; i < sizeof(crc_buf); i++) {
+        crc_buf[i] = (uint8_t)(i * 31 + 7);
+    }
+    memset(sector_buf[0], 0x00, FLASH_SECTOR_SIZE);
+    memset(sector_buf[1], 0x5A, FLASH_SECTOR_SIZE);
+    settings_init_default(&bench_cfg);
+    snprintf(bench_cfg.wifi_pass, WIFI_PASS_MAX_LEN, "%s", "BenchPassword123");
+    stack_baseline = stack_depth(op_empty, NULL);
+
+    printf("{\n  ");
+    json_string("backend", crc32_backend_name(), true);
+    printf("\"log_sectors\": %u, \"slot_size\": %u, \"record_size\": %zu, \"settings_size\": %zu,\n",
+           (unsigned)SETTINGS_LOG_SECTORS, (unsigned)SETTINGS_RECORD_SLOT_SIZE,
+           sizeof(settings_record_t), sizeof(settings_t));
+    printf("  \"results\": [");
+
+    // Масштабирование CRC32 по размеру данных
+    static const size_t crc_sizes[] = { 16, 64, 256, sizeof(settings_t), 1024, 4096, sizeof(crc_buf) };
+    for (size_t i = 0; i < sizeof(crc_sizes) / sizeof(crc_sizes[0]); i++) {
+        char name[40];
+        snprintf(name, sizeof(name), "calculate_crc32/%zu", crc_sizes[i]);
+        bench_run(name, crc_sizes[i], op_crc32, (void *)(uintptr_t)crc_sizes[i]);
+    }
+
+    bench_run("settings_init_default", sizeof(settings_t), op_init_default, NULL);
+    settings_init_default(&bench_cfg);
+    snprintf(bench_cfg.wifi_pass, WIFI_PASS_MAX_LEN, "%s", "BenchPassword123");
+    bench_run("settings_validate", sizeof(settings_t), op_validate, NULL);
+    bench_run("settings_diff", sizeof(settings_t), op_diff, (void *)&settings_default_image);
+
+    size_t encoded = settings_encode(&bench_cfg, codec_buf, sizeof(codec_buf));
+    bench_run("settings_encode", encoded, op_encode, NULL);
+    bench_run("settings_decode", encoded, op_decode, (void *)(uintptr_t)encoded);
+
+    // Журнал: сохранение с переходами по кольцу, загрузка и просмотр
+    bench_ok &= erase_flash_sector(SCRATCH_OFFSET);
+    for (uint32_t s = 0; s < SETTINGS_LOG_SECTORS; s++) {
+        bench_ok &= erase_flash_sector(FLASH_OFFSET + s * FLASH_SECTOR_SIZE);
+    }
+    bench_run("settings_save", SETTINGS_RECORD_SLOT_SIZE, op_save, NULL);
+    bench_ok &= fill_log(SETTINGS_LOG_SECTORS * SETTINGS_SLOTS_PER_SECTOR);
+    bench_run("settings_load", sizeof(settings_record_t), op_load, NULL);
+    bench_run("settings_view", sizeof(settings_t), op_view, NULL);
+    bench_run("settings_boot_load/cold", sizeof(settings_record_t), op_boot_load, (void *)1);
+    bench_run("settings_boot_load/warm", sizeof(settings_t), op_boot_load, NULL);
+
+    // Полное сканирование журнала растёт с количеством секторов
+    bench_ok &= damage_newest();
+    bench_run("settings_load/full_scan", SETTINGS_LOG_SIZE, op_load, NULL);
+
+    bench_run("write_flash_sector", FLASH_SECTOR_SIZE, op_write_sector, NULL);
+
+    printf("\n  ],\n  \"ok\": %s\n}\n", bench_ok ? "true" : "false");
+    log_flush();
+    flash_hal_host_close();
+    return bench_ok ? 0 : 1;
+}
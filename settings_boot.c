@@ -0,0 +1,94 @@
+#include <string.h>
+#include "pico/stdlib.h"
+#include "settings_boot.h"
+#include "settings_shared.h"
+#include "flash_hal.h"
+#include "crc32.h"
+#include "logging.h"
+
+#define SETTINGS_BOOT_MAGIC     0x544F4F42  // "BOOT"
+// Кэш другой версии прошивки с иной структурой настроек не принимается
+#define SETTINGS_BOOT_LAYOUT    ((uint32_t)SETTINGS_VERSION << 16 | (uint32_t)sizeof(settings_t))
+
+typedef struct {
+    uint32_t magic;
+    uint32_t flash_offset;                  // Журнал, из которого получены настройки
+    uint32_t generation;                    // Номер записи журнала
+    uint32_t record_offset;                 // Смещение этой записи во флеш-памяти
+    uint32_t layout;
+    settings_t cfg;                         // Без пароля WiFi: кэш переживает сброс
+    uint32_t crc;                           // CRC32 всех предыдущих полей
+} settings_boot_cache_t;
+
+// Не обнуляется стартовым кодом: переживает программный сброс и сброс сторожевым таймером
+static settings_boot_cache_t __uninitialized_ram(boot_cache);
+static settings_boot_stats_t boot_stats;
+
+static uint32_t boot_cache_crc(void) {
+    return crc32_compute((const uint8_t *)&boot_cache, offsetof(settings_boot_cache_t, crc));
+}
+
+// Кэш соответствует флеш-памяти, если актуальная запись на прежнем месте и с прежним номером
+static const settings_record_t *boot_cache_record(uint32_t flash_offset) {
+    if (boot_cache.magic != SETTINGS_BOOT_MAGIC || boot_cache.flash_offset != flash_offset ||
+        boot_cache.layout != SETTINGS_BOOT_LAYOUT || boot_cache.generation == 0 ||
+        boot_cache.record_offset - flash_offset >= SETTINGS_LOG_SIZE || boot_cache.crc != boot_cache_crc()) {
+        return NULL;
+    }
+    const settings_record_t *rec = (const settings_record_t *)flash_hal_xip_ptr(boot_cache.record_offset);
+    bool current = rec->seq == boot_cache.generation && rec->data.version == SETTINGS_VERSION &&
+                   rec->data.size == sizeof(settings_t);
+    return current ? rec : NULL;
+}
+
+void settings_boot_invalidate(void) {
+    boot_cache.magic = 0;
+}
+
+bool settings_boot_load(settings_t *cfg, const uint32_t flash_offset) {
+    if (!cfg) {
+        LOG_ERROR("Null pointer passed to settings_boot_load");
+        return false;
+    }
+
+    uint64_t start = time_us_64();
+    const settings_record_t *rec = boot_cache_record(flash_offset);
+    bool warm = false;
+    if (rec) {
+        memcpy(cfg, &boot_cache.cfg, sizeof(*cfg));
+        warm = settings_view_wifi_pass(&rec->data, cfg->wifi_pass, WIFI_PASS_MAX_LEN);
+    }
+    if (!warm) {
+        settings_boot_invalidate();
+        if (!settings_load(cfg, flash_offset)) {
+            return false;
+        }
+        // Поколение берётся после загрузки: мигрированная запись уже сохранена заново
+        uint32_t generation = settings_generation(flash_offset);
+        uint32_t record_offset;
+        if (generation != 0 && settings_live_record_offset(flash_offset, &record_offset)) {
+            boot_cache.flash_offset = flash_offset;
+            boot_cache.generation = generation;
+            boot_cache.record_offset = record_offset;
+            boot_cache.layout = SETTINGS_BOOT_LAYOUT;
+            memcpy(&boot_cache.cfg, cfg, sizeof(*cfg));
+            memset(boot_cache.cfg.wifi_pass, 0, WIFI_PASS_MAX_LEN);
+            boot_cache.magic = SETTINGS_BOOT_MAGIC;
+            boot_cache.crc = boot_cache_crc();
+        }
+    }
+
+    uint64_t now = time_us_64();
+    boot_stats.warm = warm;
+    boot_stats.generation = warm ? boot_cache.generation : settings_generation(flash_offset);
+    boot_stats.load_us = (uint32_t)(now - start);
+    boot_stats.ready_us = now;
+    LOG_INFO("Settings ready from %s in %u us (generation %u)", warm ? "RAM cache" : "flash",
+             (unsigned)boot_stats.load_us, (unsigned)boot_stats.generation);
+    settings_shared_publish(cfg);
+    return true;
+}
+
+void settings_boot_get_stats(settings_boot_stats_t *stats) {
+    *stats = boot_stats;
+}
@@ -0,0 +1,51 @@
+#ifndef SETTINGS_BOOT_H
+#define SETTINGS_BOOT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "settings.h"
+
+/*
+ * Кэш настроек, переживающий программный сброс.
+ *
+ * Проверенная копия settings_t без пароля WiFi хранится в секции .uninitialized_data, которую
+ * стартовый код не обнуляет. После сброса сторожевым таймером или программного сброса
+ * settings_boot_load() берёт настройки из кэша без просмотра журнала и проверки записи. Кэш защищён
+ * магическим числом и CRC32 и помечен поколением - номером записи журнала, из которой он получен,
+ * и её смещением. Кэш принимается, только если по этому смещению во флеш-памяти лежит запись с тем же
+ * номером, поэтому запись журнала в обход settings_save (образ настроек, программатор) его отменяет.
+ * Пароль расшифровывается из этой записи. Любое сохранение настроек сбрасывает кэш; после включения
+ * питания содержимое RAM случайно и не проходит проверку.
+ */
+
+/**
+ * @brief Сведения о последней загрузке настроек при старте
+ */
+typedef struct {
+    bool warm;                              ///< Настройки взяты из кэша в RAM
+    uint32_t generation;                    ///< Номер записи журнала, из которой получены настройки
+    uint32_t load_us;                       ///< Длительность settings_boot_load, мкс
+    uint64_t ready_us;                      ///< Время готовности настроек от сброса, мкс
+} settings_boot_stats_t;
+
+/**
+ * @brief Загрузка настроек при старте: из кэша в RAM или из журнала во флеш-памяти
+ * @param cfg Указатель на структуру для загрузки
+ * @param flash_offset Смещение начала журнала во флеш-памяти
+ * @return true если настройки загружены, false если в журнале нет валидной записи
+ * @note При загрузке из флеш-памяти кэш заполняется для следующего программного сброса;
+ *       загруженные настройки публикуются для второго ядра (settings_shared_publish)
+ */
+bool settings_boot_load(settings_t *cfg, const uint32_t flash_offset);
+
+/**
+ * @brief Сброс кэша (вызывается settings_save перед записью)
+ */
+void settings_boot_invalidate(void);
+
+/**
+ * @brief Сведения о последнем вызове settings_boot_load
+ */
+void settings_boot_get_stats(settings_boot_stats_t *stats);
+
+#endif // SETTINGS_BOOT_H
@@ -0,0 +1,287 @@
+#include <string.h>
+#include "settings_codec.h"
+#include "settings_schema.h"
+#include "logging.h"
+
+// Типы значений (младшие 3 бита ключа)
+#define WIRE_VARINT     0
+#define WIRE_FIXED32    5
+#define WIRE_BYTES      2
+
+// Номер поля - номер в схеме + 1 (до 15 - ключ занимает один байт). Поля добавляются только перед
+// crc32, поэтому номера остальных полей не меняются, а crc32 всегда кодируется номером 15.
+#define FIELD_CRC32     15
+
+static_assert(SETTINGS_ID_crc32 + 1 <= FIELD_CRC32, "Field numbers must not reach the CRC32 field number");
+static_assert(SETTINGS_ID_crc32 == SETTINGS_FIELD_COUNT - 1, "CRC32 must be the last schema field");
+
+static inline uint32_t field_number(size_t id) {
+    return id == SETTINGS_ID_crc32 ? FIELD_CRC32 : (uint32_t)id + 1;
+}
+
+// Номер в схеме по номеру поля; SETTINGS_FIELD_COUNT - поле более новой версии формата
+static inline size_t field_id(uint32_t number) {
+    if (number == FIELD_CRC32) {
+        return SETTINGS_ID_crc32;
+    }
+    return (number >= 1 && number <= SETTINGS_ID_crc32) ? number - 1 : SETTINGS_FIELD_COUNT;
+}
+
+// Четырёхбайтовые беззнаковые поля (magic, CRC32) кодируются без сжатия
+static inline bool field_fixed32(const settings_field_t *field) {
+    return field->kind == SETTINGS_KIND_UINT && field->size == sizeof(uint32_t);
+}
+
+// Запись в буфер с учётом границы; при переполнении pos продолжает расти для расчёта размера
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    size_t pos;
+} codec_writer_t;
+
+static void put_byte(codec_writer_t *w, uint8_t byte) {
+    if (w->buf && w->pos < w->len) {
+        w->buf[w->pos] = byte;
+    }
+    w->pos++;
+}
+
+static void put_varint(codec_writer_t *w, uint32_t value) {
+    while (value >= 0x80) {
+        put_byte(w, (uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    put_byte(w, (uint8_t)value);
+}
+
+static void put_uint(codec_writer_t *w, uint8_t field, uint32_t value) {
+    if (value != 0) {
+        put_byte(w, (uint8_t)(field << 3 | WIRE_VARINT));
+        put_varint(w, value);
+    }
+}
+
+static void put_fixed32(codec_writer_t *w, uint8_t field, uint32_t value) {
+    if (value != 0) {
+        put_byte(w, (uint8_t)(field << 3 | WIRE_FIXED32));
+        for (int i = 0; i < 4; i++) {
+            put_byte(w, (uint8_t)(value >> (8 * i)));
+        }
+    }
+}
+
+// Строковый буфер кодируется до последнего ненулевого байта: совпадение побайтное,
+// включая возможный мусор после завершающего нуля
+static void put_buffer(codec_writer_t *w, uint8_t field, int index, const char *str, size_t size) {
+    size_t used = size;
+    while (used > 0 && str[used - 1] == '\0') {
+        used--;
+    }
+    if (used == 0) {
+        return;
+    }
+    put_byte(w, (uint8_t)(field << 3 | WIRE_BYTES));
+    put_varint(w, (uint32_t)(used + (index >= 0)));
+    if (index >= 0) {
+        put_byte(w, (uint8_t)index);
+    }
+    for (size_t i = 0; i < used; i++) {
+        put_byte(w, (uint8_t)str[i]);
+    }
+}
+
+static uint32_t load_uint(const uint8_t *p, size_t size) {
+    switch (size) {
+    case 1: return p[0];
+    case 2: { uint16_t v; memcpy(&v, p, sizeof(v)); return v; }
+    default: { uint32_t v; memcpy(&v, p, sizeof(v)); return v; }
+    }
+}
+
+// Поля кодируются по таблице схемы (settings_fields) в порядке схемы
+static size_t encode(const settings_t *cfg, uint8_t *buf, size_t len) {
+    codec_writer_t w = { buf, len, 0 };
+    for (size_t id = 0; id < SETTINGS_FIELD_COUNT; id++) {
+        const settings_field_t *field = &settings_fields[id];
+        const uint8_t *src = (const uint8_t *)cfg + field->offset;
+        uint8_t number = (uint8_t)field_number(id);
+        switch (field->kind) {
+        case SETTINGS_KIND_UINT: {
+            uint32_t value = load_uint(src, field->size);
+            if (field_fixed32(field)) {
+                put_fixed32(&w, number, value);
+            } else {
+                put_uint(&w, number, value);
+            }
+            break;
+        }
+        case SETTINGS_KIND_INT: {
+            // zigzag: небольшие отрицательные значения кодируются одним-двумя байтами
+            uint32_t raw = load_uint(src, field->size);
+            int32_t value = field->size == 1 ? (int8_t)raw : field->size == 2 ? (int16_t)raw : (int32_t)raw;
+            put_uint(&w, number, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+            break;
+        }
+        case SETTINGS_KIND_STR:
+            put_buffer(&w, number, -1, (const char *)src, field->size);
+            break;
+        default:
+            for (int i = 0; i < field->count; i++) {
+                put_buffer(&w, number, i, (const char *)src + i * field->size, field->size);
+            }
+            break;
+        }
+    }
+    return w.pos;
+}
+
+size_t settings_encoded_size(const settings_t *cfg) {
+    if (!cfg) {
+        LOG_ERROR("Null pointer passed to settings_encoded_size");
+        return 0;
+    }
+    return encode(cfg, NULL, 0);
+}
+
+size_t settings_encode(const settings_t *cfg, uint8_t *buf, size_t len) {
+    if (!cfg || !buf) {
+        LOG_ERROR("Null pointer passed to settings_encode");
+        return 0;
+    }
+
+    size_t size = encode(cfg, buf, len);
+    if (size > len) {
+        LOG_ERROR("Buffer too small for encoded settings (%u bytes needed)", (unsigned)size);
+        return 0;
+    }
+    return size;
+}
+
+static bool get_varint(const uint8_t *buf, size_t len, size_t *pos, uint32_t *value) {
+    *value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (*pos >= len) {
+            return false;
+        }
+        uint8_t byte = buf[(*pos)++];
+        *value |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Целое поле с проверкой диапазона
+static bool set_uint(void *field, size_t field_size, uint32_t value) {
+    if (field_size < sizeof(uint32_t) && value >> (8 * field_size)) {
+        return false;
+    }
+    switch (field_size) {
+    case 1: *(uint8_t *)field = (uint8_t)value; break;
+    case 2: { uint16_t v = (uint16_t)value; memcpy(field, &v, sizeof(v)); break; }
+    default: memcpy(field, &value, sizeof(value)); break;
+    }
+    return true;
+}
+
+// Знаковое поле: zigzag и проверка диапазона
+static bool set_int(void *field, size_t field_size, uint32_t value) {
+    int32_t v = (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+    switch (field_size) {
+    case 1: {
+        if (v < INT8_MIN || v > INT8_MAX) return false;
+        int8_t x = (int8_t)v;
+        memcpy(field, &x, sizeof(x));
+        break;
+    }
+    case 2: {
+        if (v < INT16_MIN || v > INT16_MAX) return false;
+        int16_t x = (int16_t)v;
+        memcpy(field, &x, sizeof(x));
+        break;
+    }
+    default: memcpy(field, &v, sizeof(v)); break;
+    }
+    return true;
+}
+
+// Значение поля схемы: целые - только без длины, строки - только с ней
+static bool set_field(settings_t *cfg, const settings_field_t *field, uint32_t value, const uint8_t *bytes) {
+    uint8_t *dst = (uint8_t *)cfg + field->offset;
+    switch (field->kind) {
+    case SETTINGS_KIND_UINT:
+        return !bytes && set_uint(dst, field->size, value);
+    case SETTINGS_KIND_INT:
+        return !bytes && set_int(dst, field->size, value);
+    case SETTINGS_KIND_STR:
+        if (!bytes || value > field->size) {
+            return false;
+        }
+        memcpy(dst, bytes, value);
+        return true;
+    default:
+        // Индекс строки и её байты
+        if (!bytes || value < 1 || bytes[0] >= field->count || value - 1 > field->size) {
+            return false;
+        }
+        memcpy(dst + bytes[0] * field->size, bytes + 1, value - 1);
+        return true;
+    }
+}
+
+bool settings_decode(const uint8_t *buf, size_t len, settings_t *cfg) {
+    if (!buf || !cfg) {
+        LOG_ERROR("Null pointer passed to settings_decode");
+        return false;
+    }
+
+    memset(cfg, 0, sizeof(settings_t));
+    size_t pos = 0;
+    while (pos < len) {
+        uint32_t key, value = 0;
+        if (!get_varint(buf, len, &pos, &key)) {
+            LOG_ERROR("Truncated field key at %u", (unsigned)pos);
+            return false;
+        }
+        uint32_t field = key >> 3;
+        const uint8_t *bytes = NULL;
+
+        switch (key & 7) {
+        case WIRE_VARINT:
+            if (!get_varint(buf, len, &pos, &value)) {
+                LOG_ERROR("Truncated varint in field %u", (unsigned)field);
+                return false;
+            }
+            break;
+        case WIRE_FIXED32:
+            if (len - pos < 4) {
+                LOG_ERROR("Truncated fixed32 in field %u", (unsigned)field);
+                return false;
+            }
+            value = buf[pos] | (uint32_t)buf[pos + 1] << 8 | (uint32_t)buf[pos + 2] << 16 | (uint32_t)buf[pos + 3] << 24;
+            pos += 4;
+            break;
+        case WIRE_BYTES:
+            if (!get_varint(buf, len, &pos, &value) || value > len - pos) {
+                LOG_ERROR("Truncated bytes in field %u", (unsigned)field);
+                return false;
+            }
+            bytes = buf + pos;
+            pos += value;
+            break;
+        default:
+            LOG_ERROR("Unknown wire type %u in field %u", (unsigned)(key & 7), (unsigned)field);
+            return false;
+        }
+
+        size_t id = field_id(field);
+        bool ok = id == SETTINGS_FIELD_COUNT ||  // Поле более новой версии формата
+                  set_field(cfg, &settings_fields[id], value, bytes);
+        if (!ok) {
+            LOG_ERROR("Invalid value in field %u", (unsigned)field);
+            return false;
+        }
+    }
+    return true;
+}
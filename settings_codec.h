@@ -0,0 +1,57 @@
+#ifndef SETTINGS_CODEC_H
+#define SETTINGS_CODEC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "settings.h"
+
+/**
+ * Компактное представление settings_t: последовательность полей «ключ - значение», строится по
+ * схеме SETTINGS_SCHEMA (settings.h). Ключ - varint (номер поля << 3 | тип); номер поля - номер
+ * в схеме + 1, у crc32 всегда 15. Беззнаковые целые - varint, знаковые - zigzag varint,
+ * четырёхбайтовые беззнаковые (magic, CRC32) - 4 байта, строки - длина и байты до последнего
+ * ненулевого, массив строк - по строке на ключ с индексом перед байтами.
+ * Нулевые поля и пустые строки не кодируются; неизвестные поля при разборе пропускаются.
+ */
+
+#define SETTINGS_CODEC_VARINT_LEN(bits) (((bits) + 6) / 7)    ///< Наибольшая длина varint
+#define SETTINGS_CODEC_BYTES_LEN(len)   (1 + ((len) < 128 ? 1 : 2) + (len))  ///< Ключ, длина и байты
+
+#define SETTINGS_CODEC_LEN_NUM(type, name, min, max, def, attr, fmt, label) \
+    + 1 + ((type)-1 > (type)0 && sizeof(type) == 4 ? 4 : SETTINGS_CODEC_VARINT_LEN(8 * sizeof(type)))
+#define SETTINGS_CODEC_LEN_STR(name, len, def, attr, label)          + SETTINGS_CODEC_BYTES_LEN(len)
+#define SETTINGS_CODEC_LEN_STRS(name, count, len, def, attr, label)  + (count) * SETTINGS_CODEC_BYTES_LEN(1 + (len))
+
+/// Максимальный размер закодированных настроек
+#define SETTINGS_CODEC_MAX_LEN \
+    (0 SETTINGS_SCHEMA(SETTINGS_CODEC_LEN_NUM, SETTINGS_CODEC_LEN_STR, SETTINGS_CODEC_LEN_STRS))
+
+/**
+ * @brief Размер закодированных настроек
+ * @param cfg Указатель на настройки
+ * @return Размер в байтах
+ */
+size_t settings_encoded_size(const settings_t *cfg);
+
+/**
+ * @brief Кодирование настроек
+ * @param cfg Указатель на настройки
+ * @param buf Буфер (достаточно SETTINGS_CODEC_MAX_LEN байт)
+ * @param len Размер буфера
+ * @return Размер закодированных данных или 0, если буфер мал
+ */
+size_t settings_encode(const settings_t *cfg, uint8_t *buf, size_t len);
+
+/**
+ * @brief Разбор закодированных настроек
+ *
+ * Результат побайтно совпадает со структурой, переданной в settings_encode().
+ * @param buf Закодированные данные
+ * @param len Размер данных
+ * @param cfg Структура для результата
+ * @return true если данные корректны, false в противном случае
+ */
+bool settings_decode(const uint8_t *buf, size_t len, settings_t *cfg);
+
+#endif // SETTINGS_CODEC_H
@@ -0,0 +1,554 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "pico/stdlib.h"
+#include "settings.h"
+#include "settings_schema.h"
+#include "flash_hal.h"
+#include "logging.h"
+
+/*
+ * Генератор образов журнала настроек для партии устройств (только сборка для хоста).
+ *
+ * Строка CSV - одно устройство. Заголовок называет столбцы: имя поля settings_t из схемы
+ * (ntp_servers - адреса через «;»), board_id - уникальный идентификатор платы (16 hex-цифр,
+ * из него выводится ключ шифрования записи), name - имя файла образа. Незаданные поля получают
+ * значения по умолчанию. Запись готовится тем же кодом, что и settings_save() на устройстве
+ * (settings_record_seal_device), и кладётся в первый слот пустого журнала.
+ *
+ * Образ - вся область журнала (SETTINGS_LOG_SIZE байт с конца флеш-памяти), чтобы прошивка
+ * стёрла старые записи: raw-файл для записи по смещению журнала или UF2 для загрузчика RP2040.
+ * Образы готовятся в нескольких потоках; с -v каждый файл читается обратно в эмулятор
+ * флеш-памяти и загружается settings_load() с идентификатором своей платы.
+ */
+
+#define FLASH_OFFSET        (PICO_FLASH_SIZE_BYTES - SETTINGS_LOG_SIZE)
+#define IMAGE_XIP_BASE      0x10000000u    ///< Адрес флеш-памяти в карте памяти RP2040
+#define IMAGE_NAME_LEN      48
+#define IMAGE_CELL_MAX      (NTP_MAX_SERVERS * NTP_SERVER_MAX_LEN + 1)
+
+// Блок UF2 (https://github.com/microsoft/uf2)
+#define UF2_MAGIC_START0    0x0A324655u
+#define UF2_MAGIC_START1    0x9E5D5157u
+#define UF2_MAGIC_END       0x0AB16F30u
+#define UF2_FLAG_FAMILY_ID  0x00002000u
+#define UF2_FAMILY_RP2040   0xE48BFF56u
+#define UF2_BLOCK_SIZE      512
+#define UF2_PAYLOAD         256
+#define UF2_BLOCKS          (SETTINGS_LOG_SIZE / UF2_PAYLOAD)
+
+typedef struct {
+    uint32_t magic_start0;
+    uint32_t magic_start1;
+    uint32_t flags;
+    uint32_t target_addr;
+    uint32_t payload_size;
+    uint32_t block_no;
+    uint32_t num_blocks;
+    uint32_t family_id;
+    uint8_t data[476];
+    uint32_t magic_end;
+} uf2_block_t;
+
+_Static_assert(sizeof(uf2_block_t) == UF2_BLOCK_SIZE, "UF2 block must be 512 bytes");
+_Static_assert(SETTINGS_LOG_SIZE % UF2_PAYLOAD == 0, "Settings log must split into UF2 payloads");
+
+typedef enum { IMAGE_UF2, IMAGE_BIN } image_format_t;
+
+// Столбцы CSV помимо полей схемы
+#define COLUMN_NAME         (-1)
+#define COLUMN_BOARD_ID     (-2)
+
+typedef struct {
+    char name[IMAGE_NAME_LEN];
+    uint8_t board_id[FLASH_HAL_UNIQUE_ID_LEN];
+    settings_t cfg;
+    unsigned line;
+} device_t;
+
+typedef struct {
+    const device_t *devices;
+    size_t count;
+    const char *dir;
+    image_format_t format;
+    atomic_size_t next;
+    atomic_bool failed;
+} job_t;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// ---- Разбор CSV ----
+
+// Следующая ячейка строки (кавычки - по RFC 4180); false - конец строки или файла
+static bool csv_cell(const char **p, char *out, size_t len, bool *too_long) {
+    const char *s = *p;
+    if (*s == '\0' || *s == '\n' || *s == '\r') {
+        return false;
+    }
+    size_t n = 0;
+    *too_long = false;
+    bool quoted = *s == '"';
+    s += quoted;
+    for (;; s++) {
+        char c = *s;
+        if (c == '\0') {
+            break;
+        }
+        if (quoted) {
+            if (c == '"' && s[1] == '"') {
+                s++;
+            } else if (c == '"') {
+                quoted = false;
+                continue;
+            }
+        } else if (c == ',' || c == '\n' || c == '\r') {
+            break;
+        }
+        if (n + 1 < len) {
+            out[n++] = c;
+        } else {
+            *too_long = true;
+        }
+    }
+    out[n] = '\0';
+    *p = *s == ',' ? s + 1 : s;
+    return true;
+}
+
+static void csv_next_line(const char **p) {
+    const char *s = *p;
+    while (*s && *s != '\n') {
+        s++;
+    }
+    *p = *s ? s + 1 : s;
+}
+
+static bool parse_hex_id(const char *text, uint8_t *id) {
+    if (strlen(text) != 2 * FLASH_HAL_UNIQUE_ID_LEN) {
+        return false;
+    }
+    for (size_t i = 0; i < FLASH_HAL_UNIQUE_ID_LEN; i++) {
+        unsigned byte;
+        if (sscanf(text + 2 * i, "%2x", &byte) != 1) {
+            return false;
+        }
+        id[i] = (uint8_t)byte;
+    }
+    return true;
+}
+
+static bool parse_name(const char *text, char *name) {
+    size_t len = strlen(text);
+    if (len == 0 || len >= IMAGE_NAME_LEN || strspn(text, "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz"
+                                                          "0123456789_.-") != len || text[0] == '.') {
+        return false;
+    }
+    memcpy(name, text, len + 1);
+    return true;
+}
+
+static bool parse_field(const settings_field_t *field, const char *text, settings_t *cfg) {
+    uint8_t *dst = (uint8_t *)cfg + field->offset;
+    if (field->kind == SETTINGS_KIND_UINT || field->kind == SETTINGS_KIND_INT) {
+        char *end;
+        errno = 0;
+        long long value = strtoll(text, &end, 0);
+        if (errno || end == text || *end != '\0' || value < field->min || value > field->max) {
+            return false;
+        }
+        // Little-endian, как на устройстве
+        for (uint8_t i = 0; i < field->size; i++) {
+            dst[i] = (uint8_t)((unsigned long long)value >> (8 * i));
+        }
+        return true;
+    }
+
+    memset(dst, 0, (size_t)field->size * field->count);
+    for (uint8_t n = 0; n < field->count; n++, dst += field->size) {
+        size_t len = field->kind == SETTINGS_KIND_STRS ? strcspn(text, ";") : strlen(text);
+        if (len >= field->size) {
+            return false;
+        }
+        memcpy(dst, text, len);
+        text += len;
+        if (*text == ';') {
+            text++;
+        } else {
+            break;
+        }
+    }
+    return *text == '\0';
+}
+
+static int column_index(const char *name) {
+    if (strcmp(name, "name") == 0) {
+        return COLUMN_NAME;
+    }
+    if (strcmp(name, "board_id") == 0) {
+        return COLUMN_BOARD_ID;
+    }
+    for (int i = 0; i < SETTINGS_FIELD_COUNT; i++) {
+        if (strcmp(settings_fields[i].name, name) == 0 && !(settings_fields[i].attr & SETTINGS_FIELD_META)) {
+            return i;
+        }
+    }
+    return SETTINGS_FIELD_COUNT;
+}
+
+static char *read_file(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *text = size >= 0 ? malloc((size_t)size + 1) : NULL;
+    if (text && fread(text, 1, (size_t)size, f) == (size_t)size) {
+        text[size] = '\0';
+    } else {
+        free(text);
+        text = NULL;
+    }
+    fclose(f);
+    return text;
+}
+
+// Устройства из CSV; строки с ошибками выводятся и пропускаются
+static device_t *load_csv(const char *path, size_t *count, unsigned *errors) {
+    char *text = read_file(path);
+    if (!text) {
+        perror(path);
+        return NULL;
+    }
+
+    int columns[SETTINGS_FIELD_COUNT + 2];
+    size_t ncolumns = 0;
+    bool has_board_id = false;
+    char cell[IMAGE_CELL_MAX];
+    bool too_long;
+    const char *p = text;
+    while (csv_cell(&p, cell, sizeof(cell), &too_long)) {
+        int column = ncolumns < sizeof(columns) / sizeof(columns[0]) ? column_index(cell) : SETTINGS_FIELD_COUNT;
+        if (column == SETTINGS_FIELD_COUNT) {
+            fprintf(stderr, "%s:1: unknown column '%s'\n", path, cell);
+            free(text);
+            return NULL;
+        }
+        has_board_id |= column == COLUMN_BOARD_ID;
+        columns[ncolumns++] = column;
+    }
+    csv_next_line(&p);
+    if (!has_board_id && SETTINGS_PROTECT_DEFAULT == SETTINGS_PROTECT_AEAD) {
+        fprintf(stderr, "%s:1: board_id column is required (records are encrypted with a per-board key)\n", path);
+        free(text);
+        return NULL;
+    }
+
+    size_t capacity = 256;
+    device_t *devices = malloc(capacity * sizeof(*devices));
+    if (!devices) {
+        fprintf(stderr, "%s: out of memory\n", path);
+        free(text);
+        return NULL;
+    }
+    *count = 0;
+    for (unsigned line = 2; *p; line++, csv_next_line(&p)) {
+        if (*p == '\n' || *p == '\r') {
+            continue;
+        }
+        if (*count == capacity) {
+            device_t *grown = realloc(devices, 2 * capacity * sizeof(*devices));
+            if (!grown) {
+                fprintf(stderr, "%s:%u: out of memory\n", path, line);
+                free(devices);
+                free(text);
+                return NULL;
+            }
+            devices = grown;
+            capacity *= 2;
+        }
+        device_t *dev = &devices[*count];
+        memset(dev, 0, sizeof(*dev));
+        settings_init_default(&dev->cfg);
+        snprintf(dev->name, IMAGE_NAME_LEN, "device%05u", (unsigned)*count);
+        dev->line = line;
+
+        bool ok = true;
+        size_t c = 0;
+        for (; c < ncolumns && ok; c++) {
+            if (!csv_cell(&p, cell, sizeof(cell), &too_long)) {
+                if (columns[c] == COLUMN_BOARD_ID) {
+                    ok = false;  // Строка короче заголовка: идентификатора нет
+                }
+                break;
+            }
+            if (too_long) {
+                ok = false;
+            } else if (columns[c] == COLUMN_NAME) {
+                ok = cell[0] == '\0' || parse_name(cell, dev->name);
+            } else if (columns[c] == COLUMN_BOARD_ID) {
+                ok = parse_hex_id(cell, dev->board_id);
+            } else if (cell[0] != '\0') {
+                ok = parse_field(&settings_fields[columns[c]], cell, &dev->cfg);
+            }
+            if (!ok) {
+                fprintf(stderr, "%s:%u: invalid %s '%s'\n", path, line,
+                        columns[c] == COLUMN_NAME ? "name" :
+                        columns[c] == COLUMN_BOARD_ID ? "board_id" : settings_fields[columns[c]].name, cell);
+            }
+        }
+        // Лишние ячейки (в том числе пустая после завершающей запятой) не отбрасываются молча
+        if (ok && c == ncolumns && (p[-1] == ',' || csv_cell(&p, cell, sizeof(cell), &too_long))) {
+            fprintf(stderr, "%s:%u: more cells than the %zu header columns\n", path, line, ncolumns);
+            ok = false;
+        }
+        if (ok && !settings_validate(&dev->cfg)) {
+            fprintf(stderr, "%s:%u: settings rejected by schema\n", path, line);
+            ok = false;
+        }
+        if (ok) {
+            (*count)++;
+        } else {
+            (*errors)++;
+        }
+    }
+    free(text);
+    return devices;
+}
+
+// Синтетическая партия для замеров: уникальные сети, пароли и идентификаторы
+static device_t *make_fleet(size_t count) {
+    device_t *devices = calloc(count, sizeof(*devices));
+    for (size_t i = 0; devices && i < count; i++) {
+        device_t *dev = &devices[i];
+        settings_init_default(&dev->cfg);
+        snprintf(dev->name, IMAGE_NAME_LEN, "fleet%05zu", i);
+        snprintf(dev->cfg.wifi_ssid, WIFI_SSID_MAX_LEN, "fleet-ap-%zu", i % 97);
+        snprintf(dev->cfg.wifi_pass, WIFI_PASS_MAX_LEN, "pass-%08zx-%zu", i * 2654435761u, i);
+        snprintf(dev->cfg.ntp_servers[0], NTP_SERVER_MAX_LEN, "%zu.pool.ntp.org", i % 4);
+        dev->cfg.brightness = (uint8_t)(i % (BRIGHTNESS_MAX + 1));
+        dev->cfg.night_off_hour = (uint8_t)(i % (HOUR_MAX + 1));
+        uint64_t id = 0xE660000000000000ull | i;
+        for (size_t b = 0; b < FLASH_HAL_UNIQUE_ID_LEN; b++) {
+            dev->board_id[b] = (uint8_t)(id >> (8 * (FLASH_HAL_UNIQUE_ID_LEN - 1 - b)));
+        }
+    }
+    return devices;
+}
+
+// ---- Образы ----
+
+// Журнал с единственной записью (seq 1) в первом слоте
+static void build_log(const device_t *dev, uint8_t *log) {
+    memset(log, 0xFF, SETTINGS_LOG_SIZE);
+    settings_record_t *rec = (settings_record_t *)log;
+    rec->seq = 1;
+    rec->seq_inv = ~1u;
+    settings_record_seal_device(rec, &dev->cfg, SETTINGS_PROTECT_DEFAULT, dev->board_id);
+}
+
+static size_t build_uf2(const uint8_t *log, uint8_t *out) {
+    for (uint32_t i = 0; i < UF2_BLOCKS; i++) {
+        uf2_block_t block = {
+            .magic_start0 = UF2_MAGIC_START0,
+            .magic_start1 = UF2_MAGIC_START1,
+            .flags = UF2_FLAG_FAMILY_ID,
+            .target_addr = IMAGE_XIP_BASE + FLASH_OFFSET + i * UF2_PAYLOAD,
+            .payload_size = UF2_PAYLOAD,
+            .block_no = i,
+            .num_blocks = UF2_BLOCKS,
+            .family_id = UF2_FAMILY_RP2040,
+            .magic_end = UF2_MAGIC_END,
+        };
+        memcpy(block.data, log + i * UF2_PAYLOAD, UF2_PAYLOAD);
+        memcpy(out + i * UF2_BLOCK_SIZE, &block, UF2_BLOCK_SIZE);
+    }
+    return UF2_BLOCKS * UF2_BLOCK_SIZE;
+}
+
+static void image_path(char *path, size_t len, const char *dir, const char *name, image_format_t format) {
+    snprintf(path, len, "%s/%s.%s", dir, name, format == IMAGE_UF2 ? "uf2" : "bin");
+}
+
+static bool write_file(const char *path, const uint8_t *data, size_t len) {
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        return false;
+    }
+    bool ok = fwrite(data, 1, len, f) == len;
+    return (fclose(f) == 0) && ok;
+}
+
+static void *worker(void *arg) {
+    job_t *job = arg;
+    uint8_t *log = malloc(SETTINGS_LOG_SIZE);
+    uint8_t *uf2 = malloc(UF2_BLOCKS * UF2_BLOCK_SIZE);
+    if (!log || !uf2) {
+        atomic_store(&job->failed, true);
+    }
+    for (size_t i; log && uf2 && (i = atomic_fetch_add(&job->next, 1)) < job->count;) {
+        const device_t *dev = &job->devices[i];
+        build_log(dev, log);
+        char path[PATH_MAX];
+        image_path(path, sizeof(path), job->dir, dev->name, job->format);
+        bool ok = job->format == IMAGE_UF2 ? write_file(path, uf2, build_uf2(log, uf2))
+                                           : write_file(path, log, SETTINGS_LOG_SIZE);
+        if (!ok) {
+            fprintf(stderr, "%s: %s\n", path, strerror(errno));
+            atomic_store(&job->failed, true);
+        }
+    }
+    free(log);
+    free(uf2);
+    return NULL;
+}
+
+// ---- Проверка: образ в эмуляторе флеш-памяти и settings_load() ----
+
+static bool flash_from_file(const char *path, image_format_t format, uint8_t *log) {
+    size_t expect = format == IMAGE_UF2 ? UF2_BLOCKS * UF2_BLOCK_SIZE : SETTINGS_LOG_SIZE;
+    char *data = read_file(path);
+    if (!data) {
+        return false;
+    }
+    struct stat st;
+    bool ok = stat(path, &st) == 0 && (size_t)st.st_size == expect;
+    if (ok && format == IMAGE_UF2) {
+        // Блоки разбираются как загрузчиком: адрес и размер данных из заголовка
+        memset(log, 0xFF, SETTINGS_LOG_SIZE);
+        for (size_t i = 0; ok && i < UF2_BLOCKS; i++) {
+            uf2_block_t block;
+            memcpy(&block, data + i * UF2_BLOCK_SIZE, sizeof(block));
+            uint32_t offset = block.target_addr - IMAGE_XIP_BASE - FLASH_OFFSET;
+            ok = block.magic_start0 == UF2_MAGIC_START0 && block.magic_start1 == UF2_MAGIC_START1 &&
+                 block.magic_end == UF2_MAGIC_END && block.family_id == UF2_FAMILY_RP2040 &&
+                 block.payload_size == UF2_PAYLOAD && offset < SETTINGS_LOG_SIZE && offset % UF2_PAYLOAD == 0;
+            if (ok) {
+                memcpy(log + offset, block.data, UF2_PAYLOAD);
+            }
+        }
+    } else if (ok) {
+        memcpy(log, data, SETTINGS_LOG_SIZE);
+    }
+    free(data);
+    return ok && flash_hal_erase(FLASH_OFFSET, SETTINGS_LOG_SIZE) &&
+           flash_hal_program(FLASH_OFFSET, log, SETTINGS_LOG_SIZE);
+}
+
+static unsigned verify_images(const device_t *devices, size_t count, const char *dir, image_format_t format) {
+    static uint8_t log[SETTINGS_LOG_SIZE];
+    unsigned failures = 0;
+    for (size_t i = 0; i < count; i++) {
+        const device_t *dev = &devices[i];
+        char path[PATH_MAX];
+        image_path(path, sizeof(path), dir, dev->name, format);
+        settings_t loaded;
+        flash_hal_host_set_unique_id(dev->board_id);
+        if (!flash_from_file(path, format, log) || !settings_load(&loaded, FLASH_OFFSET) ||
+            (settings_diff(&loaded, &dev->cfg) & SETTINGS_USER_FIELDS) != 0 ||
+            strcmp(loaded.wifi_pass, dev->cfg.wifi_pass) != 0) {
+            fprintf(stderr, "%s: settings_load() rejected or changed the image\n", path);
+            failures++;
+        }
+    }
+    flash_hal_host_set_unique_id(NULL);
+    return failures;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-f uf2|bin] [-o dir] [-j threads] [-v] devices.csv\n"
+                    "       %s [-f uf2|bin] [-o dir] [-j threads] [-v] -n count\n", prog, prog);
+}
+
+int main(int argc, char **argv) {
+    image_format_t format = IMAGE_UF2;
+    const char *dir = ".";
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t fleet = 0;
+    bool verify = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "f:o:j:n:v")) != -1) {
+        switch (opt) {
+            case 'f':
+                if (strcmp(optarg, "uf2") != 0 && strcmp(optarg, "bin") != 0) {
+                    usage(argv[0]);
+                    return 2;
+                }
+                format = strcmp(optarg, "uf2") == 0 ? IMAGE_UF2 : IMAGE_BIN;
+                break;
+            case 'o': dir = optarg; break;
+            case 'j': threads = strtol(optarg, NULL, 10); break;
+            case 'n': fleet = strtoul(optarg, NULL, 10); break;
+            case 'v': verify = true; break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if ((fleet == 0) == (optind >= argc) || threads < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    size_t count = 0;
+    unsigned errors = 0;
+    device_t *devices = fleet ? make_fleet(count = fleet) : load_csv(argv[optind], &count, &errors);
+    if (!devices) {
+        return 1;
+    }
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+        perror(dir);
+        return 1;
+    }
+
+    job_t job = { .devices = devices, .count = count, .dir = dir, .format = format };
+    atomic_init(&job.next, 0);
+    atomic_init(&job.failed, false);
+    pthread_t *pool = calloc((size_t)threads, sizeof(*pool));
+    uint64_t start = now_ns();
+    for (long t = 0; t < threads; t++) {
+        pthread_create(&pool[t], NULL, worker, &job);
+    }
+    for (long t = 0; t < threads; t++) {
+        pthread_join(pool[t], NULL);
+    }
+    uint64_t elapsed = now_ns() - start;
+    free(pool);
+
+    size_t image_size = format == IMAGE_UF2 ? UF2_BLOCKS * UF2_BLOCK_SIZE : SETTINGS_LOG_SIZE;
+    printf("%zu %s images (%zu bytes, log at flash offset 0x%08X) in %.1f ms with %ld threads: "
+           "%.0f images/s, %.1f MB/s\n",
+           count, format == IMAGE_UF2 ? "UF2" : "raw", image_size, (unsigned)FLASH_OFFSET, elapsed / 1e6, threads,
+           elapsed ? count * 1e9 / elapsed : 0.0, elapsed ? count * image_size * 1e3 / elapsed : 0.0);
+
+    unsigned failures = 0;
+    if (verify && !atomic_load(&job.failed)) {
+        if (!flash_hal_host_open(NULL)) {
+            fprintf(stderr, "Flash image unavailable\n");
+            return 1;
+        }
+        start = now_ns();
+        failures = verify_images(devices, count, dir, format);
+        printf("Verified %zu images with settings_load() in %.1f ms: %u failed\n", count,
+               (now_ns() - start) / 1e6, failures);
+        flash_hal_host_close();
+    }
+    if (errors) {
+        printf("%u CSV rows skipped\n", errors);
+    }
+    free(devices);
+    return atomic_load(&job.failed) || failures || errors ? 1 : 0;
+}
@@ -0,0 +1,100 @@
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/rand.h"
+#include "settings_kv.h"
+#include "settings_codec.h"
+#include "aead.h"
+#include "flash_scratch.h"
+#include "logging.h"
+
+#define SETTINGS_KV_MAX_LEN (AEAD_NONCE_LEN + SETTINGS_CODEC_MAX_LEN + AEAD_TAG_LEN)
+
+_Static_assert(SETTINGS_KV_MAX_LEN <= KV_VALUE_MAX, "Encoded settings must fit in a key-value record");
+_Static_assert(FLASH_SCRATCH_ALIGN(SETTINGS_KV_MAX_LEN) + KV_WRITE_SCRATCH <= FLASH_SCRATCH_SIZE,
+               "Sealed settings value and a key-value write must fit the scratch arena");
+
+// Ключ записи аутентифицируется вместе с данными: значение нельзя подставить под другим ключом
+static const uint8_t settings_kv_aad[] = SETTINGS_KV_KEY;
+
+bool settings_kv_load(const kv_store_t *kv, settings_t *cfg) {
+    if (!kv || !cfg) {
+        LOG_ERROR("Null pointer passed to settings_kv_load");
+        return false;
+    }
+
+    size_t len;
+    if (!kv_get(kv, KV_NS_SETTINGS, SETTINGS_KV_KEY, NULL, 0, &len)) {
+        LOG_WARN("No settings in key-value store");
+        return false;
+    }
+    if (len < AEAD_NONCE_LEN + AEAD_TAG_LEN || len > SETTINGS_KV_MAX_LEN) {
+        LOG_ERROR("Settings value has invalid length: %u bytes", (unsigned)len);
+        return false;
+    }
+    uint8_t *value = flash_scratch_borrow(len);
+    if (!value) {
+        return false;
+    }
+
+    // Расшифровка на месте в арене, открытый текст стирается сразу после разбора
+    size_t data_len = len - AEAD_NONCE_LEN - AEAD_TAG_LEN;
+    uint8_t *data = value + AEAD_NONCE_LEN;
+    settings_t decoded;
+    bool authentic = kv_get(kv, KV_NS_SETTINGS, SETTINGS_KV_KEY, value, len, NULL) &&
+                     settings_blob_open(value, settings_kv_aad, sizeof(settings_kv_aad), data, data_len,
+                                        data + data_len);
+    bool ok = authentic && settings_decode(data, data_len, &decoded) && decoded.magic == SETTINGS_MAGIC &&
+              decoded.version == SETTINGS_VERSION && settings_validate(&decoded);
+    memset(value, 0, len);
+    flash_scratch_release(value);
+    if (!authentic) {
+        LOG_ERROR("Settings value failed authentication");
+        return false;
+    }
+    if (!ok) {
+        LOG_ERROR("Settings value from key-value store rejected");
+        return false;
+    }
+    *cfg = decoded;
+    return true;
+}
+
+bool settings_kv_save(kv_store_t *kv, const settings_t *cfg) {
+    if (!kv || !cfg) {
+        LOG_ERROR("Null pointer passed to settings_kv_save");
+        return false;
+    }
+    if (!settings_validate(cfg)) {
+        return false;
+    }
+
+    // Nonce случайный, поэтому одинаковые настройки дают разные значения: сравниваем расшифрованные
+    settings_t stored;
+    if (kv_get_ptr(kv, KV_NS_SETTINGS, SETTINGS_KV_KEY, NULL) && settings_kv_load(kv, &stored) &&
+        memcmp(&stored, cfg, sizeof(stored)) == 0) {
+        return true;
+    }
+
+    uint8_t *value = flash_scratch_borrow(SETTINGS_KV_MAX_LEN);
+    if (!value) {
+        return false;
+    }
+    uint8_t *data = value + AEAD_NONCE_LEN;
+    size_t data_len = settings_encode(cfg, data, SETTINGS_CODEC_MAX_LEN);
+    if (data_len == 0) {
+        flash_scratch_release(value);
+        LOG_ERROR("Failed to encode settings");
+        return false;
+    }
+    uint64_t random[2] = { get_rand_64(), get_rand_64() };
+    memcpy(value, random, AEAD_NONCE_LEN);
+    settings_blob_seal(value, settings_kv_aad, sizeof(settings_kv_aad), data, data_len, data + data_len);
+
+    bool ok = kv_put(kv, KV_NS_SETTINGS, SETTINGS_KV_KEY, value, AEAD_NONCE_LEN + data_len + AEAD_TAG_LEN);
+    memset(value, 0, SETTINGS_KV_MAX_LEN);
+    flash_scratch_release(value);
+    if (ok) {
+        LOG_INFO("Settings saved to key-value store (%u bytes)", (unsigned)data_len);
+    }
+    return ok;
+}
@@ -0,0 +1,39 @@
+#ifndef SETTINGS_KV_H
+#define SETTINGS_KV_H
+
+#include <stdbool.h>
+#include "settings.h"
+#include "kvstore.h"
+
+#define SETTINGS_KV_KEY         "settings" ///< Ключ настроек в пространстве KV_NS_SETTINGS
+
+/*
+ * Хранение settings_t как одного значения в хранилище «ключ - значение».
+ * Значение - компактное представление (settings_codec.c), целиком зашифрованное
+ * ChaCha20-Poly1305 ключом настроек устройства: nonce (12 байт), шифротекст, тег.
+ *
+ * Прошивка хранит настройки в журнале (settings.c), он и остаётся источником истины: settings_kv
+ * к загрузке при старте не подключён. Модуль - проверенная тестами библиотека для устройств,
+ * где настройки соседствуют с другими данными в хранилище. Значение другой версии отвергается:
+ * шаги settings_migrate() заданы для раскладки записи журнала, а settings_decode() уже разложил
+ * поля по текущей структуре; миграция значений хранилища потребует шагов на уровне полей кодека.
+ */
+
+/**
+ * @brief Загрузка настроек из хранилища
+ * @param kv Открытое хранилище
+ * @param cfg Буфер для настроек
+ * @return true если значение найдено, подлинное, текущей версии и прошло проверку
+ */
+bool settings_kv_load(const kv_store_t *kv, settings_t *cfg);
+
+/**
+ * @brief Сохранение настроек в хранилище
+ * @param kv Открытое хранилище
+ * @param cfg Настройки (пароль в открытом виде)
+ * @return true если настройки сохранены или совпадают с сохранёнными
+ * @note Неизменённые настройки повторно не записываются
+ */
+bool settings_kv_save(kv_store_t *kv, const settings_t *cfg);
+
+#endif // SETTINGS_KV_H
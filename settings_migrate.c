@@ -0,0 +1,69 @@
+#include "settings_migrate.h"
+#include "logging.h"
+#include "config.h"
+
+/**
+ * @brief Шаг миграции: обновляет запись версии version до версии to (to > version)
+ */
+typedef struct {
+    uint16_t version;                       ///< Исходная версия
+    uint16_t size;                          ///< Размер структуры исходной версии
+    uint16_t to;                            ///< Версия после шага
+    void (*upgrade)(settings_t *cfg);       ///< Преобразование на месте (записывает version = to)
+} settings_migration_t;
+
+// Таблица миграций; новая версия структуры добавляет сюда шаг для предыдущей.
+// Пустой элемент нужен только потому, что массив нулевой длины в C запрещён.
+static const settings_migration_t migrations[] = {
+    { 0, 0, 0, NULL },
+};
+
+#define MIGRATION_COUNT (sizeof(migrations) / sizeof(migrations[0]))
+
+static const settings_migration_t *find_migration(uint16_t version, uint16_t size) {
+    for (size_t i = 0; i < MIGRATION_COUNT; i++) {
+        if (migrations[i].upgrade && migrations[i].version == version && migrations[i].size == size) {
+            return &migrations[i];
+        }
+    }
+    return NULL;
+}
+
+bool settings_migrate_supported(uint16_t version, uint16_t size) {
+    if (version == SETTINGS_VERSION) {
+        return size == sizeof(settings_t);
+    }
+    return find_migration(version, size) != NULL;
+}
+
+bool settings_migrate(settings_t *cfg) {
+    if (!cfg) {
+        LOG_ERROR("Null pointer passed to settings_migrate");
+        return false;
+    }
+
+    // Каждый шаг повышает версию, поэтому цепочка не длиннее таблицы
+    uint16_t from = cfg->version;
+    for (size_t steps = 0; cfg->version != SETTINGS_VERSION; steps++) {
+        const settings_migration_t *step = find_migration(cfg->version, cfg->size);
+        if (!step || steps == MIGRATION_COUNT) {
+            LOG_ERROR("No migration from settings version 0x%04X (size %u)", cfg->version, cfg->size);
+            return false;
+        }
+        uint16_t version = cfg->version;
+        step->upgrade(cfg);
+        if (step->to <= version || cfg->version != step->to) {
+            LOG_ERROR("Migration step from 0x%04X produced version 0x%04X (expected 0x%04X)", version,
+                      cfg->version, step->to);
+            return false;
+        }
+    }
+    if (cfg->size != sizeof(settings_t)) {
+        LOG_ERROR("Migration produced size %u (expected %u)", cfg->size, (unsigned)sizeof(settings_t));
+        return false;
+    }
+
+    cfg->crc32 = calculate_crc32((const uint8_t *)cfg, sizeof(settings_t) - sizeof(uint32_t));
+    LOG_INFO("Settings migrated from version 0x%04X to 0x%04X", from, SETTINGS_VERSION);
+    return true;
+}
@@ -0,0 +1,33 @@
+
+#ifndef SETTINGS_MIGRATE_H
+#define SETTINGS_MIGRATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "settings.h"
+
+/*
+ * Выпущенная прошивка хранит settings_t версии 0x0100 - она совпадает с текущей SETTINGS_VERSION,
+ * поэтому таблица миграций пока пуста. При изменении раскладки прежняя структура объявляется здесь
+ * (settings_vXXXX_t с static_assert на размер), а в settings_migrate.c добавляется шаг обновления.
+ */
+
+/**
+ * @brief Проверка, известна ли версия записи (текущая или обновляемая)
+ * @param version Версия из заголовка записи
+ * @param size Размер из заголовка записи
+ * @return true если запись текущей версии или для неё есть цепочка обновлений
+ */
+bool settings_migrate_supported(uint16_t version, uint16_t size);
+
+/**
+ * @brief Обновление записи старой версии до SETTINGS_VERSION на месте
+ *
+ * Шаги таблицы миграций применяются по цепочке, новые поля получают значения по умолчанию.
+ * Пароль WiFi не расшифровывается; CRC32 пересчитывается для новой структуры.
+ * @param cfg Буфер размером settings_t, в начале которого лежит запись старой версии
+ * @return true если запись приведена к текущей версии, false в противном случае
+ */
+bool settings_migrate(settings_t *cfg);
+
+#endif // SETTINGS_MIGRATE_H
@@ -0,0 +1,99 @@
+#include <string.h>
+#include "settings_sched.h"
+#include "settings_shared.h"
+#include "logging.h"
+
+void settings_sched_init(settings_sched_t *sched, const settings_t *current, uint32_t flash_offset,
+                         uint32_t quiet_ms, uint32_t max_latency_ms) {
+    if (!sched || !current) {
+        LOG_ERROR("Null pointer passed to settings_sched_init");
+        return;
+    }
+
+    memset(sched, 0, sizeof(*sched));
+    memcpy(&sched->pending, current, sizeof(settings_t));
+    memcpy(&sched->accepted, current, sizeof(settings_t));
+    sched->flash_offset = flash_offset;
+    sched->quiet_ms = quiet_ms;
+    sched->max_latency_ms = max_latency_ms < quiet_ms ? quiet_ms : max_latency_ms;
+}
+
+settings_t *settings_sched_edit(settings_sched_t *sched) {
+    return sched ? &sched->pending : NULL;
+}
+
+bool settings_sched_mark_dirty(settings_sched_t *sched, uint64_t now_us) {
+    if (!sched) {
+        LOG_ERROR("Null pointer passed to settings_sched_mark_dirty");
+        return false;
+    }
+    // Недопустимые значения не должны дойти ни до дисплея, ни до журнала: правка отменяется целиком
+    if (!settings_validate(&sched->pending)) {
+        memcpy(&sched->pending, &sched->accepted, sizeof(settings_t));
+        LOG_WARN("Rejected invalid settings change");
+        return false;
+    }
+    memcpy(&sched->accepted, &sched->pending, sizeof(settings_t));
+
+    if (!sched->dirty) {
+        sched->dirty = true;
+        sched->first_change_us = now_us;
+    }
+    sched->last_change_us = now_us;
+    sched->stats.requests++;
+    // Изменение сразу видно ядру дисплея; запись во флеш-память откладывается
+    settings_shared_publish(&sched->accepted);
+    return true;
+}
+
+bool settings_sched_flush(settings_sched_t *sched) {
+    if (!sched) {
+        LOG_ERROR("Null pointer passed to settings_sched_flush");
+        return false;
+    }
+    if (!sched->dirty) {
+        return true;
+    }
+
+    // Изменения остаются несохранёнными, пока запись не удастся
+    if (!settings_save(&sched->accepted, sched->flash_offset)) {
+        sched->stats.failures++;
+        LOG_ERROR("Deferred settings save failed");
+        return false;
+    }
+    sched->dirty = false;
+    sched->retry_ms = 0;
+    sched->stats.commits++;
+    LOG_INFO("Deferred settings save: %u request(s) coalesced into %u commit(s)",
+             (unsigned)sched->stats.requests, (unsigned)sched->stats.commits);
+    return true;
+}
+
+bool settings_sched_poll(settings_sched_t *sched, uint64_t now_us) {
+    if (!sched || !sched->dirty) {
+        return false;
+    }
+
+    if (sched->retry_ms) {
+        if (now_us < sched->retry_us) {
+            return false;
+        }
+    } else {
+        bool quiet = now_us - sched->last_change_us >= (uint64_t)sched->quiet_ms * 1000u;
+        bool overdue = now_us - sched->first_change_us >= (uint64_t)sched->max_latency_ms * 1000u;
+        if (!quiet && !overdue) {
+            return false;
+        }
+    }
+    if (settings_sched_flush(sched)) {
+        return true;
+    }
+
+    sched->retry_ms = sched->retry_ms ? sched->retry_ms * 2 : SETTINGS_SCHED_RETRY_MS;
+    if (sched->retry_ms > SETTINGS_SCHED_RETRY_MAX_MS) {
+        sched->retry_ms = SETTINGS_SCHED_RETRY_MAX_MS;
+    }
+    sched->retry_us = now_us + (uint64_t)sched->retry_ms * 1000u;
+    LOG_WARN("Retrying deferred settings save in %u ms", (unsigned)sched->retry_ms);
+    return false;
+}
@@ -0,0 +1,92 @@
+#ifndef SETTINGS_SCHED_H
+#define SETTINGS_SCHED_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "settings.h"
+
+#define SETTINGS_SCHED_QUIET_MS         2000   ///< Окно тишины по умолчанию перед записью
+#define SETTINGS_SCHED_MAX_LATENCY_MS   10000  ///< Максимальная задержка записи по умолчанию
+#define SETTINGS_SCHED_RETRY_MS         1000   ///< Первая пауза перед повтором неудачной записи
+#define SETTINGS_SCHED_RETRY_MAX_MS     60000  ///< Наибольшая пауза между повторами
+
+/**
+ * @brief Статистика объединения сохранений
+ */
+typedef struct {
+    uint32_t requests;                      ///< Запросов на сохранение (изменений)
+    uint32_t commits;                       ///< Выполнено записей во флеш-память
+    uint32_t failures;                      ///< Неудачных записей
+} settings_sched_stats_t;
+
+/**
+ * @brief Планировщик отложенного сохранения настроек
+ *
+ * Изменения накапливаются в RAM-копии и записываются одной операцией, когда
+ * после последнего изменения прошло quiet_ms или с первого несохранённого
+ * изменения прошло max_latency_ms. Неудачная запись повторяется с удвоением паузы
+ * (от SETTINGS_SCHED_RETRY_MS до SETTINGS_SCHED_RETRY_MAX_MS), изменения до успешной
+ * записи остаются несохранёнными.
+ */
+typedef struct {
+    uint32_t flash_offset;                  ///< Смещение журнала настроек
+    uint32_t quiet_ms;                      ///< Окно тишины
+    uint32_t max_latency_ms;                ///< Максимальная задержка записи
+    settings_t pending;                     ///< Накопленные настройки (изменяются через settings_sched_edit)
+    settings_t accepted;                    ///< Последняя принятая копия: её записывает flush
+    bool dirty;                             ///< Есть несохранённые изменения
+    uint64_t first_change_us;               ///< Время первого несохранённого изменения
+    uint64_t last_change_us;                ///< Время последнего изменения
+    uint64_t retry_us;                      ///< Время следующей попытки после неудачной записи
+    uint32_t retry_ms;                      ///< Текущая пауза перед повтором (0 - ошибок не было)
+    settings_sched_stats_t stats;           ///< Статистика
+} settings_sched_t;
+
+/**
+ * @brief Инициализация планировщика
+ * @param sched Указатель на планировщик
+ * @param current Текущие настройки (исходное состояние RAM-копии)
+ * @param flash_offset Смещение журнала настроек во флеш-памяти
+ * @param quiet_ms Окно тишины в миллисекундах
+ * @param max_latency_ms Максимальная задержка записи в миллисекундах
+ */
+void settings_sched_init(settings_sched_t *sched, const settings_t *current, uint32_t flash_offset,
+                         uint32_t quiet_ms, uint32_t max_latency_ms);
+
+/**
+ * @brief Доступ к RAM-копии для изменения полей
+ * @return Указатель на накопленные настройки; после изменения вызвать settings_sched_mark_dirty
+ */
+settings_t *settings_sched_edit(settings_sched_t *sched);
+
+/**
+ * @brief Отметка об изменении настроек (запрос на сохранение)
+ *
+ * RAM-копия проверяется settings_validate(): недопустимые значения не публикуются и не
+ * планируются к записи, а RAM-копия возвращается к последней принятой, поэтому ранее принятые
+ * несохранённые изменения записываются как обычно.
+ * @param sched Указатель на планировщик
+ * @param now_us Текущее время в микросекундах (time_us_64)
+ * @return true если изменение принято, false если значения недопустимы
+ * @note Принятая RAM-копия сразу публикуется для второго ядра (settings_shared_publish)
+ */
+bool settings_sched_mark_dirty(settings_sched_t *sched, uint64_t now_us);
+
+/**
+ * @brief Периодическая проверка: запись во флеш-память, если подошёл срок
+ * @param sched Указатель на планировщик
+ * @param now_us Текущее время в микросекундах (time_us_64)
+ * @return true если в этом вызове выполнена запись (после ошибки - не раньше срока повтора)
+ */
+bool settings_sched_poll(settings_sched_t *sched, uint64_t now_us);
+
+/**
+ * @brief Немедленная запись накопленных изменений (перед выключением или OTA)
+ * @param sched Указатель на планировщик
+ * @return true если изменений нет или запись успешна, false при ошибке записи (изменения остаются
+ *         несохранёнными)
+ * @note Срок повтора не учитывается: запись выполняется сразу
+ */
+bool settings_sched_flush(settings_sched_t *sched);
+
+#endif // SETTINGS_SCHED_H
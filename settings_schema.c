@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <string.h>
+#include "settings_schema.h"
+#include "logging.h"
+#include "config.h"
+
+#define SETTINGS_NUM_KIND(type) ((type)-1 < (type)1 ? SETTINGS_KIND_INT : SETTINGS_KIND_UINT)
+
+#define FIELD_NUM(type, name, lo, hi, def, flags, fmt, text) \
+    { #name, text, offsetof(settings_t, name), sizeof(type), 1, SETTINGS_NUM_KIND(type), flags, fmt, lo, hi },
+#define FIELD_STR(name, len, def, flags, text) \
+    { #name, text, offsetof(settings_t, name), len, 1, SETTINGS_KIND_STR, flags, SETTINGS_FMT_DEC, 0, 0 },
+#define FIELD_STRS(name, num, len, def, flags, text) \
+    { #name, text, offsetof(settings_t, name), len, num, SETTINGS_KIND_STRS, flags, SETTINGS_FMT_DEC, 0, 0 },
+
+const settings_field_t settings_fields[SETTINGS_FIELD_COUNT] = {
+    SETTINGS_SCHEMA(FIELD_NUM, FIELD_STR, FIELD_STRS)
+};
+
+#define DEFAULT_NUM(type, name, lo, hi, def, flags, fmt, text)  .name = (def),
+#define DEFAULT_STR(name, len, def, flags, text)                .name = def,
+#define DEFAULT_STRS(name, num, len, def, flags, text)          .name = { def },
+
+const settings_t settings_default_image = {
+    SETTINGS_SCHEMA(DEFAULT_NUM, DEFAULT_STR, DEFAULT_STRS)
+};
+
+// Проверка на этапе сборки: значения по умолчанию проходят собственные ограничения
+#define CHECK_NUM(type, name, lo, hi, def, flags, fmt, text) \
+    static_assert((int64_t)(def) >= (int64_t)(lo) && (int64_t)(def) <= (int64_t)(hi), \
+                  "Default of " #name " out of range");
+#define CHECK_STR(name, len, def, flags, text) \
+    static_assert(sizeof(def) <= (len), "Default of " #name " too long");
+#define CHECK_STRS(name, num, len, def, flags, text) \
+    static_assert(sizeof(def) <= (len), "Default of " #name " too long");
+SETTINGS_SCHEMA(CHECK_NUM, CHECK_STR, CHECK_STRS)
+
+static int64_t field_value(const settings_field_t *field, const settings_t *cfg) {
+    const uint8_t *p = (const uint8_t *)cfg + field->offset;
+    bool is_signed = field->kind == SETTINGS_KIND_INT;
+    switch (field->size) {
+        case 1: return is_signed ? (int64_t)(int8_t)p[0] : (int64_t)p[0];
+        case 2: {
+            uint16_t v;
+            memcpy(&v, p, sizeof(v));
+            return is_signed ? (int64_t)(int16_t)v : (int64_t)v;
+        }
+        default: {
+            uint32_t v;
+            memcpy(&v, p, sizeof(v));
+            return is_signed ? (int64_t)(int32_t)v : (int64_t)v;
+        }
+    }
+}
+
+// Сообщения об ошибках вынесены из проверки, чтобы развёрнутые сравнения оставались короткими
+static bool field_out_of_range(unsigned id, int64_t value) {
+    const settings_field_t *field = &settings_fields[id];
+    LOG_ERROR("Setting %s out of range: %lld (allowed %lld..%lld)", field->name, (long long)value,
+              (long long)field->min, (long long)field->max);
+    return false;
+}
+
+static bool field_too_long(unsigned id, unsigned index) {
+    const settings_field_t *field = &settings_fields[id];
+    LOG_ERROR("Setting %s[%u] too long (max %u chars)", field->name, index, field->size - 1u);
+    return false;
+}
+
+// Сравнение через функцию: граница, совпадающая с пределом типа, не даёт предупреждения
+// -Wtype-limits, а после встраивания такие сравнения компилятор всё равно удаляет
+static inline bool num_in_range(int64_t value, int64_t lo, int64_t hi) {
+    return value >= lo && value <= hi;
+}
+
+// Проверка разворачивается из схемы
+#define VALIDATE_NUM(type, name, lo, hi, def, flags, fmt, text) \
+    if (!num_in_range(cfg->name, (lo), (hi))) { \
+        return field_out_of_range(SETTINGS_ID_##name, (int64_t)cfg->name); \
+    }
+#define VALIDATE_STR(name, len, def, flags, text) \
+    if (!memchr(cfg->name, '\0', len)) { \
+        return field_too_long(SETTINGS_ID_##name, 0); \
+    }
+#define VALIDATE_STRS(name, num, len, def, flags, text) \
+    for (unsigned n = 0; n < (num); n++) { \
+        if (!memchr(cfg->name[n], '\0', len)) { \
+            return field_too_long(SETTINGS_ID_##name, n); \
+        } \
+    }
+
+bool settings_schema_validate(const settings_t *cfg) {
+    SETTINGS_SCHEMA(VALIDATE_NUM, VALIDATE_STR, VALIDATE_STRS)
+    return true;
+}
+
+uint32_t settings_diff(const settings_t *a, const settings_t *b) {
+    uint32_t changed = 0;
+    for (size_t i = 0; i < SETTINGS_FIELD_COUNT; i++) {
+        const settings_field_t *field = &settings_fields[i];
+        const char *pa = (const char *)a + field->offset;
+        const char *pb = (const char *)b + field->offset;
+        bool same;
+        if (field->kind == SETTINGS_KIND_UINT || field->kind == SETTINGS_KIND_INT) {
+            same = memcmp(pa, pb, field->size) == 0;
+        } else {
+            same = true;
+            for (uint8_t n = 0; n < field->count && same; n++) {
+                same = strncmp(pa + n * field->size, pb + n * field->size, field->size) == 0;
+            }
+        }
+        if (!same) {
+            changed |= 1u << i;
+        }
+    }
+    return changed;
+}
+
+static void print_label(const char *label) {
+    printf(COLOR_CYAN "%-19s: " COLOR_RESET, label);
+}
+
+static const char *enabled_text(bool on) {
+    return on ? COLOR_GREEN "Enabled" COLOR_RESET : COLOR_RED "Disabled" COLOR_RESET;
+}
+
+// Числа печатаются с единицами из схемы; признаки расписываются по одному в строке
+static void print_number(const settings_field_t *field, int64_t value) {
+    unsigned v = (unsigned)value;
+    switch (field->format) {
+        case SETTINGS_FMT_HEX:     printf("0x%0*llX\n", field->size * 2, (unsigned long long)value); break;
+        case SETTINGS_FMT_BYTES:   printf("%u bytes\n", v); break;
+        case SETTINGS_FMT_PERCENT: printf("%u%%\n", v); break;
+        case SETTINGS_FMT_HOUR:    printf("%02u:00\n", v); break;
+        case SETTINGS_FMT_SEC:     printf("%u sec\n", v); break;
+        case SETTINGS_FMT_MIN:     printf("%u min\n", v); break;
+        case SETTINGS_FMT_FLAGS:
+            print_label("Adaptive Brightness");
+            printf("%s\n", enabled_text(v & FLAG_ADAPTIVE_BRIGHTNESS));
+            print_label("Night Mode");
+            printf("%s\n", enabled_text(v & FLAG_NIGHT_MODE));
+            print_label("Password Encrypted");
+            printf("%s\n", (v & FLAG_SETTINGS_ENCRYPTED) ? COLOR_GREEN "Yes" COLOR_RESET :
+                   COLOR_RED "No (ENCRYPT_WIFI_PASS disabled)" COLOR_RESET);
+            break;
+        case SETTINGS_FMT_ANIM:
+            printf("[%c] 1 [%c] 2 [%c] 3 [%c] 4 [%c] Lags\n",
+                   (v & ANIM_FLAG_1) ? 'X' : ' ',
+                   (v & ANIM_FLAG_2) ? 'X' : ' ',
+                   (v & ANIM_FLAG_3) ? 'X' : ' ',
+                   (v & ANIM_FLAG_4) ? 'X' : ' ',
+                   (v & ANIM_FLAG_LAGS) ? 'X' : ' ');
+            break;
+        default:                   printf("%lld\n", (long long)value); break;
+    }
+}
+
+void settings_print(const settings_t *cfg) {
+    for (size_t i = 0; i < SETTINGS_FIELD_COUNT; i++) {
+        const settings_field_t *field = &settings_fields[i];
+        if (field->kind == SETTINGS_KIND_STR) {
+            print_label(field->label);
+            printf("%.*s\n", field->size, (const char *)cfg + field->offset);
+        } else if (field->kind == SETTINGS_KIND_STRS) {
+            printf(COLOR_CYAN "%-19s:\n" COLOR_RESET, field->label);
+            const char *str = (const char *)cfg + field->offset;
+            for (uint8_t n = 0; n < field->count; n++, str += field->size) {
+                if (str[0] != '\0') {
+                    printf(COLOR_BLUE "  %u: " COLOR_RESET "%.*s\n", n + 1u, field->size, str);
+                }
+            }
+        } else {
+            if (field->format != SETTINGS_FMT_FLAGS) {
+                print_label(field->label);
+            }
+            print_number(field, field_value(field, cfg));
+        }
+    }
+}
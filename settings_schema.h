@@ -0,0 +1,92 @@
+#ifndef SETTINGS_SCHEMA_H
+#define SETTINGS_SCHEMA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "settings.h"
+
+/*
+ * Таблица полей, построенная из SETTINGS_SCHEMA (settings.h), и операции над настройками
+ * по этой таблице: проверка, поэлементное сравнение и печать.
+ */
+
+/**
+ * @brief Вид поля схемы
+ */
+typedef enum {
+    SETTINGS_KIND_UINT = 0,                 ///< Беззнаковое число
+    SETTINGS_KIND_INT,                      ///< Знаковое число
+    SETTINGS_KIND_STR,                      ///< Строка с завершающим \0
+    SETTINGS_KIND_STRS                      ///< Массив строк
+} settings_kind_t;
+
+/**
+ * @brief Описание поля
+ */
+typedef struct {
+    const char *name;                       ///< Имя поля в settings_t
+    const char *label;                      ///< Подпись при печати
+    uint16_t offset;                        ///< Смещение в settings_t
+    uint8_t size;                           ///< Размер числа или буфера одной строки
+    uint8_t count;                          ///< Количество строк (1 для остальных видов)
+    uint8_t kind;                           ///< Вид (settings_kind_t)
+    uint8_t attr;                           ///< Признаки (SETTINGS_FIELD_*)
+    uint8_t format;                         ///< Вид печати числа (SETTINGS_FMT_*)
+    int64_t min;                            ///< Наименьшее допустимое значение числа
+    int64_t max;                            ///< Наибольшее допустимое значение числа
+} settings_field_t;
+
+#define SETTINGS_ID_NUM(type, name, min, max, def, attr, fmt, label) SETTINGS_ID_##name,
+#define SETTINGS_ID_STR(name, len, def, attr, label)                 SETTINGS_ID_##name,
+#define SETTINGS_ID_STRS(name, count, len, def, attr, label)         SETTINGS_ID_##name,
+
+/// Номера полей в порядке схемы (бит номера в маске settings_diff)
+enum {
+    SETTINGS_SCHEMA(SETTINGS_ID_NUM, SETTINGS_ID_STR, SETTINGS_ID_STRS)
+    SETTINGS_FIELD_COUNT
+};
+
+/// Бит поля в маске изменений
+#define SETTINGS_CHANGED(name)  (1u << SETTINGS_ID_##name)
+
+#define SETTINGS_META_NUM(type, name, min, max, def, attr, fmt, label) \
+    | (((attr) & SETTINGS_FIELD_META) ? SETTINGS_CHANGED(name) : 0u)
+#define SETTINGS_META_STR(name, len, def, attr, label) \
+    | (((attr) & SETTINGS_FIELD_META) ? SETTINGS_CHANGED(name) : 0u)
+#define SETTINGS_META_STRS(name, count, len, def, attr, label) \
+    | (((attr) & SETTINGS_FIELD_META) ? SETTINGS_CHANGED(name) : 0u)
+
+/// Маска служебных полей (magic, version, size, crc32)
+#define SETTINGS_META_FIELDS    (0u SETTINGS_SCHEMA(SETTINGS_META_NUM, SETTINGS_META_STR, SETTINGS_META_STRS))
+/// Маска полей, которые задаёт пользователь
+#define SETTINGS_USER_FIELDS    (((1u << SETTINGS_FIELD_COUNT) - 1) & ~SETTINGS_META_FIELDS)
+
+static_assert(SETTINGS_FIELD_COUNT <= 32, "Changed-field mask is 32-bit");
+
+/// Таблица полей в порядке схемы
+extern const settings_field_t settings_fields[SETTINGS_FIELD_COUNT];
+
+/// Образ настроек по умолчанию (во флеш-памяти, копируется settings_init_default)
+extern const settings_t settings_default_image;
+
+/**
+ * @brief Проверка диапазонов чисел и длин строк по схеме
+ * @param cfg Указатель на настройки
+ * @return true если все поля допустимы
+ */
+bool settings_schema_validate(const settings_t *cfg);
+
+/**
+ * @brief Поэлементное сравнение настроек
+ * @return Маска изменившихся полей (бит SETTINGS_CHANGED(имя)); строки сравниваются до \0
+ */
+uint32_t settings_diff(const settings_t *a, const settings_t *b);
+
+/**
+ * @brief Печать всех полей с подписями
+ * @param cfg Указатель на настройки
+ */
+void settings_print(const settings_t *cfg);
+
+#endif // SETTINGS_SCHEMA_H
@@ -0,0 +1,127 @@
+#include <stdatomic.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#ifndef VFD_HOST_BUILD
+#include "hardware/sync.h"
+#endif
+#include "settings_shared.h"
+#include "logging.h"
+
+#define SHARED_WORDS ((sizeof(settings_t) + 3) / 4)
+
+// Копия настроек; слова копируются атомарно, чтобы одновременное чтение и запись не были гонкой
+typedef struct {
+    atomic_uint seq;                        // Нечётное значение - копия перезаписывается
+    atomic_uint generation;
+    atomic_uint words[SHARED_WORDS];
+} shared_slot_t;
+
+typedef union {
+    settings_t cfg;
+    uint32_t words[SHARED_WORDS];
+} shared_image_t;
+
+static shared_slot_t slots[2];
+static atomic_uint current;                 // Индекс опубликованной копии
+static atomic_uint published;               // Поколение последней публикации
+static atomic_uint read_retries;            // Счётчик без атомарного сложения: повторы редки, точность не нужна
+
+#ifdef VFD_HOST_BUILD
+// Публикации из нескольких потоков упорядочиваются флагом
+static atomic_flag writer_lock = ATOMIC_FLAG_INIT;
+
+static inline uint32_t writer_lock_take(void) {
+    while (atomic_flag_test_and_set_explicit(&writer_lock, memory_order_acquire)) {
+        tight_loop_contents();
+    }
+    return 0;
+}
+
+static inline void writer_lock_give(uint32_t save) {
+    (void)save;
+    atomic_flag_clear_explicit(&writer_lock, memory_order_release);
+}
+#else
+// У Cortex-M0+ нет LDREX/STREX: atomic_flag и атомарное сложение там не свободны от блокировок
+// и не упорядочивают ядра между собой, поэтому публикации разделяет аппаратный спин-лок SIO
+static inline uint32_t writer_lock_take(void) {
+    return spin_lock_blocking(spin_lock_instance(SETTINGS_SHARED_SPIN_LOCK));
+}
+
+static inline void writer_lock_give(uint32_t save) {
+    spin_unlock(spin_lock_instance(SETTINGS_SHARED_SPIN_LOCK), save);
+}
+#endif
+
+void settings_shared_init(void) {
+#ifndef VFD_HOST_BUILD
+    // Занимается один раз до запуска второго ядра: проверка и захват при публикации были бы гонкой
+    spin_lock_claim(SETTINGS_SHARED_SPIN_LOCK);
+#endif
+}
+
+uint32_t settings_shared_publish(const settings_t *cfg) {
+    if (!cfg) {
+        LOG_ERROR("Null pointer passed to settings_shared_publish");
+        return 0;
+    }
+    shared_image_t image;
+    memset(&image, 0, sizeof(image));
+    memcpy(&image.cfg, cfg, sizeof(*cfg));
+
+    uint32_t save = writer_lock_take();
+    unsigned next = atomic_load_explicit(&current, memory_order_relaxed) ^ 1;
+    shared_slot_t *slot = &slots[next];
+    unsigned seq = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+    uint32_t generation = atomic_load_explicit(&published, memory_order_relaxed) + 1;
+
+    atomic_store_explicit(&slot->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    for (size_t i = 0; i < SHARED_WORDS; i++) {
+        atomic_store_explicit(&slot->words[i], image.words[i], memory_order_relaxed);
+    }
+    atomic_store_explicit(&slot->generation, generation, memory_order_relaxed);
+    atomic_store_explicit(&slot->seq, seq + 2, memory_order_release);
+
+    atomic_store_explicit(&current, next, memory_order_release);
+    atomic_store_explicit(&published, generation, memory_order_release);
+    writer_lock_give(save);
+    return generation;
+}
+
+uint32_t settings_shared_read(settings_t *cfg) {
+    if (!cfg) {
+        LOG_ERROR("Null pointer passed to settings_shared_read");
+        return 0;
+    }
+    shared_image_t image;
+    for (;;) {
+        const shared_slot_t *slot = &slots[atomic_load_explicit(&current, memory_order_acquire)];
+        unsigned seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if ((seq & 1) == 0) {
+            for (size_t i = 0; i < SHARED_WORDS; i++) {
+                image.words[i] = atomic_load_explicit(&slot->words[i], memory_order_relaxed);
+            }
+            uint32_t generation = atomic_load_explicit(&slot->generation, memory_order_relaxed);
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(&slot->seq, memory_order_relaxed) == seq) {
+                if (generation != 0) {
+                    memcpy(cfg, &image.cfg, sizeof(*cfg));
+                }
+                return generation;
+            }
+        }
+        // Запись перешла на читаемую копию: индекс текущей уже переключён на другую
+        unsigned retries = atomic_load_explicit(&read_retries, memory_order_relaxed);
+        atomic_store_explicit(&read_retries, retries + 1, memory_order_relaxed);
+    }
+}
+
+uint32_t settings_shared_generation(void) {
+    return atomic_load_explicit(&published, memory_order_acquire);
+}
+
+void settings_shared_get_stats(settings_shared_stats_t *stats) {
+    stats->generation = atomic_load_explicit(&published, memory_order_acquire);
+    stats->read_retries = atomic_load_explicit(&read_retries, memory_order_relaxed);
+}
@@ -0,0 +1,67 @@
+#ifndef SETTINGS_SHARED_H
+#define SETTINGS_SHARED_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "settings.h"
+
+/*
+ * Единая точка публикации действующих настроек для обоих ядер.
+ *
+ * Ядро Wi-Fi, NTP и изменения настроек публикует новую версию settings_shared_publish(), ядро
+ * мультиплексирования дисплея читает согласованную копию settings_shared_read() без блокировок.
+ * Копий две: запись идёт в неопубликованную, после чего индекс текущей копии переключается.
+ * Каждая копия защищена счётчиком последовательности (seqlock): чтение повторяется, только если
+ * за время копирования прошли две публикации и запись дошла до читаемой копии. Версии нумеруются
+ * поколениями, начиная с 1.
+ *
+ * Чтение и переключение копий используют только 32-битные загрузки и сохранения с барьерами,
+ * которые на Cortex-M0+ выполняются одной инструкцией. Публикации на устройстве разделяет
+ * аппаратный спин-лок SETTINGS_SHARED_SPIN_LOCK (прерывания на время записи копии запрещены).
+ */
+
+#ifndef SETTINGS_SHARED_SPIN_LOCK
+#define SETTINGS_SHARED_SPIN_LOCK 31       ///< Номер спин-лока SIO (занимается settings_shared_init())
+#endif
+
+/**
+ * @brief Счётчики публикации
+ */
+typedef struct {
+    uint32_t generation;                    ///< Поколение последней публикации (0 - не было)
+    uint32_t read_retries;                  ///< Повторов чтения из-за одновременной записи
+} settings_shared_stats_t;
+
+/**
+ * @brief Занятие спин-лока публикаций
+ * @note Вызывается один раз при старте, до multicore_launch_core1() и первой публикации
+ */
+void settings_shared_init(void);
+
+/**
+ * @brief Публикация новой версии настроек
+ * @param cfg Настройки
+ * @return Поколение опубликованной версии (0 при ошибке)
+ * @note Одновременные публикации упорядочиваются; чтение при этом не ожидает
+ */
+uint32_t settings_shared_publish(const settings_t *cfg);
+
+/**
+ * @brief Чтение согласованной копии последней версии
+ * @param cfg Указатель на структуру для копии
+ * @return Поколение прочитанной версии или 0, если публикаций не было (cfg не изменяется)
+ */
+uint32_t settings_shared_read(settings_t *cfg);
+
+/**
+ * @brief Поколение последней публикации
+ * @note Позволяет не копировать настройки, если поколение не изменилось
+ */
+uint32_t settings_shared_generation(void);
+
+/**
+ * @brief Получение счётчиков публикации
+ */
+void settings_shared_get_stats(settings_shared_stats_t *stats);
+
+#endif // SETTINGS_SHARED_H
@@ -0,0 +1,294 @@
+#include <string.h>
+#include "pico/stdlib.h"
+#include "tslog.h"
+#include "flash_hal.h"
+#include "flash_utils.h"
+#include "crc32.h"
+#include "logging.h"
+
+#define TSLOG_PAGE_MAGIC        0x5354     // "TS"
+#define TSLOG_PAGES_PER_SECTOR  (FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE)
+#define TSLOG_HEADER_WORDS      (TSLOG_PAGE_HEADER_SIZE / sizeof(uint32_t))
+
+// Заголовок страницы: base_time - время первого отсчёта, base - значения до первого отсчёта.
+// CRC32 считается по заголовку до поля crc и по count отсчётам
+typedef struct {
+    uint16_t magic;
+    uint16_t count;
+    uint32_t seq;
+    uint32_t base_time;
+    int32_t base[TSLOG_KINDS];
+    uint32_t reserved;
+    uint32_t crc;
+} tslog_page_hdr_t;
+
+// Отсчёт - два слова: kind << 4 | source | dt << 8 и (uint16_t)delta | aux << 16,
+// где dt - секунды с предыдущего отсчёта страницы, delta - изменение значения того же вида
+_Static_assert(sizeof(tslog_page_hdr_t) == TSLOG_PAGE_HEADER_SIZE, "Page header size mismatch");
+_Static_assert(TSLOG_PAGE_HEADER_SIZE + TSLOG_SAMPLES_PER_PAGE * TSLOG_SAMPLE_SIZE <= FLASH_PAGE_SIZE,
+               "Samples do not fit in a page");
+
+static inline uint32_t tslog_page_offset(const tslog_t *log, uint32_t page) {
+    return log->flash_offset + page * FLASH_PAGE_SIZE;
+}
+
+static uint32_t tslog_page_crc(const uint32_t *words, uint32_t count) {
+    uint32_t crc = crc32_update(CRC32_INIT, (const uint8_t *)words, offsetof(tslog_page_hdr_t, crc));
+    return crc32_update(crc, (const uint8_t *)(words + TSLOG_HEADER_WORDS), count * TSLOG_SAMPLE_SIZE) ^ CRC32_INIT;
+}
+
+static bool tslog_page_valid(const uint32_t *words) {
+    const tslog_page_hdr_t *hdr = (const tslog_page_hdr_t *)words;
+    return hdr->magic == TSLOG_PAGE_MAGIC && hdr->count > 0 && hdr->count <= TSLOG_SAMPLES_PER_PAGE &&
+           tslog_page_crc(words, hdr->count) == hdr->crc;
+}
+
+// Разбор отсчёта: время и значение восстанавливаются от предыдущих
+static void tslog_decode(const uint32_t *sample, uint32_t *time, int32_t *values, tslog_sample_t *out) {
+    uint32_t tag = sample[0] & 0xFF;
+    out->kind = (uint8_t)(tag >> 4);
+    out->source = (uint8_t)(tag & 0x0F);
+    *time += sample[0] >> 8;
+    out->time = *time;
+    if (out->kind < TSLOG_KINDS) {
+        values[out->kind] += (int16_t)(sample[1] & 0xFFFF);
+        out->value = values[out->kind];
+    } else {
+        out->value = 0;
+    }
+    out->aux = (uint16_t)(sample[1] >> 16);
+}
+
+bool tslog_init(tslog_t *log, uint32_t flash_offset) {
+    if (!log) {
+        LOG_ERROR("Null pointer passed to tslog_init");
+        return false;
+    }
+    if (flash_offset % FLASH_SECTOR_SIZE != 0 || flash_offset > PICO_FLASH_SIZE_BYTES - TSLOG_SIZE) {
+        LOG_ERROR("Invalid time-series log offset 0x%08X", flash_offset);
+        return false;
+    }
+    memset(log, 0, sizeof(*log));
+    log->flash_offset = flash_offset;
+    log->next_seq = 1;
+
+    // Самая новая и самая старая страницы; стирание сектора перед записью
+    // исключает страницы прошлых проходов кольца
+    uint32_t newest = TSLOG_PAGES, oldest = TSLOG_PAGES;
+    uint32_t newest_seq = 0, oldest_seq = 0;
+    for (uint32_t page = 0; page < TSLOG_PAGES; page++) {
+        const uint32_t *words = (const uint32_t *)flash_hal_xip_ptr(tslog_page_offset(log, page));
+        const tslog_page_hdr_t *hdr = (const tslog_page_hdr_t *)words;
+        if (hdr->magic == 0xFFFF && hdr->count == 0xFFFF) {
+            continue;
+        }
+        if (!tslog_page_valid(words)) {
+            log->stats.damaged++;
+            continue;
+        }
+        if (newest == TSLOG_PAGES || hdr->seq > newest_seq) {
+            newest = page;
+            newest_seq = hdr->seq;
+        }
+        if (oldest == TSLOG_PAGES || hdr->seq < oldest_seq) {
+            oldest = page;
+            oldest_seq = hdr->seq;
+        }
+    }
+    if (newest == TSLOG_PAGES) {
+        LOG_INFO("Time-series log at 0x%08X is empty", flash_offset);
+        return true;
+    }
+
+    // Последние значения - база и отсчёты самой новой страницы
+    const uint32_t *words = (const uint32_t *)flash_hal_xip_ptr(tslog_page_offset(log, newest));
+    const tslog_page_hdr_t *hdr = (const tslog_page_hdr_t *)words;
+    uint32_t time = hdr->base_time;
+    memcpy(log->last, hdr->base, sizeof(log->last));
+    for (uint32_t i = 0; i < hdr->count; i++) {
+        tslog_sample_t sample;
+        tslog_decode(words + TSLOG_HEADER_WORDS + 2 * i, &time, log->last, &sample);
+    }
+    log->last_time = time;
+    log->next_seq = newest_seq + 1;
+    log->head_page = (newest + 1) % TSLOG_PAGES;
+    log->tail_page = oldest - oldest % TSLOG_PAGES_PER_SECTOR;
+    log->used_pages = (log->head_page + TSLOG_PAGES - log->tail_page) % TSLOG_PAGES;
+    if (log->used_pages == 0) {
+        log->used_pages = TSLOG_PAGES;  // Кольцо заполнено: сектор head_page ещё не выведен
+    }
+
+    LOG_INFO("Time-series log at 0x%08X: %u pages, last sample at %u", flash_offset,
+             (unsigned)log->used_pages, (unsigned)log->last_time);
+    return true;
+}
+
+// Вывод из журнала сектора, в который переходит запись: его данные самые старые
+static bool tslog_retire(tslog_t *log) {
+    uint32_t offset = tslog_page_offset(log, log->head_page);
+    if (flash_is_blank(offset, FLASH_SECTOR_SIZE)) {
+        return true;
+    }
+    if (log->used_pages > 0 && log->tail_page == log->head_page) {
+        log->tail_page = (log->tail_page + TSLOG_PAGES_PER_SECTOR) % TSLOG_PAGES;
+        log->used_pages -= TSLOG_PAGES_PER_SECTOR;
+    }
+    log->stats.retired++;
+    return erase_flash_sector(offset);
+}
+
+bool tslog_flush(tslog_t *log) {
+    if (!log) {
+        LOG_ERROR("Null pointer passed to tslog_flush");
+        return false;
+    }
+    if (log->count == 0) {
+        return true;
+    }
+    tslog_page_hdr_t *hdr = (tslog_page_hdr_t *)log->batch;
+    hdr->count = (uint16_t)log->count;
+    hdr->seq = log->next_seq;
+    hdr->crc = tslog_page_crc(log->batch, log->count);
+
+    // Страница с остатками оборванной записи пропускается, сектор перед записью стирается
+    bool ok = true;
+    for (uint32_t attempt = 0; attempt < TSLOG_PAGES_PER_SECTOR && ok; attempt++) {
+        if (log->head_page % TSLOG_PAGES_PER_SECTOR == 0) {
+            ok = tslog_retire(log);
+            break;
+        }
+        if (flash_is_blank(tslog_page_offset(log, log->head_page), FLASH_PAGE_SIZE)) {
+            break;
+        }
+        LOG_WARN("Time-series page %u is not blank - skipped", (unsigned)log->head_page);
+        log->head_page = (log->head_page + 1) % TSLOG_PAGES;
+        log->used_pages++;
+    }
+
+    uint32_t offset = tslog_page_offset(log, log->head_page);
+    // Свободные отсчёты пакета остаются 0xFF и не программируются
+    ok = ok && program_flash_pages(offset, (const uint8_t *)log->batch, FLASH_PAGE_SIZE);
+    // Страница занята даже при ошибке: она могла записаться частично
+    log->head_page = (log->head_page + 1) % TSLOG_PAGES;
+    log->used_pages++;
+    log->next_seq++;
+    if (ok) {
+        log->stats.pages++;
+    } else {
+        LOG_ERROR("Failed to write time-series page at 0x%08X (%u samples lost)", offset, (unsigned)log->count);
+        log->stats.lost += log->count;
+    }
+    log->count = 0;
+    return ok;
+}
+
+// Начало нового пакета: база - последние значения каждого вида
+static void tslog_open_batch(tslog_t *log, uint32_t time) {
+    memset(log->batch, 0xFF, sizeof(log->batch));
+    tslog_page_hdr_t *hdr = (tslog_page_hdr_t *)log->batch;
+    hdr->magic = TSLOG_PAGE_MAGIC;
+    hdr->base_time = time;
+    memcpy(hdr->base, log->last, sizeof(hdr->base));
+    log->last_time = time;
+}
+
+bool tslog_append(tslog_t *log, const tslog_sample_t *sample) {
+    if (!log || !sample) {
+        LOG_ERROR("Null pointer passed to tslog_append");
+        return false;
+    }
+    if (sample->kind >= TSLOG_KINDS || sample->source > TSLOG_SOURCE_MAX) {
+        LOG_ERROR("Invalid time-series sample (kind %u, source %u)", sample->kind, sample->source);
+        return false;
+    }
+
+    // Разность не помещается в отсчёт (часы переведены назад, большой интервал или скачок
+    // значения): пакет закрывается, новый начинается с собственной базы
+    int64_t delta = (int64_t)sample->value - log->last[sample->kind];
+    bool fits = delta >= INT16_MIN && delta <= INT16_MAX;
+    if (log->count > 0 && (sample->time < log->last_time || sample->time - log->last_time > TSLOG_DT_MAX || !fits)) {
+        if (!tslog_flush(log)) {
+            return false;
+        }
+    }
+    if (log->count == 0) {
+        if (!fits) {
+            // Скачок значения становится базой нового пакета
+            log->last[sample->kind] = sample->value;
+            delta = 0;
+        }
+        tslog_open_batch(log, sample->time);
+    }
+
+    uint32_t *words = log->batch + TSLOG_HEADER_WORDS + 2 * log->count;
+    words[0] = (uint32_t)(sample->kind << 4 | sample->source) | (sample->time - log->last_time) << 8;
+    words[1] = (uint16_t)delta | (uint32_t)sample->aux << 16;
+    log->last[sample->kind] = sample->value;
+    log->last_time = sample->time;
+    log->count++;
+    log->stats.appends++;
+
+    return log->count < TSLOG_SAMPLES_PER_PAGE || tslog_flush(log);
+}
+
+void tslog_iter_init(tslog_iter_t *it, const tslog_t *log, uint32_t from, uint32_t to) {
+    memset(it, 0, sizeof(*it));
+    it->log = log;
+    it->from = from;
+    it->to = to;
+    it->page = log->tail_page;
+    it->pages_left = log->used_pages;
+}
+
+// Переход к следующей странице с отсчётами, которые могут попасть в диапазон
+static bool tslog_iter_page(tslog_iter_t *it) {
+    while (it->pages_left > 0) {
+        const uint32_t *words = (const uint32_t *)flash_hal_xip_ptr(tslog_page_offset(it->log, it->page));
+        const tslog_page_hdr_t *hdr = (const tslog_page_hdr_t *)words;
+        it->page = (it->page + 1) % TSLOG_PAGES;
+        it->pages_left--;
+        // Отсчёты страницы не раньше base_time; номер отсекает страницы, записанные после начала чтения
+        if (tslog_page_valid(words) && hdr->seq > it->last_seq && hdr->base_time <= it->to) {
+            it->last_seq = hdr->seq;
+            it->words = words;
+            it->count = hdr->count;
+            it->index = 0;
+            it->time = hdr->base_time;
+            memcpy(it->value, hdr->base, sizeof(it->value));
+            return true;
+        }
+    }
+    if (!it->batch_done) {
+        it->batch_done = true;
+        const tslog_page_hdr_t *hdr = (const tslog_page_hdr_t *)it->log->batch;
+        if (it->log->count > 0 && hdr->base_time <= it->to) {
+            it->words = it->log->batch;
+            it->count = it->log->count;
+            it->index = 0;
+            it->time = hdr->base_time;
+            memcpy(it->value, hdr->base, sizeof(it->value));
+            return true;
+        }
+    }
+    return false;
+}
+
+bool tslog_iter_next(tslog_iter_t *it, tslog_sample_t *sample) {
+    if (!it || !it->log || !sample) {
+        return false;
+    }
+    for (;;) {
+        while (it->words && it->index < it->count) {
+            tslog_decode(it->words + TSLOG_HEADER_WORDS + 2 * it->index++, &it->time, it->value, sample);
+            if (sample->time > it->to) {
+                it->index = it->count;  // Время внутри страницы не убывает
+            } else if (sample->time >= it->from) {
+                return true;
+            }
+        }
+        it->words = NULL;
+        if (!tslog_iter_page(it)) {
+            return false;
+        }
+    }
+}
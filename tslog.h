@@ -0,0 +1,165 @@
+#ifndef TSLOG_H
+#define TSLOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "hardware/flash.h"
+
+/*
+ * Кольцевой журнал телеметрии во флеш-памяти (результаты синхронизации NTP, освещённость).
+ *
+ * Отсчёты фиксированной ширины (8 байт) копятся в RAM в странице-пакете: время и значение
+ * хранятся разностью с предыдущим отсчётом, база - в заголовке страницы. Заполненная страница
+ * программируется целиком без стирания; сектор стирается только когда запись доходит до него
+ * по кольцу и самые старые данные выводятся из журнала. Чтение диапазона времени идёт
+ * итератором прямо из окна XIP, по одной странице.
+ */
+
+#ifndef TSLOG_SECTORS
+#define TSLOG_SECTORS           4          ///< Количество секторов журнала
+#endif
+#define TSLOG_SIZE              (TSLOG_SECTORS * FLASH_SECTOR_SIZE)
+#define TSLOG_PAGES             (TSLOG_SIZE / FLASH_PAGE_SIZE)
+#define TSLOG_PAGE_HEADER_SIZE  32         ///< Заголовок страницы: номер, база времени и значений, CRC32
+#define TSLOG_SAMPLE_SIZE       8
+#define TSLOG_SAMPLES_PER_PAGE  ((FLASH_PAGE_SIZE - TSLOG_PAGE_HEADER_SIZE) / TSLOG_SAMPLE_SIZE)
+#define TSLOG_SOURCE_MAX        15         ///< Наибольший номер источника (NTP-сервера)
+#define TSLOG_DT_MAX            0xFFFFFF   ///< Наибольший интервал между отсчётами страницы, с
+#define TSLOG_OFFSET_UNIT_US    100        ///< Единица смещения часов в отсчётах NTP, мкс
+
+_Static_assert(TSLOG_SECTORS >= 2, "Time-series log needs at least two sectors");
+
+/**
+ * @brief Виды отсчётов
+ */
+typedef enum {
+    TSLOG_NTP_SYNC = 0,                     ///< Успешная синхронизация: value - смещение, aux - задержка, мс
+    TSLOG_NTP_FAIL,                         ///< Неудачная синхронизация: aux - код ошибки
+    TSLOG_LIGHT,                            ///< Освещённость: value - показание датчика, aux - яркость
+    TSLOG_KINDS
+} tslog_kind_t;
+
+/**
+ * @brief Отсчёт
+ */
+typedef struct {
+    uint32_t time;                          ///< Время, секунды
+    uint8_t kind;                           ///< Вид (tslog_kind_t)
+    uint8_t source;                         ///< Источник: номер NTP-сервера из ntp_servers
+    uint16_t aux;                           ///< Дополнительное значение
+    int32_t value;                          ///< Значение
+} tslog_sample_t;
+
+/**
+ * @brief Статистика журнала
+ */
+typedef struct {
+    uint32_t appends;                       ///< Добавлено отсчётов
+    uint32_t pages;                         ///< Записано страниц
+    uint32_t retired;                       ///< Стёрто секторов (выведено из журнала)
+    uint32_t lost;                          ///< Отсчётов потеряно при ошибке записи
+    uint32_t damaged;                       ///< Повреждённых страниц при запуске
+} tslog_stats_t;
+
+/**
+ * @brief Состояние журнала в RAM
+ */
+typedef struct {
+    uint32_t flash_offset;                  ///< Смещение первого сектора журнала
+    uint32_t head_page;                     ///< Страница для следующего пакета
+    uint32_t tail_page;                     ///< Первая страница самого старого сектора с данными
+    uint32_t used_pages;                    ///< Страниц от tail_page до head_page
+    uint32_t next_seq;                      ///< Номер следующей страницы
+    uint32_t last_time;                     ///< Время последнего отсчёта
+    int32_t last[TSLOG_KINDS];              ///< Последнее значение каждого вида
+    uint32_t count;                         ///< Отсчётов в пакете
+    tslog_stats_t stats;                    ///< Статистика
+    uint32_t batch[FLASH_PAGE_SIZE / sizeof(uint32_t)]; ///< Пакет в RAM (образ страницы)
+} tslog_t;
+
+/**
+ * @brief Итератор чтения диапазона времени
+ */
+typedef struct {
+    const tslog_t *log;                     ///< Журнал
+    uint32_t from;                          ///< Начало диапазона (включительно)
+    uint32_t to;                            ///< Конец диапазона (включительно)
+    uint32_t page;                          ///< Следующая страница во флеш-памяти
+    uint32_t pages_left;                    ///< Страниц во флеш-памяти осталось
+    uint32_t last_seq;                      ///< Номер последней прочитанной страницы
+    bool batch_done;                        ///< Пакет в RAM прочитан
+    const uint32_t *words;                  ///< Текущая страница (XIP или пакет в RAM)
+    uint32_t count;                         ///< Отсчётов в текущей странице
+    uint32_t index;                         ///< Следующий отсчёт страницы
+    uint32_t time;                          ///< Время предыдущего отсчёта
+    int32_t value[TSLOG_KINDS];             ///< Предыдущие значения
+} tslog_iter_t;
+
+/**
+ * @brief Открытие журнала: поиск последней страницы и восстановление базовых значений
+ * @param log Состояние журнала
+ * @param flash_offset Смещение журнала (выровнено по FLASH_SECTOR_SIZE, TSLOG_SIZE байт)
+ * @return true если журнал открыт, false при неверных аргументах
+ * @note Стёртая область становится пустым журналом; флеш-память не изменяется
+ */
+bool tslog_init(tslog_t *log, uint32_t flash_offset);
+
+/**
+ * @brief Добавление отсчёта
+ * @param log Состояние журнала
+ * @param sample Отсчёт
+ * @return true если отсчёт добавлен, false при неверном отсчёте или ошибке записи страницы
+ * @note Флеш-память программируется только при заполнении пакета, стирание - только при выводе сектора
+ */
+bool tslog_append(tslog_t *log, const tslog_sample_t *sample);
+
+/**
+ * @brief Запись неполного пакета (перед перезагрузкой или обновлением)
+ * @return true если пакет записан или пуст
+ * @note Остаток страницы не используется
+ */
+bool tslog_flush(tslog_t *log);
+
+/**
+ * @brief Начало чтения отсчётов с временем из [from, to]
+ * @note Отсчёты выдаются в порядке записи, включая пакет в RAM. Итератор действителен,
+ *       пока журнал не изменяется
+ */
+void tslog_iter_init(tslog_iter_t *it, const tslog_t *log, uint32_t from, uint32_t to);
+
+/**
+ * @brief Следующий отсчёт
+ * @return true если отсчёт получен, false по окончании
+ */
+bool tslog_iter_next(tslog_iter_t *it, tslog_sample_t *sample);
+
+/**
+ * @brief Результат синхронизации с NTP-сервером
+ * @param offset_us Смещение часов, мкс (хранится в единицах TSLOG_OFFSET_UNIT_US)
+ * @param rtt_us Время прохождения запроса, мкс (хранится в миллисекундах)
+ */
+static inline bool tslog_ntp_sync(tslog_t *log, uint32_t time, uint8_t server, int32_t offset_us, uint32_t rtt_us) {
+    uint32_t rtt_ms = rtt_us / 1000;
+    tslog_sample_t sample = { time, TSLOG_NTP_SYNC, server, (uint16_t)(rtt_ms > 0xFFFF ? 0xFFFF : rtt_ms),
+                              offset_us / TSLOG_OFFSET_UNIT_US };
+    return tslog_append(log, &sample);
+}
+
+/**
+ * @brief Неудачная синхронизация с NTP-сервером
+ */
+static inline bool tslog_ntp_fail(tslog_t *log, uint32_t time, uint8_t server, uint16_t error) {
+    tslog_sample_t sample = { time, TSLOG_NTP_FAIL, server, error, 0 };
+    return tslog_append(log, &sample);
+}
+
+/**
+ * @brief Показание датчика освещённости (режим FLAG_ADAPTIVE_BRIGHTNESS)
+ */
+static inline bool tslog_light(tslog_t *log, uint32_t time, uint16_t reading, uint8_t brightness) {
+    tslog_sample_t sample = { time, TSLOG_LIGHT, 0, brightness, reading };
+    return tslog_append(log, &sample);
+}
+
+#endif // TSLOG_H
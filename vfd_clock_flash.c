@@ -1,64 +1,55 @@
 
 #include <stdio.h>
 #include <string.h>
-#include <ctype.h>
+#include <stddef.h>
 #include "pico/stdlib.h"
-#include "hardware/flash.h"
-#include "hardware/sync.h"
+#ifdef VFD_HOST_BUILD
+#include <pthread.h>
+#else
+#include "pico/multicore.h"
+#endif
 #include "settings.h"
+#include "settings_schema.h"
+#include "settings_migrate.h"
+#include "settings_boot.h"
+#include "settings_shared.h"
+#include "settings_codec.h"
+#include "settings_kv.h"
+#include "kvstore.h"
+#include "tslog.h"
+#include "profiles.h"
+#include "ntp_cache.h"
+#include "ntp_sync.h"
+#include "provision.h"
+#include "flash_hal.h"
 #include "flash_utils.h"
+#include "flash_scratch.h"
+#include "settings_sched.h"
+#include "flash_async.h"
+#ifdef VFD_HOST_BUILD
+#include "flash_fault.h"
+#endif
+#include "aead.h"
 #include "logging.h"
+#include "config.h"
 
-// Смещение во флеш-памяти
-#define FLASH_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
-
-// Проверка, что строка не состоит только из пробелов
-static bool is_string_non_empty(const char *str) {
-    while (*str) {
-        if (!isspace((unsigned char)*str)) return true;
-        str++;
-    }
-    return false;
-}
+// Смещение журнала настроек во флеш-памяти (последние секторы)
+#define FLASH_OFFSET (PICO_FLASH_SIZE_BYTES - SETTINGS_LOG_SIZE)
+// Смещение хранилища «ключ - значение» (перед журналом настроек)
+#define KV_OFFSET (FLASH_OFFSET - KV_SIZE)
+// Смещение журнала телеметрии (перед хранилищем «ключ - значение»)
+#define TSLOG_OFFSET (KV_OFFSET - TSLOG_SIZE)
+// Секторы выбора активных профилей (перед журналом телеметрии)
+#define PROFILE_SELECT_OFFSET (TSLOG_OFFSET - PROFILE_SELECT_SIZE_BYTES)
 
 static void print_settings(const settings_t *cfg, const char *title, const uint32_t flash_offset) {
     printf(COLOR_YELLOW "\n=== %s ===\n" COLOR_RESET, title);
-    printf(COLOR_CYAN "Flash Offset       : " COLOR_RESET "0x%08X\n", flash_offset);
-    printf(COLOR_CYAN "Settings Size      : " COLOR_RESET "%u bytes\n", cfg->size);
-    printf(COLOR_CYAN "Magic Number       : " COLOR_RESET "0x%08X\n", cfg->magic);
-    printf(COLOR_CYAN "Version            : " COLOR_RESET "0x%04X\n", cfg->version);
-    printf(COLOR_CYAN "WiFi SSID          : " COLOR_RESET "%s\n", cfg->wifi_ssid);
-    printf(COLOR_CYAN "WiFi Password      : " COLOR_RESET "%s\n", cfg->wifi_pass);
-    printf(COLOR_CYAN "Brightness         : " COLOR_RESET "%u%%\n", cfg->brightness);
-    printf(COLOR_CYAN "Adaptive Brightness: " COLOR_RESET "%s\n", 
-           (cfg->flags & FLAG_ADAPTIVE_BRIGHTNESS) ? COLOR_GREEN "Enabled" COLOR_RESET : COLOR_RED "Disabled" COLOR_RESET);
-    printf(COLOR_CYAN "Night Mode         : " COLOR_RESET "%s\n", 
-           (cfg->flags & FLAG_NIGHT_MODE) ? COLOR_GREEN "Enabled" COLOR_RESET : COLOR_RED "Disabled" COLOR_RESET);
-    printf(COLOR_CYAN "Password Encrypted : " COLOR_RESET "%s\n", 
-           (cfg->flags & FLAG_SETTINGS_ENCRYPTED) ? 
-           COLOR_GREEN "Yes" COLOR_RESET : 
-           COLOR_RED "No (ENCRYPT_WIFI_PASS disabled)" COLOR_RESET);
-    printf(COLOR_CYAN "Night Off Hour     : " COLOR_RESET "%02u:00\n", cfg->night_off_hour);
-    printf(COLOR_CYAN "Night On Hour      : " COLOR_RESET "%02u:00\n", cfg->night_on_hour);
-    printf(COLOR_CYAN "Animations         : " COLOR_RESET "[%c] 1 [%c] 2 [%c] 3 [%c] 4 [%c] Lags\n",
-           (cfg->anim_flags & ANIM_FLAG_1) ? 'X' : ' ',
-           (cfg->anim_flags & ANIM_FLAG_2) ? 'X' : ' ',
-           (cfg->anim_flags & ANIM_FLAG_3) ? 'X' : ' ',
-           (cfg->anim_flags & ANIM_FLAG_4) ? 'X' : ' ',
-           (cfg->anim_flags & ANIM_FLAG_LAGS) ? 'X' : ' ');
-    printf(COLOR_CYAN "Anim Lags Period   : " COLOR_RESET "%u sec\n", cfg->anim_lags_period_s);
-    printf(COLOR_CYAN "NTP Servers        :\n" COLOR_RESET);
-    for (int i = 0; i < NTP_MAX_SERVERS; i++) {
-        if (is_string_non_empty(cfg->ntp_servers[i])) {
-            printf(COLOR_BLUE "  %d: " COLOR_RESET "%s\n", i + 1, cfg->ntp_servers[i]);
-        }
-    }
-    printf(COLOR_CYAN "NTP Sync Period    : " COLOR_RESET "%u min\n", cfg->ntp_sync_period_minutes);
-    printf(COLOR_CYAN "CRC32              : " COLOR_RESET "0x%08X\n", cfg->crc32);
+    printf(COLOR_CYAN "%-19s: " COLOR_RESET "0x%08X\n", "Flash Offset", flash_offset);
+    settings_print(cfg);
 }
 
 static void print_flash_contents(const uint32_t flash_offset) {
-    const uint8_t *flash = (const uint8_t *)(XIP_BASE + flash_offset);
+    const uint8_t *flash = flash_hal_xip_ptr(flash_offset);
     printf(COLOR_YELLOW "Flash Contents (first 32 bytes):\n" COLOR_RESET);
     for (int i = 0; i < 32; i++) {
         printf(COLOR_GREEN "%02X " COLOR_RESET, flash[i]);
@@ -67,29 +58,52 @@ static void print_flash_contents(const uint32_t flash_offset) {
     printf("\n");
 }
 
-static bool compare_settings(const settings_t *cfg1, const settings_t *cfg2) {
-    if (strcmp(cfg1->wifi_ssid, cfg2->wifi_ssid) != 0 ||
-        strcmp(cfg1->wifi_pass, cfg2->wifi_pass) != 0 ||
-        cfg1->brightness != cfg2->brightness ||
-        cfg1->flags != cfg2->flags ||
-        cfg1->night_off_hour != cfg2->night_off_hour ||
-        cfg1->night_on_hour != cfg2->night_on_hour ||
-        cfg1->anim_flags != cfg2->anim_flags ||
-        cfg1->anim_lags_period_s != cfg2->anim_lags_period_s ||
-        cfg1->ntp_sync_period_minutes != cfg2->ntp_sync_period_minutes) {
-        return false;
-    }
-    for (int i = 0; i < NTP_MAX_SERVERS; i++) {
-        if (strcmp(cfg1->ntp_servers[i], cfg2->ntp_servers[i]) != 0) {
-            return false;
-        }
+// Очистка всех секторов журнала настроек
+static bool erase_settings_log(void) {
+    for (uint32_t i = 0; i < SETTINGS_LOG_SECTORS; i++) {
+        if (!erase_flash_sector(FLASH_OFFSET + i * FLASH_SECTOR_SIZE)) return false;
     }
     return true;
 }
 
+// Поиск первой непустой записи журнала (после очистки и одного сохранения - единственной)
+static uint32_t find_first_record(void) {
+    for (uint32_t offset = FLASH_OFFSET; offset < FLASH_OFFSET + SETTINGS_LOG_SIZE; offset += SETTINGS_RECORD_SLOT_SIZE) {
+        const settings_record_t *rec = (const settings_record_t *)flash_hal_xip_ptr(offset);
+        if (rec->seq != 0xFFFFFFFF) return offset;
+    }
+    return FLASH_OFFSET;
+}
+
+// Настройки в формате прошивки до журнала: settings_t в последнем секторе, пароль зашифрован
+// XOR с SETTINGS_MAGIC, CRC32 - последнее поле, остаток сектора - 0xFF
+static bool write_baseline_image(const settings_t *cfg, const char *ssid, const char *pass) {
+    static uint8_t sector[FLASH_SECTOR_SIZE];
+    memset(sector, 0xFF, sizeof(sector));
+    settings_t old = *cfg;
+    old.magic = SETTINGS_MAGIC;
+    old.version = SETTINGS_VERSION;
+    old.size = sizeof(old);
+    memset(old.wifi_ssid, 0, sizeof(old.wifi_ssid));
+    memset(old.wifi_pass, 0, sizeof(old.wifi_pass));
+    snprintf(old.wifi_ssid, WIFI_SSID_MAX_LEN, "%s", ssid);
+    snprintf(old.wifi_pass, WIFI_PASS_MAX_LEN, "%s", pass);
+    old.flags = cfg->flags | FLAG_SETTINGS_ENCRYPTED;
+    for (size_t i = 0; i < strlen(pass); i++) {
+        old.wifi_pass[i] ^= (SETTINGS_MAGIC >> (i % 32)) & 0xFF;
+    }
+    old.crc32 = calculate_crc32((const uint8_t *)&old, sizeof(old) - sizeof(uint32_t));
+    memcpy(sector, &old, sizeof(old));
+    return write_flash_sector(SETTINGS_LEGACY_OFFSET, sector, sizeof(sector));
+}
+
+static bool compare_settings(const settings_t *cfg1, const settings_t *cfg2) {
+    return (settings_diff(cfg1, cfg2) & SETTINGS_USER_FIELDS) == 0;
+}
+
 static bool test_default_settings(void) {
     LOG_INFO("Test 1: Default Settings Save/Load");
-    if (!erase_flash_sector(FLASH_OFFSET)) return false;
+    if (!erase_settings_log()) return false;
 
     settings_t cfg, loaded_cfg;
     settings_init_default(&cfg);
@@ -114,7 +128,7 @@ static bool test_default_settings(void) {
 
 static bool test_edge_cases(void) {
     LOG_INFO("Test 2: Edge Case Settings Save/Load");
-    if (!erase_flash_sector(FLASH_OFFSET)) return false;
+    if (!erase_settings_log()) return false;
 
     settings_t cfg, loaded_cfg;
     settings_init_default(&cfg);
@@ -152,7 +166,7 @@ static bool test_edge_cases(void) {
 
 static bool test_invalid_data(void) {
     LOG_INFO("Test 3: Invalid Data Handling");
-    if (!erase_flash_sector(FLASH_OFFSET)) return false;
+    if (!erase_settings_log()) return false;
 
     settings_t cfg;
     settings_init_default(&cfg);
@@ -161,19 +175,18 @@ static bool test_invalid_data(void) {
         return false;
     }
 
-    uint8_t temp_buffer[FLASH_SECTOR_SIZE];
-    memset(temp_buffer, 0xFF, FLASH_SECTOR_SIZE);
-    settings_t *temp = (settings_t *)temp_buffer;
-    memcpy(temp, &cfg, sizeof(settings_t));
-    temp->crc32 = 0xDEADBEEF;
-    write_flash_sector(FLASH_OFFSET, temp_buffer, FLASH_SECTOR_SIZE);
+    // Портим CRC единственной записи журнала
+    uint32_t record_offset = find_first_record();
+    const uint32_t bad_crc = 0xDEADBEEF;
+    write_flash_range(record_offset + offsetof(settings_record_t, data) + offsetof(settings_t, crc32),
+                      (const uint8_t *)&bad_crc, sizeof(bad_crc));
 
     if (settings_load(&cfg, FLASH_OFFSET)) {
         LOG_ERROR("Test 3 failed: accepted invalid CRC");
         return false;
     }
 
-    if (!erase_flash_sector(FLASH_OFFSET)) return false;
+    if (!erase_settings_log()) return false;
     if (settings_load(&cfg, FLASH_OFFSET)) {
         LOG_ERROR("Test 3 failed: accepted blank flash");
         return false;
@@ -186,7 +199,7 @@ static bool test_invalid_data(void) {
 
 static bool test_corrupted_data(void) {
     LOG_INFO("Test 4: Corrupted Data Handling");
-    if (!erase_flash_sector(FLASH_OFFSET)) return false;
+    if (!erase_settings_log()) return false;
 
     settings_t cfg;
     settings_init_default(&cfg);
@@ -195,10 +208,10 @@ static bool test_corrupted_data(void) {
         return false;
     }
 
-    uint8_t temp_buffer[FLASH_SECTOR_SIZE];
-    memcpy(temp_buffer, &cfg, sizeof(settings_t));
-    temp_buffer[10] ^= 0xFF;  // Инверсия одного байта
-    write_flash_sector(FLASH_OFFSET, temp_buffer, FLASH_SECTOR_SIZE);
+    uint32_t record_offset = find_first_record();
+    const uint32_t byte_offset = record_offset + offsetof(settings_record_t, data) + 10;
+    const uint8_t inverted = *flash_hal_xip_ptr(byte_offset) ^ 0xFF;  // Инверсия одного байта
+    write_flash_range(byte_offset, &inverted, 1);
 
     if (settings_load(&cfg, FLASH_OFFSET)) {
         LOG_ERROR("Test 4 failed: accepted corrupted data");
@@ -211,7 +224,7 @@ static bool test_corrupted_data(void) {
 
 static bool test_buffer_overflow(void) {
     LOG_INFO("Test 5: Buffer Overflow Handling");
-    if (!erase_flash_sector(FLASH_OFFSET)) return false;
+    if (!erase_settings_log()) return false;
 
     settings_t cfg;
     settings_init_default(&cfg);
@@ -231,7 +244,7 @@ static bool test_buffer_overflow(void) {
 
 static bool test_encryption(void) {
     LOG_INFO("Test 6: WiFi Password Encryption/Decryption");
-    if (!erase_flash_sector(FLASH_OFFSET)) return false;
+    if (!erase_settings_log()) return false;
 
     settings_t cfg, loaded_cfg;
     settings_init_default(&cfg);
@@ -247,8 +260,8 @@ static bool test_encryption(void) {
         return false;
     }
 
-    const uint8_t *flash = (const uint8_t *)(XIP_BASE + FLASH_OFFSET);
-    settings_t *flash_cfg = (settings_t *)flash;
+    const settings_record_t *flash_rec = (const settings_record_t *)flash_hal_xip_ptr(find_first_record());
+    const settings_t *flash_cfg = &flash_rec->data;
     if (memcmp(flash_cfg->wifi_pass, test_pass, strlen(test_pass)) == 0) {
         LOG_ERROR("Test 6 failed: password not encrypted on flash");
         return false;
@@ -272,7 +285,7 @@ static bool test_encryption(void) {
 
 static bool test_invalid_values(void) {
     LOG_INFO("Test 7: Invalid Values Handling");
-    if (!erase_flash_sector(FLASH_OFFSET)) return false;
+    if (!erase_settings_log()) return false;
 
     settings_t cfg;
     settings_init_default(&cfg);
@@ -286,48 +299,2191 @@ static bool test_invalid_values(void) {
     return true;
 }
 
-int main(void) {
-    stdio_init_all();
-    sleep_ms(1000);  // Ожидание стабилизации UART (TODO: Replace with proper uart_init in production firmware)
+static bool test_log_wraparound(void) {
+    LOG_INFO("Test 8: Settings Log Wear Leveling");
+    if (!erase_settings_log()) return false;
 
-    printf(COLOR_YELLOW "\n=== Settings Management Test Suite ===\n" COLOR_RESET);
-    printf(COLOR_CYAN "Expected Settings Size: " COLOR_RESET "%u bytes\n", (unsigned)sizeof(settings_t));
+    settings_t cfg, loaded_cfg;
+    settings_init_default(&cfg);
+    // Больше сохранений, чем слотов в кольце: журнал должен перейти на начало
+    const uint32_t saves = SETTINGS_LOG_SECTORS * SETTINGS_SLOTS_PER_SECTOR + 3;
+    for (uint32_t i = 0; i < saves; i++) {
+        cfg.brightness = i % (BRIGHTNESS_MAX + 1);
+        if (!settings_save(&cfg, FLASH_OFFSET)) {
+            LOG_ERROR("Test 8 failed at save %u", (unsigned)i);
+            return false;
+        }
+        if (!settings_load(&loaded_cfg, FLASH_OFFSET) || !compare_settings(&cfg, &loaded_cfg)) {
+            LOG_ERROR("Test 8 failed: save %u not loaded back", (unsigned)i);
+            return false;
+        }
+    }
 
-    int passed_tests = 0;
-    int failed_tests = 0;
-    bool result;
-
-    result = test_default_settings();
-    result ? passed_tests++ : failed_tests++;
-    result = test_edge_cases();
-    result ? passed_tests++ : failed_tests++;
-    result = test_invalid_data();
-    result ? passed_tests++ : failed_tests++;
-    result = test_corrupted_data();
-    result ? passed_tests++ : failed_tests++;
-    result = test_buffer_overflow();
-    result ? passed_tests++ : failed_tests++;
-    result = test_encryption();
-    result ? passed_tests++ : failed_tests++;
-    result = test_invalid_values();
-    result ? passed_tests++ : failed_tests++;
+    // После перехода кольца старые секторы переиспользованы, а записи идут подряд без пропусков
+    const uint32_t total_slots = SETTINGS_LOG_SECTORS * SETTINGS_SLOTS_PER_SECTOR;
+    uint32_t min_seq = 0xFFFFFFFF, max_seq = 0, written = 0;
+    for (uint32_t slot = 0; slot < total_slots; slot++) {
+        const settings_record_t *rec = (const settings_record_t *)flash_hal_xip_ptr(FLASH_OFFSET + slot * SETTINGS_RECORD_SLOT_SIZE);
+        if ((rec->seq ^ rec->seq_inv) != 0xFFFFFFFF) continue;
+        if (rec->seq < min_seq) min_seq = rec->seq;
+        if (rec->seq > max_seq) max_seq = rec->seq;
+        written++;
+    }
+    if (written >= saves || written <= total_slots - SETTINGS_SLOTS_PER_SECTOR || max_seq - min_seq + 1 != written) {
+        LOG_ERROR("Test 8 failed: unexpected log contents (%u records, seq %u..%u)",
+                  (unsigned)written, (unsigned)min_seq, (unsigned)max_seq);
+        return false;
+    }
 
-    if (failed_tests == 0) {
-        LOG_INFO("All tests passed successfully");
-    } else {
-        LOG_ERROR("Some tests failed");
+    // Образ прошивки до журнала: настройки переносятся первой записью, после чего их сектор стирается
+    if (!erase_settings_log() || !write_baseline_image(&cfg, "BaselineNet", "BaselinePass")) {
+        LOG_ERROR("Test 8 failed at writing baseline image");
+        return false;
+    }
+    if (!settings_load(&loaded_cfg, FLASH_OFFSET) || strcmp(loaded_cfg.wifi_ssid, "BaselineNet") != 0 ||
+        strcmp(loaded_cfg.wifi_pass, "BaselinePass") != 0 || loaded_cfg.brightness != cfg.brightness ||
+        settings_generation(FLASH_OFFSET) != 1 || find_first_record() != FLASH_OFFSET ||
+        !flash_is_blank(SETTINGS_LEGACY_OFFSET, FLASH_SECTOR_SIZE)) {
+        LOG_ERROR("Test 8 failed: baseline settings not moved into the log");
+        return false;
     }
 
-    printf(COLOR_YELLOW "\nTest Summary:\n" COLOR_RESET);
-    printf(COLOR_GREEN "Passed: %d\n" COLOR_RESET, passed_tests);
-    printf(COLOR_RED "Failed: %d\n" COLOR_RESET, failed_tests);
-    printf(COLOR_CYAN "Total: %d\n" COLOR_RESET, passed_tests + failed_tests);
+    // Питание пропало между переносом и стиранием: загружается журнал, сектор стирается теперь
+    if (!write_baseline_image(&cfg, "StaleNet", "StalePass") || !settings_load(&loaded_cfg, FLASH_OFFSET) ||
+        strcmp(loaded_cfg.wifi_ssid, "BaselineNet") != 0 || settings_generation(FLASH_OFFSET) != 1 ||
+        !flash_is_blank(SETTINGS_LEGACY_OFFSET, FLASH_SECTOR_SIZE)) {
+        LOG_ERROR("Test 8 failed: leftover legacy sector after an interrupted move");
+        return false;
+    }
+    cfg = loaded_cfg;
+    for (uint32_t i = 0; i < total_slots; i++) {
+        cfg.night_off_hour = i % (HOUR_MAX + 1);
+        if (!settings_save(&cfg, FLASH_OFFSET) || !settings_load(&loaded_cfg, FLASH_OFFSET) ||
+            !compare_settings(&cfg, &loaded_cfg)) {
+            LOG_ERROR("Test 8 failed: save %u after baseline migration", (unsigned)i);
+            return false;
+        }
+    }
 
-    if (!erase_flash_sector(FLASH_OFFSET)) {
-        LOG_ERROR("Failed to clear flash at end");
+    LOG_INFO("Test 8 completed successfully");
+    return true;
+}
+
+static bool test_nor_semantics(void) {
+    LOG_INFO("Test 9: NOR Program Semantics");
+    if (!erase_settings_log()) return false;
+
+    uint8_t page[FLASH_PAGE_SIZE];
+    memset(page, 0x0F, sizeof(page));
+    if (!program_flash_pages(FLASH_OFFSET, page, sizeof(page))) {
+        LOG_ERROR("Test 9 failed at first program");
+        return false;
     }
-    print_flash_contents(FLASH_OFFSET);
-    printf(COLOR_YELLOW "=== Test Suite Completed ===\n" COLOR_RESET);
 
+    // Повторное программирование без стирания может только сбросить биты
+    memset(page, 0xF0, sizeof(page));
+    if (program_flash_pages(FLASH_OFFSET, page, sizeof(page))) {
+        LOG_ERROR("Test 9 failed: bits set without erase");
+        return false;
+    }
+    const uint8_t *flash = flash_hal_xip_ptr(FLASH_OFFSET);
+    for (size_t i = 0; i < sizeof(page); i++) {
+        if (flash[i] != 0x00) {
+            LOG_ERROR("Test 9 failed: byte %u is 0x%02X (expected 0x00)", (unsigned)i, flash[i]);
+            return false;
+        }
+    }
+
+    if (!erase_settings_log() || flash[0] != 0xFF) {
+        LOG_ERROR("Test 9 failed: sector not erased");
+        return false;
+    }
+
+    LOG_INFO("Test 9 completed successfully");
+    return true;
+}
+
+static bool test_range_write(void) {
+    LOG_INFO("Test 10: Partial Range Writes");
+    if (!erase_settings_log()) return false;
+
+    flash_hal_stats_t stats;
+    const uint32_t offset = FLASH_OFFSET + FLASH_PAGE_SIZE - 4;  // Диапазон пересекает границу страниц
+    uint8_t data[16];
+    memset(data, 0x5A, sizeof(data));
+
+    // Запись в стёртую область: только программирование двух затронутых страниц
+    flash_hal_reset_stats();
+    if (!write_flash_range(offset, data, sizeof(data))) {
+        LOG_ERROR("Test 10 failed at first write");
+        return false;
+    }
+    flash_hal_get_stats(&stats);
+    if (stats.erase_ops != 0 || stats.program_bytes != 2 * FLASH_PAGE_SIZE) {
+        LOG_ERROR("Test 10 failed: %u erases, %u bytes programmed on blank flash",
+                  (unsigned)stats.erase_ops, (unsigned)stats.program_bytes);
+        return false;
+    }
+
+    // Повторная запись тех же данных ничего не программирует
+    flash_hal_reset_stats();
+    write_flash_range(offset, data, sizeof(data));
+    flash_hal_get_stats(&stats);
+    if (stats.program_ops != 0 || stats.erase_ops != 0) {
+        LOG_ERROR("Test 10 failed: unchanged data was reprogrammed");
+        return false;
+    }
+
+    // Установка битов требует стирания, соседние данные сектора сохраняются
+    const uint8_t marker = 0x00;
+    write_flash_range(FLASH_OFFSET + 2 * FLASH_PAGE_SIZE, &marker, 1);
+    data[0] = 0xFF;
+    flash_hal_reset_stats();
+    if (!write_flash_range(offset, data, sizeof(data))) {
+        LOG_ERROR("Test 10 failed at rewrite");
+        return false;
+    }
+    flash_hal_get_stats(&stats);
+    const uint8_t *flash = flash_hal_xip_ptr(offset);
+    if (stats.erase_ops != 1 || memcmp(flash, data, sizeof(data)) != 0 ||
+        *flash_hal_xip_ptr(FLASH_OFFSET + 2 * FLASH_PAGE_SIZE) != marker) {
+        LOG_ERROR("Test 10 failed: rewrite with erase lost data");
+        return false;
+    }
+
+    // Пакетное программирование несмежных страниц
+    uint8_t page[FLASH_PAGE_SIZE];
+    memset(page, 0xA5, sizeof(page));
+    flash_page_write_t pages[] = {
+        { FLASH_OFFSET + FLASH_SECTOR_SIZE, page },
+        { FLASH_OFFSET + FLASH_SECTOR_SIZE + 4 * FLASH_PAGE_SIZE, page },
+    };
+    if (!program_flash_page_list(pages, 2)) {
+        LOG_ERROR("Test 10 failed at page list program");
+        return false;
+    }
+
+    LOG_INFO("Test 10 completed successfully");
+    return true;
+}
+
+static bool test_power_cut_fallback(void) {
+    LOG_INFO("Test 11: Interrupted Save Falls Back To Previous Copy");
+    if (!erase_settings_log()) return false;
+
+    settings_t cfg, newer_cfg, loaded_cfg;
+    settings_init_default(&cfg);
+    cfg.brightness = 10;
+    newer_cfg = cfg;
+    newer_cfg.brightness = 20;
+    if (!settings_save(&cfg, FLASH_OFFSET) || !settings_save(&newer_cfg, FLASH_OFFSET)) {
+        LOG_ERROR("Test 11 failed at save");
+        return false;
+    }
+
+    // Имитация обрыва питания: вторая страница новой записи недописана (биты сброшены)
+    uint32_t newest = find_first_record() + SETTINGS_RECORD_SLOT_SIZE;
+    uint8_t page[FLASH_PAGE_SIZE];
+    memset(page, 0x00, sizeof(page));
+    program_flash_pages(newest + FLASH_PAGE_SIZE, page, sizeof(page));
+
+    if (!settings_load(&loaded_cfg, FLASH_OFFSET) || !compare_settings(&cfg, &loaded_cfg)) {
+        LOG_ERROR("Test 11 failed: previous copy not recovered");
+        return false;
+    }
+
+    // Следующее сохранение идёт в свободный слот и становится актуальным
+    if (!settings_save(&newer_cfg, FLASH_OFFSET) ||
+        !settings_load(&loaded_cfg, FLASH_OFFSET) || !compare_settings(&newer_cfg, &loaded_cfg)) {
+        LOG_ERROR("Test 11 failed: save after interrupted write");
+        return false;
+    }
+
+    LOG_INFO("Test 11 completed successfully");
+    return true;
+}
+
+static bool test_zero_copy_view(void) {
+    LOG_INFO("Test 12: Zero-Copy Settings View");
+    if (!erase_settings_log()) return false;
+
+    if (settings_view(FLASH_OFFSET) != NULL) {
+        LOG_ERROR("Test 12 failed: view of blank log");
+        return false;
+    }
+
+    settings_t cfg;
+    settings_init_default(&cfg);
+    cfg.brightness = 77;
+    cfg.night_on_hour = 7;
+    snprintf(cfg.wifi_pass, WIFI_PASS_MAX_LEN, "%s", "ViewPass42");
+    if (!settings_save(&cfg, FLASH_OFFSET)) {
+        LOG_ERROR("Test 12 failed at save");
+        return false;
+    }
+
+    const settings_t *view = settings_view(FLASH_OFFSET);
+    const uint8_t *flash_start = flash_hal_xip_ptr(FLASH_OFFSET);
+    if (!view || (const uint8_t *)view < flash_start || (const uint8_t *)view >= flash_start + SETTINGS_LOG_SIZE) {
+        LOG_ERROR("Test 12 failed: view does not point into flash");
+        return false;
+    }
+    if (settings_view_brightness(view) != 77 || settings_view_night_on_hour(view) != 7 ||
+        strcmp(settings_view_wifi_ssid(view), cfg.wifi_ssid) != 0) {
+        LOG_ERROR("Test 12 failed: field mismatch through view");
+        return false;
+    }
+
+    char pass[WIFI_PASS_MAX_LEN];
+    if (!settings_view_wifi_pass(view, pass, sizeof(pass)) || strcmp(pass, cfg.wifi_pass) != 0) {
+        LOG_ERROR("Test 12 failed: lazy password decryption");
+        return false;
+    }
+
+    // После сохранения представление указывает на новую запись
+    cfg.brightness = 33;
+    if (!settings_save(&cfg, FLASH_OFFSET) || settings_view_brightness(settings_view(FLASH_OFFSET)) != 33) {
+        LOG_ERROR("Test 12 failed: view not updated after save");
+        return false;
+    }
+
+    LOG_INFO("Test 12 completed successfully");
+    return true;
+}
+
+static bool test_deferred_save(void) {
+    LOG_INFO("Test 13: Coalescing Deferred Save");
+    if (!erase_settings_log()) return false;
+
+    settings_t cfg, loaded_cfg;
+    settings_init_default(&cfg);
+    settings_sched_t sched;
+    settings_sched_init(&sched, &cfg, FLASH_OFFSET, 100, 500);
+
+    // Десять быстрых изменений яркости с интервалом 20 мс (виртуальное время)
+    flash_hal_stats_t stats;
+    flash_hal_reset_stats();
+    uint64_t now_us = 0;
+    for (int i = 0; i < 10; i++) {
+        settings_sched_edit(&sched)->brightness = 10 + i;
+        settings_sched_mark_dirty(&sched, now_us);
+        if (settings_sched_poll(&sched, now_us)) {
+            LOG_ERROR("Test 13 failed: commit during burst");
+            return false;
+        }
+        now_us += 20 * 1000;
+    }
+    if (!settings_sched_poll(&sched, now_us + 100 * 1000)) {
+        LOG_ERROR("Test 13 failed: no commit after quiet window");
+        return false;
+    }
+    flash_hal_get_stats(&stats);
+    if (sched.stats.requests != 10 || sched.stats.commits != 1 || stats.program_ops != 1) {
+        LOG_ERROR("Test 13 failed: %u requests, %u commits, %u programs",
+                  (unsigned)sched.stats.requests, (unsigned)sched.stats.commits, (unsigned)stats.program_ops);
+        return false;
+    }
+    if (!settings_load(&loaded_cfg, FLASH_OFFSET) || loaded_cfg.brightness != 19) {
+        LOG_ERROR("Test 13 failed: coalesced value not stored");
+        return false;
+    }
+
+    // Непрерывные изменения всё равно записываются не реже max_latency
+    now_us += 1000 * 1000;
+    for (int i = 0; i < 25; i++) {
+        settings_sched_edit(&sched)->night_on_hour = i % (HOUR_MAX + 1);
+        settings_sched_mark_dirty(&sched, now_us);
+        settings_sched_poll(&sched, now_us);
+        now_us += 50 * 1000;
+    }
+    if (sched.stats.commits != 3) {
+        LOG_ERROR("Test 13 failed: %u commits under continuous changes", (unsigned)sched.stats.commits);
+        return false;
+    }
+
+    // Недопустимое значение не принимается и не публикуется, RAM-копия возвращается к принятой,
+    // а принятое раньше изменение по-прежнему записывается
+    settings_sched_edit(&sched)->night_on_hour = 5;
+    settings_sched_mark_dirty(&sched, now_us);
+    uint32_t published = settings_shared_generation();
+    settings_sched_edit(&sched)->brightness = BRIGHTNESS_MAX + 1;
+    if (settings_sched_mark_dirty(&sched, now_us) || settings_shared_generation() != published ||
+        settings_sched_edit(&sched)->brightness != 19 || settings_sched_edit(&sched)->night_on_hour != 5 ||
+        !settings_sched_flush(&sched) || !settings_load(&loaded_cfg, FLASH_OFFSET) ||
+        loaded_cfg.night_on_hour != 5 || loaded_cfg.brightness != 19) {
+        LOG_ERROR("Test 13 failed: invalid change accepted or earlier change lost");
+        return false;
+    }
+    settings_sched_edit(&sched)->night_on_hour = 0;
+    settings_sched_mark_dirty(&sched, now_us);
+
+#ifdef VFD_HOST_BUILD
+    // Неудачная запись: изменения остаются несохранёнными и записываются повтором после паузы
+    settings_sched_edit(&sched)->night_off_hour = 1;
+    settings_sched_mark_dirty(&sched, now_us);
+    now_us += 1000 * 1000;
+    flash_hal_host_set_power_cut(0);
+    bool saved = settings_sched_poll(&sched, now_us);
+    bool early = settings_sched_poll(&sched, now_us + (SETTINGS_SCHED_RETRY_MS - 1) * 1000ull);
+    flash_hal_host_set_power_cut(FLASH_HAL_NO_POWER_CUT);
+    if (saved || early || !sched.dirty || sched.stats.failures != 1 ||
+        !settings_sched_poll(&sched, now_us + SETTINGS_SCHED_RETRY_MS * 1000ull) || sched.dirty ||
+        !settings_load(&loaded_cfg, FLASH_OFFSET) || loaded_cfg.night_off_hour != 1) {
+        LOG_ERROR("Test 13 failed: failed save not retried (%u failures)", (unsigned)sched.stats.failures);
+        return false;
+    }
+#endif
+
+    // Явный сброс перед выключением
+    if (!settings_sched_flush(&sched) || sched.dirty ||
+        !settings_load(&loaded_cfg, FLASH_OFFSET) || loaded_cfg.night_on_hour != 0) {
+        LOG_ERROR("Test 13 failed: flush did not persist pending changes");
+        return false;
+    }
+
+    LOG_INFO("Test 13 completed successfully");
+    return true;
+}
+
+// Цикл второго ядра (мультиплексирование дисплея): код и данные только в SRAM
+static volatile bool peer_stop;
+static volatile uint32_t peer_ticks;
+
+static void __not_in_flash_func(peer_display_loop)(void) {
+    flash_hal_peer_init();
+    while (!peer_stop) {
+        flash_hal_peer_checkpoint();
+        peer_ticks++;
+    }
+    flash_hal_peer_exit();
+}
+
+#ifdef VFD_HOST_BUILD
+static pthread_t peer_thread;
+
+static void *peer_thread_entry(void *arg) {
+    (void)arg;
+    peer_display_loop();
+    return NULL;
+}
+#endif
+
+static void peer_start(void) {
+    peer_stop = false;
+    peer_ticks = 0;
+#ifdef VFD_HOST_BUILD
+    pthread_create(&peer_thread, NULL, peer_thread_entry, NULL);
+#else
+    multicore_launch_core1(peer_display_loop);
+#endif
+    while (peer_ticks == 0) {
+        tight_loop_contents();
+    }
+}
+
+static void peer_finish(void) {
+    peer_stop = true;
+#ifdef VFD_HOST_BUILD
+    pthread_join(peer_thread, NULL);
+#else
+    sleep_ms(1);
+    multicore_reset_core1();
+#endif
+}
+
+static void flash_job_done(bool ok, void *user) {
+    int *counter = (int *)user;
+    *counter += ok ? 1 : -100;
+}
+
+static bool test_async_flash_jobs(void) {
+    LOG_INFO("Test 14: Asynchronous Flash Jobs With Second Core Running");
+    if (!erase_settings_log()) return false;
+
+    static uint8_t page[FLASH_PAGE_SIZE];
+    memset(page, 0x3C, sizeof(page));
+    int completed = 0;
+    flash_hal_stats_t stats;
+
+    // Режим остановки: второе ядро ждёт в SRAM только на время операции
+    peer_start();
+    flash_hal_set_peer_mode(FLASH_PEER_LOCKOUT);
+    flash_hal_reset_stats();
+    flash_job_t jobs[] = {
+        { FLASH_JOB_WRITE_RANGE, FLASH_OFFSET, page, sizeof(page), flash_job_done, &completed },
+        { FLASH_JOB_ERASE, FLASH_OFFSET, NULL, 0, flash_job_done, &completed },
+        { FLASH_JOB_PROGRAM, FLASH_OFFSET + FLASH_PAGE_SIZE, page, sizeof(page), flash_job_done, &completed },
+    };
+    for (size_t i = 0; i < sizeof(jobs) / sizeof(jobs[0]); i++) {
+        if (!flash_async_submit(&jobs[i])) {
+            LOG_ERROR("Test 14 failed: job %u rejected", (unsigned)i);
+            peer_finish();
+            return false;
+        }
+    }
+    if (completed != 0 || flash_async_pending() != 3) {
+        LOG_ERROR("Test 14 failed: jobs ran synchronously");
+        peer_finish();
+        return false;
+    }
+    while (flash_async_task()) {
+    }
+    flash_hal_get_stats(&stats);
+    if (completed != 3 || !flash_is_blank(FLASH_OFFSET, FLASH_PAGE_SIZE) ||
+        memcmp(flash_hal_xip_ptr(FLASH_OFFSET + FLASH_PAGE_SIZE), page, sizeof(page)) != 0 ||
+        stats.lockouts == 0 || stats.xip_violations != 0) {
+        LOG_ERROR("Test 14 failed: %d callbacks, %u lockouts, %u XIP violations",
+                  completed, (unsigned)stats.lockouts, (unsigned)stats.xip_violations);
+        peer_finish();
+        return false;
+    }
+
+    // Режим SRAM: второе ядро продолжает работу во время стирания
+#ifdef VFD_HOST_BUILD
+    flash_hal_host_set_timing(20000, 0);  // Стирание сектора ~20 мс
+#endif
+    flash_hal_set_peer_mode(FLASH_PEER_RAM_RESIDENT);
+    flash_job_t erase_job = { FLASH_JOB_ERASE, FLASH_OFFSET, NULL, 0, flash_job_done, &completed };
+    flash_async_submit(&erase_job);
+    uint32_t ticks_before = peer_ticks;
+    flash_async_task();
+    uint32_t ticks_during = peer_ticks - ticks_before;
+#ifdef VFD_HOST_BUILD
+    flash_hal_host_set_timing(0, 0);
+#endif
+    flash_hal_set_peer_mode(FLASH_PEER_LOCKOUT);
+    peer_finish();
+
+    if (completed != 4 || ticks_during == 0) {
+        LOG_ERROR("Test 14 failed: second core stalled during erase (%u ticks)", (unsigned)ticks_during);
+        return false;
+    }
+
+    LOG_INFO("Test 14 completed successfully (%u lockouts, %u display ticks during erase)",
+             (unsigned)stats.lockouts, (unsigned)ticks_during);
+    return true;
+}
+
+static bool test_schema_migration(void) {
+    LOG_INFO("Test 15: Migration Of Shipped Settings Layout");
+    if (!erase_settings_log()) return false;
+
+    // Образ выпущенной прошивки: журнал пуст, настройки лежат в последнем секторе
+    settings_t old;
+    settings_init_default(&old);
+    old.brightness = 64;
+    old.flags = FLAG_NIGHT_MODE;
+    old.night_off_hour = 23;
+    old.night_on_hour = 7;
+    old.anim_flags = ANIM_FLAG_2;
+    old.ntp_sync_period_minutes = 120;
+    if (!write_baseline_image(&old, "LegacyNet", "LegacyPass")) {
+        LOG_ERROR("Test 15 failed at writing baseline image");
+        return false;
+    }
+
+    if (settings_view(FLASH_OFFSET) != NULL) {
+        LOG_ERROR("Test 15 failed: zero-copy view before the baseline is moved into the log");
+        return false;
+    }
+
+    settings_t loaded;
+    flash_hal_stats_t stats;
+    flash_hal_reset_stats();
+    if (!settings_load(&loaded, FLASH_OFFSET)) {
+        LOG_ERROR("Test 15 failed: old record rejected");
+        return false;
+    }
+    flash_hal_get_stats(&stats);
+    if (loaded.version != SETTINGS_VERSION || loaded.size != sizeof(settings_t) ||
+        strcmp(loaded.wifi_ssid, "LegacyNet") != 0 || strcmp(loaded.wifi_pass, "LegacyPass") != 0 ||
+        loaded.brightness != 64 || loaded.night_off_hour != 23 || loaded.anim_flags != ANIM_FLAG_2 ||
+        loaded.ntp_sync_period_minutes != 120 || loaded.night_on_hour != 7) {
+        LOG_ERROR("Test 15 failed: fields lost in migration");
+        print_settings(&loaded, "Migrated Settings", FLASH_OFFSET);
+        return false;
+    }
+    if (stats.program_ops == 0) {
+        LOG_ERROR("Test 15 failed: migrated record not written back");
+        return false;
+    }
+
+    // Повторная загрузка читает уже обновлённую запись: без миграции и без записи
+    settings_t reloaded;
+    flash_hal_reset_stats();
+    if (!settings_load(&reloaded, FLASH_OFFSET) || !compare_settings(&loaded, &reloaded)) {
+        LOG_ERROR("Test 15 failed: reload after migration");
+        return false;
+    }
+    flash_hal_get_stats(&stats);
+    const settings_t *view = settings_view(FLASH_OFFSET);
+    if (stats.program_ops != 0 || stats.erase_ops != 0 || !view || view->version != SETTINGS_VERSION) {
+        LOG_ERROR("Test 15 failed: migration repeated (%u program ops)", (unsigned)stats.program_ops);
+        return false;
+    }
+
+    LOG_INFO("Test 15 completed successfully");
+    return true;
+}
+
+static bool test_deferred_logging(void) {
+    LOG_INFO("Test 16: Deferred Binary Logging");
+    log_flush();
+
+    // Строковые аргументы копируются в запись: буфер можно менять сразу после вызова
+    char ssid[WIFI_SSID_MAX_LEN];
+    snprintf(ssid, sizeof(ssid), "%s", "RingNet");
+    log_write(LOG_LEVEL_WARN, "Slot %u at 0x%08X: %s (%d%%)", 7u, 0x1000u, ssid, -5);
+    memset(ssid, 'X', sizeof(ssid) - 1);
+    log_write(LOG_LEVEL_INFO, "Stats %llu/%zu", 1ULL << 40, sizeof(settings_t));
+
+    char line[128];
+    uint64_t t1, t2;
+    if (log_read(line, sizeof(line), &t1) != LOG_LEVEL_WARN || strcmp(line, "Slot 7 at 0x00001000: RingNet (-5%)") != 0) {
+        LOG_ERROR("Test 16 failed: first record decoded as \"%s\"", line);
+        return false;
+    }
+    char expected[64];
+    snprintf(expected, sizeof(expected), "Stats %llu/%zu", 1ULL << 40, sizeof(settings_t));
+    if (log_read(line, sizeof(line), &t2) != LOG_LEVEL_INFO || strcmp(line, expected) != 0 || t2 < t1) {
+        LOG_ERROR("Test 16 failed: second record decoded as \"%s\"", line);
+        return false;
+    }
+    if (log_read(line, sizeof(line), NULL) != LOG_LEVEL_NONE) {
+        LOG_ERROR("Test 16 failed: ring not empty after reading");
+        return false;
+    }
+
+    // Переполнение: лишние сообщения отбрасываются, сохранённые читаются по порядку
+    uint32_t dropped_before = log_dropped();
+    unsigned written = 0;
+    while (log_dropped() == dropped_before) {
+        log_write(LOG_LEVEL_INFO, "Record %u", written++);
+    }
+    unsigned read = 0;
+    while (log_read(line, sizeof(line), NULL) == LOG_LEVEL_INFO) {
+        snprintf(expected, sizeof(expected), "Record %u", read++);
+        if (strcmp(line, expected) != 0) {
+            LOG_ERROR("Test 16 failed: record order after overflow (\"%s\")", line);
+            return false;
+        }
+    }
+    if (read + 1 != written) {
+        LOG_ERROR("Test 16 failed: %u of %u records read", read, written);
+        return false;
+    }
+    // Кольцо снова принимает записи после переполнения (в том числе через границу буфера)
+    for (unsigned i = 0; i < 3 * LOG_RING_SIZE / 16; i++) {
+        log_write(LOG_LEVEL_ERROR, "Wrap %u", i);
+        if (log_read(line, sizeof(line), NULL) != LOG_LEVEL_ERROR) {
+            LOG_ERROR("Test 16 failed: ring stuck at record %u", i);
+            return false;
+        }
+    }
+
+    LOG_INFO("Test 16 completed successfully (%u records fit in %u bytes)", read, (unsigned)LOG_RING_SIZE);
+    return true;
+}
+
+static bool test_authenticated_encryption(void) {
+    LOG_INFO("Test 17: Authenticated Encryption Of Settings Records");
+
+    // Тестовый вектор RFC 8439, раздел 2.8.2
+    static const char plaintext[] = "Ladies and Gentlemen of the class of '99: If I could offer you only one "
+                                    "tip for the future, sunscreen would be it.";
+    static const uint8_t nonce[AEAD_NONCE_LEN] = { 0x07, 0x00, 0x00, 0x00, 0x40, 0x41, 0x42, 0x43,
+                                                   0x44, 0x45, 0x46, 0x47 };
+    static const uint8_t aad[] = { 0x50, 0x51, 0x52, 0x53, 0xc0, 0xc1, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7 };
+    static const uint8_t expected_start[16] = { 0xd3, 0x1a, 0x8d, 0x34, 0x64, 0x8e, 0x60, 0xdb,
+                                                0x7b, 0x86, 0xaf, 0xbc, 0x53, 0xef, 0x7e, 0xc2 };
+    static const uint8_t expected_tag[AEAD_TAG_LEN] = { 0x1a, 0xe1, 0x0b, 0x59, 0x4f, 0x09, 0xe2, 0x6a,
+                                                        0x7e, 0x90, 0x2e, 0xcb, 0xd0, 0x60, 0x06, 0x91 };
+    uint8_t key[AEAD_KEY_LEN];
+    for (int i = 0; i < AEAD_KEY_LEN; i++) {
+        key[i] = (uint8_t)(0x80 + i);
+    }
+    size_t text_len = sizeof(plaintext) - 1;
+    uint8_t cipher[sizeof(plaintext)], decrypted[sizeof(plaintext)], tag[AEAD_TAG_LEN];
+    aead_ctx_t ctx;
+    aead_init(&ctx, key, nonce);
+    aead_aad(&ctx, aad, sizeof(aad));
+    aead_encrypt(&ctx, cipher, (const uint8_t *)plaintext, 50);  // Потоковая обработка частями
+    aead_encrypt(&ctx, cipher + 50, (const uint8_t *)plaintext + 50, text_len - 50);
+    aead_finish(&ctx, tag);
+    if (memcmp(cipher, expected_start, sizeof(expected_start)) != 0 || memcmp(tag, expected_tag, sizeof(tag)) != 0) {
+        LOG_ERROR("Test 17 failed: RFC 8439 test vector mismatch");
+        return false;
+    }
+    aead_init(&ctx, key, nonce);
+    aead_aad(&ctx, aad, sizeof(aad));
+    aead_decrypt(&ctx, decrypted, cipher, text_len);
+    if (!aead_verify(&ctx, expected_tag) || memcmp(decrypted, plaintext, text_len) != 0) {
+        LOG_ERROR("Test 17 failed: RFC 8439 decryption");
+        return false;
+    }
+
+    // Запись журнала: пароль зашифрован, тег покрывает всю запись
+    if (!erase_settings_log()) return false;
+    settings_t cfg, loaded;
+    settings_init_default(&cfg);
+    cfg.flags |= FLAG_SETTINGS_ENCRYPTED;
+    snprintf(cfg.wifi_pass, WIFI_PASS_MAX_LEN, "%s", "AeadSecret!");
+    if (!settings_save(&cfg, FLASH_OFFSET)) {
+        LOG_ERROR("Test 17 failed at save");
+        return false;
+    }
+    uint32_t record_offset = find_first_record();
+    const settings_record_t *flash_rec = (const settings_record_t *)flash_hal_xip_ptr(record_offset);
+#ifdef SETTINGS_AEAD
+    if (flash_rec->protect != SETTINGS_PROTECT_AEAD || flash_rec->data.crc32 != 0 ||
+        memcmp(flash_rec->data.wifi_pass, cfg.wifi_pass, strlen(cfg.wifi_pass)) == 0) {
+        LOG_ERROR("Test 17 failed: record not protected by ChaCha20-Poly1305");
+        return false;
+    }
+#endif
+    if (!settings_load(&loaded, FLASH_OFFSET) || !compare_settings(&cfg, &loaded)) {
+        LOG_ERROR("Test 17 failed: load of protected record");
+        return false;
+    }
+
+    // Изменение любого байта записи (шифротекст пароля, флаги, тег, способ защиты) обнаруживается
+    static const size_t tamper_offsets[] = {
+        offsetof(settings_record_t, data) + offsetof(settings_t, wifi_pass),
+        offsetof(settings_record_t, data) + offsetof(settings_t, flags),
+#ifdef SETTINGS_AEAD
+        offsetof(settings_record_t, tag) + 5,
+        offsetof(settings_record_t, protect),
+#endif
+    };
+    settings_record_t copy;
+    for (size_t i = 0; i < sizeof(tamper_offsets) / sizeof(tamper_offsets[0]); i++) {
+        memcpy(&copy, flash_rec, sizeof(copy));
+        ((uint8_t *)&copy)[tamper_offsets[i]] ^= 0x01;
+        if (settings_record_open(&copy, &loaded)) {
+            LOG_ERROR("Test 17 failed: tampering at offset %u not detected", (unsigned)tamper_offsets[i]);
+            return false;
+        }
+    }
+
+    // Запись старого формата (XOR и CRC32) читается и перезаписывается в новом при сохранении
+    copy.seq = 1;
+    copy.seq_inv = ~copy.seq;
+    settings_record_seal(&copy, &cfg, SETTINGS_PROTECT_CRC);
+    if (!settings_record_open(&copy, &loaded) || !compare_settings(&cfg, &loaded)) {
+        LOG_ERROR("Test 17 failed: XOR+CRC32 record round trip");
+        return false;
+    }
+
+    LOG_INFO("Test 17 completed successfully");
+    return true;
+}
+
+static bool test_compact_codec(void) {
+    LOG_INFO("Test 18: Compact Settings Codec");
+
+    static uint8_t buf[SETTINGS_CODEC_MAX_LEN];
+    settings_t cfg, decoded;
+    settings_init_default(&cfg);
+    size_t default_size = settings_encode(&cfg, buf, sizeof(buf));
+    if (default_size == 0 || default_size != settings_encoded_size(&cfg) ||
+        !settings_decode(buf, default_size, &decoded) || memcmp(&cfg, &decoded, sizeof(cfg)) != 0) {
+        LOG_ERROR("Test 18 failed: default settings round trip (%u bytes)", (unsigned)default_size);
+        return false;
+    }
+
+    // Все поля заполнены, мусор после завершающего нуля
+    memset(&cfg, 0xA5, sizeof(cfg));
+    for (int i = 0; i < NTP_MAX_SERVERS; i++) {
+        snprintf(cfg.ntp_servers[i], NTP_SERVER_MAX_LEN, "%d.pool.ntp.org", i);
+    }
+    size_t full_size = settings_encode(&cfg, buf, sizeof(buf));
+    if (full_size == 0 || !settings_decode(buf, full_size, &decoded) || memcmp(&cfg, &decoded, sizeof(cfg)) != 0) {
+        LOG_ERROR("Test 18 failed: full settings round trip");
+        return false;
+    }
+
+    // Наихудший случай помещается в SETTINGS_CODEC_MAX_LEN
+    memset(&cfg, 0xFF, sizeof(cfg));
+    if (settings_encoded_size(&cfg) > SETTINGS_CODEC_MAX_LEN) {
+        LOG_ERROR("Test 18 failed: worst case %u exceeds %u bytes",
+                  (unsigned)settings_encoded_size(&cfg), (unsigned)SETTINGS_CODEC_MAX_LEN);
+        return false;
+    }
+
+    // Мал буфер, обрезанные данные, неизвестное поле
+    settings_init_default(&cfg);
+    if (settings_encode(&cfg, buf, default_size - 1) != 0) {
+        LOG_ERROR("Test 18 failed: encoded into short buffer");
+        return false;
+    }
+    settings_encode(&cfg, buf, sizeof(buf));
+    if (settings_decode(buf, default_size - 1, &decoded)) {
+        LOG_ERROR("Test 18 failed: accepted truncated data");
+        return false;
+    }
+    buf[default_size] = 0xF8;  // Ключ поля 31 (varint (31 << 3) в двух байтах)
+    buf[default_size + 1] = 0x01;
+    buf[default_size + 2] = 0x7F;
+    if (!settings_decode(buf, default_size + 3, &decoded) || memcmp(&cfg, &decoded, sizeof(cfg)) != 0) {
+        LOG_ERROR("Test 18 failed: unknown field not skipped");
+        return false;
+    }
+
+    LOG_INFO("Test 18 completed successfully (default %u bytes, four NTP servers %u bytes, struct %u bytes)",
+             (unsigned)default_size, (unsigned)full_size, (unsigned)sizeof(settings_t));
+    return true;
+}
+
+#ifdef VFD_HOST_BUILD
+// Шаг начинается с загрузки: после отката образа RAM-состояние журнала устарело
+static bool fault_step_save(void *ctx, uint32_t step) {
+    (void)ctx;
+    settings_t cfg;
+    if (!settings_load(&cfg, FLASH_OFFSET)) return false;
+    cfg.brightness = (uint8_t)(10 + step);
+    return settings_save(&cfg, FLASH_OFFSET);
+}
+
+static bool fault_check_load(void *ctx, uint32_t step) {
+    (void)ctx;
+    settings_t loaded;
+    return settings_load(&loaded, FLASH_OFFSET) &&
+           (loaded.brightness == 10 + step || loaded.brightness == 9 + step);
+}
+#endif
+
+static bool test_power_cut_injection(void) {
+    LOG_INFO("Test 19: Power Cut Injection In The Flash Emulator");
+#ifndef VFD_HOST_BUILD
+    LOG_INFO("Test 19 skipped: power cut injection needs the host flash emulator");
+    return true;
+#else
+    if (!erase_settings_log() || !flash_hal_host_snapshot()) return false;
+
+    // Программирование обрывается на 11-м байте: он запрограммирован частично, остальные не тронуты
+    static uint8_t zeros[5 * FLASH_PAGE_SIZE];
+    const uint8_t *flash = flash_hal_xip_ptr(FLASH_OFFSET);
+    flash_hal_host_set_power_cut(10);
+    bool programmed = program_flash_pages(FLASH_OFFSET, zeros, FLASH_PAGE_SIZE);
+    if (programmed || !flash_hal_host_power_lost() || flash[9] != 0x00 || flash[10] != 0xF0 || flash[11] != 0xFF) {
+        LOG_ERROR("Test 19 failed: partial program state %02X %02X %02X", flash[9], flash[10], flash[11]);
+        return false;
+    }
+    if (erase_flash_sector(FLASH_OFFSET) || flash[0] != 0x00) {
+        LOG_ERROR("Test 19 failed: erase accepted after power loss");
+        return false;
+    }
+
+    // Стирание обрывается на 4-й странице
+    flash_hal_host_set_power_cut(FLASH_HAL_NO_POWER_CUT);
+    if (!program_flash_pages(FLASH_OFFSET + FLASH_PAGE_SIZE, zeros, sizeof(zeros) - FLASH_PAGE_SIZE) ||
+        flash_hal_host_power_units() != sizeof(zeros) - FLASH_PAGE_SIZE) {
+        LOG_ERROR("Test 19 failed: program without power cut");
+        return false;
+    }
+    flash_hal_host_set_power_cut(3);
+    if (erase_flash_sector(FLASH_OFFSET) || !flash_is_blank(FLASH_OFFSET, 3 * FLASH_PAGE_SIZE) ||
+        flash[3 * FLASH_PAGE_SIZE] != 0xA5 || flash[4 * FLASH_PAGE_SIZE] != 0x00) {
+        LOG_ERROR("Test 19 failed: partial erase state");
+        return false;
+    }
+    flash_hal_host_set_power_cut(FLASH_HAL_NO_POWER_CUT);
+
+    // Откат возвращает сектор к точке восстановления
+    flash_hal_host_rollback();
+    if (!flash_is_blank(FLASH_OFFSET, FLASH_SECTOR_SIZE)) {
+        LOG_ERROR("Test 19 failed: rollback left sector dirty");
+        return false;
+    }
+    flash_hal_host_snapshot_drop();
+
+    // Перебор с шагом 128 единиц: после каждого отключения загружается одна из двух записей
+    settings_t cfg;
+    settings_init_default(&cfg);
+    cfg.brightness = 9;
+    if (!settings_save(&cfg, FLASH_OFFSET)) return false;
+    flash_fault_plan_t plan = { fault_step_save, fault_check_load, NULL, 2, 128 };
+    flash_fault_report_t report;
+    settings_t loaded;
+    if (!flash_fault_sweep(&plan, &report) || report.failures != 0 || report.cut_points == 0) {
+        LOG_ERROR("Test 19 failed: %llu of %llu cut points did not recover",
+                  (unsigned long long)report.failures, (unsigned long long)report.cut_points);
+        return false;
+    }
+    if (!settings_load(&loaded, FLASH_OFFSET) || loaded.brightness != 11) {
+        LOG_ERROR("Test 19 failed: sweep did not leave the completed steps in flash");
+        return false;
+    }
+
+    LOG_INFO("Test 19 completed successfully (%llu cut points)", (unsigned long long)report.cut_points);
+    return true;
+#endif
+}
+
+static bool test_write_verification(void) {
+    LOG_INFO("Test 20: Page Verification And Retry After Programming");
+#ifndef VFD_HOST_BUILD
+    LOG_INFO("Test 20 skipped: weak page injection needs the host flash emulator");
+    return true;
+#else
+    if (!erase_settings_log()) return false;
+
+    static uint8_t data[2 * FLASH_PAGE_SIZE + 1];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t)(i * 7 + 3);
+    }
+    const uint8_t *unaligned = data + 1;  // Проверка не требует выравнивания данных
+
+    // Вторая страница не программируется с первого раза: повторяется только она
+    flash_verify_stats_t stats;
+    flash_verify_reset_stats();
+    flash_hal_host_inject_weak_page(FLASH_OFFSET + FLASH_PAGE_SIZE, 1);
+    if (!program_flash_pages(FLASH_OFFSET, unaligned, 2 * FLASH_PAGE_SIZE) ||
+        memcmp(flash_hal_xip_ptr(FLASH_OFFSET), unaligned, 2 * FLASH_PAGE_SIZE) != 0) {
+        LOG_ERROR("Test 20 failed: weak page not recovered by retry");
+        return false;
+    }
+    flash_verify_get_stats(&stats);
+    if (stats.verify_ops != 1 || stats.verify_pages != 2 || stats.retries != 1 || stats.failures != 0) {
+        LOG_ERROR("Test 20 failed: counters after retry (%u ops, %u pages, %u retries, %u failures)",
+                  (unsigned)stats.verify_ops, (unsigned)stats.verify_pages, (unsigned)stats.retries,
+                  (unsigned)stats.failures);
+        return false;
+    }
+
+    // Страница не записывается и после всех повторов: сообщается её смещение
+    const uint32_t weak = FLASH_OFFSET + FLASH_SECTOR_SIZE + FLASH_PAGE_SIZE;
+    flash_verify_reset_stats();
+    flash_hal_host_inject_weak_page(weak, FLASH_VERIFY_RETRIES + 1);
+    if (write_flash_sector(FLASH_OFFSET + FLASH_SECTOR_SIZE, unaligned, 2 * FLASH_PAGE_SIZE)) {
+        LOG_ERROR("Test 20 failed: write reported success for a dead page");
+        return false;
+    }
+    flash_verify_get_stats(&stats);
+    if (stats.retries != FLASH_VERIFY_RETRIES || stats.failures != 1 || stats.last_failed_offset != weak) {
+        LOG_ERROR("Test 20 failed: dead page counters (%u retries, failed at 0x%08X)",
+                  (unsigned)stats.retries, (unsigned)stats.last_failed_offset);
+        return false;
+    }
+
+    // Бит 0 на месте 1 повтором не исправить: повторов нет
+    flash_verify_reset_stats();
+    if (program_flash_pages(FLASH_OFFSET, data, FLASH_PAGE_SIZE)) {
+        LOG_ERROR("Test 20 failed: page with cleared bits accepted");
+        return false;
+    }
+    flash_verify_get_stats(&stats);
+    if (stats.retries != 0 || stats.failures != 1 || stats.last_failed_offset != FLASH_OFFSET) {
+        LOG_ERROR("Test 20 failed: retried a page that needs an erase");
+        return false;
+    }
+
+    flash_hal_host_inject_weak_page(0, 0);
+    LOG_INFO("Test 20 completed successfully");
+    return true;
+#endif
+}
+
+static kv_store_t kv;
+
+static bool erase_kv_region(void) {
+    for (uint32_t i = 0; i < KV_SECTORS; i++) {
+        if (!erase_flash_sector(KV_OFFSET + i * FLASH_SECTOR_SIZE)) return false;
+    }
+    return true;
+}
+
+#ifdef VFD_HOST_BUILD
+// Шаг перебора: запуск хранилища и запись значения, помеченного номером шага
+static bool kv_fault_step(void *ctx, uint32_t step) {
+    (void)ctx;
+    uint8_t value[600];
+    memset(value, (uint8_t)step, sizeof(value));
+    return kv_init(&kv, KV_OFFSET) && kv_put(&kv, KV_NS_CALIBRATION, "curve", value, sizeof(value));
+}
+
+static bool kv_fault_check(void *ctx, uint32_t step) {
+    (void)ctx;
+    uint8_t value[600];
+    size_t len;
+    if (!kv_init(&kv, KV_OFFSET)) {
+        return false;
+    }
+    // До первого шага значения ещё нет
+    if (!kv_get(&kv, KV_NS_CALIBRATION, "curve", value, sizeof(value), &len)) {
+        if (step != 0) {
+            return false;
+        }
+    } else {
+        if (len != sizeof(value) || (value[0] != (uint8_t)step && value[0] != (uint8_t)(step - 1))) {
+            return false;
+        }
+        for (size_t i = 1; i < sizeof(value); i++) {
+            if (value[i] != value[0]) {
+                return false;
+            }
+        }
+    }
+    uint32_t other;
+    return kv_get(&kv, KV_NS_NTP, "drift", &other, sizeof(other), NULL) && other == 0x1234;
+}
+#endif
+
+static bool test_kv_store(void) {
+    LOG_INFO("Test 21: Key-Value Store With RAM Hash Index");
+    if (!erase_kv_region() || !kv_init(&kv, KV_OFFSET) || kv.keys != 0) {
+        LOG_ERROR("Test 21 failed: empty store");
+        return false;
+    }
+
+    // Одинаковые ключи в разных пространствах имён, значения разной длины
+    static const uint16_t curve[] = { 0, 40, 120, 400, 1023 };
+    const char *pass = "per-network-secret";
+    uint32_t drift = 0x1234;
+    if (!kv_put(&kv, KV_NS_CALIBRATION, "curve", curve, sizeof(curve)) ||
+        !kv_put(&kv, KV_NS_NETWORKS, "curve", pass, strlen(pass)) ||
+        !kv_put(&kv, KV_NS_NTP, "drift", &drift, sizeof(drift)) ||
+        !kv_put(&kv, KV_NS_NTP, "empty", NULL, 0)) {
+        LOG_ERROR("Test 21 failed: put");
+        return false;
+    }
+    uint16_t curve_out[5];
+    char pass_out[32];
+    size_t len;
+    if (!kv_get(&kv, KV_NS_CALIBRATION, "curve", curve_out, sizeof(curve_out), &len) || len != sizeof(curve) ||
+        memcmp(curve_out, curve, sizeof(curve)) != 0 ||
+        !kv_get(&kv, KV_NS_NETWORKS, "curve", pass_out, sizeof(pass_out), &len) || len != strlen(pass) ||
+        memcmp(pass_out, pass, len) != 0 || !kv_get(&kv, KV_NS_NTP, "empty", NULL, 0, &len) || len != 0 ||
+        kv_get(&kv, KV_NS_NTP, "missing", NULL, 0, NULL) || kv.keys != 4) {
+        LOG_ERROR("Test 21 failed: get");
+        return false;
+    }
+
+    // Удаление и неизменённое значение (без записи)
+    uint32_t appends = kv.stats.appends;
+    if (!kv_delete(&kv, KV_NS_NTP, "empty") || kv_get_ptr(&kv, KV_NS_NTP, "empty", NULL) ||
+        !kv_put(&kv, KV_NS_NTP, "drift", &drift, sizeof(drift)) || kv.stats.appends != appends + 1) {
+        LOG_ERROR("Test 21 failed: delete or unchanged put");
+        return false;
+    }
+
+    // Перезаписи до многократного освобождения секторов
+    uint8_t blob[300];
+    for (uint32_t i = 0; i < 120; i++) {
+        memset(blob, (uint8_t)i, sizeof(blob));
+        char key[8];
+        snprintf(key, sizeof(key), "k%u", (unsigned)(i % 6));
+        if (!kv_put(&kv, KV_NS_CALIBRATION, key, blob, sizeof(blob))) {
+            LOG_ERROR("Test 21 failed: churn write %u", (unsigned)i);
+            return false;
+        }
+    }
+    if (kv.stats.compactions == 0) {
+        LOG_ERROR("Test 21 failed: no compaction after churn");
+        return false;
+    }
+
+    // Перезапуск: индекс строится заново, значения те же
+    uint32_t compactions = kv.stats.compactions;
+    if (!kv_init(&kv, KV_OFFSET) || kv.keys != 9 ||
+        !kv_get(&kv, KV_NS_NETWORKS, "curve", pass_out, sizeof(pass_out), &len) || len != strlen(pass) ||
+        !kv_get(&kv, KV_NS_NTP, "drift", &drift, sizeof(drift), NULL) || drift != 0x1234 ||
+        kv_get_ptr(&kv, KV_NS_NTP, "empty", NULL)) {
+        LOG_ERROR("Test 21 failed: reopen (%u keys)", (unsigned)kv.keys);
+        return false;
+    }
+    for (uint32_t k = 0; k < 6; k++) {
+        char key[8];
+        snprintf(key, sizeof(key), "k%u", (unsigned)k);
+        const uint8_t *value = kv_get_ptr(&kv, KV_NS_CALIBRATION, key, &len);
+        if (!value || len != sizeof(blob) || value[0] != 114 + k || value[len - 1] != 114 + k) {
+            LOG_ERROR("Test 21 failed: value of %s after reopen", key);
+            return false;
+        }
+    }
+
+    // settings_t как клиент хранилища: пароль не хранится открытым текстом
+    settings_t cfg, loaded;
+    settings_init_default(&cfg);
+    snprintf(cfg.wifi_pass, WIFI_PASS_MAX_LEN, "%s", "KvSecretPass");
+    appends = kv.stats.appends;
+    if (!settings_kv_save(&kv, &cfg) || !settings_kv_save(&kv, &cfg) || kv.stats.appends != appends + 1 ||
+        !settings_kv_load(&kv, &loaded) || !compare_settings(&cfg, &loaded)) {
+        LOG_ERROR("Test 21 failed: settings round trip through the store");
+        return false;
+    }
+    const uint8_t *value = kv_get_ptr(&kv, KV_NS_SETTINGS, SETTINGS_KV_KEY, &len);
+    for (size_t i = 0; value && i + strlen(cfg.wifi_pass) <= len; i++) {
+        if (memcmp(value + i, cfg.wifi_pass, strlen(cfg.wifi_pass)) == 0) {
+            LOG_ERROR("Test 21 failed: plaintext password in store");
+            return false;
+        }
+    }
+
+    // Подлинное значение другой версии не загружается: миграции значений хранилища нет
+    static uint8_t sealed[AEAD_NONCE_LEN + SETTINGS_CODEC_MAX_LEN + AEAD_TAG_LEN];
+    static const uint8_t aad[] = SETTINGS_KV_KEY;
+    settings_t future = cfg;
+    future.version = SETTINGS_VERSION + 1;
+    memset(sealed, 0x5A, AEAD_NONCE_LEN);
+    size_t sealed_len = settings_encode(&future, sealed + AEAD_NONCE_LEN, SETTINGS_CODEC_MAX_LEN);
+    settings_blob_seal(sealed, aad, sizeof(aad), sealed + AEAD_NONCE_LEN, sealed_len,
+                       sealed + AEAD_NONCE_LEN + sealed_len);
+    if (sealed_len == 0 ||
+        !kv_put(&kv, KV_NS_SETTINGS, SETTINGS_KV_KEY, sealed, AEAD_NONCE_LEN + sealed_len + AEAD_TAG_LEN) ||
+        settings_kv_load(&kv, &loaded) || !settings_kv_save(&kv, &cfg) || !settings_kv_load(&kv, &loaded)) {
+        LOG_ERROR("Test 21 failed: settings value of unknown version");
+        return false;
+    }
+
+#ifdef VFD_HOST_BUILD
+    // Отключение питания при записи и освобождении секторов: остаётся старое или новое значение
+    if (!erase_kv_region() || !kv_init(&kv, KV_OFFSET) || !kv_put(&kv, KV_NS_NTP, "drift", &drift, sizeof(drift))) {
+        return false;
+    }
+    flash_fault_plan_t plan = { kv_fault_step, kv_fault_check, NULL, 24, 37 };
+    flash_fault_report_t report;
+    if (!flash_fault_sweep(&plan, &report) || report.failures != 0) {
+        LOG_ERROR("Test 21 failed: %llu of %llu power cuts lost data (step %u, unit %llu)",
+                  (unsigned long long)report.failures, (unsigned long long)report.cut_points,
+                  (unsigned)report.first_failed_step, (unsigned long long)report.first_failed_unit);
+        return false;
+    }
+#endif
+
+    LOG_INFO("Test 21 completed successfully (%u compactions)", (unsigned)compactions);
+    return true;
+}
+
+static tslog_t tslog;
+
+// Отсчёт номер i: синхронизации трёх серверов, неудачи и освещённость. На 500-м отсчёте
+// смещение скачком меняется (не помещается в разность), на 1000-м часы переводятся назад
+static void tslog_test_sample(uint32_t i, tslog_sample_t *sample) {
+    sample->time = 1700000000u + 60 * i + (i % 7) - (i >= 1000 ? 7200 : 0);
+    sample->kind = (uint8_t)(i % TSLOG_KINDS);
+    sample->source = (uint8_t)(i % NTP_MAX_SERVERS);
+    sample->aux = (uint16_t)(i * 3);
+    if (sample->kind == TSLOG_NTP_SYNC) {
+        sample->value = (int32_t)((i * 7919) % 2001) - 1000 + (i >= 500 ? 100000 : 0);
+    } else if (sample->kind == TSLOG_LIGHT) {
+        sample->value = (int32_t)((i * 13) % 4096);
+    } else {
+        sample->value = 0;
+    }
+}
+
+static bool tslog_sample_equal(const tslog_sample_t *a, const tslog_sample_t *b) {
+    return a->time == b->time && a->kind == b->kind && a->source == b->source && a->aux == b->aux &&
+           a->value == b->value;
+}
+
+// Чтение всего журнала: отсчёты должны совпасть с последними из total сгенерированных
+static bool tslog_check_all(uint32_t total, uint32_t *found) {
+    tslog_iter_t it;
+    tslog_sample_t sample, expected;
+    uint32_t count = 0, first = 0;
+    tslog_iter_init(&it, &tslog, 0, UINT32_MAX);
+    while (tslog_iter_next(&it, &sample)) {
+        if (count == 0) {
+            // Первый отсчёт определяет, с какого номера сохранились данные
+            while (first < total) {
+                tslog_test_sample(first, &expected);
+                if (tslog_sample_equal(&sample, &expected)) break;
+                first++;
+            }
+        }
+        tslog_test_sample(first + count, &expected);
+        if (first + count >= total || !tslog_sample_equal(&sample, &expected)) {
+            LOG_ERROR("Time-series sample %u mismatch", (unsigned)(first + count));
+            return false;
+        }
+        count++;
+    }
+    *found = count;
+    return first + count == total;
+}
+
+static bool test_time_series_log(void) {
+    LOG_INFO("Test 22: Circular Time-Series Log");
+    for (uint32_t i = 0; i < TSLOG_SECTORS; i++) {
+        if (!erase_flash_sector(TSLOG_OFFSET + i * FLASH_SECTOR_SIZE)) return false;
+    }
+    if (!tslog_init(&tslog, TSLOG_OFFSET) || tslog.used_pages != 0) {
+        LOG_ERROR("Test 22 failed: empty log");
+        return false;
+    }
+
+    // Три прохода кольца: страницы программируются без стирания, стирается только выводимый сектор
+    const uint32_t total = 3 * TSLOG_PAGES * TSLOG_SAMPLES_PER_PAGE;
+    flash_hal_stats_t before, after;
+    flash_hal_get_stats(&before);
+    for (uint32_t i = 0; i < total; i++) {
+        tslog_sample_t sample;
+        tslog_test_sample(i, &sample);
+        if (!tslog_append(&tslog, &sample)) {
+            LOG_ERROR("Test 22 failed: append %u", (unsigned)i);
+            return false;
+        }
+    }
+    flash_hal_get_stats(&after);
+    if (after.erase_ops - before.erase_ops != tslog.stats.retired || tslog.stats.retired == 0 ||
+        after.program_ops - before.program_ops != tslog.stats.pages) {
+        LOG_ERROR("Test 22 failed: %u erases for %u retired sectors, %u programs for %u pages",
+                  (unsigned)(after.erase_ops - before.erase_ops), (unsigned)tslog.stats.retired,
+                  (unsigned)(after.program_ops - before.program_ops), (unsigned)tslog.stats.pages);
+        return false;
+    }
+    const uint32_t retired = tslog.stats.retired;
+
+    // В журнале не меньше всех секторов, кроме выводимого, плюс пакет в RAM
+    uint32_t found;
+    if (!tslog_check_all(total, &found) ||
+        found < (TSLOG_PAGES - FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE) * TSLOG_SAMPLES_PER_PAGE) {
+        LOG_ERROR("Test 22 failed: full read (%u samples)", (unsigned)found);
+        return false;
+    }
+
+    // Диапазон времени: только отсчёты внутри, в порядке записи
+    const uint32_t from = 1700000000u + 60 * (total - 200), to = from + 60 * 50;
+    uint32_t expected = 0, matched = 0;
+    for (uint32_t i = total - found; i < total; i++) {
+        tslog_sample_t sample;
+        tslog_test_sample(i, &sample);
+        expected += sample.time >= from && sample.time <= to;
+    }
+    tslog_iter_t it;
+    tslog_sample_t sample;
+    tslog_iter_init(&it, &tslog, from, to);
+    while (tslog_iter_next(&it, &sample)) {
+        if (sample.time < from || sample.time > to) {
+            LOG_ERROR("Test 22 failed: sample at %u outside range", (unsigned)sample.time);
+            return false;
+        }
+        matched++;
+    }
+    if (matched != expected || expected == 0) {
+        LOG_ERROR("Test 22 failed: range query returned %u of %u samples", (unsigned)matched, (unsigned)expected);
+        return false;
+    }
+
+    // После перезагрузки разности продолжаются от восстановленных значений
+    if (!tslog_flush(&tslog) || !tslog_init(&tslog, TSLOG_OFFSET) || !tslog_check_all(total, &found)) {
+        LOG_ERROR("Test 22 failed: reopen");
+        return false;
+    }
+    for (uint32_t i = total; i < total + 40; i++) {
+        tslog_test_sample(i, &sample);
+        if (!tslog_append(&tslog, &sample)) return false;
+    }
+    if (!tslog_check_all(total + 40, &found)) {
+        LOG_ERROR("Test 22 failed: append after reopen");
+        return false;
+    }
+
+    // Повреждённая страница пропускается при чтении и при запуске
+    static uint8_t page[FLASH_PAGE_SIZE];
+    uint32_t damaged = TSLOG_OFFSET + (tslog.head_page + TSLOG_PAGES - 2) % TSLOG_PAGES * FLASH_PAGE_SIZE;
+    memcpy(page, flash_hal_xip_ptr(damaged), sizeof(page));
+    memset(page + TSLOG_PAGE_HEADER_SIZE, 0, 16);  // Биты только сбрасываются
+    if (!tslog_flush(&tslog) || !program_flash_pages(damaged, page, sizeof(page)) ||
+        !tslog_init(&tslog, TSLOG_OFFSET) || tslog.stats.damaged != 1) {
+        LOG_ERROR("Test 22 failed: damaged page");
+        return false;
+    }
+    uint32_t after_damage = 0;
+    tslog_iter_init(&it, &tslog, 0, UINT32_MAX);
+    while (tslog_iter_next(&it, &sample)) {
+        after_damage++;
+    }
+    if (after_damage + TSLOG_SAMPLES_PER_PAGE < found || after_damage >= found) {
+        LOG_ERROR("Test 22 failed: %u samples after damage (was %u)", (unsigned)after_damage, (unsigned)found);
+        return false;
+    }
+
+    LOG_INFO("Test 22 completed successfully (%u samples kept, %u sectors retired)", (unsigned)found,
+             (unsigned)retired);
+    return true;
+}
+
+static bool test_flash_scratch_arena(void) {
+    LOG_INFO("Test 23: Shared Flash Scratch Arena");
+    flash_scratch_stats_t stats;
+    flash_scratch_get_stats(&stats);
+    if (stats.in_use != 0 || stats.peak > FLASH_SCRATCH_SIZE) {
+        LOG_ERROR("Test 23 failed: %u bytes still borrowed after previous tests", (unsigned)stats.in_use);
+        return false;
+    }
+
+    // Участки выдаются стеком; освобождение первого возвращает и следующие
+    uint8_t *a = flash_scratch_borrow(100);
+    uint8_t *b = flash_scratch_borrow(200);
+    uint8_t *too_big = flash_scratch_borrow(FLASH_SCRATCH_SIZE);
+    flash_scratch_get_stats(&stats);
+    if (!a || b != a + 104 || too_big || stats.in_use != 304 || stats.failures == 0) {
+        LOG_ERROR("Test 23 failed: borrow");
+        return false;
+    }
+    flash_scratch_release(a);
+    flash_scratch_get_stats(&stats);
+    if (stats.in_use != 0) {
+        LOG_ERROR("Test 23 failed: release");
+        return false;
+    }
+
+    // Перезапись со стиранием занимает арену целиком и возвращает её
+    static const uint8_t ones[4] = { 0xFF, 0xFF, 0xFF, 0xFF };
+    static const uint8_t zeros[4];
+    flash_scratch_reset_stats();
+    if (!erase_settings_log() || !write_flash_range(FLASH_OFFSET + 10, zeros, sizeof(zeros)) ||
+        !write_flash_range(FLASH_OFFSET + 10, ones, sizeof(ones))) {
+        LOG_ERROR("Test 23 failed: sector rewrite");
+        return false;
+    }
+    flash_scratch_get_stats(&stats);
+    if (stats.in_use != 0 || stats.peak != FLASH_SECTOR_SIZE) {
+        LOG_ERROR("Test 23 failed: rewrite used %u bytes of scratch", (unsigned)stats.peak);
+        return false;
+    }
+
+    // Перезапись со стиранием, пока вызывающий держит свой участок (запись хранилища, страница копирования)
+    uint8_t *held = flash_scratch_borrow(FLASH_SCRATCH_SIZE - FLASH_SCRATCH_COPY);
+    uint8_t *page = flash_scratch_borrow(FLASH_PAGE_SIZE);
+    bool rewritten = held && page && write_flash_range(FLASH_OFFSET + 10, zeros, sizeof(zeros)) &&
+                     write_flash_range(FLASH_OFFSET + 10, ones, sizeof(ones));
+    flash_scratch_release(held);
+    flash_scratch_get_stats(&stats);
+    if (!rewritten || stats.in_use != 0 || stats.failures != 0) {
+        LOG_ERROR("Test 23 failed: rewrite while holding scratch (%u failures)", (unsigned)stats.failures);
+        return false;
+    }
+
+    // Копирование между секторами идёт через одну страницу арены
+    static uint8_t pattern[700];
+    for (size_t i = 0; i < sizeof(pattern); i++) {
+        pattern[i] = (uint8_t)(i * 11 + 3);
+    }
+    const uint32_t src = TSLOG_OFFSET + 5, dst = TSLOG_OFFSET + FLASH_SECTOR_SIZE + 123;
+    if (!erase_flash_sector(TSLOG_OFFSET) || !erase_flash_sector(TSLOG_OFFSET + FLASH_SECTOR_SIZE) ||
+        !write_flash_range(src, pattern, sizeof(pattern))) {
+        return false;
+    }
+    flash_scratch_reset_stats();
+    if (!copy_flash_range(dst, src, sizeof(pattern)) ||
+        memcmp(flash_hal_xip_ptr(dst), pattern, sizeof(pattern)) != 0 ||
+        copy_flash_range(src + 1, src, sizeof(pattern))) {
+        LOG_ERROR("Test 23 failed: flash copy");
+        return false;
+    }
+    flash_scratch_get_stats(&stats);
+    if (stats.in_use != 0 || stats.peak > 3 * FLASH_PAGE_SIZE) {
+        LOG_ERROR("Test 23 failed: copy used %u bytes of scratch", (unsigned)stats.peak);
+        return false;
+    }
+
+    // Копирование поверх других данных: перезапись со стиранием под страницей копирования
+    for (size_t i = 0; i < sizeof(pattern); i++) {
+        pattern[i] = (uint8_t)~pattern[i];
+    }
+    if (!write_flash_range(src, pattern, sizeof(pattern)) || !copy_flash_range(dst, src, sizeof(pattern)) ||
+        memcmp(flash_hal_xip_ptr(dst), pattern, sizeof(pattern)) != 0) {
+        LOG_ERROR("Test 23 failed: flash copy over existing data");
+        return false;
+    }
+
+    // Сохранение настроек в журнал и в хранилище с переносом записей: вложенные участки помещаются
+    settings_t cfg;
+    settings_init_default(&cfg);
+    flash_scratch_reset_stats();
+    if (!settings_save(&cfg, FLASH_OFFSET) || !erase_kv_region() || !kv_init(&kv, KV_OFFSET)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < 40; i++) {
+        cfg.brightness = (uint8_t)(i % (BRIGHTNESS_MAX + 1));
+        snprintf(cfg.wifi_ssid, WIFI_SSID_MAX_LEN, "Network-%u", (unsigned)i);
+        if (!settings_kv_save(&kv, &cfg)) {
+            LOG_ERROR("Test 23 failed: settings_kv_save %u", (unsigned)i);
+            return false;
+        }
+        static uint8_t blob[600];
+        memset(blob, (uint8_t)i, sizeof(blob));
+        if (!kv_put(&kv, KV_NS_CALIBRATION, "curve", blob, sizeof(blob))) {
+            return false;
+        }
+    }
+    flash_scratch_get_stats(&stats);
+    if (stats.in_use != 0 || stats.failures != 0 || kv.stats.compactions == 0) {
+        LOG_ERROR("Test 23 failed: store writes (%u in use, %u failures, %u compactions)", (unsigned)stats.in_use,
+                  (unsigned)stats.failures, (unsigned)kv.stats.compactions);
+        return false;
+    }
+
+    LOG_INFO("Test 23 completed successfully (peak %u of %u bytes for store writes)", (unsigned)stats.peak,
+             (unsigned)FLASH_SCRATCH_SIZE);
+    return true;
+}
+
+static bool test_warm_boot_cache(void) {
+    LOG_INFO("Test 24: Warm Reboot Settings Cache");
+    settings_t cfg, loaded;
+    settings_boot_stats_t cold, warm;
+    if (!erase_settings_log()) return false;
+    settings_boot_invalidate();
+    if (settings_boot_load(&loaded, FLASH_OFFSET)) {
+        LOG_ERROR("Test 24 failed: loaded from blank flash");
+        return false;
+    }
+
+    // Первый старт: журнал во флеш-памяти, кэш заполняется
+    settings_init_default(&cfg);
+    cfg.brightness = 7;
+    snprintf(cfg.wifi_pass, WIFI_PASS_MAX_LEN, "%s", "WarmBootPass");
+    if (!settings_save(&cfg, FLASH_OFFSET) || !settings_boot_load(&loaded, FLASH_OFFSET)) {
+        LOG_ERROR("Test 24 failed: cold boot");
+        return false;
+    }
+    settings_boot_get_stats(&cold);
+    if (cold.warm || cold.generation == 0 || cold.generation != settings_generation(FLASH_OFFSET) ||
+        !compare_settings(&cfg, &loaded)) {
+        LOG_ERROR("Test 24 failed: cold boot result");
+        return false;
+    }
+
+    // Программный сброс: настройки из RAM, пароль расшифровывается из актуальной записи
+    if (!settings_boot_load(&loaded, FLASH_OFFSET)) {
+        LOG_ERROR("Test 24 failed: warm boot");
+        return false;
+    }
+    settings_boot_get_stats(&warm);
+    if (!warm.warm || warm.generation != cold.generation || !compare_settings(&cfg, &loaded)) {
+        LOG_ERROR("Test 24 failed: warm boot result");
+        return false;
+    }
+
+    // Сохранение сбрасывает кэш: следующий старт читает новую запись
+    cfg.brightness = 3;
+    if (!settings_save(&cfg, FLASH_OFFSET) || !settings_boot_load(&loaded, FLASH_OFFSET)) {
+        LOG_ERROR("Test 24 failed: boot after save");
+        return false;
+    }
+    settings_boot_stats_t after_save;
+    settings_boot_get_stats(&after_save);
+    if (after_save.warm || loaded.brightness != 3 || !compare_settings(&cfg, &loaded) ||
+        !settings_boot_load(&loaded, FLASH_OFFSET)) {
+        LOG_ERROR("Test 24 failed: cache not invalidated by save");
+        return false;
+    }
+    settings_boot_get_stats(&warm);
+    if (!warm.warm || warm.generation != after_save.generation) {
+        LOG_ERROR("Test 24 failed: second warm boot");
+        return false;
+    }
+
+    // Журнал перезаписан в обход settings_save (образ настроек с записью seq 1): кэш отвергается
+    static uint8_t image[SETTINGS_RECORD_SLOT_SIZE];
+    settings_record_t *rec = (settings_record_t *)image;
+    settings_t flashed = cfg;
+    flashed.brightness = 91;
+    memset(image, 0xFF, sizeof(image));
+    rec->seq = 1;
+    rec->seq_inv = ~1u;
+    settings_record_seal(rec, &flashed, SETTINGS_PROTECT_DEFAULT);
+    if (!erase_settings_log() || !program_flash_pages(FLASH_OFFSET, image, sizeof(image)) ||
+        !settings_boot_load(&loaded, FLASH_OFFSET)) {
+        LOG_ERROR("Test 24 failed: boot after reflash");
+        return false;
+    }
+    settings_boot_stats_t reflash;
+    settings_boot_get_stats(&reflash);
+    if (reflash.warm || reflash.generation != 1 || !compare_settings(&flashed, &loaded)) {
+        LOG_ERROR("Test 24 failed: stale cache served after reflash (brightness %u)", loaded.brightness);
+        return false;
+    }
+
+    LOG_INFO("Test 24 completed successfully (settings ready: %u us from flash, %u us from RAM)",
+             (unsigned)cold.load_us, (unsigned)warm.load_us);
+    return true;
+}
+
+// Имитация DNS и NTP в виртуальном времени: ответы доставляются с заданными задержками
+#define NTP_STUB_EVENTS 16
+
+typedef struct {
+    uint64_t due_us;                        // Время доставки
+    uint8_t server;
+    bool dns;                               // Ответ DNS (иначе ответ NTP)
+    uint32_t ipv4;
+} ntp_stub_event_t;
+
+typedef struct {
+    uint64_t now_us;                        // Виртуальное время
+    uint32_t dns_latency_us;                // Задержка ответа DNS для сервера 0 (+100 мс на каждый следующий)
+    uint32_t address[NTP_MAX_SERVERS];      // Адреса серверов в DNS
+    uint32_t rtt_us[NTP_MAX_SERVERS];       // RTT сервера (0 - не отвечает)
+    ntp_stub_event_t events[NTP_STUB_EVENTS];
+    size_t count;
+    uint32_t dns_queries;
+} ntp_stub_t;
+
+static bool ntp_stub_push(ntp_stub_t *stub, uint64_t due_us, uint8_t server, bool dns, uint32_t ipv4) {
+    if (stub->count >= NTP_STUB_EVENTS) return false;
+    stub->events[stub->count++] = (ntp_stub_event_t){due_us, server, dns, ipv4};
+    return true;
+}
+
+static bool ntp_stub_resolve(void *ctx, uint8_t server, const char *host) {
+    (void)host;
+    ntp_stub_t *stub = ctx;
+    stub->dns_queries++;
+    return ntp_stub_push(stub, stub->now_us + stub->dns_latency_us + server * 100000u, server, true,
+                         stub->address[server]);
+}
+
+static bool ntp_stub_request(void *ctx, uint8_t server, uint32_t ipv4) {
+    ntp_stub_t *stub = ctx;
+    if (stub->rtt_us[server] == 0 || ipv4 != stub->address[server]) {
+        return true;  // Запрос ушёл, но ответа не будет
+    }
+    return ntp_stub_push(stub, stub->now_us + stub->rtt_us[server], server, false, ipv4);
+}
+
+// Шаг 10 мс до окончания синхронизации и доставки всех ответов DNS (фоновая проверка имён)
+static ntp_sync_state_t ntp_stub_run(ntp_stub_t *stub, ntp_sync_t *sync) {
+    for (; stub->now_us < 10000000u; stub->now_us += 10000u) {
+        for (size_t i = 0; i < stub->count;) {
+            ntp_stub_event_t event = stub->events[i];
+            if (event.due_us > stub->now_us) {
+                i++;
+                continue;
+            }
+            stub->events[i] = stub->events[--stub->count];
+            if (event.dns) {
+                ntp_sync_on_dns(sync, event.server, event.ipv4, 300, 0, stub->now_us);
+            } else {
+                ntp_sync_on_reply(sync, event.server, event.ipv4, 1500, stub->rtt_us[event.server], stub->now_us);
+            }
+        }
+        if (ntp_sync_poll(sync, stub->now_us) != NTP_SYNC_RUNNING && stub->count == 0) {
+            break;
+        }
+    }
+    return sync->state;
+}
+
+static bool test_ntp_server_cache(void) {
+    LOG_INFO("Test 25: NTP Server Cache And Time To First Sync");
+    settings_t cfg;
+    settings_init_default(&cfg);
+    memset(cfg.ntp_servers, 0, sizeof(cfg.ntp_servers));
+    snprintf(cfg.ntp_servers[0], NTP_SERVER_MAX_LEN, "%s", "pool.ntp.org");
+    snprintf(cfg.ntp_servers[1], NTP_SERVER_MAX_LEN, "%s", "time.google.com");
+    snprintf(cfg.ntp_servers[2], NTP_SERVER_MAX_LEN, "%s", "ntp.dead.example");
+
+    ntp_stub_t stub = {
+        .dns_latency_us = 800000u,
+        .address = {0x0A000001u, 0x0A000002u, 0x0A000003u},
+        .rtt_us = {300000u, 40000u, 0},
+    };
+    const ntp_transport_t transport = {&stub, ntp_stub_resolve, ntp_stub_request};
+    ntp_cache_t cache;
+    ntp_sync_t sync;
+
+    // Первый старт: кэш пуст, запрос ждёт первого ответа DNS
+    if (!erase_kv_region() || !kv_init(&kv, KV_OFFSET) || ntp_cache_load(&cache, &kv, &cfg)) {
+        LOG_ERROR("Test 25 failed: cache not empty on blank flash");
+        return false;
+    }
+    if (!ntp_sync_start(&sync, &cfg, &cache, &transport, NTP_SYNC_TIMEOUT_MS, 0, stub.now_us) || sync.from_cache ||
+        ntp_stub_run(&stub, &sync) != NTP_SYNC_DONE || sync.offset_us != 1500) {
+        LOG_ERROR("Test 25 failed: cold sync");
+        return false;
+    }
+    uint32_t cold_ms = (uint32_t)(sync.first_sync_us / 1000);
+    if (cache.servers[0].srtt_us != 300000u || cache.servers[1].ipv4 != 0x0A000002u ||
+        cache.servers[2].ipv4 != 0x0A000003u) {
+        LOG_ERROR("Test 25 failed: cache after cold sync");
+        return false;
+    }
+
+    // Штатная работа: сервер 1 отвечает быстрее и набирает оценку
+    for (int i = 0; i < 3; i++) {
+        ntp_cache_success(&cache, 1, 40000u + i * 1000u, 1500 + i * 100);
+    }
+    if (!ntp_cache_save(&cache, &kv) || cache.dirty || ntp_cache_best(&cache, 0) != 1) {
+        LOG_ERROR("Test 25 failed: cache save");
+        return false;
+    }
+
+    // Перезагрузка: запрос сразу по адресу из кэша, имена проверяются в фоне
+    stub.now_us = 0;
+    stub.dns_queries = 0;
+    if (!kv_init(&kv, KV_OFFSET) || !ntp_cache_load(&cache, &kv, &cfg) ||
+        !ntp_sync_start(&sync, &cfg, &cache, &transport, NTP_SYNC_TIMEOUT_MS, 0, stub.now_us) ||
+        !sync.from_cache || sync.current != 1 || ntp_stub_run(&stub, &sync) != NTP_SYNC_DONE) {
+        LOG_ERROR("Test 25 failed: warm sync");
+        return false;
+    }
+    uint32_t warm_ms = (uint32_t)(sync.first_sync_us / 1000);
+    if (warm_ms >= cold_ms || stub.dns_queries != 3 || cache.servers[1].score != 4) {
+        LOG_ERROR("Test 25 failed: warm sync result (%u ms, %u DNS queries)", (unsigned)warm_ms,
+                  (unsigned)stub.dns_queries);
+        return false;
+    }
+
+    // Лучший по кэшу сервер перестал отвечать: после ожидания запрос уходит следующему
+    cache.servers[2].score = NTP_CACHE_SCORE_MAX;
+    stub.now_us = 0;
+    if (!ntp_sync_start(&sync, &cfg, &cache, &transport, NTP_SYNC_TIMEOUT_MS, 0, stub.now_us) ||
+        sync.current != 2 || ntp_stub_run(&stub, &sync) != NTP_SYNC_DONE ||
+        sync.first_sync_us < NTP_SYNC_TIMEOUT_MS * 1000u || cache.servers[2].score != NTP_CACHE_SCORE_MAX - 2) {
+        LOG_ERROR("Test 25 failed: fallback after timeout");
+        return false;
+    }
+
+    // Сменилось имя сервера: его запись в кэше не используется
+    if (!ntp_cache_save(&cache, &kv)) {
+        LOG_ERROR("Test 25 failed: cache save after fallback");
+        return false;
+    }
+    snprintf(cfg.ntp_servers[1], NTP_SERVER_MAX_LEN, "%s", "time.example.org");
+    if (!ntp_cache_load(&cache, &kv, &cfg) || cache.servers[1].ipv4 != 0 || cache.servers[0].ipv4 != 0x0A000001u) {
+        LOG_ERROR("Test 25 failed: renamed server kept cached entry");
+        return false;
+    }
+
+    LOG_INFO("Test 25 completed successfully (time to first sync: %u ms without cache, %u ms with cache)",
+             (unsigned)cold_ms, (unsigned)warm_ms);
+    return true;
+}
+
+// Читатель на втором ядре: проверка, что все поля копии относятся к одной версии
+static volatile bool shared_stop;
+static volatile uint32_t shared_reads;
+static volatile uint32_t shared_torn;
+static uint32_t shared_base;
+
+// Версия k: поля выводятся из k, поколение публикации равно shared_base + k
+static void shared_fill(settings_t *cfg, uint16_t k) {
+    cfg->anim_lags_period_s = k;
+    cfg->brightness = (uint8_t)k;
+    cfg->night_on_hour = (uint8_t)(k >> 3);
+    cfg->anim_flags = (uint16_t)(k * 3u);
+    snprintf(cfg->wifi_ssid, WIFI_SSID_MAX_LEN, "ssid-%05u", (unsigned)k);
+    memset(cfg->ntp_servers[NTP_MAX_SERVERS - 1], 'a' + k % 26, NTP_SERVER_MAX_LEN - 1);
+}
+
+static void shared_reader_loop(void) {
+    settings_t snap, expected;
+    uint32_t last = 0;
+    while (!shared_stop) {
+        uint32_t generation = settings_shared_read(&snap);
+        if (generation <= shared_base) {
+            continue;
+        }
+        uint16_t k = snap.anim_lags_period_s;
+        memcpy(&expected, &snap, sizeof(expected));
+        shared_fill(&expected, k);
+        if (memcmp(&expected, &snap, sizeof(snap)) != 0 || (uint16_t)(generation - shared_base) != k ||
+            generation < last) {
+            shared_torn++;
+        }
+        last = generation;
+        shared_reads++;
+    }
+}
+
+#ifdef VFD_HOST_BUILD
+static void *shared_reader_entry(void *arg) {
+    (void)arg;
+    shared_reader_loop();
+    return NULL;
+}
+#endif
+
+static bool test_shared_snapshot(void) {
+    LOG_INFO("Test 26: Seqlock-Published Settings Snapshot");
+    settings_t cfg;
+    settings_init_default(&cfg);
+    shared_fill(&cfg, 0);
+    shared_base = settings_shared_publish(&cfg);
+    settings_t snap;
+    if (shared_base == 0 || settings_shared_read(&snap) != shared_base || !compare_settings(&cfg, &snap)) {
+        LOG_ERROR("Test 26 failed: publish and read");
+        return false;
+    }
+
+    shared_stop = false;
+    shared_reads = 0;
+    shared_torn = 0;
+#ifdef VFD_HOST_BUILD
+    pthread_t reader;
+    pthread_create(&reader, NULL, shared_reader_entry, NULL);
+#else
+    multicore_launch_core1(shared_reader_loop);
+#endif
+    const uint16_t versions = 50000;
+    for (uint16_t k = 1; k <= versions; k++) {
+        shared_fill(&cfg, k);
+        if (settings_shared_publish(&cfg) != shared_base + k) {
+            LOG_ERROR("Test 26 failed: generation out of order");
+            shared_stop = true;
+            break;
+        }
+    }
+    // Читатель должен увидеть последнюю версию
+    while (!shared_stop && shared_reads < 100) {
+        tight_loop_contents();
+    }
+    shared_stop = true;
+#ifdef VFD_HOST_BUILD
+    pthread_join(reader, NULL);
+#else
+    sleep_ms(1);
+    multicore_reset_core1();
+#endif
+
+    settings_shared_stats_t stats;
+    settings_shared_get_stats(&stats);
+    if (shared_torn != 0 || stats.generation != shared_base + versions ||
+        settings_shared_read(&snap) != stats.generation || snap.anim_lags_period_s != versions) {
+        LOG_ERROR("Test 26 failed: %u torn reads of %u", (unsigned)shared_torn, (unsigned)shared_reads);
+        return false;
+    }
+
+    LOG_INFO("Test 26 completed successfully (%u reads during %u publications, %u retries, 0 torn)",
+             (unsigned)shared_reads, (unsigned)versions, (unsigned)stats.read_retries);
+    return true;
+}
+
+static bool test_settings_schema(void) {
+    LOG_INFO("Test 27: Settings Schema Table");
+    // Таблица покрывает структуру без пропусков
+    uint32_t end = 0;
+    for (size_t i = 0; i < SETTINGS_FIELD_COUNT; i++) {
+        const settings_field_t *field = &settings_fields[i];
+        if (field->offset != end) {
+            LOG_ERROR("Test 27 failed: gap before field %s", field->name);
+            return false;
+        }
+        end += (uint32_t)field->size * field->count;
+    }
+    if (end != sizeof(settings_t) || SETTINGS_META_FIELDS != (SETTINGS_CHANGED(magic) | SETTINGS_CHANGED(version) |
+                                                              SETTINGS_CHANGED(size) | SETTINGS_CHANGED(crc32))) {
+        LOG_ERROR("Test 27 failed: table covers %u of %u bytes", (unsigned)end, (unsigned)sizeof(settings_t));
+        return false;
+    }
+
+    // Значения по умолчанию - копия образа, проходящая проверку
+    settings_t cfg, changed;
+    settings_init_default(&cfg);
+    if (memcmp(&cfg, &settings_default_image, sizeof(cfg)) != 0 || !settings_validate(&cfg) ||
+        cfg.size != sizeof(settings_t) || strcmp(cfg.ntp_servers[0], DEFAULT_NTP_SERVER) != 0 ||
+        cfg.ntp_servers[1][0] != '\0' || cfg.brightness != 50) {
+        LOG_ERROR("Test 27 failed: default image");
+        return false;
+    }
+
+    // Маска изменений; байты после \0 строки не считаются изменением
+    memcpy(&changed, &cfg, sizeof(changed));
+    changed.brightness = 80;
+    snprintf(changed.ntp_servers[2], NTP_SERVER_MAX_LEN, "%s", "time.example.org");
+    changed.wifi_ssid[WIFI_SSID_MAX_LEN - 1] = 'x';
+    changed.crc32 = 0x12345678;
+    uint32_t mask = settings_diff(&cfg, &changed);
+    if (settings_diff(&cfg, &cfg) != 0 ||
+        mask != (SETTINGS_CHANGED(brightness) | SETTINGS_CHANGED(ntp_servers) | SETTINGS_CHANGED(crc32)) ||
+        (mask & SETTINGS_USER_FIELDS) != (SETTINGS_CHANGED(brightness) | SETTINGS_CHANGED(ntp_servers))) {
+        LOG_ERROR("Test 27 failed: diff mask 0x%08X", (unsigned)mask);
+        return false;
+    }
+
+    // Границы из таблицы: допустимые крайние значения проходят, выход за них - нет
+    memcpy(&changed, &cfg, sizeof(changed));
+    changed.brightness = BRIGHTNESS_MAX;
+    changed.night_on_hour = HOUR_MAX;
+    changed.night_off_hour = HOUR_MIN;
+    if (!settings_validate(&changed)) {
+        LOG_ERROR("Test 27 failed: boundary values rejected");
+        return false;
+    }
+    static const struct {
+        size_t offset;
+        size_t len;
+        uint8_t fill;
+    } invalid[] = {
+        { offsetof(settings_t, brightness), 1, BRIGHTNESS_MAX + 1 },
+        { offsetof(settings_t, night_off_hour), 1, HOUR_MAX + 1 },
+        { offsetof(settings_t, night_on_hour), 1, HOUR_MAX + 1 },
+        { offsetof(settings_t, size), 1, 0x00 },
+        { offsetof(settings_t, wifi_pass), WIFI_PASS_MAX_LEN, 'p' },
+        { offsetof(settings_t, ntp_servers) + 3 * NTP_SERVER_MAX_LEN, NTP_SERVER_MAX_LEN, 'n' },
+    };
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        memcpy(&changed, &cfg, sizeof(changed));
+        memset((uint8_t *)&changed + invalid[i].offset, invalid[i].fill, invalid[i].len);
+        if (settings_validate(&changed)) {
+            LOG_ERROR("Test 27 failed: invalid case %u accepted", (unsigned)i);
+            return false;
+        }
+    }
+
+    print_settings(&cfg, "Schema Default Settings", FLASH_OFFSET);
+    LOG_INFO("Test 27 completed successfully (%u fields)", (unsigned)SETTINGS_FIELD_COUNT);
+    return true;
+}
+
+static profiles_t profiles;
+
+static bool erase_profile_select(void) {
+    for (uint32_t i = 0; i < PROFILE_SELECT_SECTORS; i++) {
+        if (!erase_flash_sector(PROFILE_SELECT_OFFSET + i * FLASH_SECTOR_SIZE)) return false;
+    }
+    return true;
+}
+
+static bool test_profiles(void) {
+    LOG_INFO("Test 28: Wi-Fi And Display Profiles");
+    if (!erase_kv_region() || !erase_profile_select() || !kv_init(&kv, KV_OFFSET) ||
+        !profiles_init(&profiles, &kv, PROFILE_SELECT_OFFSET) || profiles.network || profiles.display) {
+        LOG_ERROR("Test 28 failed: empty profiles");
+        return false;
+    }
+
+    static const profile_network_t networks[] = {
+        { "home", "HomeNet", "HomeSecret-1", 10 },
+        { "office", "OfficeNet", "OfficeSecret-2", 5 },
+        { "phone", "PhoneAP", "PhoneSecret-3", 1 },
+    };
+    static const profile_display_t displays[] = {
+        { "day", 80, FLAG_ADAPTIVE_BRIGHTNESS, ANIM_FLAG_1 | ANIM_FLAG_2, 22, 6 },
+        { "night", 10, FLAG_NIGHT_MODE, 0, 23, 7 },
+    };
+    for (uint8_t i = 0; i < 3; i++) {
+        if (!profiles_set_network(&profiles, i, &networks[i])) {
+            LOG_ERROR("Test 28 failed: set network %u", i);
+            return false;
+        }
+    }
+    for (uint8_t i = 0; i < 2; i++) {
+        if (!profiles_set_display(&profiles, i, &displays[i])) {
+            LOG_ERROR("Test 28 failed: set display %u", i);
+            return false;
+        }
+    }
+    profile_display_t bad = displays[0];
+    bad.brightness = BRIGHTNESS_MAX + 1;
+    if (profiles_set_display(&profiles, 2, &bad) || profiles_select(&profiles, 5, 0)) {
+        LOG_ERROR("Test 28 failed: invalid profile accepted");
+        return false;
+    }
+
+    // Пароли в хранилище зашифрованы
+    const uint8_t *region = flash_hal_xip_ptr(KV_OFFSET);
+    for (size_t i = 0; i + 12 <= KV_SIZE; i++) {
+        if (memcmp(region + i, "HomeSecret-1", 12) == 0) {
+            LOG_ERROR("Test 28 failed: plaintext password in flash");
+            return false;
+        }
+    }
+
+    // После перезагрузки без выбора активна сеть с наибольшим приоритетом и первый набор
+    if (!kv_init(&kv, KV_OFFSET) || !profiles_init(&profiles, &kv, PROFILE_SELECT_OFFSET) ||
+        profiles_network_index(&profiles) != 0 || profiles_display_index(&profiles) != 0 ||
+        strcmp(profiles.network->pass, "HomeSecret-1") != 0 || profiles_next_network(&profiles, 1u << 0) != 1) {
+        LOG_ERROR("Test 28 failed: reload");
+        return false;
+    }
+
+    // Переключение: указатели в RAM и одна страница без стирания
+    flash_hal_stats_t before, after;
+    flash_hal_get_stats(&before);
+    if (!profiles_select(&profiles, 1, 1)) {
+        LOG_ERROR("Test 28 failed: select");
+        return false;
+    }
+    flash_hal_get_stats(&after);
+    if (after.erase_ops != before.erase_ops || after.program_ops != before.program_ops + 1 ||
+        after.program_bytes - before.program_bytes != FLASH_PAGE_SIZE) {
+        LOG_ERROR("Test 28 failed: switch cost %u erases, %u programs", (unsigned)(after.erase_ops - before.erase_ops),
+                  (unsigned)(after.program_ops - before.program_ops));
+        return false;
+    }
+    settings_t cfg;
+    settings_init_default(&cfg);
+    profiles_apply(&profiles, &cfg);
+    if (strcmp(cfg.wifi_ssid, "OfficeNet") != 0 || strcmp(cfg.wifi_pass, "OfficeSecret-2") != 0 ||
+        cfg.brightness != 10 || !(cfg.flags & FLAG_NIGHT_MODE) || (cfg.flags & FLAG_ADAPTIVE_BRIGHTNESS) ||
+        cfg.night_off_hour != 23 || !settings_validate(&cfg)) {
+        LOG_ERROR("Test 28 failed: apply");
+        return false;
+    }
+
+    // Одно стирание на PROFILE_SELECT_SLOTS переключений, заполненный сектор при этом не стирается
+    uint8_t wrap_network = PROFILE_NONE, wrap_display = PROFILE_NONE;
+    for (uint32_t i = 0; i < PROFILE_SELECT_SLOTS + 44; i++) {
+        if (!profiles_select(&profiles, (uint8_t)(i % 3), (uint8_t)(i % 2))) {
+            LOG_ERROR("Test 28 failed: switch %u", (unsigned)i);
+            return false;
+        }
+        if (profiles.select_sector == 0 && profiles.select_slot == PROFILE_SELECT_SLOTS) {
+            wrap_network = profiles_network_index(&profiles);
+            wrap_display = profiles_display_index(&profiles);
+        }
+    }
+    uint8_t network = profiles_network_index(&profiles);
+    uint8_t display = profiles_display_index(&profiles);
+    if (profiles.stats.select_erases != 1 || !profiles_init(&profiles, &kv, PROFILE_SELECT_OFFSET) ||
+        profiles_network_index(&profiles) != network || profiles_display_index(&profiles) != display) {
+        LOG_ERROR("Test 28 failed: selection after sector wrap");
+        return false;
+    }
+
+    // Запись, прерванная отключением питания, пропускается
+    uint8_t torn[PROFILE_SELECT_SIZE];
+    memset(torn, 0xFF, sizeof(torn));
+    memset(torn, 0x00, 6);
+    uint32_t torn_offset = PROFILE_SELECT_OFFSET + profiles.select_sector * FLASH_SECTOR_SIZE +
+                           profiles.select_slot * PROFILE_SELECT_SIZE;
+    if (!write_flash_range(torn_offset, torn, sizeof(torn)) ||
+        !profiles_init(&profiles, &kv, PROFILE_SELECT_OFFSET) || profiles_network_index(&profiles) != network ||
+        !profiles_select(&profiles, 2, 0) || !profiles_init(&profiles, &kv, PROFILE_SELECT_OFFSET) ||
+        profiles_network_index(&profiles) != 2) {
+        LOG_ERROR("Test 28 failed: torn select record");
+        return false;
+    }
+
+    // Питание пропало после стирания другого сектора до записи: действует последний выбор
+    // заполненного сектора, следующее переключение снова стирает другой сектор
+    if (profiles.select_sector != 1 || !erase_flash_sector(PROFILE_SELECT_OFFSET + FLASH_SECTOR_SIZE) ||
+        !profiles_init(&profiles, &kv, PROFILE_SELECT_OFFSET) || profiles.select_sector != 0 ||
+        profiles_network_index(&profiles) != wrap_network || profiles_display_index(&profiles) != wrap_display ||
+        !profiles_select(&profiles, 2, 1) || profiles.select_sector != 1 ||
+        !profiles_init(&profiles, &kv, PROFILE_SELECT_OFFSET) || profiles_network_index(&profiles) != 2) {
+        LOG_ERROR("Test 28 failed: selection lost between erase and write");
+        return false;
+    }
+
+    // Удалённая активная сеть: выбор возвращается к сети с наибольшим приоритетом
+    if (!profiles_set_network(&profiles, 2, NULL) || profiles.network ||
+        !profiles_init(&profiles, &kv, PROFILE_SELECT_OFFSET) || profiles_network_index(&profiles) != 0) {
+        LOG_ERROR("Test 28 failed: deleted active network");
+        return false;
+    }
+
+    LOG_INFO("Test 28 completed successfully (switch: 1 page program, 0 erases)");
+    return true;
+}
+
+// Порт в памяти: запросы клиента и ответы устройства; запись принимает не больше FIFO UART за вызов
+typedef struct {
+    uint8_t in[2048];
+    size_t in_len, in_pos;
+    uint8_t out[4096];
+    size_t out_len, out_pos;
+    uint8_t seq;
+} prov_link_t;
+
+static prov_link_t prov_link;
+static provision_t provision;
+
+static size_t prov_link_read(void *ctx, uint8_t *buf, size_t len) {
+    prov_link_t *link = ctx;
+    size_t n = link->in_len - link->in_pos < len ? link->in_len - link->in_pos : len;
+    memcpy(buf, link->in + link->in_pos, n);
+    link->in_pos += n;
+    return n;
+}
+
+static size_t prov_link_write(void *ctx, const uint8_t *buf, size_t len) {
+    prov_link_t *link = ctx;
+    size_t n = len < 32 ? len : 32;
+    if (n > sizeof(link->out) - link->out_len) {
+        n = sizeof(link->out) - link->out_len;
+    }
+    memcpy(link->out + link->out_len, buf, n);
+    link->out_len += n;
+    return n;
+}
+
+static const provision_io_t prov_io = { &prov_link, prov_link_read, prov_link_write };
+
+static void prov_send(uint8_t cmd, const void *data, size_t len) {
+    prov_link.in_len += provision_frame_encode(cmd, prov_link.seq++, data, len, prov_link.in + prov_link.in_len);
+}
+
+static void prov_run(void) {
+    while (prov_link.in_pos < prov_link.in_len || provision.rx_len || provision.tx_len) {
+        provision_poll(&provision);
+    }
+}
+
+// Следующий ответ: код результата и данные после него
+static int prov_reply(uint8_t cmd, const uint8_t **data, size_t *len) {
+    provision_frame_t frame;
+    size_t consumed;
+    provision_frame_result_t result = provision_frame_find(prov_link.out + prov_link.out_pos,
+                                                           prov_link.out_len - prov_link.out_pos, &frame, &consumed);
+    prov_link.out_pos += consumed;
+    if (result != PROVISION_FRAME_OK || frame.cmd != (cmd | PROVISION_RESPONSE) || frame.len < 1) {
+        return -1;
+    }
+    if (data) {
+        *data = frame.data + 1;
+        *len = frame.len - 1u;
+    }
+    return frame.data[0];
+}
+
+static void prov_chunk_request(uint8_t cmd, size_t offset, const uint8_t *src, size_t len) {
+    uint8_t buf[2 + PROVISION_MAX_DATA];
+    buf[0] = (uint8_t)offset;
+    buf[1] = (uint8_t)(offset >> 8);
+    if (src) {
+        memcpy(buf + 2, src + offset, len);
+    } else {
+        buf[2] = (uint8_t)len;
+        buf[3] = (uint8_t)(len >> 8);
+        len = 2;
+    }
+    prov_send(cmd, buf, 2 + len);
+}
+
+static bool test_provisioning(void) {
+    LOG_INFO("Test 29: Binary Provisioning Protocol");
+    settings_t cfg;
+    settings_init_default(&cfg);
+    if (!erase_settings_log() || !settings_save(&cfg, FLASH_OFFSET) || !settings_load(&cfg, FLASH_OFFSET)) {
+        LOG_ERROR("Test 29 failed: initial settings");
+        return false;
+    }
+    memset(&prov_link, 0, sizeof(prov_link));
+    provision_init(&provision, &prov_io, FLASH_OFFSET, &cfg);
+
+    // Пакет запросов без ожидания ответов, перед ним текст журнала и кадр с повреждённой CRC32
+    static const char noise[] = "[INFO] boot\r\n\xA5";
+    memcpy(prov_link.in, noise, sizeof(noise) - 1);
+    prov_link.in_len = sizeof(noise) - 1;
+    prov_send(PROVISION_CMD_PING, NULL, 0);
+    prov_link.in[prov_link.in_len - 1] ^= 0x01;
+    uint8_t brightness[] = { SETTINGS_ID_brightness, 55 };
+    uint8_t too_bright[] = { SETTINGS_ID_brightness, BRIGHTNESS_MAX + 1 };
+    uint8_t field_id = SETTINGS_ID_brightness;
+    uint8_t magic[5] = { SETTINGS_ID_magic };
+    uint16_t lags = 330;
+    const size_t lags_offset = offsetof(settings_t, anim_lags_period_s);
+    uint8_t patch[2 + sizeof(lags)] = { (uint8_t)lags_offset, (uint8_t)(lags_offset >> 8) };
+    memcpy(patch + 2, &lags, sizeof(lags));
+
+    prov_send(PROVISION_CMD_PING, NULL, 0);
+    prov_send(PROVISION_CMD_FIELD_SET, brightness, sizeof(brightness));
+    prov_send(PROVISION_CMD_FIELD_SET, too_bright, sizeof(too_bright));
+    prov_send(PROVISION_CMD_FIELD_GET, &field_id, 1);
+    prov_send(PROVISION_CMD_FIELD_SET, magic, sizeof(magic));
+    prov_send(PROVISION_CMD_PATCH, patch, sizeof(patch));
+    prov_send(PROVISION_CMD_COMMIT, NULL, 0);
+    prov_run();
+
+    const uint8_t *data;
+    size_t len;
+    bool ok = prov_reply(PROVISION_CMD_PING, &data, &len) == PROVISION_OK && len == 8 && data[0] == PROVISION_VERSION;
+    ok = ok && prov_reply(PROVISION_CMD_FIELD_SET, NULL, NULL) == PROVISION_OK;
+    ok = ok && prov_reply(PROVISION_CMD_FIELD_SET, NULL, NULL) == PROVISION_ERR_INVALID;
+    ok = ok && prov_reply(PROVISION_CMD_FIELD_GET, &data, &len) == PROVISION_OK && len == 1 && data[0] == 55;
+    ok = ok && prov_reply(PROVISION_CMD_FIELD_SET, NULL, NULL) == PROVISION_ERR_ARGUMENT;
+    ok = ok && prov_reply(PROVISION_CMD_PATCH, NULL, NULL) == PROVISION_OK;
+    ok = ok && prov_reply(PROVISION_CMD_COMMIT, &data, &len) == PROVISION_OK && len == 4;
+    if (!ok || provision.stats.bad_frames != 1 || provision.stats.frames != 7) {
+        LOG_ERROR("Test 29 failed: pipelined requests (%u frames, %u bad)", (unsigned)provision.stats.frames,
+                  (unsigned)provision.stats.bad_frames);
+        return false;
+    }
+    settings_t loaded;
+    if (!settings_load(&loaded, FLASH_OFFSET) || loaded.brightness != 55 || loaded.anim_lags_period_s != 330 ||
+        settings_shared_read(&cfg) == 0 || cfg.brightness != 55) {
+        LOG_ERROR("Test 29 failed: committed settings");
+        return false;
+    }
+
+    // Резервная копия записи журнала блоками и восстановление поверх изменённого черновика
+    static settings_record_t backup;
+    const size_t chunk = 100;
+    for (size_t offset = 0; offset < sizeof(backup); offset += chunk) {
+        prov_chunk_request(PROVISION_CMD_RECORD_READ, offset, NULL,
+                           sizeof(backup) - offset < chunk ? sizeof(backup) - offset : chunk);
+    }
+    prov_run();
+    for (size_t offset = 0; offset < sizeof(backup); offset += chunk) {
+        if (prov_reply(PROVISION_CMD_RECORD_READ, &data, &len) != PROVISION_OK || len < 2) {
+            LOG_ERROR("Test 29 failed: record read at %u", (unsigned)offset);
+            return false;
+        }
+        memcpy((uint8_t *)&backup + offset, data + 2, len - 2);
+    }
+    const settings_t *view = settings_view(FLASH_OFFSET);
+    if (!view || memcmp(&backup, (const uint8_t *)view - offsetof(settings_record_t, data), sizeof(backup)) != 0) {
+        LOG_ERROR("Test 29 failed: record dump differs from flash");
+        return false;
+    }
+
+    brightness[1] = 10;
+    prov_send(PROVISION_CMD_FIELD_SET, brightness, sizeof(brightness));
+    for (size_t offset = 0; offset < sizeof(backup); offset += chunk) {
+        prov_chunk_request(PROVISION_CMD_RECORD_WRITE, offset, (const uint8_t *)&backup,
+                           sizeof(backup) - offset < chunk ? sizeof(backup) - offset : chunk);
+    }
+    prov_send(PROVISION_CMD_RECORD_APPLY, NULL, 0);
+    ((uint8_t *)&backup)[offsetof(settings_record_t, data) + offsetof(settings_t, wifi_ssid)] ^= 0x20;
+    prov_chunk_request(PROVISION_CMD_RECORD_WRITE, 0, (const uint8_t *)&backup, chunk);
+    prov_send(PROVISION_CMD_RECORD_APPLY, NULL, 0);
+    prov_run();
+    ok = prov_reply(PROVISION_CMD_FIELD_SET, NULL, NULL) == PROVISION_OK;
+    for (size_t offset = 0; ok && offset < sizeof(backup); offset += chunk) {
+        ok = prov_reply(PROVISION_CMD_RECORD_WRITE, NULL, NULL) == PROVISION_OK;
+    }
+    ok = ok && prov_reply(PROVISION_CMD_RECORD_APPLY, NULL, NULL) == PROVISION_OK;
+    ok = ok && prov_reply(PROVISION_CMD_RECORD_WRITE, NULL, NULL) == PROVISION_OK;
+    ok = ok && prov_reply(PROVISION_CMD_RECORD_APPLY, NULL, NULL) == PROVISION_ERR_INVALID;
+    if (!ok || provision.draft.brightness != 55) {
+        LOG_ERROR("Test 29 failed: record restore");
+        return false;
+    }
+
+    // Настройки одним закодированным блоком и чтение черновика обратно
+    settings_t target = loaded;
+    snprintf(target.wifi_ssid, WIFI_SSID_MAX_LEN, "%s", "ProvisionedAP");
+    snprintf(target.wifi_pass, WIFI_PASS_MAX_LEN, "%s", "Provisioned-Pass");
+    target.brightness = 90;
+    uint8_t blob[SETTINGS_CODEC_MAX_LEN];
+    size_t blob_len = settings_encode(&target, blob, sizeof(blob));
+    uint8_t total[2] = { (uint8_t)blob_len, (uint8_t)(blob_len >> 8) };
+    for (size_t offset = 0; offset < blob_len; offset += chunk) {
+        prov_chunk_request(PROVISION_CMD_BLOB_WRITE, offset, blob, blob_len - offset < chunk ? blob_len - offset : chunk);
+        if (offset == 0) {
+            prov_chunk_request(PROVISION_CMD_BLOB_READ, 0, NULL, 16);  // Чтение черновика посреди загрузки
+        }
+    }
+    prov_send(PROVISION_CMD_BLOB_APPLY, total, sizeof(total));
+    prov_chunk_request(PROVISION_CMD_BLOB_READ, 0, NULL, blob_len);
+    prov_run();
+    for (size_t offset = 0; offset < blob_len; offset += chunk) {
+        prov_reply(PROVISION_CMD_BLOB_WRITE, NULL, NULL);
+        if (offset == 0 && prov_reply(PROVISION_CMD_BLOB_READ, NULL, NULL) != PROVISION_OK) {
+            LOG_ERROR("Test 29 failed: draft read during upload");
+            return false;
+        }
+    }
+    uint8_t readback[SETTINGS_CODEC_MAX_LEN];
+    settings_t decoded;
+    if (prov_reply(PROVISION_CMD_BLOB_APPLY, NULL, NULL) != PROVISION_OK ||
+        prov_reply(PROVISION_CMD_BLOB_READ, &data, &len) != PROVISION_OK || len != 2 + blob_len) {
+        LOG_ERROR("Test 29 failed: blob transfer");
+        return false;
+    }
+    memcpy(readback, data + 2, blob_len);
+    if (!settings_decode(readback, blob_len, &decoded) || !compare_settings(&decoded, &target) ||
+        provision.stats.errors != 3) {
+        LOG_ERROR("Test 29 failed: blob readback");
+        return false;
+    }
+
+    LOG_INFO("Test 29 completed successfully (%u frames, %u bytes in, %u bytes out)", (unsigned)provision.stats.frames,
+             (unsigned)provision.stats.bytes_in, (unsigned)provision.stats.bytes_out);
+    return true;
+}
+
+int main(void) {
+    stdio_init_all();
+    settings_shared_init();
+#ifndef VFD_HOST_BUILD
+    sleep_ms(1000);  // Ожидание стабилизации UART (TODO: Replace with proper uart_init in production firmware)
+#endif
+
+    printf(COLOR_YELLOW "\n=== Settings Management Test Suite ===\n" COLOR_RESET);
+    printf(COLOR_CYAN "Expected Settings Size: " COLOR_RESET "%u bytes\n", (unsigned)sizeof(settings_t));
+
+    static bool (*const tests[])(void) = {
+        test_default_settings,
+        test_edge_cases,
+        test_invalid_data,
+        test_corrupted_data,
+        test_buffer_overflow,
+        test_encryption,
+        test_invalid_values,
+        test_log_wraparound,
+        test_nor_semantics,
+        test_range_write,
+        test_power_cut_fallback,
+        test_zero_copy_view,
+        test_deferred_save,
+        test_async_flash_jobs,
+        test_schema_migration,
+        test_deferred_logging,
+        test_authenticated_encryption,
+        test_compact_codec,
+        test_power_cut_injection,
+        test_write_verification,
+        test_kv_store,
+        test_time_series_log,
+        test_flash_scratch_arena,
+        test_warm_boot_cache,
+        test_ntp_server_cache,
+        test_shared_snapshot,
+        test_settings_schema,
+        test_profiles,
+        test_provisioning,
+    };
+
+    int passed_tests = 0;
+    int failed_tests = 0;
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        bool result = tests[i]();
+        result ? passed_tests++ : failed_tests++;
+        log_flush();  // Вывод отложенных сообщений между тестами
+    }
+
+    if (failed_tests == 0) {
+        LOG_INFO("All tests passed successfully");
+    } else {
+        LOG_ERROR("Some tests failed");
+    }
+
+    printf(COLOR_YELLOW "\nTest Summary:\n" COLOR_RESET);
+    printf(COLOR_GREEN "Passed: %d\n" COLOR_RESET, passed_tests);
+    printf(COLOR_RED "Failed: %d\n" COLOR_RESET, failed_tests);
+    printf(COLOR_CYAN "Total: %d\n" COLOR_RESET, passed_tests + failed_tests);
+
+    flash_hal_stats_t stats;
+    flash_hal_get_stats(&stats);
+    printf(COLOR_CYAN "Flash erases       : " COLOR_RESET "%u (%llu bytes)\n",
+           (unsigned)stats.erase_ops, (unsigned long long)stats.erase_bytes);
+    printf(COLOR_CYAN "Flash programs     : " COLOR_RESET "%u (%llu bytes)\n",
+           (unsigned)stats.program_ops, (unsigned long long)stats.program_bytes);
+    flash_verify_stats_t verify;
+    flash_verify_get_stats(&verify);
+    printf(COLOR_CYAN "Flash verifies     : " COLOR_RESET "%u (%u pages, %u retries, %llu us)\n",
+           (unsigned)verify.verify_ops, (unsigned)verify.verify_pages, (unsigned)verify.retries,
+           (unsigned long long)verify.total_us);
+    flash_scratch_stats_t scratch;
+    flash_scratch_get_stats(&scratch);
+    printf(COLOR_CYAN "Flash scratch peak : " COLOR_RESET "%u of %u bytes (%u borrows)\n",
+           (unsigned)scratch.peak, (unsigned)FLASH_SCRATCH_SIZE, (unsigned)scratch.borrows);
+
+    if (!erase_settings_log()) {
+        LOG_ERROR("Failed to clear flash at end");
+    }
+    print_flash_contents(FLASH_OFFSET);
+    log_flush();
+    printf(COLOR_YELLOW "=== Test Suite Completed ===\n" COLOR_RESET);
+
+#ifndef VFD_HOST_BUILD
+    // Плата остаётся доступной для настройки по UART (provision_host -p <порт>)
+    settings_t provision_cfg;
+    settings_init_default(&provision_cfg);
+    provision_init(&provision, &provision_stdio_uart, FLASH_OFFSET, &provision_cfg);
+    for (;;) {
+        provision_poll(&provision);
+        tight_loop_contents();
+    }
+#endif
     return failed_tests == 0 ? 0 : 1;
 }
\ No newline at end of file